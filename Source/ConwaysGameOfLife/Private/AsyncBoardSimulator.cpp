@@ -0,0 +1,126 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "AsyncBoardSimulator.h"
+
+#include "GameBoard.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+
+// How long the background thread sleeps when it is waiting on the consumer. Consuming a snapshot wakes it up early.
+constexpr uint32 kIdleWaitMilliseconds = 5;
+
+FAsyncBoardSimulator::FAsyncBoardSimulator(const FBoardSnapshot& InitialSnapshot, const FLifeRule& Rule, float TargetGenerationsPerSecond, int32 MaxStepsPerFrame, int32 MaxPendingSnapshots) :
+	mPendingSnapshots(FMath::Max(MaxPendingSnapshots, 1) + 1),
+	mCurrentSnapshot(InitialSnapshot),
+	mRule(Rule),
+	mTargetGenerationsPerSecond(FMath::Max(TargetGenerationsPerSecond, 0.0f)),
+	mMaxStepsPerFrame(FMath::Max(MaxStepsPerFrame, 0)),
+	mMaxPendingSnapshots(FMath::Max(MaxPendingSnapshots, 1)),
+	mStepsSinceLastConsume(0),
+	mStopRequested(false),
+	mWakeEvent(FPlatformProcess::GetSynchEventFromPool(false)),
+	mThread(nullptr)
+{
+	mThread = FRunnableThread::Create(this, TEXT("GameOfLifeAsyncSimulation"));
+}
+
+FAsyncBoardSimulator::~FAsyncBoardSimulator()
+{
+	StopAndWait();
+
+	FPlatformProcess::ReturnSynchEventToPool(mWakeEvent);
+	mWakeEvent = nullptr;
+}
+
+bool FAsyncBoardSimulator::ConsumeLatestSnapshot(FBoardSnapshot& SnapshotOut)
+{
+	// Skip over everything but the newest snapshot. Older ones would only be drawn for a frame we are already late for.
+	bool bFoundSnapshot = false;
+	FBoardSnapshot Snapshot;
+	while (mPendingSnapshots.Dequeue(Snapshot))
+	{
+		SnapshotOut = MoveTemp(Snapshot);
+		bFoundSnapshot = true;
+	}
+
+	// A new frame has started, so the background thread may run ahead again.
+	mStepsSinceLastConsume = 0;
+	mWakeEvent->Trigger();
+
+	return bFoundSnapshot;
+}
+
+void FAsyncBoardSimulator::SetTargetGenerationsPerSecond(float TargetGenerationsPerSecond)
+{
+	mTargetGenerationsPerSecond = FMath::Max(TargetGenerationsPerSecond, 0.0f);
+	mWakeEvent->Trigger();
+}
+
+void FAsyncBoardSimulator::SetMaxStepsPerFrame(int32 MaxStepsPerFrame)
+{
+	mMaxStepsPerFrame = FMath::Max(MaxStepsPerFrame, 0);
+	mWakeEvent->Trigger();
+}
+
+int32 FAsyncBoardSimulator::GetMaxPendingSnapshots() const
+{
+	return (int32)mMaxPendingSnapshots;
+}
+
+void FAsyncBoardSimulator::StopAndWait()
+{
+	if (mThread != nullptr)
+	{
+		// Kill calls Stop() and waits for Run() to return.
+		mThread->Kill(true);
+		delete mThread;
+		mThread = nullptr;
+	}
+}
+
+uint32 FAsyncBoardSimulator::Run()
+{
+	double NextStepTime = FPlatformTime::Seconds();
+
+	while (!mStopRequested)
+	{
+		// Don't get too far ahead of the consumer, either in steps this frame or in snapshots it hasn't picked up.
+		const int32 MaxStepsPerFrame = mMaxStepsPerFrame;
+		if ((MaxStepsPerFrame > 0 && mStepsSinceLastConsume >= MaxStepsPerFrame) || mPendingSnapshots.Count() >= mMaxPendingSnapshots)
+		{
+			mWakeEvent->Wait(kIdleWaitMilliseconds);
+			continue;
+		}
+
+		// If we're aiming for a specific rate, wait until the next step is due.
+		const float TargetGenerationsPerSecond = mTargetGenerationsPerSecond;
+		if (TargetGenerationsPerSecond > 0.0f)
+		{
+			const double CurrentTime = FPlatformTime::Seconds();
+			if (CurrentTime < NextStepTime)
+			{
+				mWakeEvent->Wait(FMath::Max(1u, (uint32)((NextStepTime - CurrentTime) * 1000.0)));
+				continue;
+			}
+
+			// If we've fallen behind, don't try to catch up with a burst of steps.
+			NextStepTime = FMath::Max(NextStepTime + 1.0 / TargetGenerationsPerSecond, CurrentTime);
+		}
+
+		mCurrentSnapshot.mRootNode = UGameBoard::ComputeNextGenerationOfRoot(mCurrentSnapshot.mRootNode, mRule);
+		++mCurrentSnapshot.mGeneration;
+
+		// We checked that there was room above, and we're the only producer, so this can't fail.
+		mPendingSnapshots.Enqueue(mCurrentSnapshot);
+		++mStepsSinceLastConsume;
+	}
+
+	return 0;
+}
+
+void FAsyncBoardSimulator::Stop()
+{
+	mStopRequested = true;
+	mWakeEvent->Trigger();
+}
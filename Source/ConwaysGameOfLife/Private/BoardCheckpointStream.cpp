@@ -0,0 +1,441 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardCheckpointStream.h"
+
+#include "BoardSerialization.h"
+#include "BoardUtilities.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+#include "QuadTreeNode.h"
+
+namespace
+{
+	// Marks the start of a checkpoint stream.
+	constexpr uint64 kFileMagic = 0x4D41455254534B43ull;
+
+	// Bumped whenever the layout of the file changes. Streams from other versions can't be read or continued.
+	constexpr uint32 kFileVersion = 1;
+
+	// Marks the start of each checkpoint, so a damaged stream is noticed instead of misread.
+	constexpr uint64 kCheckpointMagic = 0x544E494F504B4843ull;
+
+	// The start of a checkpoint stream.
+	struct FFileHeader
+	{
+		uint64 mMagic = kFileMagic;
+		uint32 mVersion = kFileVersion;
+		uint32 mReserved = 0;
+	};
+
+	// The start of each checkpoint, followed by mNumNodes node definitions.
+	struct FCheckpointHeader
+	{
+		uint64 mMagic = kCheckpointMagic;
+
+		// The generation the board was at.
+		int64 mGeneration = 0;
+
+		// The root of the board, as a hash if it has a definition and as a bitmap if it's an 8x8 block.
+		uint64 mRootReference = 0;
+
+		// The number of node definitions that follow.
+		int32 mNumNodes = 0;
+
+		// The level of the root.
+		uint8 mRootLevel = 0;
+
+		uint8 mPadding[3] = {};
+
+		// The rule the board followed, in "B3/S23" form.
+		FStoredRuleString mRuleString;
+	};
+
+	// Returns a word made from a node's child references, used to tell apart different nodes that share a hash. It's mixed differently from the node hash, so a collision of one says nothing about the other.
+	uint64 GetChildrenCheckWord(const uint64 (&Children)[ChildNode::kCount])
+	{
+		uint64 CheckWord = 0x2545F4914F6CDD1Dull;
+		for (const uint64 Child : Children)
+		{
+			CheckWord = (CheckWord ^ Child) * 0xFF51AFD7ED558CCDull;
+			CheckWord ^= CheckWord >> 33;
+		}
+
+		return CheckWord;
+	}
+
+	// Reads each whole checkpoint of the stream at Filename in order, handing its header, node definitions and size in bytes to Visitor until Visitor returns false.
+	// Returns the number of bytes at the start of the file read without finding anything damaged or cut short, or INDEX_NONE if the file can't be read or isn't a checkpoint stream.
+	template <typename VisitorType>
+	int64 ReadCheckpoints(const FString& Filename, VisitorType&& Visitor)
+	{
+		TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+		if (!File.IsValid())
+		{
+			return INDEX_NONE;
+		}
+
+		const int64 FileSize = File->Size();
+
+		FFileHeader FileHeader;
+		if (FileSize < (int64)sizeof(FFileHeader) || !File->Read((uint8*)&FileHeader, sizeof(FFileHeader)) || FileHeader.mMagic != kFileMagic || FileHeader.mVersion != kFileVersion)
+		{
+			return INDEX_NONE;
+		}
+
+		int64 Offset = sizeof(FFileHeader);
+		TArray<FNodeDefinition> NodeDefinitions;
+
+		while (Offset + (int64)sizeof(FCheckpointHeader) <= FileSize)
+		{
+			FCheckpointHeader Header;
+			if (!File->Read((uint8*)&Header, sizeof(FCheckpointHeader)) || Header.mMagic != kCheckpointMagic || Header.mNumNodes < 0)
+			{
+				break;
+			}
+
+			const int64 CheckpointBytes = sizeof(FCheckpointHeader) + (int64)Header.mNumNodes * sizeof(FNodeDefinition);
+			if (Offset + CheckpointBytes > FileSize)
+			{
+				break;
+			}
+
+			NodeDefinitions.SetNumUninitialized(Header.mNumNodes);
+			if (!File->Read((uint8*)NodeDefinitions.GetData(), (int64)Header.mNumNodes * sizeof(FNodeDefinition)))
+			{
+				break;
+			}
+
+			Offset += CheckpointBytes;
+
+			if (!Visitor(Header, NodeDefinitions, CheckpointBytes))
+			{
+				break;
+			}
+		}
+
+		return Offset;
+	}
+
+	// Rebuilds the node at Level referred to by Reference out of NodeDefinitions, reusing any node already in BuiltNodes.
+	// Returns nullptr if a definition is missing or doesn't rebuild into the node it was written for.
+	TSharedPtr<const QuadTreeNode> BuildNode(const uint64 Reference, const uint8 Level, const TMap<uint64, FNodeDefinition>& NodeDefinitions, TMap<uint64, TSharedPtr<const QuadTreeNode>>& BuiltNodes)
+	{
+		if (Level == QuadTreeNode::kBlockLevel)
+		{
+			return QuadTreeNode::CreateBlockFromBitmap(Reference);
+		}
+
+		if (const TSharedPtr<const QuadTreeNode>* BuiltNode = BuiltNodes.Find(Reference))
+		{
+			return *BuiltNode;
+		}
+
+		const FNodeDefinition* Definition = NodeDefinitions.Find(Reference);
+		if (Definition == nullptr || Definition->mLevel != Level)
+		{
+			return nullptr;
+		}
+
+		TSharedPtr<const QuadTreeNode> Node = Definition->Build([&NodeDefinitions, &BuiltNodes](const uint64 ChildReference, const uint8 ChildLevel)
+			{
+				return BuildNode(ChildReference, ChildLevel, NodeDefinitions, BuiltNodes);
+			});
+
+		if (Node.IsValid())
+		{
+			BuiltNodes.Add(Reference, Node);
+		}
+
+		return Node;
+	}
+}
+
+TUniquePtr<FBoardCheckpointStream> FBoardCheckpointStream::OpenForWriting(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	TUniquePtr<FBoardCheckpointStream> Stream(new FBoardCheckpointStream(Filename));
+
+	// Start a new stream if there isn't one. Otherwise note every node it already has, so we never write one twice.
+	const int64 FileSize = PlatformFile.FileSize(*Filename);
+	int64 ValidBytes = sizeof(FFileHeader);
+
+	if (FileSize < (int64)sizeof(FFileHeader))
+	{
+		const FFileHeader FileHeader;
+		TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*Filename));
+		if (!File.IsValid() || !File->Write((const uint8*)&FileHeader, sizeof(FFileHeader)))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not create the checkpoint stream %s."), *Filename);
+			return nullptr;
+		}
+	}
+	else
+	{
+		ValidBytes = ReadCheckpoints(Filename, [&Stream](const FCheckpointHeader& Header, const TArray<FNodeDefinition>& NodeDefinitions, const int64 CheckpointBytes)
+			{
+				for (const FNodeDefinition& Definition : NodeDefinitions)
+				{
+					Stream->mWrittenNodes.Add(Definition.mHash, GetChildrenCheckWord(Definition.mChildren));
+				}
+				return true;
+			});
+
+		if (ValidBytes == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s isn't a checkpoint stream this version can continue."), *Filename);
+			return nullptr;
+		}
+	}
+
+	Stream->mFile.Reset(PlatformFile.OpenWrite(*Filename, true));
+	if (!Stream->mFile.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the checkpoint stream %s for writing."), *Filename);
+		return nullptr;
+	}
+
+	// A run that stopped partway through writing a checkpoint leaves part of one at the end. Cut it off, so the checkpoints we add can be read.
+	if (ValidBytes < FileSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Discarding %lld bytes of an unfinished checkpoint at the end of %s."), FileSize - ValidBytes, *Filename);
+
+		if (!Stream->mFile->Truncate(ValidBytes))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not repair the checkpoint stream %s."), *Filename);
+			return nullptr;
+		}
+	}
+
+	return Stream;
+}
+
+FBoardCheckpointStream::FBoardCheckpointStream(const FString& Filename) :
+	mFilename(Filename)
+{
+}
+
+FBoardCheckpointStream::~FBoardCheckpointStream()
+{
+	if (mFile.IsValid())
+	{
+		mFile->Flush();
+	}
+}
+
+bool FBoardCheckpointStream::WriteCheckpoint(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation, const FString& RuleString)
+{
+	if (mHasFailed || !mFile.IsValid())
+	{
+		return false;
+	}
+
+	if (!RootNode.IsValid() || RootNode->mLevel < QuadTreeNode::kBlockLevel)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to checkpoint a board smaller than 8x8."));
+		return false;
+	}
+
+	FCheckpointHeader Header;
+	if (!Header.mRuleString.Set(RuleString))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to checkpoint a board following %s, which is too long a rulestring to store."), *RuleString);
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Leave room for the header, which has to wait until we know how many definitions follow it.
+	TArray<uint8> Buffer;
+	Buffer.AddZeroed(sizeof(FCheckpointHeader));
+
+	Header.mGeneration = Generation;
+	Header.mRootLevel = RootNode->mLevel;
+	if (!AppendNodeDefinitions(RootNode, Buffer, Header.mNumNodes, Header.mRootReference))
+	{
+		// The nodes gathered so far were never written, but the stream now thinks it has them, so it can't take any more checkpoints.
+		UE_LOG(LogTemp, Error, TEXT("The board at generation %lld has a node whose hash matches a different node already in %s, so it can't be checkpointed. No more checkpoints will be written to it."), Generation, *mFilename);
+		mHasFailed = true;
+		return false;
+	}
+
+	FMemory::Memcpy(Buffer.GetData(), &Header, sizeof(FCheckpointHeader));
+
+	if (!mFile->Write(Buffer.GetData(), Buffer.Num()) || !mFile->Flush())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write a checkpoint to %s. No more checkpoints will be written to it."), *mFilename);
+		mHasFailed = true;
+		return false;
+	}
+
+	++mStats.mNumCheckpoints;
+	mStats.mNumNodes += Header.mNumNodes;
+	mStats.mNumBytes += Buffer.Num();
+	mStats.mSeconds += FPlatformTime::Seconds() - StartTime;
+
+	return true;
+}
+
+const FBoardCheckpointStreamStats& FBoardCheckpointStream::GetStats() const
+{
+	return mStats;
+}
+
+const FString& FBoardCheckpointStream::GetFilename() const
+{
+	return mFilename;
+}
+
+bool FBoardCheckpointStream::AppendNodeDefinitions(const TSharedPtr<const QuadTreeNode>& Node, TArray<uint8>& NodeDefinitionsOut, int32& NumNodesOut, uint64& ReferenceOut)
+{
+	return FNodeDefinition::AppendDefinitions(Node,
+		[this](const QuadTreeNode& WrittenNode)
+		{
+			// Only the children of a node the stream already has are checked, to make sure it really is the same node.
+			const uint64* WrittenCheckWord = mWrittenNodes.Find(WrittenNode.GetHash());
+			if (WrittenCheckWord == nullptr)
+			{
+				return EWrittenNodeState::NotWritten;
+			}
+
+			return (*WrittenCheckWord == GetChildrenCheckWord(FNodeDefinition::Make(WrittenNode).mChildren)) ? EWrittenNodeState::Written : EWrittenNodeState::Conflicting;
+		},
+		[this, &NodeDefinitionsOut, &NumNodesOut](const TSharedPtr<const QuadTreeNode>& NewNode, const FNodeDefinition& Definition)
+		{
+			mWrittenNodes.Add(Definition.mHash, GetChildrenCheckWord(Definition.mChildren));
+			NodeDefinitionsOut.Append((const uint8*)&Definition, sizeof(FNodeDefinition));
+			++NumNodesOut;
+		},
+		ReferenceOut);
+}
+
+bool FBoardCheckpointStream::ReadCheckpointInfos(const FString& Filename, TArray<FBoardCheckpointInfo>& InfosOut)
+{
+	InfosOut.Reset();
+
+	const int64 ValidBytes = ReadCheckpoints(Filename, [&InfosOut](const FCheckpointHeader& Header, const TArray<FNodeDefinition>& NodeDefinitions, const int64 CheckpointBytes)
+		{
+			FBoardCheckpointInfo& Info = InfosOut.AddDefaulted_GetRef();
+			Info.mGeneration = Header.mGeneration;
+			Info.mRuleString = Header.mRuleString.Get();
+			Info.mRootLevel = Header.mRootLevel;
+			Info.mNumNewNodes = Header.mNumNodes;
+			Info.mNumBytes = CheckpointBytes;
+			return true;
+		});
+
+	if (ValidBytes == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s isn't a checkpoint stream this version can read."), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool FBoardCheckpointStream::LoadCheckpoint(const FString& Filename, const int32 CheckpointIndex, FBoardCheckpoint& CheckpointOut)
+{
+	// Every checkpoint up to the one we want may have written some of its nodes.
+	TMap<uint64, FNodeDefinition> NodeDefinitions;
+	FCheckpointHeader LastHeader;
+	int32 NumCheckpointsRead = 0;
+	bool HasConflictingDefinitions = false;
+
+	const int64 ValidBytes = ReadCheckpoints(Filename, [&](const FCheckpointHeader& Header, const TArray<FNodeDefinition>& CheckpointNodeDefinitions, const int64 CheckpointBytes)
+		{
+			for (const FNodeDefinition& Definition : CheckpointNodeDefinitions)
+			{
+				// A stream written by several runs may define a hash more than once. That's only safe if every definition has the same children.
+				const FNodeDefinition* ExistingDefinition = NodeDefinitions.Find(Definition.mHash);
+				if (ExistingDefinition != nullptr && (ExistingDefinition->mLevel != Definition.mLevel || FMemory::Memcmp(ExistingDefinition->mChildren, Definition.mChildren, sizeof(Definition.mChildren)) != 0))
+				{
+					HasConflictingDefinitions = true;
+					return false;
+				}
+
+				NodeDefinitions.Add(Definition.mHash, Definition);
+			}
+
+			LastHeader = Header;
+			++NumCheckpointsRead;
+			return CheckpointIndex == INDEX_NONE || NumCheckpointsRead <= CheckpointIndex;
+		});
+
+	if (ValidBytes == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s isn't a checkpoint stream this version can read."), *Filename);
+		return false;
+	}
+
+	if (HasConflictingDefinitions)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s defines two different nodes with the same hash, so its checkpoints can't be trusted."), *Filename);
+		return false;
+	}
+
+	if (NumCheckpointsRead == 0 || (CheckpointIndex != INDEX_NONE && NumCheckpointsRead != CheckpointIndex + 1))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has %d checkpoints, so there's no checkpoint %d to load."), *Filename, NumCheckpointsRead, CheckpointIndex);
+		return false;
+	}
+
+	TSharedPtr<const QuadTreeNode> RootNode;
+	if (LastHeader.mRootLevel >= QuadTreeNode::kBlockLevel && LastHeader.mRootLevel <= 64)
+	{
+		TMap<uint64, TSharedPtr<const QuadTreeNode>> BuiltNodes;
+		RootNode = BuildNode(LastHeader.mRootReference, LastHeader.mRootLevel, NodeDefinitions, BuiltNodes);
+	}
+
+	if (!RootNode.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("The checkpoint of generation %lld in %s is missing or has damaged some of its nodes."), LastHeader.mGeneration, *Filename);
+		return false;
+	}
+
+	CheckpointOut.mRootNode = RootNode;
+	CheckpointOut.mGeneration = LastHeader.mGeneration;
+	CheckpointOut.mRuleString = LastHeader.mRuleString.Get();
+
+	return true;
+}
+
+bool FBoardCheckpointStream::Compact(const FString& Filename, const int32 CheckpointIndex, const FString& OutputFilename, FBoardCheckpointInfo& InfoOut)
+{
+	FBoardCheckpoint Checkpoint;
+	if (!LoadCheckpoint(Filename, CheckpointIndex, Checkpoint))
+	{
+		return false;
+	}
+
+	// Write the compacted stream next to where it's going, and only replace anything once it's complete.
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString CompactedFilename = OutputFilename + TEXT(".compacting");
+	PlatformFile.DeleteFile(*CompactedFilename);
+
+	{
+		TUniquePtr<FBoardCheckpointStream> CompactedStream = OpenForWriting(CompactedFilename);
+		if (!CompactedStream.IsValid() || !CompactedStream->WriteCheckpoint(Checkpoint.mRootNode, Checkpoint.mGeneration, Checkpoint.mRuleString))
+		{
+			CompactedStream.Reset();
+			PlatformFile.DeleteFile(*CompactedFilename);
+			return false;
+		}
+
+		InfoOut.mGeneration = Checkpoint.mGeneration;
+		InfoOut.mRuleString = Checkpoint.mRuleString;
+		InfoOut.mRootLevel = Checkpoint.mRootNode->mLevel;
+		InfoOut.mNumNewNodes = (int32)CompactedStream->GetStats().mNumNodes;
+		InfoOut.mNumBytes = CompactedStream->GetStats().mNumBytes;
+	}
+
+	if (!UBoardUtilities::ReplaceFile(OutputFilename, CompactedFilename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not replace %s with its compacted stream."), *OutputFilename);
+		return false;
+	}
+
+	return true;
+}
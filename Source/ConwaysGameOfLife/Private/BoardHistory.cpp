@@ -0,0 +1,298 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardHistory.h"
+
+FBoardHistory::FBoardHistory(const int32 RecentGenerations, const int32 CheckpointsPerDoubling, const int64 MemoryBudgetBytes) :
+	mOldestRecentIndex(0),
+	mNumRecentEntries(0),
+	mMaxRecentEntries(FMath::Max(RecentGenerations, 0)),
+	mCheckpointsPerDoubling(FMath::Max(CheckpointsPerDoubling, 1)),
+	mMemoryBudgetBytes(MemoryBudgetBytes),
+	mTotalNodesNotInNewerEntries(0)
+{
+}
+
+void FBoardHistory::AddGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation)
+{
+	if (mMaxRecentEntries == 0 || !RootNode.IsValid())
+	{
+		return;
+	}
+
+	if (GetNumGenerations() > 0 && Generation <= GetNewestEntry().mGeneration)
+	{
+		return;
+	}
+
+	if (mRecentEntries.Num() != mMaxRecentEntries)
+	{
+		mRecentEntries.SetNum(mMaxRecentEntries);
+	}
+
+	FHistoryEntry NewEntry;
+	NewEntry.mRootNode = RootNode;
+	NewEntry.mGeneration = Generation;
+
+	// The entry that used to be newest now shares most of its nodes with the new one; what it doesn't share is what it costs us to keep.
+	if (GetNumGenerations() > 0)
+	{
+		UpdateNodesNotInNewerEntry(GetNewestEntry(), &NewEntry);
+	}
+
+	// Make room for the new entry, turning the oldest recent entry into a checkpoint if we're full.
+	if (mNumRecentEntries == mMaxRecentEntries)
+	{
+		mCheckpoints.Add(MoveTemp(GetRecentEntry(0)));
+		mOldestRecentIndex = (mOldestRecentIndex + 1) % mMaxRecentEntries;
+		--mNumRecentEntries;
+	}
+
+	++mNumRecentEntries;
+	GetNewestEntry() = MoveTemp(NewEntry);
+
+	ThinCheckpoints();
+	EnforceMemoryBudget();
+}
+
+bool FBoardHistory::FindNearestGeneration(const int64 Generation, TSharedPtr<const QuadTreeNode>& RootNodeOut, int64& GenerationOut) const
+{
+	const FHistoryEntry* NearestEntry = nullptr;
+
+	// Recent entries are every generation in a row, so the one we want is right where we'd expect it to be.
+	if (mNumRecentEntries > 0 && GetRecentEntry(0).mGeneration <= Generation)
+	{
+		const int64 IndexFromOldest = FMath::Min<int64>(Generation - GetRecentEntry(0).mGeneration, mNumRecentEntries - 1);
+		for (int32 Index = (int32)IndexFromOldest; Index >= 0; --Index)
+		{
+			if (GetRecentEntry(Index).mGeneration <= Generation)
+			{
+				NearestEntry = &GetRecentEntry(Index);
+				break;
+			}
+		}
+	}
+	else
+	{
+		// Checkpoints are in order, so find the last one that isn't newer than Generation.
+		int32 Low = 0;
+		int32 High = mCheckpoints.Num();
+		while (Low < High)
+		{
+			const int32 Middle = (Low + High) / 2;
+			if (mCheckpoints[Middle].mGeneration <= Generation)
+			{
+				Low = Middle + 1;
+			}
+			else
+			{
+				High = Middle;
+			}
+		}
+
+		if (Low > 0)
+		{
+			NearestEntry = &mCheckpoints[Low - 1];
+		}
+	}
+
+	if (NearestEntry == nullptr)
+	{
+		return false;
+	}
+
+	RootNodeOut = NearestEntry->mRootNode;
+	GenerationOut = NearestEntry->mGeneration;
+	return true;
+}
+
+void FBoardHistory::DiscardGenerationsAfter(const int64 Generation)
+{
+	while (mNumRecentEntries > 0 && GetNewestEntry().mGeneration > Generation)
+	{
+		mTotalNodesNotInNewerEntries -= GetNewestEntry().mNodesNotInNewerEntry;
+		GetNewestEntry() = FHistoryEntry();
+		--mNumRecentEntries;
+	}
+
+	while (mNumRecentEntries == 0 && mCheckpoints.Num() > 0 && mCheckpoints.Last().mGeneration > Generation)
+	{
+		mTotalNodesNotInNewerEntries -= mCheckpoints.Last().mNodesNotInNewerEntry;
+		mCheckpoints.Pop();
+	}
+
+	// Whatever is newest now is the board we're on, which costs nothing extra to keep.
+	if (GetNumGenerations() > 0)
+	{
+		UpdateNodesNotInNewerEntry(GetNewestEntry(), nullptr);
+	}
+}
+
+void FBoardHistory::Reset()
+{
+	mCheckpoints.Reset();
+	mRecentEntries.Reset();
+	mOldestRecentIndex = 0;
+	mNumRecentEntries = 0;
+	mTotalNodesNotInNewerEntries = 0;
+}
+
+void FBoardHistory::SetLimits(const int32 RecentGenerations, const int32 CheckpointsPerDoubling, const int64 MemoryBudgetBytes)
+{
+	mMaxRecentEntries = FMath::Max(RecentGenerations, 0);
+	mCheckpointsPerDoubling = FMath::Max(CheckpointsPerDoubling, 1);
+	mMemoryBudgetBytes = MemoryBudgetBytes;
+	Reset();
+}
+
+int64 FBoardHistory::GetOldestGeneration() const
+{
+	if (mCheckpoints.Num() > 0)
+	{
+		return mCheckpoints[0].mGeneration;
+	}
+
+	return (mNumRecentEntries > 0) ? GetRecentEntry(0).mGeneration : INDEX_NONE;
+}
+
+int64 FBoardHistory::GetNewestGeneration() const
+{
+	return (GetNumGenerations() > 0) ? GetNewestEntry().mGeneration : INDEX_NONE;
+}
+
+int32 FBoardHistory::GetNumGenerations() const
+{
+	return mCheckpoints.Num() + mNumRecentEntries;
+}
+
+int64 FBoardHistory::GetEstimatedMemoryBytes() const
+{
+	return mTotalNodesNotInNewerEntries * (int64)QuadTreeNode::GetBytesPerNode();
+}
+
+void FBoardHistory::GetRootNodeReferences(TArray<TSharedPtr<const QuadTreeNode>*>& RootNodesOut)
+{
+	for (FHistoryEntry& Checkpoint : mCheckpoints)
+	{
+		RootNodesOut.Add(&Checkpoint.mRootNode);
+	}
+
+	for (int32 Index = 0; Index < mNumRecentEntries; ++Index)
+	{
+		RootNodesOut.Add(&GetRecentEntry(Index).mRootNode);
+	}
+}
+
+FBoardHistory::FHistoryEntry& FBoardHistory::GetRecentEntry(const int32 Index)
+{
+	return mRecentEntries[(mOldestRecentIndex + Index) % mMaxRecentEntries];
+}
+
+const FBoardHistory::FHistoryEntry& FBoardHistory::GetRecentEntry(const int32 Index) const
+{
+	return mRecentEntries[(mOldestRecentIndex + Index) % mMaxRecentEntries];
+}
+
+FBoardHistory::FHistoryEntry& FBoardHistory::GetNewestEntry()
+{
+	return (mNumRecentEntries > 0) ? GetRecentEntry(mNumRecentEntries - 1) : mCheckpoints.Last();
+}
+
+const FBoardHistory::FHistoryEntry& FBoardHistory::GetNewestEntry() const
+{
+	return (mNumRecentEntries > 0) ? GetRecentEntry(mNumRecentEntries - 1) : mCheckpoints.Last();
+}
+
+const FBoardHistory::FHistoryEntry* FBoardHistory::GetEntryNewerThanCheckpoint(const int32 CheckpointIndex) const
+{
+	if (CheckpointIndex + 1 < mCheckpoints.Num())
+	{
+		return &mCheckpoints[CheckpointIndex + 1];
+	}
+
+	return (mNumRecentEntries > 0) ? &GetRecentEntry(0) : nullptr;
+}
+
+void FBoardHistory::ThinCheckpoints()
+{
+	const int64 NewestGeneration = GetNewestEntry().mGeneration;
+
+	// A checkpoint can go if its neighbors are already close enough together for its age. Walking from newest to oldest, the oldest checkpoint is always kept.
+	for (int32 Index = mCheckpoints.Num() - 2; Index >= 1; --Index)
+	{
+		const int64 Age = NewestGeneration - mCheckpoints[Index].mGeneration;
+		const int64 MaxGap = FMath::Max<int64>(Age / mCheckpointsPerDoubling, 1);
+
+		if (mCheckpoints[Index + 1].mGeneration - mCheckpoints[Index - 1].mGeneration <= MaxGap)
+		{
+			mTotalNodesNotInNewerEntries -= mCheckpoints[Index].mNodesNotInNewerEntry;
+			mCheckpoints.RemoveAt(Index);
+			UpdateNodesNotInNewerEntry(mCheckpoints[Index - 1], &mCheckpoints[Index]);
+		}
+	}
+}
+
+void FBoardHistory::EnforceMemoryBudget()
+{
+	if (mMemoryBudgetBytes <= 0)
+	{
+		return;
+	}
+
+	while (GetEstimatedMemoryBytes() > mMemoryBudgetBytes && GetNumGenerations() > 1)
+	{
+		RemoveOldestEntry();
+	}
+}
+
+void FBoardHistory::RemoveOldestEntry()
+{
+	if (mCheckpoints.Num() > 0)
+	{
+		mTotalNodesNotInNewerEntries -= mCheckpoints[0].mNodesNotInNewerEntry;
+		mCheckpoints.RemoveAt(0);
+	}
+	else if (mNumRecentEntries > 0)
+	{
+		mTotalNodesNotInNewerEntries -= GetRecentEntry(0).mNodesNotInNewerEntry;
+		GetRecentEntry(0) = FHistoryEntry();
+		mOldestRecentIndex = (mOldestRecentIndex + 1) % mMaxRecentEntries;
+		--mNumRecentEntries;
+	}
+}
+
+void FBoardHistory::UpdateNodesNotInNewerEntry(FHistoryEntry& Entry, const FHistoryEntry* Newer)
+{
+	mTotalNodesNotInNewerEntries -= Entry.mNodesNotInNewerEntry;
+	TSet<const QuadTreeNode*> Visited;
+	Entry.mNodesNotInNewerEntry = (Newer != nullptr) ? CountNodesNotIn(*Entry.mRootNode, Newer->mRootNode.Get(), Visited) : 0;
+	mTotalNodesNotInNewerEntries += Entry.mNodesNotInNewerEntry;
+}
+
+int64 FBoardHistory::CountNodesNotIn(const QuadTreeNode& Node, const QuadTreeNode* Other, TSet<const QuadTreeNode*>& Visited)
+{
+	// Empty nodes and leaves are canonical, so they're shared by every board.
+	if (&Node == Other || !Node.IsAlive() || Node.IsLeaf())
+	{
+		return 0;
+	}
+
+	// A subtree that shows up more than once in Node is only held once, so only count it the first time we reach it.
+	bool IsAlreadyVisited = false;
+	Visited.Add(&Node, &IsAlreadyVisited);
+	if (IsAlreadyVisited)
+	{
+		return 0;
+	}
+
+	const bool IsOtherComparable = (Other != nullptr) && (Other->mLevel == Node.mLevel) && !Other->IsLeaf();
+
+	int64 Count = 1;
+	for (int8 Child = 0; Child < ChildNode::kCount; ++Child)
+	{
+		const QuadTreeNode* OtherChild = IsOtherComparable ? Other->GetChild((ChildNode)Child).Get() : nullptr;
+		Count += CountNodesNotIn(*Node.GetChild((ChildNode)Child), OtherChild, Visited);
+	}
+
+	return Count;
+}
@@ -0,0 +1,365 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardLODVisualizer.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "GameBoard.h"
+
+// Sets default values
+ABoardLODVisualizer::ABoardLODVisualizer() :
+	mQuadMesh(nullptr),
+	mCellSize(100.0f),
+	mMaxAngularSizePerQuad(0.01f),
+	mMaxViewDistance(1000000.0f),
+	mCameraMoveThreshold(10.0f),
+	mLastRootLevel(0),
+	mLastCameraLocation(FVector::ZeroVector)
+{
+	// This Actor should not tick, it should be told when to update via the Controller.
+	PrimaryActorTick.bCanEverTick = false;
+
+	mQuadInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("QuadInstances"));
+	mQuadInstances->NumCustomDataFloats = 1;
+	RootComponent = mQuadInstances;
+}
+
+void ABoardLODVisualizer::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	if (mQuadMesh != nullptr)
+	{
+		mQuadInstances->SetStaticMesh(mQuadMesh);
+	}
+}
+
+void ABoardLODVisualizer::UpdateRepresentation(const UGameBoard* GameBoard, FVector CameraLocation)
+{
+	if (GameBoard == nullptr)
+	{
+		return;
+	}
+
+	const TSharedPtr<const QuadTreeNode> RootNode = GameBoard->GetRootNode();
+	if (!RootNode.IsValid())
+	{
+		return;
+	}
+
+	// If neither the board nor the camera has meaningfully changed, what we're drawing is still correct.
+	const FVector LocalCameraLocation = GetActorTransform().InverseTransformPosition(CameraLocation);
+	const bool HasBoardChanged = (mLastRootNode.Pin() != RootNode);
+	const bool HasCameraMoved = (FVector::Dist(LocalCameraLocation, mLastCameraLocation) >= mCameraMoveThreshold);
+	if (!HasBoardChanged && !HasCameraMoved)
+	{
+		return;
+	}
+
+	// A board of another size doesn't share any positions with the old one, so start the cut over.
+	if (RootNode->mLevel != mLastRootLevel)
+	{
+		for (const TPair<FVisibleNodeKey, FVisibleNode>& VisibleNode : mVisibleNodes)
+		{
+			ReleaseInstance(VisibleNode.Value.mInstanceIndex);
+		}
+
+		mVisibleNodes.Reset();
+		mCutNodes.Reset();
+		mLastRootLevel = RootNode->mLevel;
+	}
+
+	// Only the parts of the board that changed need another look. Nodes are deduplicated, so wherever the cut still holds the same node as before, everything below it is the same too.
+	if (HasBoardChanged)
+	{
+		FVisibleNodeKey RootKey;
+		RootKey.mLevel = RootNode->mLevel;
+		UpdateCutNode(RootKey, RootNode, LocalCameraLocation, true);
+		mLastRootNode = RootNode;
+	}
+
+	// Parts that didn't change were last checked against the old camera location, so the camera is only considered moved once the whole cut has been checked against the new one.
+	if (HasCameraMoved)
+	{
+		UpdateCutForCamera(RootNode, LocalCameraLocation);
+		mLastCameraLocation = LocalCameraLocation;
+	}
+
+	mQuadInstances->MarkRenderStateDirty();
+}
+
+int32 ABoardLODVisualizer::GetVisibleNodeCount() const
+{
+	return mVisibleNodes.Num();
+}
+
+ABoardLODVisualizer::ENodeLOD ABoardLODVisualizer::GetNodeLOD(const FVisibleNodeKey& Key, const QuadTreeNode& Node, const FVector& LocalCameraLocation) const
+{
+	// There is nothing to draw for empty nodes, no matter how close they are.
+	if (!Node.IsAlive())
+	{
+		return ENodeLOD::Hidden;
+	}
+
+	// Find the distance from the camera to the closest point of this node.
+	const FTransform NodeTransform = GetNodeTransform(Key);
+	const FVector NodeCenter = NodeTransform.GetLocation();
+	const double NodeWorldSize = NodeTransform.GetScale3D().X;
+
+	const double DistanceX = FMath::Max(0.0, FMath::Abs(LocalCameraLocation.X - NodeCenter.X) - NodeWorldSize / 2);
+	const double DistanceY = FMath::Max(0.0, FMath::Abs(LocalCameraLocation.Y - NodeCenter.Y) - NodeWorldSize / 2);
+	const double Distance = FMath::Sqrt(DistanceX * DistanceX + DistanceY * DistanceY + LocalCameraLocation.Z * LocalCameraLocation.Z);
+
+	if (Distance > mMaxViewDistance)
+	{
+		return ENodeLOD::Hidden;
+	}
+
+	// Nodes that look small enough from the camera are drawn as one quad, shaded by how full they are.
+	if (Node.IsLeaf() || NodeWorldSize <= mMaxAngularSizePerQuad * FMath::Max(Distance, (double)mCellSize))
+	{
+		return ENodeLOD::Drawn;
+	}
+
+	return ENodeLOD::Split;
+}
+
+void ABoardLODVisualizer::UpdateCutNode(const FVisibleNodeKey& Key, const TSharedPtr<const QuadTreeNode>& Node, const FVector& LocalCameraLocation, const bool OnlyIfChanged)
+{
+	FCutNode* ExistingCutNode = mCutNodes.Find(Key);
+	if (OnlyIfChanged && ExistingCutNode != nullptr && ExistingCutNode->mNode.Pin() == Node)
+	{
+		return;
+	}
+
+	const bool WasSplit = (ExistingCutNode != nullptr && ExistingCutNode->mIsSplit);
+	const ENodeLOD LOD = GetNodeLOD(Key, *Node, LocalCameraLocation);
+
+	FCutNode& CutNode = (ExistingCutNode != nullptr) ? *ExistingCutNode : mCutNodes.Add(Key);
+	CutNode.mNode = Node;
+	CutNode.mIsSplit = (LOD == ENodeLOD::Split);
+
+	if (LOD != ENodeLOD::Split)
+	{
+		// Whatever was drawn below this node is covered by it now.
+		if (WasSplit)
+		{
+			RemoveCutChildren(Key);
+		}
+
+		if (LOD == ENodeLOD::Drawn)
+		{
+			const double NodeArea = FMath::Pow(2.0, 2.0 * Node->mLevel);
+			DrawNode(Key, (float)(Node->GetPopulation() / NodeArea));
+		}
+		else
+		{
+			HideNode(Key);
+		}
+
+		return;
+	}
+
+	HideNode(Key);
+
+	// Children that weren't in the cut before have nothing to compare against, so they're always looked at.
+	FVisibleNodeKey ChildKeys[ChildNode::kCount];
+	GetChildKeys(Key, ChildKeys);
+
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		UpdateCutNode(ChildKeys[ChildIndex], Node->GetChild((ChildNode)ChildIndex), LocalCameraLocation, OnlyIfChanged && WasSplit);
+	}
+}
+
+void ABoardLODVisualizer::UpdateCutForCamera(const TSharedPtr<const QuadTreeNode>& RootNode, const FVector& LocalCameraLocation)
+{
+	// Coarsen first, from the bottom up, so that nodes merged away aren't refined for nothing. A node that looks small enough has children that do too, so only the parents of the bottom of the cut need checking at first.
+	// Candidates are kept by level, and merging a node makes its parent a candidate in turn.
+	TArray<TSet<FVisibleNodeKey>> MergeCandidates;
+	MergeCandidates.SetNum(mLastRootLevel + 1);
+
+	auto AddParentAsCandidate = [&MergeCandidates, this](const FVisibleNodeKey& Key)
+	{
+		if (Key.mLevel >= mLastRootLevel)
+		{
+			return;
+		}
+
+		FVisibleNodeKey ParentKey;
+		ParentKey.mLevel = Key.mLevel + 1;
+
+		const uint64 ParentMask = (ParentKey.mLevel < 64) ? ~((uint64(1) << ParentKey.mLevel) - 1) : 0;
+		ParentKey.mX = Key.mX & ParentMask;
+		ParentKey.mY = Key.mY & ParentMask;
+		MergeCandidates[ParentKey.mLevel].Add(ParentKey);
+	};
+
+	for (const TPair<FVisibleNodeKey, FCutNode>& CutNode : mCutNodes)
+	{
+		if (!CutNode.Value.mIsSplit)
+		{
+			AddParentAsCandidate(CutNode.Key);
+		}
+	}
+
+	for (int32 Level = 1; Level <= mLastRootLevel; ++Level)
+	{
+		for (const FVisibleNodeKey& Key : MergeCandidates[Level])
+		{
+			const FCutNode* CutNode = mCutNodes.Find(Key);
+			if (CutNode == nullptr || !CutNode->mIsSplit)
+			{
+				continue;
+			}
+
+			TSharedPtr<const QuadTreeNode> Node = CutNode->mNode.Pin();
+			if (!Node.IsValid())
+			{
+				Node = FindNode(RootNode, Key);
+			}
+
+			if (GetNodeLOD(Key, *Node, LocalCameraLocation) != ENodeLOD::Split)
+			{
+				UpdateCutNode(Key, Node, LocalCameraLocation, false);
+				AddParentAsCandidate(Key);
+			}
+		}
+	}
+
+	// Then look at the bottom of the cut again, splitting what has grown too big on screen and drawing or hiding the rest anew.
+	TArray<FVisibleNodeKey> BottomKeys;
+	for (const TPair<FVisibleNodeKey, FCutNode>& CutNode : mCutNodes)
+	{
+		if (!CutNode.Value.mIsSplit)
+		{
+			BottomKeys.Add(CutNode.Key);
+		}
+	}
+
+	for (const FVisibleNodeKey& Key : BottomKeys)
+	{
+		TSharedPtr<const QuadTreeNode> Node = mCutNodes.FindChecked(Key).mNode.Pin();
+		if (!Node.IsValid())
+		{
+			Node = FindNode(RootNode, Key);
+		}
+
+		UpdateCutNode(Key, Node, LocalCameraLocation, false);
+	}
+}
+
+void ABoardLODVisualizer::RemoveCutChildren(const FVisibleNodeKey& Key)
+{
+	FVisibleNodeKey ChildKeys[ChildNode::kCount];
+	GetChildKeys(Key, ChildKeys);
+
+	for (const FVisibleNodeKey& ChildKey : ChildKeys)
+	{
+		FCutNode RemovedCutNode;
+		if (!mCutNodes.RemoveAndCopyValue(ChildKey, RemovedCutNode))
+		{
+			continue;
+		}
+
+		if (RemovedCutNode.mIsSplit)
+		{
+			RemoveCutChildren(ChildKey);
+		}
+
+		HideNode(ChildKey);
+	}
+}
+
+void ABoardLODVisualizer::DrawNode(const FVisibleNodeKey& Key, const float Density)
+{
+	// Only touch the nodes we were already drawing if their density has changed.
+	if (FVisibleNode* ExistingNode = mVisibleNodes.Find(Key))
+	{
+		if (ExistingNode->mDensity != Density)
+		{
+			ExistingNode->mDensity = Density;
+			mQuadInstances->SetCustomDataValue(ExistingNode->mInstanceIndex, 0, Density);
+		}
+
+		return;
+	}
+
+	FVisibleNode& AddedNode = mVisibleNodes.Add(Key);
+	AddedNode.mDensity = Density;
+	AddedNode.mInstanceIndex = AcquireInstance();
+
+	mQuadInstances->UpdateInstanceTransform(AddedNode.mInstanceIndex, GetNodeTransform(Key));
+	mQuadInstances->SetCustomDataValue(AddedNode.mInstanceIndex, 0, Density);
+}
+
+void ABoardLODVisualizer::HideNode(const FVisibleNodeKey& Key)
+{
+	FVisibleNode HiddenNode;
+	if (mVisibleNodes.RemoveAndCopyValue(Key, HiddenNode))
+	{
+		ReleaseInstance(HiddenNode.mInstanceIndex);
+	}
+}
+
+void ABoardLODVisualizer::GetChildKeys(const FVisibleNodeKey& Key, FVisibleNodeKey (&ChildKeysOut)[ChildNode::kCount])
+{
+	const uint64 ChildNodeDimension = uint64(1) << (Key.mLevel - 1);
+
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		const bool IsEastern = (ChildIndex == ChildNode::Northeast || ChildIndex == ChildNode::Southeast);
+		const bool IsNorthern = (ChildIndex == ChildNode::Northwest || ChildIndex == ChildNode::Northeast);
+
+		ChildKeysOut[ChildIndex].mLevel = Key.mLevel - 1;
+		ChildKeysOut[ChildIndex].mX = Key.mX + (IsEastern ? ChildNodeDimension : 0);
+		ChildKeysOut[ChildIndex].mY = Key.mY + (IsNorthern ? ChildNodeDimension : 0);
+	}
+}
+
+TSharedPtr<const QuadTreeNode> ABoardLODVisualizer::FindNode(const TSharedPtr<const QuadTreeNode>& RootNode, const FVisibleNodeKey& Key)
+{
+	TSharedPtr<const QuadTreeNode> Node = RootNode;
+	while (Node->mLevel > Key.mLevel)
+	{
+		const uint64 ChildNodeDimension = uint64(1) << (Node->mLevel - 1);
+		const bool IsEastern = (Key.mX & ChildNodeDimension) != 0;
+		const bool IsNorthern = (Key.mY & ChildNodeDimension) != 0;
+
+		Node = Node->GetChild(IsNorthern ? (IsEastern ? ChildNode::Northeast : ChildNode::Northwest) : (IsEastern ? ChildNode::Southeast : ChildNode::Southwest));
+	}
+
+	return Node;
+}
+
+FTransform ABoardLODVisualizer::GetNodeTransform(const FVisibleNodeKey& Key) const
+{
+	// Convert to signed coordinates before going to floating point, so that cells near the center of the board keep their precision.
+	const int64 SignedX = (int64)(Key.mX - (uint64)INT64_MAX);
+	const int64 SignedY = (int64)(Key.mY - (uint64)INT64_MAX);
+
+	const double NodeDimension = FMath::Pow(2.0, (double)Key.mLevel);
+	const double NodeWorldSize = NodeDimension * mCellSize;
+
+	const FVector NodeCenter(((double)SignedX + NodeDimension / 2) * mCellSize, ((double)SignedY + NodeDimension / 2) * mCellSize, 0.0);
+
+	return FTransform(FQuat::Identity, NodeCenter, FVector(NodeWorldSize, NodeWorldSize, 1.0));
+}
+
+int32 ABoardLODVisualizer::AcquireInstance()
+{
+	if (mFreeInstances.Num() > 0)
+	{
+		return mFreeInstances.Pop(false);
+	}
+
+	return mQuadInstances->AddInstance(FTransform::Identity);
+}
+
+void ABoardLODVisualizer::ReleaseInstance(int32 InstanceIndex)
+{
+	// Removing instances shifts every instance after it, so instead we collapse unused ones and keep them around for reuse.
+	mQuadInstances->UpdateInstanceTransform(InstanceIndex, FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector));
+	mFreeInstances.Add(InstanceIndex);
+}
@@ -0,0 +1,131 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardPeriodDetector.h"
+
+#include "BoardUtilities.h"
+
+FBoardPeriodDetector::FBoardPeriodDetector(const int32 MaxPeriod) :
+	mNextHistoryIndex(0),
+	mMaxPeriod(FMath::Max(MaxPeriod, 0))
+{
+}
+
+bool FBoardPeriodDetector::AddGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation)
+{
+	if (mPeriodicity.mKind != EBoardPeriodicity::Unknown)
+	{
+		return true;
+	}
+
+	if (mMaxPeriod == 0 || !RootNode.IsValid())
+	{
+		return false;
+	}
+
+	FHistoryEntry NewEntry;
+	NewEntry.mRootNode = RootNode;
+	NewEntry.mTranslationInvariantHash = RootNode->GetTranslationInvariantHash();
+	NewEntry.mPopulation = RootNode->GetPopulation();
+	NewEntry.mGeneration = Generation;
+
+	FBoardRect LiveBounds;
+	if (RootNode->GetLiveBounds(LiveBounds))
+	{
+		NewEntry.mLiveMinX = LiveBounds.mMinX;
+		NewEntry.mLiveMinY = LiveBounds.mMinY;
+		NewEntry.mLiveWidth = LiveBounds.GetWidth();
+		NewEntry.mLiveHeight = LiveBounds.GetHeight();
+	}
+
+	// Any earlier board with the same live cells, wherever they were, is a candidate for the start of our cycle.
+	TArray<int32> CandidateIndices;
+	mHistoryIndicesByHash.MultiFind(NewEntry.mTranslationInvariantHash, CandidateIndices);
+
+	// Try the most recent candidates first, so we find the shortest period.
+	CandidateIndices.Sort([this](const int32 A, const int32 B) { return mHistory[A].mGeneration > mHistory[B].mGeneration; });
+
+	for (const int32 CandidateIndex : CandidateIndices)
+	{
+		const FHistoryEntry& PreviousEntry = mHistory[CandidateIndex];
+
+		const bool IsSameShape = (PreviousEntry.mPopulation == NewEntry.mPopulation) && (PreviousEntry.mLiveWidth == NewEntry.mLiveWidth) && (PreviousEntry.mLiveHeight == NewEntry.mLiveHeight);
+		if (!IsSameShape || PreviousEntry.mGeneration >= Generation)
+		{
+			continue;
+		}
+
+		// Differences of unsigned coordinates wrap around, so reading them back as signed values gives us the displacement in either direction.
+		const int64 DisplacementX = (int64)(NewEntry.mLiveMinX - PreviousEntry.mLiveMinX);
+		const int64 DisplacementY = (int64)(NewEntry.mLiveMinY - PreviousEntry.mLiveMinY);
+		const bool IsInPlace = (DisplacementX == 0 && DisplacementY == 0);
+
+		// Equal nodes are the same object, so this rules out boards that only share a hash.
+		const TSharedPtr<const QuadTreeNode> PreviousRootNode = IsInPlace ? PreviousEntry.mRootNode : QuadTreeNode::Translate(PreviousEntry.mRootNode, DisplacementX, DisplacementY);
+		if (PreviousRootNode != RootNode)
+		{
+			continue;
+		}
+
+		mPeriodicity.mPeriod = Generation - PreviousEntry.mGeneration;
+		mPeriodicity.mDetectedAtGeneration = Generation;
+
+		if (IsInPlace)
+		{
+			mPeriodicity.mKind = (mPeriodicity.mPeriod == 1) ? EBoardPeriodicity::Static : EBoardPeriodicity::Oscillator;
+		}
+		else
+		{
+			mPeriodicity.mKind = EBoardPeriodicity::Spaceship;
+			mPeriodicity.mDisplacementX = DisplacementX;
+			mPeriodicity.mDisplacementY = DisplacementY;
+		}
+
+		// Nothing else is recorded once we know the periodicity, so let go of the boards we were holding on to.
+		mHistory.Reset();
+		mHistoryIndicesByHash.Reset();
+		mNextHistoryIndex = 0;
+
+		return true;
+	}
+
+	// Make room for the new entry, forgetting the oldest one if we're full.
+	if (mHistory.Num() < mMaxPeriod)
+	{
+		mHistory.AddDefaulted();
+	}
+	else
+	{
+		mHistoryIndicesByHash.RemoveSingle(mHistory[mNextHistoryIndex].mTranslationInvariantHash, mNextHistoryIndex);
+	}
+
+	mHistory[mNextHistoryIndex] = NewEntry;
+	mHistoryIndicesByHash.Add(NewEntry.mTranslationInvariantHash, mNextHistoryIndex);
+	mNextHistoryIndex = (mNextHistoryIndex + 1) % mMaxPeriod;
+
+	return false;
+}
+
+const FBoardPeriodicity& FBoardPeriodDetector::GetPeriodicity() const
+{
+	return mPeriodicity;
+}
+
+void FBoardPeriodDetector::Reset()
+{
+	mHistory.Reset();
+	mHistoryIndicesByHash.Reset();
+	mNextHistoryIndex = 0;
+	mPeriodicity = FBoardPeriodicity();
+}
+
+void FBoardPeriodDetector::SetMaxPeriod(const int32 MaxPeriod)
+{
+	mMaxPeriod = FMath::Max(MaxPeriod, 0);
+	Reset();
+}
+
+int32 FBoardPeriodDetector::GetMaxPeriod() const
+{
+	return mMaxPeriod;
+}
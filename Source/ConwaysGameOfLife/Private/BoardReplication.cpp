@@ -0,0 +1,582 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardReplication.h"
+
+#include "BoardSerialization.h"
+#include "Common/TcpSocketBuilder.h"
+#include "QuadTreeNode.h"
+#include "SocketSubsystem.h"
+#include "Sockets.h"
+
+namespace
+{
+	// Marks the start of a connection, so a client that connected to something else notices instead of misreading it.
+	constexpr uint64 kHelloMagic = 0x4F4C4C4548464F43ull;
+
+	// Bumped whenever the layout of the messages changes. Clients only watch servers speaking the same version.
+	constexpr uint32 kProtocolVersion = 2;
+
+	// Mark the start of each message, so a stream that has lost its place is noticed instead of misread.
+	constexpr uint64 kNodeChunkMagic = 0x4B4E484346464F43ull;
+	constexpr uint64 kGenerationMagic = 0x4E45474846464F43ull;
+
+	// Set on a chunk of nodes to tell the client to forget every node it has before reading the chunk. The nodes sent from then on make up the whole board.
+	constexpr uint8 kForgetKnownNodesFlag = 0x1;
+
+	// The most node definitions one chunk carries. A generation that needs more is sent in several chunks, and clients don't accept bigger ones, so a damaged or hostile header can't make them wait for gigabytes before noticing.
+	constexpr int32 kMaxNodesPerChunk = 1 << 14;
+
+	// A client is told to forget its nodes once it holds this many times as many as the last whole board it was sent, and at least kMinKnownNodesToForget.
+	constexpr int32 kForgetKnownNodesFactor = 4;
+	constexpr int32 kMinKnownNodesToForget = 64 * 1024;
+
+	// Once this many bytes are waiting to go out to a client, it doesn't get any more generations until it has caught up.
+	constexpr int32 kMaxPendingBytesPerClient = 16 * 1024 * 1024;
+
+	// How much a client reads off its connection at a time.
+	constexpr int32 kReceiveChunkBytes = 64 * 1024;
+
+	// The first thing a server sends each client.
+	struct FHelloMessage
+	{
+		uint64 mMagic = kHelloMagic;
+		uint32 mVersion = kProtocolVersion;
+		uint32 mReserved = 0;
+	};
+
+	// The start of a chunk of nodes the client doesn't have yet, followed by mNumNodes node definitions, children before parents. Chunks go out ahead of the generation that first uses their nodes.
+	struct FNodeChunkHeader
+	{
+		uint64 mMagic = kNodeChunkMagic;
+
+		// The number of node definitions that follow, no more than kMaxNodesPerChunk.
+		int32 mNumNodes = 0;
+
+		// kForgetKnownNodesFlag, or nothing.
+		uint8 mFlags = 0;
+
+		uint8 mPadding[3] = {};
+	};
+
+	// Moves the client on to a generation, once every node of it the client didn't have has been sent.
+	struct FGenerationMessage
+	{
+		uint64 mMagic = kGenerationMagic;
+
+		// The generation the board is at.
+		int64 mGeneration = 0;
+
+		// The root of the board, as an id if it's 16x16 or bigger and as a tile if it's an 8x8 block.
+		uint64 mRootReference = 0;
+
+		// The level of the root.
+		uint8 mRootLevel = 0;
+
+		uint8 mPadding[7] = {};
+
+		// The rule the board follows, in "B3/S23" form.
+		FStoredRuleString mRuleString;
+	};
+
+	// Returns the node at Level referred to by Reference, a tile if Level is that of an 8x8 block and otherwise the id of a node in KnownNodes. Returns nullptr if there's no such node.
+	TSharedPtr<const QuadTreeNode> FindReferencedNode(const uint64 Reference, const uint8 Level, const TMap<uint64, TSharedPtr<const QuadTreeNode>>& KnownNodes)
+	{
+		if (Level == QuadTreeNode::kBlockLevel)
+		{
+			return QuadTreeNode::CreateBlockFromBitmap(Reference);
+		}
+
+		const TSharedPtr<const QuadTreeNode>* KnownNode = KnownNodes.Find(Reference);
+		return (KnownNode != nullptr && (*KnownNode)->mLevel == Level) ? *KnownNode : nullptr;
+	}
+
+	// Closes Socket and gives it back to the socket subsystem.
+	void DestroySocket(FSocket* Socket)
+	{
+		if (Socket != nullptr)
+		{
+			Socket->Close();
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		}
+	}
+}
+
+TUniquePtr<FBoardReplicationServer> FBoardReplicationServer::Listen(const int32 Port)
+{
+	FSocket* ListenSocket = FTcpSocketBuilder(TEXT("ConwaysReplicationServer")).AsReusable().AsNonBlocking().BoundToPort(Port).Listening(16).Build();
+	if (ListenSocket == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not listen for replication clients on port %d."), Port);
+		return nullptr;
+	}
+
+	return TUniquePtr<FBoardReplicationServer>(new FBoardReplicationServer(ListenSocket));
+}
+
+FBoardReplicationServer::FBoardReplicationServer(FSocket* ListenSocket) :
+	mListenSocket(ListenSocket),
+	mPort(ListenSocket->GetPortNo())
+{
+}
+
+FBoardReplicationServer::~FBoardReplicationServer()
+{
+	for (FClientConnection& Client : mClients)
+	{
+		CloseClient(Client);
+	}
+
+	DestroySocket(mListenSocket);
+}
+
+void FBoardReplicationServer::SendGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation, const FString& RuleString)
+{
+	if (!RootNode.IsValid() || RootNode->mLevel < QuadTreeNode::kBlockLevel)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to replicate a board smaller than 8x8."));
+		return;
+	}
+
+	if (RuleString.Len() >= FStoredRuleString::kMaxLength)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to replicate a board following %s, which is too long a rulestring to send."), *RuleString);
+		return;
+	}
+
+	mLastRootNode = RootNode;
+	mLastGeneration = Generation;
+	mLastRuleString = RuleString;
+
+	for (FClientConnection& Client : mClients)
+	{
+		QueueGeneration(Client);
+	}
+
+	Update();
+}
+
+void FBoardReplicationServer::Update()
+{
+	AcceptClients();
+
+	for (int32 ClientIndex = mClients.Num() - 1; ClientIndex >= 0; --ClientIndex)
+	{
+		FClientConnection& Client = mClients[ClientIndex];
+		if (!FlushPendingBytes(Client))
+		{
+			CloseClient(Client);
+			mClients.RemoveAtSwap(ClientIndex);
+			UE_LOG(LogTemp, Display, TEXT("A replication client disconnected, %d still watching."), mClients.Num());
+			continue;
+		}
+
+		// A client that had generations skipped gets the latest one as soon as it has caught up, so it doesn't wait for the board to change again.
+		if (Client.mIsBehind && Client.mPendingBytes.Num() == 0)
+		{
+			QueueGeneration(Client);
+			FlushPendingBytes(Client);
+		}
+	}
+}
+
+int32 FBoardReplicationServer::GetPort() const
+{
+	return mPort;
+}
+
+int32 FBoardReplicationServer::GetNumClients() const
+{
+	return mClients.Num();
+}
+
+const FBoardReplicationStats& FBoardReplicationServer::GetStats() const
+{
+	return mStats;
+}
+
+void FBoardReplicationServer::AcceptClients()
+{
+	bool HasPendingConnection = false;
+	while (mListenSocket->HasPendingConnection(HasPendingConnection) && HasPendingConnection)
+	{
+		FSocket* Socket = mListenSocket->Accept(TEXT("ConwaysReplicationClient"));
+		if (Socket == nullptr)
+		{
+			break;
+		}
+
+		Socket->SetNonBlocking(true);
+		Socket->SetNoDelay(true);
+
+		FClientConnection& Client = mClients.AddDefaulted_GetRef();
+		Client.mSocket = Socket;
+
+		const FHelloMessage Hello;
+		Client.mPendingBytes.Append((const uint8*)&Hello, sizeof(FHelloMessage));
+
+		if (mLastRootNode.IsValid())
+		{
+			QueueGeneration(Client);
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("A replication client connected, %d now watching."), mClients.Num());
+	}
+}
+
+void FBoardReplicationServer::QueueGeneration(FClientConnection& Client)
+{
+	// A client still working through earlier generations gets this one later, along with whatever else it missed, instead of queuing up ever more of them.
+	if (Client.mPendingBytes.Num() - Client.mNumPendingBytesSent > kMaxPendingBytesPerClient)
+	{
+		Client.mIsBehind = true;
+		++mStats.mNumSkippedGenerations;
+		return;
+	}
+
+	Client.mIsBehind = false;
+
+	// Nodes the board stopped using a while ago pile up on the client, so every so often start over with just the board as it is.
+	const bool ShouldForgetKnownNodes = (Client.mKnownNodes.Num() > FMath::Max(kMinKnownNodesToForget, kForgetKnownNodesFactor * Client.mNumNodesInLastWholeBoard));
+	if (ShouldForgetKnownNodes)
+	{
+		Client.mKnownNodes.Reset();
+	}
+
+	const bool IsWholeBoard = (Client.mKnownNodes.Num() == 0);
+
+	// The nodes go out in chunks ahead of the generation, so however many the board needs, no message holds more than kMaxNodesPerChunk of them.
+	// Each chunk leaves room for its header, which has to wait until we know how many definitions follow it.
+	FNodeChunkHeader ChunkHeader;
+	int32 ChunkHeaderOffset = INDEX_NONE;
+	auto FinishChunk = [&Client, &ChunkHeader, &ChunkHeaderOffset]()
+	{
+		if (ChunkHeaderOffset != INDEX_NONE)
+		{
+			FMemory::Memcpy(Client.mPendingBytes.GetData() + ChunkHeaderOffset, &ChunkHeader, sizeof(FNodeChunkHeader));
+		}
+	};
+	auto StartChunk = [&Client, &ChunkHeader, &ChunkHeaderOffset, &FinishChunk]()
+	{
+		FinishChunk();
+		ChunkHeader = FNodeChunkHeader();
+		ChunkHeaderOffset = Client.mPendingBytes.AddZeroed(sizeof(FNodeChunkHeader));
+	};
+
+	// The client has to forget its nodes before it reads any of the new ones, so that goes on a first chunk, even if there turn out to be no new nodes to put in it.
+	if (ShouldForgetKnownNodes)
+	{
+		StartChunk();
+		ChunkHeader.mFlags |= kForgetKnownNodesFlag;
+	}
+
+	FGenerationMessage Message;
+	Message.mGeneration = mLastGeneration;
+	Message.mRootLevel = mLastRootNode->mLevel;
+	Message.mRuleString.Set(mLastRuleString);
+
+	int32 NumNodes = 0;
+	FNodeDefinition::AppendDefinitions(mLastRootNode,
+		[&Client](const QuadTreeNode& Node)
+		{
+			// An id the client was last sent a different node under, because that node shares the hash or was let go of and built again, has to be sent again.
+			const TWeakPtr<const QuadTreeNode>* KnownNode = Client.mKnownNodes.Find(Node.GetHash());
+			return (KnownNode != nullptr && KnownNode->Pin().Get() == &Node) ? EWrittenNodeState::Written : EWrittenNodeState::NotWritten;
+		},
+		[&Client, &ChunkHeader, &ChunkHeaderOffset, &StartChunk, &NumNodes](const TSharedPtr<const QuadTreeNode>& Node, const FNodeDefinition& Definition)
+		{
+			if (ChunkHeaderOffset == INDEX_NONE || ChunkHeader.mNumNodes == kMaxNodesPerChunk)
+			{
+				StartChunk();
+			}
+
+			Client.mKnownNodes.Add(Definition.mHash, Node);
+			Client.mPendingBytes.Append((const uint8*)&Definition, sizeof(FNodeDefinition));
+			++ChunkHeader.mNumNodes;
+			++NumNodes;
+		},
+		Message.mRootReference);
+
+	FinishChunk();
+	Client.mPendingBytes.Append((const uint8*)&Message, sizeof(FGenerationMessage));
+
+	if (IsWholeBoard)
+	{
+		Client.mNumNodesInLastWholeBoard = NumNodes;
+	}
+
+	++mStats.mNumGenerations;
+	mStats.mNumNodes += NumNodes;
+}
+
+bool FBoardReplicationServer::FlushPendingBytes(FClientConnection& Client)
+{
+	while (Client.mNumPendingBytesSent < Client.mPendingBytes.Num())
+	{
+		int32 BytesSent = 0;
+		if (!Client.mSocket->Send(Client.mPendingBytes.GetData() + Client.mNumPendingBytesSent, Client.mPendingBytes.Num() - Client.mNumPendingBytesSent, BytesSent))
+		{
+			// The connection not taking any more right now isn't an error. We'll send the rest later.
+			if (ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode() != SE_EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			break;
+		}
+
+		if (BytesSent <= 0)
+		{
+			break;
+		}
+
+		Client.mNumPendingBytesSent += BytesSent;
+		mStats.mNumBytes += BytesSent;
+	}
+
+	// Drop what has gone out once it's most of the buffer, so the buffer doesn't keep growing while a client keeps up.
+	if (Client.mNumPendingBytesSent == Client.mPendingBytes.Num())
+	{
+		Client.mPendingBytes.Reset();
+		Client.mNumPendingBytesSent = 0;
+	}
+	else if (Client.mNumPendingBytesSent > Client.mPendingBytes.Num() / 2)
+	{
+		Client.mPendingBytes.RemoveAt(0, Client.mNumPendingBytesSent, false);
+		Client.mNumPendingBytesSent = 0;
+	}
+
+	return Client.mSocket->GetConnectionState() != SCS_ConnectionError;
+}
+
+void FBoardReplicationServer::CloseClient(FClientConnection& Client)
+{
+	DestroySocket(Client.mSocket);
+	Client.mSocket = nullptr;
+}
+
+TUniquePtr<FBoardReplicationClient> FBoardReplicationClient::Connect(const FString& Address, const int32 Port)
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+
+	bool IsValidAddress = false;
+	TSharedRef<FInternetAddr> ServerAddress = SocketSubsystem->CreateInternetAddr();
+	ServerAddress->SetIp(*Address, IsValidAddress);
+	ServerAddress->SetPort(Port);
+
+	if (!IsValidAddress)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s isn't an IPv4 address we can connect to."), *Address);
+		return nullptr;
+	}
+
+	// Connect while blocking, so we know whether it worked, and only then stop blocking.
+	FSocket* Socket = FTcpSocketBuilder(TEXT("ConwaysReplicationClient")).AsBlocking().Build();
+	if (Socket == nullptr || !Socket->Connect(*ServerAddress))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not connect to a replication server at %s:%d."), *Address, Port);
+		DestroySocket(Socket);
+		return nullptr;
+	}
+
+	Socket->SetNonBlocking(true);
+	Socket->SetNoDelay(true);
+
+	return TUniquePtr<FBoardReplicationClient>(new FBoardReplicationClient(Socket));
+}
+
+FBoardReplicationClient::FBoardReplicationClient(FSocket* Socket) :
+	mSocket(Socket)
+{
+}
+
+FBoardReplicationClient::~FBoardReplicationClient()
+{
+	DestroySocket(mSocket);
+}
+
+bool FBoardReplicationClient::Update()
+{
+	if (mHasFailed)
+	{
+		return false;
+	}
+
+	// Take everything that has arrived, then read whatever whole messages it makes up.
+	for (;;)
+	{
+		const int32 NumBytesBefore = mReceivedBytes.Num();
+		mReceivedBytes.AddUninitialized(kReceiveChunkBytes);
+
+		int32 BytesRead = 0;
+		const bool IsConnected = mSocket->Recv(mReceivedBytes.GetData() + NumBytesBefore, kReceiveChunkBytes, BytesRead);
+		BytesRead = FMath::Max(BytesRead, 0);
+		mReceivedBytes.SetNum(NumBytesBefore + BytesRead, false);
+		mStats.mNumBytes += BytesRead;
+
+		if (!IsConnected)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Lost the connection to the replication server."));
+			mHasFailed = true;
+			break;
+		}
+
+		if (BytesRead < kReceiveChunkBytes)
+		{
+			break;
+		}
+	}
+
+	if (!ReadMessages())
+	{
+		mHasFailed = true;
+	}
+
+	return !mHasFailed;
+}
+
+bool FBoardReplicationClient::ReadMessages()
+{
+	int32 Offset = 0;
+
+	if (!mHasReadHello)
+	{
+		if (mReceivedBytes.Num() < (int32)sizeof(FHelloMessage))
+		{
+			return true;
+		}
+
+		FHelloMessage Hello;
+		FMemory::Memcpy(&Hello, mReceivedBytes.GetData(), sizeof(FHelloMessage));
+		if (Hello.mMagic != kHelloMagic || Hello.mVersion != kProtocolVersion)
+		{
+			UE_LOG(LogTemp, Error, TEXT("The replication server isn't one this version can watch."));
+			return false;
+		}
+
+		mHasReadHello = true;
+		Offset += sizeof(FHelloMessage);
+	}
+
+	bool IsValid = true;
+	while (IsValid && mReceivedBytes.Num() - Offset >= (int32)sizeof(uint64))
+	{
+		const int32 NumBytesLeft = mReceivedBytes.Num() - Offset;
+		const uint8* MessageData = mReceivedBytes.GetData() + Offset;
+
+		uint64 Magic = 0;
+		FMemory::Memcpy(&Magic, MessageData, sizeof(uint64));
+
+		if (Magic == kNodeChunkMagic)
+		{
+			if (NumBytesLeft < (int32)sizeof(FNodeChunkHeader))
+			{
+				break;
+			}
+
+			FNodeChunkHeader Header;
+			FMemory::Memcpy(&Header, MessageData, sizeof(FNodeChunkHeader));
+			if (Header.mNumNodes < 0 || Header.mNumNodes > kMaxNodesPerChunk)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The replication server sent a chunk of nodes we can't read."));
+				IsValid = false;
+				break;
+			}
+
+			const int32 ChunkBytes = sizeof(FNodeChunkHeader) + Header.mNumNodes * sizeof(FNodeDefinition);
+			if (NumBytesLeft < ChunkBytes)
+			{
+				break;
+			}
+
+			if (Header.mFlags & kForgetKnownNodesFlag)
+			{
+				mKnownNodes.Reset();
+			}
+
+			// Children always come before their parents, so each node can be built as soon as its definition is read.
+			const uint8* DefinitionData = MessageData + sizeof(FNodeChunkHeader);
+			for (int32 NodeIndex = 0; NodeIndex < Header.mNumNodes && IsValid; ++NodeIndex)
+			{
+				FNodeDefinition Definition;
+				FMemory::Memcpy(&Definition, DefinitionData + NodeIndex * sizeof(FNodeDefinition), sizeof(FNodeDefinition));
+
+				TSharedPtr<const QuadTreeNode> Node = Definition.Build([this](const uint64 Reference, const uint8 Level)
+					{
+						return FindReferencedNode(Reference, Level, mKnownNodes);
+					});
+
+				// A node sent under an id we already have replaces the one we had. Any node we built out of the old one holds on to it itself, so it stays as it was.
+				IsValid = Node.IsValid();
+				mKnownNodes.Add(Definition.mHash, Node);
+			}
+
+			if (!IsValid)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The replication server sent nodes that are missing children or damaged."));
+				break;
+			}
+
+			mStats.mNumNodes += Header.mNumNodes;
+			Offset += ChunkBytes;
+		}
+		else if (Magic == kGenerationMagic)
+		{
+			if (NumBytesLeft < (int32)sizeof(FGenerationMessage))
+			{
+				break;
+			}
+
+			FGenerationMessage Message;
+			FMemory::Memcpy(&Message, MessageData, sizeof(FGenerationMessage));
+
+			TSharedPtr<const QuadTreeNode> RootNode = (Message.mRootLevel >= QuadTreeNode::kBlockLevel && Message.mRootLevel <= 64) ? FindReferencedNode(Message.mRootReference, Message.mRootLevel, mKnownNodes) : nullptr;
+			if (!RootNode.IsValid())
+			{
+				UE_LOG(LogTemp, Error, TEXT("The replication server sent generation %lld with nodes missing or damaged."), Message.mGeneration);
+				IsValid = false;
+				break;
+			}
+
+			mRootNode = RootNode;
+			mGeneration = Message.mGeneration;
+			mRuleString = Message.mRuleString.Get();
+
+			++mStats.mNumGenerations;
+			Offset += sizeof(FGenerationMessage);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("The replication server sent a message we can't read."));
+			IsValid = false;
+		}
+	}
+
+	mReceivedBytes.RemoveAt(0, Offset, false);
+	return IsValid;
+}
+
+const TSharedPtr<const QuadTreeNode>& FBoardReplicationClient::GetRootNode() const
+{
+	return mRootNode;
+}
+
+int64 FBoardReplicationClient::GetGeneration() const
+{
+	return mGeneration;
+}
+
+const FString& FBoardReplicationClient::GetRuleString() const
+{
+	return mRuleString;
+}
+
+int32 FBoardReplicationClient::GetNumKnownNodes() const
+{
+	return mKnownNodes.Num();
+}
+
+const FBoardReplicationStats& FBoardReplicationClient::GetStats() const
+{
+	return mStats;
+}
@@ -0,0 +1,107 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "BoardSerialization.h"
+
+uint64 FNodeDefinition::GetReference(const QuadTreeNode& Node)
+{
+	return (Node.mLevel <= QuadTreeNode::kBlockLevel) ? Node.GetBlockBitmap() : Node.GetHash();
+}
+
+FNodeDefinition FNodeDefinition::Make(const QuadTreeNode& Node)
+{
+	FNodeDefinition Definition;
+	Definition.mHash = Node.GetHash();
+	Definition.mLevel = Node.mLevel;
+	for (int32 Child = 0; Child < ChildNode::kCount; ++Child)
+	{
+		Definition.mChildren[Child] = GetReference(*Node.GetChild((ChildNode)Child));
+	}
+
+	return Definition;
+}
+
+bool FNodeDefinition::AppendDefinitions(const TSharedPtr<const QuadTreeNode>& Node, TFunctionRef<EWrittenNodeState(const QuadTreeNode&)> FindWrittenNode,
+	TFunctionRef<void(const TSharedPtr<const QuadTreeNode>&, const FNodeDefinition&)> AppendDefinition, uint64& ReferenceOut)
+{
+	ReferenceOut = GetReference(*Node);
+	if (Node->mLevel <= QuadTreeNode::kBlockLevel)
+	{
+		return true;
+	}
+
+	// Anything already written was written along with everything below it, so the walk only goes as far as what's new.
+	switch (FindWrittenNode(*Node))
+	{
+	case EWrittenNodeState::Written:
+		return true;
+
+	case EWrittenNodeState::Conflicting:
+		return false;
+
+	default:
+		break;
+	}
+
+	FNodeDefinition Definition;
+	Definition.mHash = ReferenceOut;
+	Definition.mLevel = Node->mLevel;
+	for (int32 Child = 0; Child < ChildNode::kCount; ++Child)
+	{
+		if (!AppendDefinitions(Node->GetChild((ChildNode)Child), FindWrittenNode, AppendDefinition, Definition.mChildren[Child]))
+		{
+			return false;
+		}
+	}
+
+	AppendDefinition(Node, Definition);
+	return true;
+}
+
+TSharedPtr<const QuadTreeNode> FNodeDefinition::Build(TFunctionRef<TSharedPtr<const QuadTreeNode>(uint64, uint8)> FindChild) const
+{
+	// Levels run up to 64, the level of a board as big as its coordinates allow.
+	if (mLevel <= QuadTreeNode::kBlockLevel || mLevel > 64)
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<const QuadTreeNode> Children[ChildNode::kCount];
+	for (int32 Child = 0; Child < ChildNode::kCount; ++Child)
+	{
+		Children[Child] = FindChild(mChildren[Child], mLevel - 1);
+		if (!Children[Child].IsValid())
+		{
+			return nullptr;
+		}
+	}
+
+	// Check the node against its hash, so a damaged definition is noticed rather than giving back the wrong board.
+	TSharedPtr<const QuadTreeNode> Node = QuadTreeNode::CreateNodeWithSubnodes(mLevel, Children[ChildNode::Northwest], Children[ChildNode::Northeast], Children[ChildNode::Southwest], Children[ChildNode::Southeast]);
+	return (Node.IsValid() && Node->GetHash() == mHash) ? Node : nullptr;
+}
+
+bool FStoredRuleString::Set(const FString& RuleString)
+{
+	if (RuleString.Len() >= kMaxLength)
+	{
+		return false;
+	}
+
+	FMemory::Memzero(mChars, sizeof(mChars));
+	for (int32 Index = 0; Index < RuleString.Len(); ++Index)
+	{
+		mChars[Index] = (ANSICHAR)RuleString[Index];
+	}
+
+	return true;
+}
+
+FString FStoredRuleString::Get() const
+{
+	ANSICHAR TerminatedChars[kMaxLength];
+	FMemory::Memcpy(TerminatedChars, mChars, sizeof(mChars));
+	TerminatedChars[kMaxLength - 1] = 0;
+
+	return FString(TerminatedChars);
+}
@@ -4,7 +4,17 @@
 
 #include "BoardUtilities.h"
 
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
 #include "Misc/DefaultValueHelper.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
 
 void UBoardUtilities::ParseStringIntoCoordinates(FString SourceString, TArray<FBoardCoordinate>& ResultsOut)
 {
@@ -39,6 +49,110 @@ void UBoardUtilities::ParseStringIntoCoordinates(FString SourceString, TArray<FB
 	}
 }
 
+void UBoardUtilities::ParseRLEIntoCoordinates(FString SourceString, TArray<FBoardCoordinate>& ResultsOut)
+{
+	ResultsOut.Empty();
+
+	TArray<FString> Lines;
+	SourceString.ParseIntoArrayLines(Lines);
+
+	// RLE rows go from the top of the pattern down, so Y decreases as we read.
+	int64 CurrentX = 0;
+	int64 CurrentY = 0;
+	int64 RunCount = 0;
+
+	for (const FString& Line : Lines)
+	{
+		const FString TrimmedLine = Line.TrimStartAndEnd();
+
+		// Skip comments and the "x = ..., y = ..." header.
+		if (TrimmedLine.IsEmpty() || TrimmedLine.StartsWith(TEXT("#")) || TrimmedLine.StartsWith(TEXT("x")))
+		{
+			continue;
+		}
+
+		for (const TCHAR Character : TrimmedLine)
+		{
+			if (FChar::IsDigit(Character))
+			{
+				RunCount = RunCount * 10 + (Character - TEXT('0'));
+				continue;
+			}
+
+			const int64 RunLength = FMath::Max<int64>(RunCount, 1);
+			RunCount = 0;
+
+			switch (Character)
+			{
+			case TEXT('b'):
+			case TEXT('.'):
+				// Dead cells.
+				CurrentX += RunLength;
+				break;
+			case TEXT('$'):
+				// End of one or more rows.
+				CurrentX = 0;
+				CurrentY -= RunLength;
+				break;
+			case TEXT('!'):
+				// End of the pattern.
+				return;
+			default:
+				if (FChar::IsWhitespace(Character))
+				{
+					break;
+				}
+
+				// Anything else is some kind of live cell.
+				for (int64 RunIndex = 0; RunIndex < RunLength; ++RunIndex)
+				{
+					FBoardCoordinate NewCoordinate;
+					NewCoordinate.SetXAndYFromSignedCoordinates(CurrentX + RunIndex, CurrentY);
+					ResultsOut.Add(NewCoordinate);
+				}
+				CurrentX += RunLength;
+				break;
+			}
+		}
+	}
+}
+
+bool UBoardUtilities::LoadPatternFile(FString FilePath, TArray<FBoardCoordinate>& ResultsOut)
+{
+	ResultsOut.Empty();
+
+	FString FileContents;
+	if (!FFileHelper::LoadFileToString(FileContents, *FilePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read pattern file %s."), *FilePath);
+		return false;
+	}
+
+	if (FPaths::GetExtension(FilePath).Equals(TEXT("rle"), ESearchCase::IgnoreCase))
+	{
+		ParseRLEIntoCoordinates(FileContents, ResultsOut);
+	}
+	else
+	{
+		ParseStringIntoCoordinates(FileContents, ResultsOut);
+	}
+
+	return true;
+}
+
+bool UBoardUtilities::ReplaceFile(FString TargetFilename, FString SourceFilename)
+{
+#if PLATFORM_WINDOWS
+	// MoveFile won't replace a file on Windows, but MoveFileEx can, atomically as long as both are on the same volume.
+	const FString FullSourceFilename = FPaths::ConvertRelativePathToFull(SourceFilename);
+	const FString FullTargetFilename = FPaths::ConvertRelativePathToFull(TargetFilename);
+	return MoveFileExW(*FullSourceFilename, *FullTargetFilename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	// Everywhere else MoveFile is a rename, which atomically replaces whatever was at the target.
+	return FPlatformFileManager::Get().GetPlatformFile().MoveFile(*TargetFilename, *SourceFilename);
+#endif
+}
+
 int64 UBoardUtilities::ParseStringToInt64(FString SourceString)
 {
 	int64 Result = 0;
@@ -0,0 +1,701 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysBenchmarkCommandlet.h"
+
+#include "Async/ParallelFor.h"
+#include "BoardUtilities.h"
+#include "Dom/JsonObject.h"
+#include "GameBoard.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformMisc.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/UObjectGlobals.h"
+
+#if PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/**
+	 * One pattern in the benchmark corpus, along with how long to run it for.
+	 */
+	struct FBenchmarkCase
+	{
+		// The name the case is reported and compared under.
+		FString mName;
+
+		// Fills in the live cells of the pattern. Returns false if the pattern could not be made, which fails the whole run.
+		TFunction<bool(TArray<FBoardCoordinate>&)> mGeneratePattern;
+
+		// How many generations to average the time per generation over.
+		int64 mNumGenerations;
+
+		// We also time running 2^mDoublingExponent generations from the start.
+		int32 mDoublingExponent;
+	};
+
+	/**
+	 * The measurements taken for one benchmark case.
+	 */
+	struct FBenchmarkResult
+	{
+		FString mName;
+		double mInitialPopulation = 0.0;
+		double mLoadMilliseconds = 0.0;
+		double mMillisecondsPerGeneration = 0.0;
+		double mDoublingExponent = 0.0;
+		double mMillisecondsForDoublingGenerations = 0.0;
+		double mPeakNodeCount = 0.0;
+		double mBytesPerNode = 0.0;
+		double mFinalPopulation = 0.0;
+		double mCompactionMilliseconds = 0.0;
+		double mLookupMilliseconds = 0.0;
+		double mCompactedLookupMilliseconds = 0.0;
+		double mMillisecondsPerColdGeneration = 0.0;
+		double mCompactedMillisecondsPerColdGeneration = 0.0;
+		double mCacheMissesPerColdGeneration = -1.0;
+		double mCompactedCacheMissesPerColdGeneration = -1.0;
+	};
+
+	/**
+	 * A metric we compare against the baseline. Larger values are always worse.
+	 */
+	struct FBenchmarkMetric
+	{
+		const TCHAR* mFieldName;
+		double FBenchmarkResult::* mValue;
+	};
+
+	// Every metric that is written out. The first ones, up to kNumComparedMetrics, are also compared against the baseline. Loading is dominated by file and allocator noise, and bytes per node
+	// comes from process memory deltas, so neither is steady enough from run to run to fail a build over.
+	const FBenchmarkMetric kBenchmarkMetrics[] =
+	{
+		{ TEXT("ms_per_generation"), &FBenchmarkResult::mMillisecondsPerGeneration },
+		{ TEXT("ms_for_doubling_generations"), &FBenchmarkResult::mMillisecondsForDoublingGenerations },
+		{ TEXT("peak_nodes"), &FBenchmarkResult::mPeakNodeCount },
+		{ TEXT("load_ms"), &FBenchmarkResult::mLoadMilliseconds },
+		{ TEXT("bytes_per_node"), &FBenchmarkResult::mBytesPerNode },
+		{ TEXT("initial_population"), &FBenchmarkResult::mInitialPopulation },
+		{ TEXT("doubling_exponent"), &FBenchmarkResult::mDoublingExponent },
+		{ TEXT("final_population"), &FBenchmarkResult::mFinalPopulation },
+		{ TEXT("compaction_ms"), &FBenchmarkResult::mCompactionMilliseconds },
+		{ TEXT("lookup_ms"), &FBenchmarkResult::mLookupMilliseconds },
+		{ TEXT("lookup_ms_compacted"), &FBenchmarkResult::mCompactedLookupMilliseconds },
+		{ TEXT("ms_per_cold_generation"), &FBenchmarkResult::mMillisecondsPerColdGeneration },
+		{ TEXT("ms_per_cold_generation_compacted"), &FBenchmarkResult::mCompactedMillisecondsPerColdGeneration },
+		{ TEXT("cache_misses_per_cold_generation"), &FBenchmarkResult::mCacheMissesPerColdGeneration },
+		{ TEXT("cache_misses_per_cold_generation_compacted"), &FBenchmarkResult::mCompactedCacheMissesPerColdGeneration },
+	};
+	constexpr int32 kNumComparedMetrics = 3;
+
+	// Returns a generator that parses an RLE pattern.
+	TFunction<bool(TArray<FBoardCoordinate>&)> MakeRLEGenerator(const FString& RLE)
+	{
+		return [RLE](TArray<FBoardCoordinate>& ResultsOut)
+		{
+			UBoardUtilities::ParseRLEIntoCoordinates(RLE, ResultsOut);
+			return ResultsOut.Num() > 0;
+		};
+	}
+
+	// Returns a generator that lays NumGuns copies of the RLE pattern GunRLE along a diagonal, Spacing cells apart on each axis.
+	// Spaced this way a Gosper glider gun's stream runs parallel to its neighbours' and never reaches another gun, so the population keeps growing at NumGuns times the rate of one gun.
+	TFunction<bool(TArray<FBoardCoordinate>&)> MakeGunArrayGenerator(const FString& GunRLE, const int64 NumGuns, const int64 Spacing)
+	{
+		return [GunRLE, NumGuns, Spacing](TArray<FBoardCoordinate>& ResultsOut)
+		{
+			TArray<FBoardCoordinate> Gun;
+			UBoardUtilities::ParseRLEIntoCoordinates(GunRLE, Gun);
+
+			for (int64 GunIndex = 0; GunIndex < NumGuns; ++GunIndex)
+			{
+				const uint64 Offset = (GunIndex - NumGuns / 2) * Spacing;
+				for (const FBoardCoordinate& GunCell : Gun)
+				{
+					FBoardCoordinate Cell;
+					Cell.SetXAndY(GunCell.mX + Offset, GunCell.mY + Offset);
+					ResultsOut.Add(Cell);
+				}
+			}
+			return ResultsOut.Num() > 0;
+		};
+	}
+
+	// Returns a generator that fills a Dimension x Dimension square centered on the origin with random cells.
+	TFunction<bool(TArray<FBoardCoordinate>&)> MakeSoupGenerator(const int64 Dimension, const float Density, const int32 Seed)
+	{
+		return [Dimension, Density, Seed](TArray<FBoardCoordinate>& ResultsOut)
+		{
+			FRandomStream RandomStream(Seed);
+			for (int64 Y = -Dimension / 2; Y < Dimension / 2; ++Y)
+			{
+				for (int64 X = -Dimension / 2; X < Dimension / 2; ++X)
+				{
+					if (RandomStream.FRand() < Density)
+					{
+						ResultsOut.Add(UBoardUtilities::MakeCoordinateFromInts(X, Y));
+					}
+				}
+			}
+			return true;
+		};
+	}
+
+	// Returns a generator that scatters GlidersPerSide x GlidersPerSide gliders over a large, mostly empty area.
+	TFunction<bool(TArray<FBoardCoordinate>&)> MakeGliderFieldGenerator(const int64 GlidersPerSide, const int64 Spacing, const int32 Seed)
+	{
+		return [GlidersPerSide, Spacing, Seed](TArray<FBoardCoordinate>& ResultsOut)
+		{
+			TArray<FBoardCoordinate> Glider;
+			UBoardUtilities::ParseRLEIntoCoordinates(TEXT("bo$2bo$3o!"), Glider);
+
+			FRandomStream RandomStream(Seed);
+			for (int64 GridY = 0; GridY < GlidersPerSide; ++GridY)
+			{
+				for (int64 GridX = 0; GridX < GlidersPerSide; ++GridX)
+				{
+					// Jitter each glider inside its grid cell so that they don't all line up on the same node boundaries.
+					const uint64 OffsetX = (GridX - GlidersPerSide / 2) * Spacing + RandomStream.RandRange(0, (int32)(Spacing / 2));
+					const uint64 OffsetY = (GridY - GlidersPerSide / 2) * Spacing + RandomStream.RandRange(0, (int32)(Spacing / 2));
+
+					for (const FBoardCoordinate& GliderCell : Glider)
+					{
+						FBoardCoordinate Cell;
+						Cell.SetXAndY(GliderCell.mX + OffsetX, GliderCell.mY + OffsetY);
+						ResultsOut.Add(Cell);
+					}
+				}
+			}
+			return true;
+		};
+	}
+
+	// Returns the fixed benchmark corpus.
+	TArray<FBenchmarkCase> MakeBenchmarkCorpus()
+	{
+		const TCHAR* GosperGliderGun = TEXT("24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4bobo$10bo5bo7bo$11bo3bo$12b2o!");
+
+		TArray<FBenchmarkCase> Corpus;
+
+		Corpus.Add({ TEXT("glider_gun"), MakeRLEGenerator(GosperGliderGun), 256, 8 });
+		Corpus.Add({ TEXT("r_pentomino"), MakeRLEGenerator(TEXT("b2o$2o$bo!")), 256, 8 });
+		Corpus.Add({ TEXT("acorn"), MakeRLEGenerator(TEXT("bo5b$3bo3b$2o2b3o!")), 256, 8 });
+		Corpus.Add({ TEXT("soup_64_25"), MakeSoupGenerator(64, 0.25f, 1), 128, 7 });
+		Corpus.Add({ TEXT("soup_64_375"), MakeSoupGenerator(64, 0.375f, 2), 128, 7 });
+		Corpus.Add({ TEXT("soup_64_50"), MakeSoupGenerator(64, 0.5f, 3), 128, 7 });
+
+		// Stands in for a breeder: a large, regular pattern whose population and node count keep growing for as long as it runs.
+		Corpus.Add({ TEXT("glider_gun_array"), MakeGunArrayGenerator(GosperGliderGun, 16, 64), 64, 6 });
+
+		Corpus.Add({ TEXT("sparse_glider_field"), MakeGliderFieldGenerator(16, 4096, 4), 64, 6 });
+		Corpus.Add({ TEXT("dense_soup_4096"), MakeSoupGenerator(4096, 0.5f, 5), 4, 2 });
+
+		return Corpus;
+	}
+
+	// How many random cells we look up, and how many generations we simulate with a cold result cache, on either side of compacting a board's nodes.
+	constexpr int32 kNumCompactionLookups = 200000;
+	constexpr int64 kNumCompactionGenerations = 8;
+
+	/**
+	 * Counts the CPU's last level cache misses on the calling thread, where the platform lets us. Only Linux does for now, and only if perf events aren't locked down.
+	 */
+	class FCacheMissCounter
+	{
+	public:
+		FCacheMissCounter()
+		{
+#if PLATFORM_LINUX
+			perf_event_attr Attributes = {};
+			Attributes.size = sizeof(Attributes);
+			Attributes.type = PERF_TYPE_HARDWARE;
+			Attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			Attributes.disabled = 1;
+			Attributes.exclude_kernel = 1;
+			Attributes.exclude_hv = 1;
+
+			mFileDescriptor = (int32)syscall(__NR_perf_event_open, &Attributes, 0, -1, -1, 0);
+			if (mFileDescriptor >= 0)
+			{
+				ioctl(mFileDescriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(mFileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		~FCacheMissCounter()
+		{
+#if PLATFORM_LINUX
+			if (mFileDescriptor >= 0)
+			{
+				close(mFileDescriptor);
+			}
+#endif
+		}
+
+		// Returns the number of cache misses since we were created, or -1 if they can't be counted.
+		double GetCacheMisses() const
+		{
+#if PLATFORM_LINUX
+			uint64 CacheMisses = 0;
+			if (mFileDescriptor >= 0 && read(mFileDescriptor, &CacheMisses, sizeof(CacheMisses)) == sizeof(CacheMisses))
+			{
+				return (double)CacheMisses;
+			}
+#endif
+			return -1.0;
+		}
+
+	private:
+		// The perf event we read the count from.
+		int32 mFileDescriptor = -1;
+	};
+
+	// How many nodes' worth of memory each thread allocates at a time when measuring the node allocator, before freeing them all again.
+	constexpr int32 kNumAllocatedNodesPerRound = 4096;
+
+	// How many rounds of allocating and freeing each thread does when measuring the node allocator.
+	constexpr int32 kNumAllocationRoundsPerThread = 64;
+
+	// Allocates and frees memory for nodes on NumThreads threads at once, and returns how many nodes per second were allocated across all of them. Nodes themselves aren't built, so the node table's locks play no part.
+	// With UseNodeSlots, memory comes from the node allocator CreateNodeWithSubnodes uses; otherwise it comes straight from the heap, as it did before nodes had an allocator of their own.
+	double MeasureNodeAllocation(const int32 NumThreads, const bool UseNodeSlots)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+
+		ParallelFor(NumThreads, [UseNodeSlots](const int32 ThreadIndex)
+			{
+				TArray<void*> Allocations;
+				Allocations.SetNumUninitialized(kNumAllocatedNodesPerRound);
+
+				for (int32 Round = 0; Round < kNumAllocationRoundsPerThread; ++Round)
+				{
+					for (void*& Allocation : Allocations)
+					{
+						Allocation = UseNodeSlots ? QuadTreeNode::AllocateNodeMemory() : FMemory::Malloc(sizeof(QuadTreeNode));
+					}
+
+					for (void* Allocation : Allocations)
+					{
+						if (UseNodeSlots)
+						{
+							QuadTreeNode::FreeNodeMemory(Allocation);
+						}
+						else
+						{
+							FMemory::Free(Allocation);
+						}
+					}
+				}
+			});
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		const double NumAllocations = (double)NumThreads * kNumAllocationRoundsPerThread * kNumAllocatedNodesPerRound;
+		return (Seconds > 0.0) ? NumAllocations / Seconds : 0.0;
+	}
+
+	// How many distinct blocks each thread builds its nodes out of. Every way of picking four of them makes a different node, so each round builds kNumAllocatedNodesPerRound distinct nodes.
+	constexpr int32 kNumConstructionChildrenPerThread = 8;
+	static_assert(kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread == kNumAllocatedNodesPerRound,
+		"Each round should build as many nodes as MeasureNodeAllocation allocates.");
+
+	// Builds and releases nodes with CreateNodeWithSubnodes on NumThreads threads at once, and returns how many nodes per second were built across all of them.
+	// Every thread builds its nodes out of children no other thread uses, so no two threads ever build the same node, but they do all go through the node table and its locks.
+	double MeasureNodeConstruction(const int32 NumThreads)
+	{
+		// The children are made up front, so that only building the nodes above them is timed.
+		TArray<TArray<TSharedPtr<const QuadTreeNode>>> ThreadChildren;
+		ThreadChildren.SetNum(NumThreads);
+		for (int32 ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+		{
+			for (int32 ChildIndex = 0; ChildIndex < kNumConstructionChildrenPerThread; ++ChildIndex)
+			{
+				// The top bit keeps every block from being empty, and the thread and child indices keep them apart.
+				ThreadChildren[ThreadIndex].Add(QuadTreeNode::CreateBlockFromBitmap((uint64(1) << 63) | ((uint64)ThreadIndex << 8) | (uint64)ChildIndex));
+			}
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+
+		ParallelFor(NumThreads, [&ThreadChildren](const int32 ThreadIndex)
+			{
+				const TArray<TSharedPtr<const QuadTreeNode>>& Children = ThreadChildren[ThreadIndex];
+				TArray<TSharedPtr<const QuadTreeNode>> Nodes;
+				Nodes.Reserve(kNumAllocatedNodesPerRound);
+
+				for (int32 Round = 0; Round < kNumAllocationRoundsPerThread; ++Round)
+				{
+					for (int32 NodeIndex = 0; NodeIndex < kNumAllocatedNodesPerRound; ++NodeIndex)
+					{
+						Nodes.Add(QuadTreeNode::CreateNodeWithSubnodes(QuadTreeNode::kBlockLevel + 1,
+							Children[NodeIndex % kNumConstructionChildrenPerThread],
+							Children[(NodeIndex / kNumConstructionChildrenPerThread) % kNumConstructionChildrenPerThread],
+							Children[(NodeIndex / (kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread)) % kNumConstructionChildrenPerThread],
+							Children[NodeIndex / (kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread * kNumConstructionChildrenPerThread)]));
+					}
+
+					// Releasing the nodes takes them back out of the table, so the next round builds them all over again.
+					Nodes.Reset();
+				}
+			});
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		const double NumNodes = (double)NumThreads * kNumAllocationRoundsPerThread * kNumAllocatedNodesPerRound;
+		return (Seconds > 0.0) ? NumNodes / Seconds : 0.0;
+	}
+
+	// Builds a max size board containing Pattern.
+	UGameBoard* CreateBoardWithPattern(const TArray<FBoardCoordinate>& Pattern)
+	{
+		UGameBoard* GameBoard = UGameBoard::InitializeMaxSizeBoard();
+		GameBoard->AddToRoot();
+		GameBoard->SetCellsToAlive(Pattern);
+		return GameBoard;
+	}
+
+	// Releases a board created by CreateBoardWithPattern, along with all of its nodes.
+	void DestroyBoard(UGameBoard* GameBoard)
+	{
+		GameBoard->RemoveFromRoot();
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	// Looks up random cells within the live bounds of GameBoard, returning how long it took in milliseconds. Each lookup walks the tree from the root down to a leaf.
+	double TimeRandomLookups(const UGameBoard* GameBoard)
+	{
+		FBoardRect Bounds;
+		if (!GameBoard->GetLiveBounds(Bounds))
+		{
+			return 0.0;
+		}
+
+		FRandomStream RandomStream(kNumCompactionLookups);
+		const TSharedPtr<const QuadTreeNode> RootNode = GameBoard->GetRootNode();
+
+		int32 NumAlive = 0;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Lookup = 0; Lookup < kNumCompactionLookups; ++Lookup)
+		{
+			const uint64 X = Bounds.mMinX + (uint64)(RandomStream.FRand() * (Bounds.mMaxX - Bounds.mMinX));
+			const uint64 Y = Bounds.mMinY + (uint64)(RandomStream.FRand() * (Bounds.mMaxY - Bounds.mMinY));
+			NumAlive += RootNode->GetIsCellAlive(X, Y) ? 1 : 0;
+		}
+		const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+		UE_LOG(LogTemp, Verbose, TEXT("%d of %d random lookups were alive."), NumAlive, kNumCompactionLookups);
+		return Milliseconds;
+	}
+
+	// Simulates GameBoard for kNumCompactionGenerations generations starting with an empty result cache, so every step has to walk the board's own nodes.
+	// The root is advanced directly rather than through the board, which would skip the work entirely once its period detector finds the pattern has settled. The board itself is left where it was.
+	void TimeColdGenerations(UGameBoard* GameBoard, double& MillisecondsPerGenerationOut, double& CacheMissesPerGenerationOut)
+	{
+		QuadTreeNode::ClearResultCache();
+
+		TSharedPtr<const QuadTreeNode> RootNode = GameBoard->GetRootNode();
+		const FLifeRule& Rule = GameBoard->GetRule();
+
+		const FCacheMissCounter CacheMissCounter;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int64 Generation = 0; Generation < kNumCompactionGenerations; ++Generation)
+		{
+			RootNode = UGameBoard::ComputeNextGenerationOfRoot(RootNode, Rule);
+		}
+
+		MillisecondsPerGenerationOut = (FPlatformTime::Seconds() - StartTime) * 1000.0 / kNumCompactionGenerations;
+
+		const double CacheMisses = CacheMissCounter.GetCacheMisses();
+		CacheMissesPerGenerationOut = (CacheMisses >= 0.0) ? CacheMisses / kNumCompactionGenerations : -1.0;
+	}
+
+	// Measures GameBoard as it is and again after compacting its nodes, from the same generation both times. Runs on one thread, which is the only one whose cache misses are counted.
+	void MeasureCompaction(UGameBoard* GameBoard, const int32 NumThreads, FBenchmarkResult& Result)
+	{
+		QuadTreeNode::SetMaxSimulationThreads(1);
+
+		Result.mLookupMilliseconds = TimeRandomLookups(GameBoard);
+		TimeColdGenerations(GameBoard, Result.mMillisecondsPerColdGeneration, Result.mCacheMissesPerColdGeneration);
+
+		QuadTreeNode::ClearResultCache();
+		Result.mCompactionMilliseconds = GameBoard->CompactNodes().mSeconds * 1000.0;
+
+		Result.mCompactedLookupMilliseconds = TimeRandomLookups(GameBoard);
+		TimeColdGenerations(GameBoard, Result.mCompactedMillisecondsPerColdGeneration, Result.mCompactedCacheMissesPerColdGeneration);
+
+		QuadTreeNode::SetMaxSimulationThreads(NumThreads);
+	}
+
+	// Runs one case of the corpus and measures it. Returns false if the case's pattern could not be made.
+	bool RunBenchmarkCase(const FBenchmarkCase& Case, const int32 NumThreads, FBenchmarkResult& Result)
+	{
+		Result.mName = Case.mName;
+		Result.mDoublingExponent = Case.mDoublingExponent;
+
+		TArray<FBoardCoordinate> Pattern;
+		const double LoadStartTime = FPlatformTime::Seconds();
+		if (!Case.mGeneratePattern(Pattern))
+		{
+			return false;
+		}
+
+		UGameBoard* GameBoard = CreateBoardWithPattern(Pattern);
+		Result.mLoadMilliseconds = (FPlatformTime::Seconds() - LoadStartTime) * 1000.0;
+		Result.mInitialPopulation = GameBoard->GetRootNode()->GetPopulation();
+
+		// Time per generation, along with how many nodes and how much memory it took.
+		QuadTreeNode::ResetPeakLiveNodeCount();
+		const int64 NodeCountBefore = QuadTreeNode::GetLiveNodeCount();
+		const uint64 MemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+
+		const double SimulationStartTime = FPlatformTime::Seconds();
+		for (int64 Generation = 0; Generation < Case.mNumGenerations; ++Generation)
+		{
+			GameBoard->SimulateNextGeneration();
+		}
+		Result.mMillisecondsPerGeneration = (FPlatformTime::Seconds() - SimulationStartTime) * 1000.0 / FMath::Max<int64>(Case.mNumGenerations, 1);
+
+		const uint64 MemoryAfter = FPlatformMemory::GetStats().UsedPhysical;
+		Result.mPeakNodeCount = QuadTreeNode::GetPeakLiveNodeCount();
+		Result.mFinalPopulation = GameBoard->GetRootNode()->GetPopulation();
+
+		// Memory measurements are noisy for small patterns, so fall back to the size of a node and its reference controller when they don't tell us anything.
+		const int64 NodesAdded = QuadTreeNode::GetPeakLiveNodeCount() - NodeCountBefore;
+		Result.mBytesPerNode = (NodesAdded > 0 && MemoryAfter > MemoryBefore) ? (double)(MemoryAfter - MemoryBefore) / NodesAdded : (double)QuadTreeNode::GetBytesPerNode();
+
+		// How much laying the board's nodes out in walk order helps, once the board has run long enough to scatter them.
+		MeasureCompaction(GameBoard, NumThreads, Result);
+
+		DestroyBoard(GameBoard);
+
+		// Time for 2^k generations, from a fresh copy of the pattern.
+		GameBoard = CreateBoardWithPattern(Pattern);
+
+		const int64 NumDoublingGenerations = int64(1) << Case.mDoublingExponent;
+		const double DoublingStartTime = FPlatformTime::Seconds();
+		for (int64 Generation = 0; Generation < NumDoublingGenerations; ++Generation)
+		{
+			GameBoard->SimulateNextGeneration();
+		}
+		Result.mMillisecondsForDoublingGenerations = (FPlatformTime::Seconds() - DoublingStartTime) * 1000.0;
+
+		DestroyBoard(GameBoard);
+
+		return true;
+	}
+
+	// Writes results as both JSON and CSV. OutputPath is the JSON path, and the CSV goes beside it.
+	bool WriteBenchmarkResults(const TArray<FBenchmarkResult>& Results, const FString& OutputPath)
+	{
+		TArray<TSharedPtr<FJsonValue>> JsonCases;
+		FString CSV = TEXT("name");
+		for (const FBenchmarkMetric& Metric : kBenchmarkMetrics)
+		{
+			CSV += FString::Printf(TEXT(",%s"), Metric.mFieldName);
+		}
+		CSV += TEXT("\n");
+
+		for (const FBenchmarkResult& Result : Results)
+		{
+			TSharedRef<FJsonObject> JsonCase = MakeShared<FJsonObject>();
+			JsonCase->SetStringField(TEXT("name"), Result.mName);
+			CSV += Result.mName;
+
+			for (const FBenchmarkMetric& Metric : kBenchmarkMetrics)
+			{
+				JsonCase->SetNumberField(Metric.mFieldName, Result.*Metric.mValue);
+				CSV += FString::Printf(TEXT(",%f"), Result.*Metric.mValue);
+			}
+
+			JsonCases.Add(MakeShared<FJsonValueObject>(JsonCase));
+			CSV += TEXT("\n");
+		}
+
+		TSharedRef<FJsonObject> JsonRoot = MakeShared<FJsonObject>();
+		JsonRoot->SetArrayField(TEXT("cases"), JsonCases);
+
+		FString JSON;
+		TSharedRef<TJsonWriter<>> JsonWriter = TJsonWriterFactory<>::Create(&JSON);
+		FJsonSerializer::Serialize(JsonRoot, JsonWriter);
+
+		const FString CSVPath = FPaths::ChangeExtension(OutputPath, TEXT("csv"));
+		if (!FFileHelper::SaveStringToFile(JSON, *OutputPath) || !FFileHelper::SaveStringToFile(CSV, *CSVPath))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not write benchmark results to %s."), *OutputPath);
+			return false;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Wrote benchmark results to %s and %s."), *OutputPath, *CSVPath);
+		return true;
+	}
+
+	// Compares results against a baseline written by a previous run. Returns the number of metrics that regressed by more than Tolerance, or -1 if the baseline could not be read.
+	int32 CompareAgainstBaseline(const TArray<FBenchmarkResult>& Results, const FString& BaselinePath, const float Tolerance)
+	{
+		FString BaselineJSON;
+		TSharedPtr<FJsonObject> BaselineRoot;
+		if (!FFileHelper::LoadFileToString(BaselineJSON, *BaselinePath) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(BaselineJSON), BaselineRoot) || !BaselineRoot.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not read benchmark baseline %s."), *BaselinePath);
+			return -1;
+		}
+
+		TMap<FString, TSharedPtr<FJsonObject>> BaselineCases;
+		for (const TSharedPtr<FJsonValue>& BaselineCase : BaselineRoot->GetArrayField(TEXT("cases")))
+		{
+			const TSharedPtr<FJsonObject> BaselineCaseObject = BaselineCase->AsObject();
+			BaselineCases.Add(BaselineCaseObject->GetStringField(TEXT("name")), BaselineCaseObject);
+		}
+
+		int32 NumRegressions = 0;
+		for (const FBenchmarkResult& Result : Results)
+		{
+			const TSharedPtr<FJsonObject>* BaselineCase = BaselineCases.Find(Result.mName);
+			if (BaselineCase == nullptr)
+			{
+				UE_LOG(LogTemp, Display, TEXT("%s: no baseline to compare against."), *Result.mName);
+				continue;
+			}
+
+			for (int32 MetricIndex = 0; MetricIndex < kNumComparedMetrics; ++MetricIndex)
+			{
+				const FBenchmarkMetric& Metric = kBenchmarkMetrics[MetricIndex];
+
+				double BaselineValue = 0.0;
+				if (!(*BaselineCase)->TryGetNumberField(Metric.mFieldName, BaselineValue) || BaselineValue <= 0.0)
+				{
+					continue;
+				}
+
+				const double CurrentValue = Result.*Metric.mValue;
+				const double Change = (CurrentValue - BaselineValue) / BaselineValue;
+
+				if (Change > Tolerance)
+				{
+					UE_LOG(LogTemp, Warning, TEXT("%s: %s regressed from %f to %f (%+.1f%%)"), *Result.mName, Metric.mFieldName, BaselineValue, CurrentValue, Change * 100.0);
+					++NumRegressions;
+				}
+				else if (Change < -Tolerance)
+				{
+					UE_LOG(LogTemp, Display, TEXT("%s: %s improved from %f to %f (%+.1f%%)"), *Result.mName, Metric.mFieldName, BaselineValue, CurrentValue, Change * 100.0);
+				}
+			}
+		}
+
+		return NumRegressions;
+	}
+}
+
+UConwaysBenchmarkCommandlet::UConwaysBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("results.json"));
+	FParse::Value(*Params, TEXT("output="), OutputPath);
+
+	FString BaselinePath;
+	FParse::Value(*Params, TEXT("baseline="), BaselinePath);
+
+	float Tolerance = 0.1f;
+	FParse::Value(*Params, TEXT("tolerance="), Tolerance);
+
+	FString CaseFilter;
+	TArray<FString> CasesToRun;
+	if (FParse::Value(*Params, TEXT("cases="), CaseFilter))
+	{
+		CaseFilter.ParseIntoArray(CasesToRun, TEXT(","));
+	}
+
+	int32 NumThreads = 0;
+	FParse::Value(*Params, TEXT("threads="), NumThreads);
+	QuadTreeNode::SetMaxSimulationThreads(NumThreads);
+
+	// Threads allocating nodes at once should each get about as much done as one thread on its own, and more than they would from the heap.
+	const int32 NumAllocationThreads = (NumThreads > 0) ? NumThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	double SlotNodesPerSecond[2] = {};
+	for (const bool UseNodeSlots : { true, false })
+	{
+		const double SingleThreadNodesPerSecond = MeasureNodeAllocation(1, UseNodeSlots);
+		const double MultiThreadNodesPerSecond = MeasureNodeAllocation(NumAllocationThreads, UseNodeSlots);
+		UE_LOG(LogTemp, Display, TEXT("node allocation from %s: %.2f million nodes per second on 1 thread, %.2f million on %d threads (%.2fx)"), UseNodeSlots ? TEXT("slots") : TEXT("the heap"),
+			SingleThreadNodesPerSecond / 1000000.0, MultiThreadNodesPerSecond / 1000000.0, NumAllocationThreads, MultiThreadNodesPerSecond / FMath::Max(SingleThreadNodesPerSecond, 1.0));
+
+		if (UseNodeSlots)
+		{
+			SlotNodesPerSecond[0] = SingleThreadNodesPerSecond;
+			SlotNodesPerSecond[1] = MultiThreadNodesPerSecond;
+		}
+	}
+
+	// Building whole nodes also hashes them into the node table, under its locks, and takes them back out when they're released. Whatever that costs on top of allocating from slots is the table's share.
+	const double SingleThreadConstructedNodesPerSecond = MeasureNodeConstruction(1);
+	const double MultiThreadConstructedNodesPerSecond = MeasureNodeConstruction(NumAllocationThreads);
+	UE_LOG(LogTemp, Display, TEXT("node construction: %.2f million nodes per second on 1 thread, %.2f million on %d threads (%.2fx)"),
+		SingleThreadConstructedNodesPerSecond / 1000000.0, MultiThreadConstructedNodesPerSecond / 1000000.0, NumAllocationThreads, MultiThreadConstructedNodesPerSecond / FMath::Max(SingleThreadConstructedNodesPerSecond, 1.0));
+
+	// Nanoseconds per node of wall clock time, across all threads, spent on top of allocating the node's memory.
+	auto GetTableNanosecondsPerNode = [](const double ConstructedNodesPerSecond, const double AllocatedNodesPerSecond)
+	{
+		return (ConstructedNodesPerSecond > 0.0 && AllocatedNodesPerSecond > 0.0) ? (1.0 / ConstructedNodesPerSecond - 1.0 / AllocatedNodesPerSecond) * 1000000000.0 : 0.0;
+	};
+	UE_LOG(LogTemp, Display, TEXT("    the node table adds %.1f ns per node on 1 thread and %.1f ns on %d threads, %.0f%% and %.0f%% of the time to build a node"),
+		GetTableNanosecondsPerNode(SingleThreadConstructedNodesPerSecond, SlotNodesPerSecond[0]), GetTableNanosecondsPerNode(MultiThreadConstructedNodesPerSecond, SlotNodesPerSecond[1]), NumAllocationThreads,
+		100.0 * (1.0 - SingleThreadConstructedNodesPerSecond / FMath::Max(SlotNodesPerSecond[0], 1.0)), 100.0 * (1.0 - MultiThreadConstructedNodesPerSecond / FMath::Max(SlotNodesPerSecond[1], 1.0)));
+
+	TArray<FBenchmarkResult> Results;
+	for (const FBenchmarkCase& Case : MakeBenchmarkCorpus())
+	{
+		if (CasesToRun.Num() > 0 && !CasesToRun.Contains(Case.mName))
+		{
+			continue;
+		}
+
+		FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+		if (!RunBenchmarkCase(Case, NumThreads, Result))
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s: could not make the pattern."), *Case.mName);
+			return 1;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("%s: load %.3f ms, %.3f ms per generation, %.3f ms for 2^%d generations, %.0f peak nodes, %.1f bytes per node"),
+			*Result.mName, Result.mLoadMilliseconds, Result.mMillisecondsPerGeneration, Result.mMillisecondsForDoublingGenerations, (int32)Result.mDoublingExponent, Result.mPeakNodeCount, Result.mBytesPerNode);
+		UE_LOG(LogTemp, Display, TEXT("    compaction %.3f ms: lookups %.3f -> %.3f ms, cold generations %.3f -> %.3f ms, %.0f -> %.0f cache misses per generation"),
+			Result.mCompactionMilliseconds, Result.mLookupMilliseconds, Result.mCompactedLookupMilliseconds, Result.mMillisecondsPerColdGeneration, Result.mCompactedMillisecondsPerColdGeneration,
+			Result.mCacheMissesPerColdGeneration, Result.mCompactedCacheMissesPerColdGeneration);
+	}
+
+	if (!WriteBenchmarkResults(Results, OutputPath))
+	{
+		return 1;
+	}
+
+	if (!BaselinePath.IsEmpty())
+	{
+		const int32 NumRegressions = CompareAgainstBaseline(Results, BaselinePath, Tolerance);
+		if (NumRegressions != 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%d benchmark metrics regressed by more than %.0f%%."), FMath::Max(NumRegressions, 0), Tolerance * 100.0);
+			return 1;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("No benchmark metrics regressed by more than %.0f%%."), Tolerance * 100.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysCheckpointCommandlet.h"
+
+#include "BoardCheckpointStream.h"
+#include "Misc/Parse.h"
+
+UConwaysCheckpointCommandlet::UConwaysCheckpointCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysCheckpointCommandlet::Main(const FString& Params)
+{
+	FString StreamPath;
+	if (!FParse::Value(*Params, TEXT("stream="), StreamPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ConwaysCheckpoint -stream=<file> [-compact] [-checkpoint=N] [-output=<file>]"));
+		return 1;
+	}
+
+	TArray<FBoardCheckpointInfo> CheckpointInfos;
+	if (!FBoardCheckpointStream::ReadCheckpointInfos(StreamPath, CheckpointInfos))
+	{
+		return 1;
+	}
+
+	// Without -compact, just describe the stream.
+	if (!FParse::Param(*Params, TEXT("compact")))
+	{
+		int64 TotalBytes = 0;
+		for (int32 Index = 0; Index < CheckpointInfos.Num(); ++Index)
+		{
+			const FBoardCheckpointInfo& Info = CheckpointInfos[Index];
+			UE_LOG(LogTemp, Display, TEXT("Checkpoint %d: generation %lld, rule %s, level %d, %d new nodes, %lld bytes"), Index, Info.mGeneration, *Info.mRuleString, Info.mRootLevel, Info.mNumNewNodes, Info.mNumBytes);
+			TotalBytes += Info.mNumBytes;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("%s: %d checkpoints in %.1f KB"), *StreamPath, CheckpointInfos.Num(), TotalBytes / 1024.0);
+		return 0;
+	}
+
+	// Compact up to the last checkpoint unless told otherwise, in place unless told otherwise.
+	int32 CheckpointIndex = CheckpointInfos.Num() - 1;
+	FParse::Value(*Params, TEXT("checkpoint="), CheckpointIndex);
+
+	FString OutputPath = StreamPath;
+	FParse::Value(*Params, TEXT("output="), OutputPath);
+
+	if (CheckpointIndex < 0 || CheckpointIndex >= CheckpointInfos.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has %d checkpoints, so there's no checkpoint %d to compact to."), *StreamPath, CheckpointInfos.Num(), CheckpointIndex);
+		return 1;
+	}
+
+	int64 StreamBytes = 0;
+	for (int32 Index = 0; Index <= CheckpointIndex; ++Index)
+	{
+		StreamBytes += CheckpointInfos[Index].mNumBytes;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	FBoardCheckpointInfo CompactedInfo;
+	if (!FBoardCheckpointStream::Compact(StreamPath, CheckpointIndex, OutputPath, CompactedInfo))
+	{
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Compacted %d checkpoints in %.1f KB into generation %lld in %.1f KB (%d nodes) at %s, in %.3f ms"), CheckpointIndex + 1, StreamBytes / 1024.0, CompactedInfo.mGeneration,
+		CompactedInfo.mNumBytes / 1024.0, CompactedInfo.mNumNewNodes, *OutputPath, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	return 0;
+}
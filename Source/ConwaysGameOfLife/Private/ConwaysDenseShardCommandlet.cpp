@@ -0,0 +1,38 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysDenseShardCommandlet.h"
+
+#include "DenseShardSimulation.h"
+#include "LifeRule.h"
+#include "Misc/Parse.h"
+
+UConwaysDenseShardCommandlet::UConwaysDenseShardCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysDenseShardCommandlet::Main(const FString& Params)
+{
+	FString RegionName;
+	int32 ShardIndex = INDEX_NONE;
+	FString RuleString = TEXT("B3/S23");
+	FParse::Value(*Params, TEXT("rule="), RuleString);
+
+	if (!FParse::Value(*Params, TEXT("region="), RegionName) || !FParse::Value(*Params, TEXT("shard="), ShardIndex))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ConwaysDenseShard -region=<name> -shard=N [-rule=B3/S23]"));
+		return 1;
+	}
+
+	const FLifeRule* Rule = FLifeRule::FindOrCreate(RuleString);
+	if (Rule == nullptr)
+	{
+		return 1;
+	}
+
+	return FDenseShardSimulation::RunWorker(RegionName, ShardIndex, *Rule);
+}
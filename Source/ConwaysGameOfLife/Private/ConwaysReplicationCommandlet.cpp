@@ -0,0 +1,237 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysReplicationCommandlet.h"
+
+#include "BoardReplication.h"
+#include "BoardUtilities.h"
+#include "GameBoard.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Parse.h"
+
+namespace
+{
+	// The port servers listen on and clients connect to unless told otherwise.
+	constexpr int32 kDefaultPort = 7777;
+
+	// How long the loopback test waits for a generation to arrive before giving up, in seconds.
+	constexpr double kLoopbackTimeoutSeconds = 30.0;
+
+	// Pumps Server and Spectator until Spectator has caught up with Server's generation. Returns false if it didn't within kLoopbackTimeoutSeconds.
+	// Both boards live in this process, so nodes are shared between them and the spectator has only caught up once its root is the very same node as the server's, not just one with the same hash.
+	bool WaitForSpectator(UGameBoard* Server, UGameBoard* Spectator)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		while (Spectator->GetGeneration() != Server->GetGeneration() || Spectator->GetRootNode() != Server->GetRootNode())
+		{
+			Server->UpdateReplication();
+			Spectator->UpdateReplication();
+
+			if (Spectator->GetReplicationClient() == nullptr || FPlatformTime::Seconds() - StartTime > kLoopbackTimeoutSeconds)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Serves Pattern and watches it from a spectator in this process over loopback, checking that every generation arrives intact. Returns the commandlet's exit code.
+	int32 RunLoopback(const FString& Params, UGameBoard* Server)
+	{
+		int64 NumGenerations = 100;
+		FParse::Value(*Params, TEXT("generations="), NumGenerations);
+
+		int64 ReportEvery = 0;
+		FParse::Value(*Params, TEXT("reportevery="), ReportEvery);
+
+		// Any free port will do, since both ends are ours.
+		UGameBoard* Spectator = UGameBoard::InitializeMaxSizeBoard();
+		Spectator->AddToRoot();
+
+		if (!Server->StartReplicationServer(0) || !Spectator->StartReplicationClient(TEXT("127.0.0.1"), Server->GetReplicationServer()->GetPort()) || !WaitForSpectator(Server, Spectator))
+		{
+			UE_LOG(LogTemp, Error, TEXT("The spectator never received the starting board."));
+			Spectator->RemoveFromRoot();
+			return 1;
+		}
+
+		const FBoardReplicationStats InitialStats = Server->GetReplicationServer()->GetStats();
+		UE_LOG(LogTemp, Display, TEXT("Starting board: population %llu, %lld nodes in %.1f KB"), Server->GetRootNode()->GetPopulation(), InitialStats.mNumNodes, InitialStats.mNumBytes / 1024.0);
+
+		// A spectator sent the live cells every generation would need this much, which is what we compare against.
+		double TotalPopulation = 0.0;
+		int64 NumGenerationsReceived = 0;
+
+		for (int64 Generation = 1; Generation <= NumGenerations; ++Generation)
+		{
+			const FBoardReplicationStats StatsBefore = Server->GetReplicationServer()->GetStats();
+			Server->SimulateNextGeneration();
+
+			if (!WaitForSpectator(Server, Spectator))
+			{
+				UE_LOG(LogTemp, Error, TEXT("The spectator didn't receive generation %lld intact."), Server->GetGeneration());
+				Spectator->RemoveFromRoot();
+				return 1;
+			}
+
+			++NumGenerationsReceived;
+			TotalPopulation += Server->GetRootNode()->GetPopulation();
+
+			if (ReportEvery > 0 && Generation % ReportEvery == 0)
+			{
+				const FBoardReplicationStats& Stats = Server->GetReplicationServer()->GetStats();
+				UE_LOG(LogTemp, Display, TEXT("Generation %lld: population %llu, %lld new nodes in %lld bytes"), Server->GetGeneration(), Server->GetRootNode()->GetPopulation(),
+					Stats.mNumNodes - StatsBefore.mNumNodes, Stats.mNumBytes - StatsBefore.mNumBytes);
+			}
+		}
+
+		const FBoardReplicationStats& Stats = Server->GetReplicationServer()->GetStats();
+		const double BytesPerGeneration = (double)(Stats.mNumBytes - InitialStats.mNumBytes) / FMath::Max<int64>(NumGenerationsReceived, 1);
+		const double CellBytesPerGeneration = TotalPopulation * sizeof(FBoardCoordinate) / FMath::Max<int64>(NumGenerationsReceived, 1);
+
+		UE_LOG(LogTemp, Display, TEXT("Replicated %lld generations intact: %.0f bytes and %.1f nodes per generation, against %.0f bytes per generation to send every live cell. The spectator holds %d nodes."),
+			NumGenerationsReceived, BytesPerGeneration, (double)(Stats.mNumNodes - InitialStats.mNumNodes) / FMath::Max<int64>(NumGenerationsReceived, 1), CellBytesPerGeneration,
+			Spectator->GetReplicationClient()->GetNumKnownNodes());
+
+		Spectator->RemoveFromRoot();
+		return 0;
+	}
+
+	// Serves Pattern on a port of its own, waiting for spectators before simulating it at a steady rate. Returns the commandlet's exit code.
+	int32 RunServer(const FString& Params, UGameBoard* Server)
+	{
+		int32 Port = kDefaultPort;
+		FParse::Value(*Params, TEXT("port="), Port);
+
+		int32 NumClients = 1;
+		FParse::Value(*Params, TEXT("clients="), NumClients);
+
+		float GenerationsPerSecond = 10.0f;
+		FParse::Value(*Params, TEXT("gps="), GenerationsPerSecond);
+
+		int64 NumGenerations = 1000;
+		FParse::Value(*Params, TEXT("generations="), NumGenerations);
+
+		if (!Server->StartReplicationServer(Port))
+		{
+			return 1;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Serving on port %d, waiting for %d spectators."), Server->GetReplicationServer()->GetPort(), NumClients);
+		while (Server->GetReplicationServer()->GetNumClients() < NumClients)
+		{
+			Server->UpdateReplication();
+			FPlatformProcess::Sleep(0.01f);
+		}
+
+		const double SecondsPerGeneration = 1.0 / FMath::Max(GenerationsPerSecond, 0.001f);
+		double NextGenerationTime = FPlatformTime::Seconds();
+
+		while (Server->GetGeneration() < NumGenerations && Server->GetReplicationServer()->GetNumClients() > 0)
+		{
+			Server->UpdateReplication();
+
+			if (FPlatformTime::Seconds() < NextGenerationTime)
+			{
+				FPlatformProcess::Sleep(0.001f);
+				continue;
+			}
+
+			Server->SimulateNextGeneration();
+			NextGenerationTime += SecondsPerGeneration;
+		}
+
+		const FBoardReplicationStats& Stats = Server->GetReplicationServer()->GetStats();
+		UE_LOG(LogTemp, Display, TEXT("Served %lld generations to spectators: %lld nodes in %.1f KB, %lld generations skipped for spectators that fell behind."),
+			Stats.mNumGenerations, Stats.mNumNodes, Stats.mNumBytes / 1024.0, Stats.mNumSkippedGenerations);
+
+		return 0;
+	}
+
+	// Watches the server at Address until it goes away. Returns the commandlet's exit code.
+	int32 RunClient(const FString& Params, const FString& Address)
+	{
+		int32 Port = kDefaultPort;
+		FParse::Value(*Params, TEXT("port="), Port);
+
+		UGameBoard* Spectator = UGameBoard::InitializeMaxSizeBoard();
+		Spectator->AddToRoot();
+
+		if (!Spectator->StartReplicationClient(Address, Port))
+		{
+			Spectator->RemoveFromRoot();
+			return 1;
+		}
+
+		FBoardReplicationStats StatsBefore;
+		while (const FBoardReplicationClient* Client = Spectator->GetReplicationClient())
+		{
+			StatsBefore = Client->GetStats();
+
+			if (!Spectator->UpdateReplication())
+			{
+				FPlatformProcess::Sleep(0.001f);
+				continue;
+			}
+
+			// The client goes away with the connection, so it's looked up again.
+			if (const FBoardReplicationClient* UpdatedClient = Spectator->GetReplicationClient())
+			{
+				const FBoardReplicationStats& Stats = UpdatedClient->GetStats();
+				UE_LOG(LogTemp, Display, TEXT("Generation %lld: population %llu, %lld new nodes in %lld bytes"), Spectator->GetGeneration(), Spectator->GetRootNode()->GetPopulation(),
+					Stats.mNumNodes - StatsBefore.mNumNodes, Stats.mNumBytes - StatsBefore.mNumBytes);
+			}
+		}
+
+		Spectator->RemoveFromRoot();
+		return 0;
+	}
+}
+
+UConwaysReplicationCommandlet::UConwaysReplicationCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysReplicationCommandlet::Main(const FString& Params)
+{
+	FString Address;
+	if (FParse::Value(*Params, TEXT("connect="), Address))
+	{
+		return RunClient(Params, Address);
+	}
+
+	FString PatternPath;
+	if (!FParse::Value(*Params, TEXT("pattern="), PatternPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ConwaysReplication [-serve] -pattern=<file> [-generations=N] [-rule=B3/S23] [-reportevery=N] [-port=N] [-clients=N] [-gps=N], or -run=ConwaysReplication -connect=<address> [-port=N]"));
+		return 1;
+	}
+
+	FString RuleString = TEXT("B3/S23");
+	FParse::Value(*Params, TEXT("rule="), RuleString);
+
+	TArray<FBoardCoordinate> Pattern;
+	if (!UBoardUtilities::LoadPatternFile(PatternPath, Pattern))
+	{
+		return 1;
+	}
+
+	UGameBoard* Server = UGameBoard::InitializeMaxSizeBoard(RuleString);
+	if (Server == nullptr)
+	{
+		return 1;
+	}
+
+	Server->AddToRoot();
+	Server->SetCellsToAlive(Pattern);
+
+	const int32 Result = FParse::Param(*Params, TEXT("serve")) ? RunServer(Params, Server) : RunLoopback(Params, Server);
+
+	Server->RemoveFromRoot();
+	return Result;
+}
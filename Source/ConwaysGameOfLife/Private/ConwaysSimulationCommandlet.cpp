@@ -0,0 +1,300 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysSimulationCommandlet.h"
+
+#include "BoardCheckpointStream.h"
+#include "BoardUtilities.h"
+#include "DenseLifeGrid.h"
+#include "DenseShardSimulation.h"
+#include "GameBoard.h"
+#include "HAL/PlatformMemory.h"
+#include "LifeRule.h"
+#include "Misc/Parse.h"
+#include "PersistentResultCache.h"
+
+namespace
+{
+	// Runs Pattern on a dense grid, either on this process's threads or split across worker processes. Returns the commandlet's exit code.
+	int32 RunDenseSimulation(const FString& Params, const FString& Engine, const TArray<FBoardCoordinate>& Pattern, const FString& RuleString, const int64 NumGenerations)
+	{
+		const FLifeRule* Rule = FLifeRule::FindOrCreate(RuleString);
+		if (Rule == nullptr)
+		{
+			return 1;
+		}
+
+		// Dense grids are bounded, so size the grid to fit the pattern with room to grow on every side, unless told otherwise.
+		uint64 MinX = 0, MinY = 0, MaxX = 0, MaxY = 0;
+		for (int32 Index = 0; Index < Pattern.Num(); ++Index)
+		{
+			MinX = (Index == 0) ? Pattern[Index].mX : FMath::Min(MinX, Pattern[Index].mX);
+			MinY = (Index == 0) ? Pattern[Index].mY : FMath::Min(MinY, Pattern[Index].mY);
+			MaxX = (Index == 0) ? Pattern[Index].mX : FMath::Max(MaxX, Pattern[Index].mX);
+			MaxY = (Index == 0) ? Pattern[Index].mY : FMath::Max(MaxY, Pattern[Index].mY);
+		}
+
+		int64 Margin = 64;
+		FParse::Value(*Params, TEXT("margin="), Margin);
+
+		int64 Width = (int64)(MaxX - MinX + 1) + 2 * Margin;
+		int64 Height = (int64)(MaxY - MinY + 1) + 2 * Margin;
+		FParse::Value(*Params, TEXT("width="), Width);
+		FParse::Value(*Params, TEXT("height="), Height);
+
+		if (Width <= 0 || Height <= 0 || Width > MAX_int32 || Height > MAX_int32)
+		{
+			UE_LOG(LogTemp, Error, TEXT("A dense grid of %lldx%lld isn't supported."), Width, Height);
+			return 1;
+		}
+
+		// Center the pattern on the grid. Anything that doesn't fit is left off.
+		FDenseLifeGrid Grid((int32)Width, (int32)Height);
+		const int64 OffsetX = (Width - (int64)(MaxX - MinX + 1)) / 2;
+		const int64 OffsetY = (Height - (int64)(MaxY - MinY + 1)) / 2;
+		for (const FBoardCoordinate& Cell : Pattern)
+		{
+			Grid.SetCellToAlive((int32)((int64)(Cell.mX - MinX) + OffsetX), (int32)((int64)(Cell.mY - MinY) + OffsetY));
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Dense grid: %dx%d, population %llu"), Grid.GetWidth(), Grid.GetHeight(), Grid.GetPopulation());
+
+		// Run the simulation.
+		const double SimulationStartTime = FPlatformTime::Seconds();
+		uint64 FinalPopulation = 0;
+
+		if (Engine == TEXT("dense"))
+		{
+			for (int64 Generation = 1; Generation <= NumGenerations; ++Generation)
+			{
+				Grid.SimulateNextGeneration(*Rule);
+			}
+
+			FinalPopulation = Grid.GetPopulation();
+		}
+		else
+		{
+			FDenseShardSettings Settings;
+			Settings.mRuleString = RuleString;
+			Settings.mNumGenerations = NumGenerations;
+			FParse::Value(*Params, TEXT("shards="), Settings.mNumShards);
+			FParse::Value(*Params, TEXT("halo="), Settings.mHaloWidth);
+
+			FDenseShardStats ShardStats;
+			if (!FDenseShardSimulation::Run(Grid, Settings, ShardStats))
+			{
+				return 1;
+			}
+
+			FinalPopulation = ShardStats.mPopulation;
+			UE_LOG(LogTemp, Display, TEXT("Shards: %d worker processes, halos %d rows wide, %lld exchanges"), Settings.mNumShards, Settings.mHaloWidth, ShardStats.mNumExchanges);
+		}
+
+		const double SimulationTime = FPlatformTime::Seconds() - SimulationStartTime;
+
+		// Print our stats.
+		const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+
+		UE_LOG(LogTemp, Display, TEXT("Engine: %s, rule: %s"), *Engine, *Rule->GetRuleString());
+		UE_LOG(LogTemp, Display, TEXT("Generations: %lld in %.3f ms (%.3f ms per generation, %.1f million cell updates per second)"), NumGenerations, SimulationTime * 1000.0, NumGenerations > 0 ? SimulationTime * 1000.0 / NumGenerations : 0.0,
+			SimulationTime > 0.0 ? (double)Width * Height * NumGenerations / SimulationTime / 1000000.0 : 0.0);
+		UE_LOG(LogTemp, Display, TEXT("Final population: %llu"), FinalPopulation);
+		UE_LOG(LogTemp, Display, TEXT("Process memory: %.1f MB used, %.1f MB peak"), MemoryStats.UsedPhysical / (1024.0 * 1024.0), MemoryStats.PeakUsedPhysical / (1024.0 * 1024.0));
+
+		return 0;
+	}
+}
+
+UConwaysSimulationCommandlet::UConwaysSimulationCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysSimulationCommandlet::Main(const FString& Params)
+{
+	FString PatternPath;
+	if (!FParse::Value(*Params, TEXT("pattern="), PatternPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ConwaysSimulation -pattern=<file> [-generations=N] [-rule=B3/S23] [-engine=quadtree|dense|sharded] [-threads=N] [-reportevery=N] [-resultcache=<file>] [-resultcachemb=N] [-checkpoint=<file>] [-checkpointevery=N] [-compactevery=N] [-find=<file>] [-findborder=N] [-shards=N] [-halo=N] [-margin=N] [-width=N] [-height=N]"));
+		return 1;
+	}
+
+	int64 NumGenerations = 100;
+	FParse::Value(*Params, TEXT("generations="), NumGenerations);
+
+	int32 NumThreads = 0;
+	FParse::Value(*Params, TEXT("threads="), NumThreads);
+
+	int64 ReportEvery = 0;
+	FParse::Value(*Params, TEXT("reportevery="), ReportEvery);
+
+	FString RuleString = TEXT("B3/S23");
+	FParse::Value(*Params, TEXT("rule="), RuleString);
+
+	// The quadtree handles unbounded boards. The dense engines run a bounded grid around the pattern, in this process or split across worker processes.
+	FString Engine = TEXT("quadtree");
+	FParse::Value(*Params, TEXT("engine="), Engine);
+	if (Engine != TEXT("quadtree") && Engine != TEXT("dense") && Engine != TEXT("sharded"))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unknown engine '%s'. Supported engines: quadtree, dense, sharded"), *Engine);
+		return 1;
+	}
+
+	QuadTreeNode::SetMaxSimulationThreads(NumThreads);
+
+	// Results can be kept in a file between runs, so simulating a pattern an earlier run already simulated starts from a warm cache.
+	FString ResultCachePath;
+	FParse::Value(*Params, TEXT("resultcache="), ResultCachePath);
+
+	int64 ResultCacheMegabytes = 256;
+	FParse::Value(*Params, TEXT("resultcachemb="), ResultCacheMegabytes);
+
+	if (!ResultCachePath.IsEmpty() && Engine == TEXT("quadtree") && !QuadTreeNode::SetPersistentResultCache(ResultCachePath, ResultCacheMegabytes * 1024 * 1024))
+	{
+		return 1;
+	}
+
+	// Load the pattern.
+	const double LoadStartTime = FPlatformTime::Seconds();
+
+	TArray<FBoardCoordinate> Pattern;
+	if (!UBoardUtilities::LoadPatternFile(PatternPath, Pattern))
+	{
+		return 1;
+	}
+
+	if (Engine != TEXT("quadtree"))
+	{
+		UE_LOG(LogTemp, Display, TEXT("Loaded %s: %d cells in %.3f ms"), *PatternPath, Pattern.Num(), (FPlatformTime::Seconds() - LoadStartTime) * 1000.0);
+		return RunDenseSimulation(Params, Engine, Pattern, RuleString, NumGenerations);
+	}
+
+	UGameBoard* GameBoard = UGameBoard::InitializeMaxSizeBoard(RuleString);
+	if (GameBoard == nullptr)
+	{
+		return 1;
+	}
+
+	GameBoard->AddToRoot();
+	GameBoard->SetCellsToAlive(Pattern);
+
+	// The board can be checkpointed to a stream as it's simulated, each checkpoint only adding the nodes that changed since the last one.
+	FString CheckpointPath;
+	FParse::Value(*Params, TEXT("checkpoint="), CheckpointPath);
+
+	int32 CheckpointEvery = 1;
+	FParse::Value(*Params, TEXT("checkpointevery="), CheckpointEvery);
+
+	if (!CheckpointPath.IsEmpty() && !GameBoard->StartCheckpointStream(CheckpointPath, CheckpointEvery))
+	{
+		GameBoard->RemoveFromRoot();
+		return 1;
+	}
+
+	// Long runs scatter the board's nodes across the heap, so they can be moved back together every so often.
+	int32 CompactEvery = 0;
+	FParse::Value(*Params, TEXT("compactevery="), CompactEvery);
+	GameBoard->SetNodeCompactionInterval(CompactEvery);
+
+	const double LoadTime = FPlatformTime::Seconds() - LoadStartTime;
+
+	UE_LOG(LogTemp, Display, TEXT("Loaded %s: %d cells in %.3f ms"), *PatternPath, Pattern.Num(), LoadTime * 1000.0);
+
+	// Run the simulation.
+	QuadTreeNode::ResetPeakLiveNodeCount();
+
+	double SlowestGenerationTime = 0.0;
+	const FQuadTreeSimulationStats StatsBeforeSimulation = QuadTreeNode::GetSimulationStats();
+	const double SimulationStartTime = FPlatformTime::Seconds();
+
+	for (int64 Generation = 1; Generation <= NumGenerations; ++Generation)
+	{
+		const double GenerationStartTime = FPlatformTime::Seconds();
+		GameBoard->SimulateNextGeneration();
+		SlowestGenerationTime = FMath::Max(SlowestGenerationTime, FPlatformTime::Seconds() - GenerationStartTime);
+
+		if (ReportEvery > 0 && Generation % ReportEvery == 0)
+		{
+			const FGameBoardStepStats& StepStats = GameBoard->GetLastStepStats();
+
+			UE_LOG(LogTemp, Display, TEXT("Generation %lld: population %llu, %lld nodes"), Generation, GameBoard->GetRootNode()->GetPopulation(), QuadTreeNode::GetLiveNodeCount());
+			UE_LOG(LogTemp, Display, TEXT("    Last step: %.3f ms, quadrants %.3f/%.3f/%.3f/%.3f ms (NW/NE/SW/SE), depth %d"), StepStats.mStepMilliseconds,
+				StepStats.mQuadrantMilliseconds[ChildNode::Northwest], StepStats.mQuadrantMilliseconds[ChildNode::Northeast], StepStats.mQuadrantMilliseconds[ChildNode::Southwest], StepStats.mQuadrantMilliseconds[ChildNode::Southeast],
+				StepStats.mMaxRecursionDepth);
+			UE_LOG(LogTemp, Display, TEXT("    %llu nodes created, %llu cache hits, %llu cache misses, %llu base cases, %llu parallel tasks"), StepStats.mSimulationStats.mNodesCreated, StepStats.mSimulationStats.mResultCacheHits,
+				StepStats.mSimulationStats.mResultCacheMisses, StepStats.mSimulationStats.mBaseCaseInvocations, StepStats.mSimulationStats.mParallelTasks);
+		}
+	}
+
+	const double SimulationTime = FPlatformTime::Seconds() - SimulationStartTime;
+	const FQuadTreeSimulationStats SimulationStats = QuadTreeNode::GetSimulationStats() - StatsBeforeSimulation;
+	const uint64 NumCacheLookups = SimulationStats.mResultCacheHits + SimulationStats.mResultCacheMisses;
+
+	// Print our stats.
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+
+	UE_LOG(LogTemp, Display, TEXT("Engine: %s, rule: %s, threads: %s"), *Engine, *GameBoard->GetRuleString(), NumThreads > 0 ? *FString::FromInt(NumThreads) : TEXT("all"));
+	UE_LOG(LogTemp, Display, TEXT("Generations: %lld in %.3f ms (%.3f ms per generation, slowest %.3f ms)"), NumGenerations, SimulationTime * 1000.0, NumGenerations > 0 ? SimulationTime * 1000.0 / NumGenerations : 0.0, SlowestGenerationTime * 1000.0);
+	UE_LOG(LogTemp, Display, TEXT("Final population: %llu"), GameBoard->GetRootNode()->GetPopulation());
+	UE_LOG(LogTemp, Display, TEXT("Nodes: %lld live, %lld peak, %d bytes per node"), QuadTreeNode::GetLiveNodeCount(), QuadTreeNode::GetPeakLiveNodeCount(), (int32)QuadTreeNode::GetBytesPerNode());
+	UE_LOG(LogTemp, Display, TEXT("Nodes created: %llu, base cases: %llu, parallel tasks: %llu"), SimulationStats.mNodesCreated, SimulationStats.mBaseCaseInvocations, SimulationStats.mParallelTasks);
+	UE_LOG(LogTemp, Display, TEXT("Result cache: %llu hits, %llu misses (%.1f%% hit rate), %lld results held"), SimulationStats.mResultCacheHits, SimulationStats.mResultCacheMisses,
+		NumCacheLookups > 0 ? 100.0 * SimulationStats.mResultCacheHits / NumCacheLookups : 0.0, QuadTreeNode::GetCachedResultCount());
+
+	if (const FPersistentResultCache* PersistentResultCache = QuadTreeNode::GetPersistentResultCache())
+	{
+		const FPersistentResultCacheStats PersistentStats = PersistentResultCache->GetStats();
+		UE_LOG(LogTemp, Display, TEXT("Persistent result cache: %llu misses found on disk, %llu results added, %lld results and %lld nodes in %.1f MB%s"), SimulationStats.mPersistentCacheHits, PersistentStats.mNumStores,
+			PersistentStats.mNumResults, PersistentStats.mNumNodes, PersistentStats.mFileBytes / (1024.0 * 1024.0), PersistentStats.mIsFull ? TEXT(" (full)") : TEXT(""));
+	}
+
+	if (const FBoardCheckpointStream* CheckpointStream = GameBoard->GetCheckpointStream())
+	{
+		const FBoardCheckpointStreamStats& CheckpointStats = CheckpointStream->GetStats();
+		UE_LOG(LogTemp, Display, TEXT("Checkpoints: %lld written to %s in %.3f ms, %lld nodes in %.1f KB (%.1f nodes per checkpoint)"), CheckpointStats.mNumCheckpoints, *CheckpointStream->GetFilename(), CheckpointStats.mSeconds * 1000.0,
+			CheckpointStats.mNumNodes, CheckpointStats.mNumBytes / 1024.0, CheckpointStats.mNumCheckpoints > 0 ? (double)CheckpointStats.mNumNodes / CheckpointStats.mNumCheckpoints : 0.0);
+	}
+
+	const FBoardPeriodicity Periodicity = GameBoard->GetPeriodicity();
+	if (Periodicity.mKind == EBoardPeriodicity::Unknown)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Periodicity: none found"));
+	}
+	else
+	{
+		UE_LOG(LogTemp, Display, TEXT("Periodicity: %s with period %lld, displacement (%lld, %lld), found at generation %lld"), *UEnum::GetValueAsString(Periodicity.mKind),
+			Periodicity.mPeriod, Periodicity.mDisplacementX, Periodicity.mDisplacementY, Periodicity.mDetectedAtGeneration);
+	}
+
+	// The final board can be searched for a pattern, in any orientation, to count things like the gliders or blocks a pattern left behind.
+	FString FindPath;
+	if (FParse::Value(*Params, TEXT("find="), FindPath))
+	{
+		int32 FindBorder = 1;
+		FParse::Value(*Params, TEXT("findborder="), FindBorder);
+
+		TArray<FBoardCoordinate> FindPattern;
+		if (UBoardUtilities::LoadPatternFile(FindPath, FindPattern))
+		{
+			const double FindStartTime = FPlatformTime::Seconds();
+
+			TArray<FPatternMatch> Matches;
+			GameBoard->FindPattern(FindPattern, true, FindBorder, Matches);
+
+			UE_LOG(LogTemp, Display, TEXT("Found %s: %d matches with a border of %d in %.3f ms"), *FindPath, Matches.Num(), FindBorder, (FPlatformTime::Seconds() - FindStartTime) * 1000.0);
+		}
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Process memory: %.1f MB used, %.1f MB peak"), MemoryStats.UsedPhysical / (1024.0 * 1024.0), MemoryStats.PeakUsedPhysical / (1024.0 * 1024.0));
+
+	GameBoard->StopCheckpointStream();
+	GameBoard->RemoveFromRoot();
+
+	// Write out whatever the persistent result cache has left to write.
+	QuadTreeNode::SetPersistentResultCache(FString());
+
+	return 0;
+}
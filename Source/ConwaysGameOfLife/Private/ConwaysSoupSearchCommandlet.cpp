@@ -0,0 +1,84 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "ConwaysSoupSearchCommandlet.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "SoupSearch.h"
+
+UConwaysSoupSearchCommandlet::UConwaysSoupSearchCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UConwaysSoupSearchCommandlet::Main(const FString& Params)
+{
+	FSoupSearchSettings Settings;
+	FParse::Value(*Params, TEXT("soups="), Settings.mNumSoups);
+	FParse::Value(*Params, TEXT("seed="), Settings.mSeed);
+	FParse::Value(*Params, TEXT("rule="), Settings.mRuleString);
+	FParse::Value(*Params, TEXT("soupsize="), Settings.mSoupDimension);
+	FParse::Value(*Params, TEXT("density="), Settings.mDensity);
+	FParse::Value(*Params, TEXT("boardlevel="), Settings.mBoardLevel);
+	FParse::Value(*Params, TEXT("maxgenerations="), Settings.mMaxGenerations);
+	FParse::Value(*Params, TEXT("maxperiod="), Settings.mMaxPeriod);
+	FParse::Value(*Params, TEXT("threads="), Settings.mNumThreads);
+
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("SoupSearch"), TEXT("soups.csv"));
+	FParse::Value(*Params, TEXT("output="), OutputPath);
+
+	FSoupSearchResults Results;
+	if (!FSoupSearch::Run(Settings, Results))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=ConwaysSoupSearch [-soups=N] [-seed=N] [-rule=B3/S23] [-soupsize=16] [-density=0.5] [-boardlevel=10] [-maxgenerations=N] [-maxperiod=N] [-threads=N] [-output=<soups.csv>]"));
+		return 1;
+	}
+
+	// Write out every soup.
+	FString CSV = TEXT("soup,initial_population,final_population,generations,periodicity,period,displacement_x,displacement_y,reached_edge\n");
+	for (const FSoupResult& Soup : Results.mSoups)
+	{
+		CSV += FString::Printf(TEXT("%d,%llu,%llu,%lld,%s,%lld,%lld,%lld,%d\n"), Soup.mSoupIndex, Soup.mInitialPopulation, Soup.mFinalPopulation, Soup.mGenerations,
+			*UEnum::GetValueAsString(Soup.mPeriodicity.mKind), Soup.mPeriodicity.mPeriod, Soup.mPeriodicity.mDisplacementX, Soup.mPeriodicity.mDisplacementY, Soup.mReachedEdge ? 1 : 0);
+	}
+
+	if (!FFileHelper::SaveStringToFile(CSV, *OutputPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write soup results to %s."), *OutputPath);
+		return 1;
+	}
+
+	// Print our census.
+	const uint64 NumCacheLookups = Results.mSimulationStats.mResultCacheHits + Results.mSimulationStats.mResultCacheMisses;
+
+	UE_LOG(LogTemp, Display, TEXT("Rule: %s, %d soups of %dx%d at density %.2f, seed %d"), *Settings.mRuleString, Results.mSoups.Num(), Settings.mSoupDimension, Settings.mSoupDimension, Settings.mDensity, Settings.mSeed);
+	UE_LOG(LogTemp, Display, TEXT("Time: %.3f s (%.1f soups per second)"), Results.mSeconds, Results.GetSoupsPerSecond());
+	UE_LOG(LogTemp, Display, TEXT("Settled: %d static, %d oscillating, %d spaceships, %d unsettled after %lld generations"),
+		Results.mNumSoupsByPeriodicity[(int32)EBoardPeriodicity::Static], Results.mNumSoupsByPeriodicity[(int32)EBoardPeriodicity::Oscillator],
+		Results.mNumSoupsByPeriodicity[(int32)EBoardPeriodicity::Spaceship], Results.mNumSoupsByPeriodicity[(int32)EBoardPeriodicity::Unknown], Settings.mMaxGenerations);
+
+	TArray<int64> Periods;
+	Results.mNumSoupsByPeriod.GetKeys(Periods);
+	Periods.Sort();
+	for (const int64 Period : Periods)
+	{
+		UE_LOG(LogTemp, Display, TEXT("  Period %lld: %d soups"), Period, Results.mNumSoupsByPeriod[Period]);
+	}
+
+	if (Results.mNumSoupsReachedEdge > 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%d soups reached the edge of their %llux%llu board, usually by sending a spaceship off of it, so their results may differ from an unbounded board. Raise -boardlevel to give them more room."),
+			Results.mNumSoupsReachedEdge, uint64(1) << Settings.mBoardLevel, uint64(1) << Settings.mBoardLevel);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Result cache: %llu hits, %llu misses (%.1f%% hit rate), %llu nodes created"), Results.mSimulationStats.mResultCacheHits, Results.mSimulationStats.mResultCacheMisses,
+		NumCacheLookups > 0 ? 100.0 * Results.mSimulationStats.mResultCacheHits / NumCacheLookups : 0.0, Results.mSimulationStats.mNodesCreated);
+	UE_LOG(LogTemp, Display, TEXT("Wrote every soup to %s."), *OutputPath);
+
+	return 0;
+}
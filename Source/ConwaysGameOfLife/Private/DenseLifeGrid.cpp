@@ -0,0 +1,182 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "DenseLifeGrid.h"
+
+#include "Async/ParallelFor.h"
+#include "LifeRule.h"
+
+namespace
+{
+	// The number of cells in each word.
+	constexpr int32 kCellsPerWord = 64;
+
+	// The fewest rows we hand to one task when splitting a generation across threads.
+	constexpr int32 kMinRowsPerTask = 64;
+
+	// Returns the word at WordIndex in Row, treating missing rows and words past either end as dead.
+	FORCEINLINE uint64 GetWord(const uint64* Row, const int32 WordIndex, const int32 WordsPerRow)
+	{
+		return (Row != nullptr && WordIndex >= 0 && WordIndex < WordsPerRow) ? Row[WordIndex] : 0;
+	}
+
+	// Adds Value into the bitsliced counters, where bit i of Count0..Count3 holds the count for cell i.
+	FORCEINLINE void AddToCount(const uint64 Value, uint64& Count0, uint64& Count1, uint64& Count2, uint64& Count3)
+	{
+		const uint64 Carry0 = Count0 & Value;
+		Count0 ^= Value;
+		const uint64 Carry1 = Count1 & Carry0;
+		Count1 ^= Carry0;
+		const uint64 Carry2 = Count2 & Carry1;
+		Count2 ^= Carry1;
+		Count3 |= Carry2;
+	}
+}
+
+FDenseLifeGrid::FDenseLifeGrid(const int32 Width, const int32 Height) :
+	mWidth(FMath::Max(Width, 0)),
+	mHeight(FMath::Max(Height, 0))
+{
+	mCells.SetNumZeroed(GetWordsPerRow() * mHeight);
+	mNextCells.SetNumZeroed(GetWordsPerRow() * mHeight);
+}
+
+int32 FDenseLifeGrid::GetWidth() const
+{
+	return mWidth;
+}
+
+int32 FDenseLifeGrid::GetHeight() const
+{
+	return mHeight;
+}
+
+int32 FDenseLifeGrid::GetWordsPerRow() const
+{
+	return GetWordsPerRow(mWidth);
+}
+
+void FDenseLifeGrid::SetCellToAlive(const int32 X, const int32 Y)
+{
+	if (X < 0 || X >= mWidth || Y < 0 || Y >= mHeight)
+	{
+		return;
+	}
+
+	GetRow(Y)[X / kCellsPerWord] |= uint64(1) << (X % kCellsPerWord);
+}
+
+bool FDenseLifeGrid::GetIsCellAlive(const int32 X, const int32 Y) const
+{
+	if (X < 0 || X >= mWidth || Y < 0 || Y >= mHeight)
+	{
+		return false;
+	}
+
+	return (GetRow(Y)[X / kCellsPerWord] >> (X % kCellsPerWord)) & 0x1;
+}
+
+void FDenseLifeGrid::SimulateNextGeneration(const FLifeRule& Rule)
+{
+	const int32 NumTasks = FMath::Max(mHeight / kMinRowsPerTask, 1);
+
+	ParallelFor(NumTasks, [&](int32 TaskIndex)
+		{
+			const int32 FirstRow = (int32)((int64)mHeight * TaskIndex / NumTasks);
+			const int32 EndRow = (int32)((int64)mHeight * (TaskIndex + 1) / NumTasks);
+			SimulateRows(mCells.GetData(), mHeight, mWidth, FirstRow, EndRow, Rule, mNextCells.GetData());
+		});
+
+	Swap(mCells, mNextCells);
+}
+
+uint64 FDenseLifeGrid::GetPopulation() const
+{
+	return CountPopulation(mCells.GetData(), mHeight, mWidth);
+}
+
+uint64* FDenseLifeGrid::GetRow(const int32 Y)
+{
+	return mCells.GetData() + (int64)Y * GetWordsPerRow();
+}
+
+const uint64* FDenseLifeGrid::GetRow(const int32 Y) const
+{
+	return mCells.GetData() + (int64)Y * GetWordsPerRow();
+}
+
+void FDenseLifeGrid::SimulateRows(const uint64* Rows, const int32 NumRows, const int32 Width, const int32 FirstRow, const int32 EndRow, const FLifeRule& Rule, uint64* RowsOut)
+{
+	const int32 WordsPerRow = GetWordsPerRow(Width);
+	const uint64 LastWordMask = (Width % kCellsPerWord == 0) ? ~uint64(0) : (uint64(1) << (Width % kCellsPerWord)) - 1;
+
+	// Work out once which neighbor counts give birth and which let a cell survive.
+	const uint16 BirthMask = Rule.GetBirthMask();
+	const uint16 SurvivalMask = Rule.GetSurvivalMask();
+	const uint16 AnyMask = BirthMask | SurvivalMask;
+
+	for (int32 Y = FMath::Max(FirstRow, 0); Y < FMath::Min(EndRow, NumRows); ++Y)
+	{
+		const uint64* RowAbove = (Y > 0) ? Rows + (int64)(Y - 1) * WordsPerRow : nullptr;
+		const uint64* Row = Rows + (int64)Y * WordsPerRow;
+		const uint64* RowBelow = (Y + 1 < NumRows) ? Rows + (int64)(Y + 1) * WordsPerRow : nullptr;
+		uint64* RowOut = RowsOut + (int64)Y * WordsPerRow;
+
+		for (int32 WordIndex = 0; WordIndex < WordsPerRow; ++WordIndex)
+		{
+			// Count all 64 cells' neighbors at once. Each neighboring row contributes itself shifted west, east, and (except for our own row) in place.
+			uint64 Count0 = 0, Count1 = 0, Count2 = 0, Count3 = 0;
+
+			for (const uint64* NeighborRow : { RowAbove, Row, RowBelow })
+			{
+				const uint64 Center = GetWord(NeighborRow, WordIndex, WordsPerRow);
+				const uint64 West = (Center << 1) | (GetWord(NeighborRow, WordIndex - 1, WordsPerRow) >> (kCellsPerWord - 1));
+				const uint64 East = (Center >> 1) | (GetWord(NeighborRow, WordIndex + 1, WordsPerRow) << (kCellsPerWord - 1));
+
+				AddToCount(West, Count0, Count1, Count2, Count3);
+				AddToCount(East, Count0, Count1, Count2, Count3);
+				if (NeighborRow != Row)
+				{
+					AddToCount(Center, Count0, Count1, Count2, Count3);
+				}
+			}
+
+			// Pick out the cells whose count the rule cares about.
+			const uint64 Alive = Row[WordIndex];
+			uint64 Result = 0;
+
+			for (int32 NumLiveNeighbors = 0; NumLiveNeighbors <= 8; ++NumLiveNeighbors)
+			{
+				if (((AnyMask >> NumLiveNeighbors) & 0x1) == 0)
+				{
+					continue;
+				}
+
+				const uint64 HasCount = ((NumLiveNeighbors & 0x1) ? Count0 : ~Count0) & ((NumLiveNeighbors & 0x2) ? Count1 : ~Count1)
+					& ((NumLiveNeighbors & 0x4) ? Count2 : ~Count2) & ((NumLiveNeighbors & 0x8) ? Count3 : ~Count3);
+
+				const uint64 Born = ((BirthMask >> NumLiveNeighbors) & 0x1) ? ~Alive : 0;
+				const uint64 Survives = ((SurvivalMask >> NumLiveNeighbors) & 0x1) ? Alive : 0;
+				Result |= HasCount & (Born | Survives);
+			}
+
+			RowOut[WordIndex] = (WordIndex == WordsPerRow - 1) ? (Result & LastWordMask) : Result;
+		}
+	}
+}
+
+uint64 FDenseLifeGrid::CountPopulation(const uint64* Rows, const int32 NumRows, const int32 Width)
+{
+	uint64 Population = 0;
+	for (int64 WordIndex = 0; WordIndex < (int64)NumRows * GetWordsPerRow(Width); ++WordIndex)
+	{
+		Population += FMath::CountBits(Rows[WordIndex]);
+	}
+
+	return Population;
+}
+
+int32 FDenseLifeGrid::GetWordsPerRow(const int32 Width)
+{
+	return (Width + kCellsPerWord - 1) / kCellsPerWord;
+}
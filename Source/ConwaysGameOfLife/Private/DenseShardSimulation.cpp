@@ -0,0 +1,399 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "DenseShardSimulation.h"
+
+#include "DenseLifeGrid.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformProcess.h"
+#include "LifeRule.h"
+#include "Misc/Paths.h"
+
+#include <atomic>
+
+namespace
+{
+	// Bumped whenever the layout of the shared memory region changes, so a worker from another build can't misread it.
+	constexpr uint32 kSharedRegionVersion = 1;
+
+	// What one worker tells the coordinator and the other workers. Each worker's state gets its own cache line so they don't slow each other down.
+	struct alignas(64) FSharedShardState
+	{
+		// The last halo exchange this worker published its edge rows for. 0 once it has copied its starting rows out of the grid, and -1 before then.
+		std::atomic<int64> mPublishedExchange;
+
+		// The number of generations this worker has simulated. The coordinator checks that every worker got through all of them.
+		std::atomic<int64> mGeneration;
+
+		// The number of live cells in this worker's strip as of mGeneration.
+		std::atomic<uint64> mPopulation;
+
+		// Set once this worker has written its strip back into the grid. The coordinator only trusts the grid if every worker set it.
+		std::atomic<int32> mIsDone;
+	};
+
+	// The start of the shared memory region. The grid follows it, then every worker's published halo rows.
+	struct FSharedRegionHeader
+	{
+		uint32 mVersion;
+		int32 mWidth;
+		int32 mHeight;
+		int32 mNumShards;
+		int32 mHaloWidth;
+		int64 mNumGenerations;
+
+		// Set by the coordinator if a worker failed, so the others stop waiting for it.
+		std::atomic<int32> mShouldAbort;
+
+		FSharedShardState mShards[FDenseShardSimulation::kMaxShards];
+	};
+
+	// Where everything lives in the shared memory region.
+	struct FSharedRegionLayout
+	{
+		// The number of words in each row of the grid.
+		int32 mWordsPerRow = 0;
+
+		// The number of rows in each set of published halo rows.
+		int32 mHaloWidth = 0;
+
+		// The offset of the grid from the start of the region, in bytes.
+		int64 mGridOffset = 0;
+
+		// The offset of the first set of published halo rows from the start of the region, in bytes.
+		int64 mHalosOffset = 0;
+
+		// The size of the whole region, in bytes.
+		int64 mTotalSize = 0;
+
+		FSharedRegionLayout(const int32 Width, const int32 Height, const int32 NumShards, const int32 HaloWidth) :
+			mWordsPerRow(FDenseLifeGrid::GetWordsPerRow(Width)),
+			mHaloWidth(HaloWidth)
+		{
+			mGridOffset = Align((int64)sizeof(FSharedRegionHeader), 64);
+			mHalosOffset = Align(mGridOffset + (int64)Height * mWordsPerRow * sizeof(uint64), 64);
+
+			// Every shard publishes its first and last rows, double buffered so a neighbor can start publishing the next exchange before we've read the last one.
+			mTotalSize = mHalosOffset + (int64)NumShards * 2 * 2 * HaloWidth * mWordsPerRow * sizeof(uint64);
+		}
+
+		uint64* GetGrid(void* RegionAddress) const
+		{
+			return (uint64*)((uint8*)RegionAddress + mGridOffset);
+		}
+
+		// Returns the rows Shard published for exchanges with this Parity, along its first rows if IsLastRows is false and its last rows otherwise.
+		uint64* GetPublishedRows(void* RegionAddress, const int32 Shard, const int64 Exchange, const bool IsLastRows) const
+		{
+			const int64 SetIndex = ((int64)Shard * 2 + (Exchange % 2)) * 2 + (IsLastRows ? 1 : 0);
+			return (uint64*)((uint8*)RegionAddress + mHalosOffset) + SetIndex * mHaloWidth * mWordsPerRow;
+		}
+	};
+
+	// Returns the first row of the strip simulated by Shard. The strip ends where the next one starts.
+	int32 GetFirstRowOfShard(const int32 Height, const int32 NumShards, const int32 Shard)
+	{
+		return (int32)((int64)Height * Shard / NumShards);
+	}
+
+	// The number of times a waiting worker checks again right away, and then after giving up its time slice, before it starts sleeping.
+	constexpr int32 kNumSpinWaits = 64;
+	constexpr int32 kNumYieldWaits = 64;
+
+	// The longest a waiting worker sleeps between checks, in seconds.
+	constexpr float kMaxWaitSleepSeconds = 0.001f;
+
+	// Waits for Shard to publish its rows for Exchange. Returns false if the simulation was aborted while waiting.
+	// Neighbors usually publish within moments of each other, so we spin briefly first, then yield, and only then sleep for longer and longer, so a worker stuck behind a slow neighbor doesn't keep a core busy.
+	bool WaitForExchange(const FSharedRegionHeader& Header, const int32 Shard, const int64 Exchange)
+	{
+		float SleepSeconds = 0.00001f;
+
+		for (int32 NumWaits = 0; Header.mShards[Shard].mPublishedExchange.load(std::memory_order_acquire) < Exchange; ++NumWaits)
+		{
+			if (Header.mShouldAbort.load(std::memory_order_relaxed) != 0)
+			{
+				return false;
+			}
+
+			if (NumWaits < kNumSpinWaits)
+			{
+				FPlatformProcess::Yield();
+			}
+			else if (NumWaits < kNumSpinWaits + kNumYieldWaits)
+			{
+				FPlatformProcess::YieldThread();
+			}
+			else
+			{
+				FPlatformProcess::SleepNoStats(SleepSeconds);
+				SleepSeconds = FMath::Min(SleepSeconds * 2.0f, kMaxWaitSleepSeconds);
+			}
+		}
+
+		return true;
+	}
+
+	// Gives every region we create a different name, in case one process runs several simulations.
+	std::atomic<int32> sNextRegionIndex = 0;
+}
+
+bool FDenseShardSimulation::Run(FDenseLifeGrid& Grid, const FDenseShardSettings& Settings, FDenseShardStats& StatsOut)
+{
+	if (FLifeRule::FindOrCreate(Settings.mRuleString) == nullptr)
+	{
+		return false;
+	}
+
+	const int32 NumShards = Settings.mNumShards;
+	const int32 HaloWidth = Settings.mHaloWidth;
+	if (NumShards < 1 || NumShards > kMaxShards || HaloWidth < 1 || Grid.GetHeight() / NumShards < HaloWidth)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Can't split %d rows into %d shards with halos %d rows wide. Shards must be at least as tall as their halos, and there can be at most %d of them."), Grid.GetHeight(), NumShards, HaloWidth, kMaxShards);
+		return false;
+	}
+
+	// Set up the shared memory region with the grid in it.
+	const FSharedRegionLayout Layout(Grid.GetWidth(), Grid.GetHeight(), NumShards, HaloWidth);
+	const FString RegionName = FString::Printf(TEXT("ConwaysDenseShards_%u_%d"), FPlatformProcess::GetCurrentProcessId(), sNextRegionIndex++);
+
+	FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, Layout.mTotalSize);
+	if (Region == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not create a shared memory region of %lld bytes for the shards."), Layout.mTotalSize);
+		return false;
+	}
+
+	FSharedRegionHeader* Header = new (Region->GetAddress()) FSharedRegionHeader();
+	Header->mVersion = kSharedRegionVersion;
+	Header->mWidth = Grid.GetWidth();
+	Header->mHeight = Grid.GetHeight();
+	Header->mNumShards = NumShards;
+	Header->mHaloWidth = HaloWidth;
+	Header->mNumGenerations = Settings.mNumGenerations;
+
+	for (int32 Shard = 0; Shard < NumShards; ++Shard)
+	{
+		Header->mShards[Shard].mPublishedExchange = -1;
+	}
+
+	const int64 GridSize = (int64)Grid.GetHeight() * Layout.mWordsPerRow * sizeof(uint64);
+	FMemory::Memcpy(Layout.GetGrid(Region->GetAddress()), Grid.GetRow(0), GridSize);
+
+	// Start a worker for every shard.
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<FProcHandle> Workers;
+	for (int32 Shard = 0; Shard < NumShards; ++Shard)
+	{
+		const FString WorkerParams = FString::Printf(TEXT("\"%s\" -run=ConwaysDenseShard -region=%s -shard=%d -rule=%s -nullrhi -unattended"), *FPaths::GetProjectFilePath(), *RegionName, Shard, *Settings.mRuleString);
+
+		FProcHandle Worker = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *WorkerParams, false, true, true, nullptr, 0, nullptr, nullptr);
+		if (!Worker.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not start the worker for shard %d."), Shard);
+			Header->mShouldAbort = 1;
+			break;
+		}
+
+		Workers.Add(Worker);
+	}
+
+	// Wait for them all to finish, stopping everyone if any of them fail.
+	bool DidAllWorkersSucceed = (Workers.Num() == NumShards);
+	for (bool IsAnyWorkerRunning = true; IsAnyWorkerRunning; )
+	{
+		IsAnyWorkerRunning = false;
+
+		for (int32 Shard = 0; Shard < Workers.Num(); ++Shard)
+		{
+			if (!Workers[Shard].IsValid())
+			{
+				continue;
+			}
+
+			if (FPlatformProcess::IsProcRunning(Workers[Shard]))
+			{
+				IsAnyWorkerRunning = true;
+				continue;
+			}
+
+			int32 ReturnCode = 0;
+			if (!FPlatformProcess::GetProcReturnCode(Workers[Shard], &ReturnCode) || ReturnCode != 0)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The worker for shard %d failed with exit code %d."), Shard, ReturnCode);
+				Header->mShouldAbort = 1;
+				DidAllWorkersSucceed = false;
+			}
+
+			FPlatformProcess::CloseProc(Workers[Shard]);
+			Workers[Shard] = FProcHandle();
+		}
+
+		if (IsAnyWorkerRunning)
+		{
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+
+	// A worker that exited cleanly without finishing its strip would leave stale rows in the grid, so make sure they all got to the end.
+	for (int32 Shard = 0; DidAllWorkersSucceed && Shard < NumShards; ++Shard)
+	{
+		const FSharedShardState& State = Header->mShards[Shard];
+		const int64 NumGenerations = FMath::Max<int64>(Header->mNumGenerations, 0);
+		if (State.mIsDone.load(std::memory_order_acquire) == 0 || State.mGeneration.load(std::memory_order_relaxed) != NumGenerations)
+		{
+			UE_LOG(LogTemp, Error, TEXT("The worker for shard %d exited after %lld of %lld generations without handing back its strip."), Shard, State.mGeneration.load(std::memory_order_relaxed), NumGenerations);
+			DidAllWorkersSucceed = false;
+		}
+	}
+
+	// Collect the results.
+	if (DidAllWorkersSucceed)
+	{
+		StatsOut = FDenseShardStats();
+		StatsOut.mSeconds = FPlatformTime::Seconds() - StartTime;
+		StatsOut.mNumExchanges = FMath::Max<int64>(Header->mShards[0].mPublishedExchange, 0);
+
+		for (int32 Shard = 0; Shard < NumShards; ++Shard)
+		{
+			StatsOut.mPopulation += Header->mShards[Shard].mPopulation;
+		}
+
+		FMemory::Memcpy(Grid.GetRow(0), Layout.GetGrid(Region->GetAddress()), GridSize);
+	}
+
+	Header->~FSharedRegionHeader();
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+
+	return DidAllWorkersSucceed;
+}
+
+int32 FDenseShardSimulation::RunWorker(const FString& RegionName, const int32 ShardIndex, const FLifeRule& Rule)
+{
+	const uint32 AccessMode = FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write;
+
+	// Read the header first to find out how big the whole region is.
+	FPlatformMemory::FSharedMemoryRegion* HeaderRegion = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, false, AccessMode, sizeof(FSharedRegionHeader));
+	if (HeaderRegion == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the shared memory region %s."), *RegionName);
+		return 1;
+	}
+
+	const FSharedRegionHeader* HeaderCopy = (const FSharedRegionHeader*)HeaderRegion->GetAddress();
+	const bool IsHeaderValid = HeaderCopy->mVersion == kSharedRegionVersion && ShardIndex >= 0 && ShardIndex < HeaderCopy->mNumShards;
+	const FSharedRegionLayout Layout(HeaderCopy->mWidth, HeaderCopy->mHeight, HeaderCopy->mNumShards, HeaderCopy->mHaloWidth);
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(HeaderRegion);
+
+	if (!IsHeaderValid)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Shard %d doesn't match the shared memory region %s."), ShardIndex, *RegionName);
+		return 1;
+	}
+
+	FPlatformMemory::FSharedMemoryRegion* Region = FPlatformMemory::MapNamedSharedMemoryRegion(RegionName, false, AccessMode, Layout.mTotalSize);
+	if (Region == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the shared memory region %s."), *RegionName);
+		return 1;
+	}
+
+	void* RegionAddress = Region->GetAddress();
+	FSharedRegionHeader& Header = *(FSharedRegionHeader*)RegionAddress;
+	FSharedShardState& State = Header.mShards[ShardIndex];
+
+	const int32 Width = Header.mWidth;
+	const int32 Height = Header.mHeight;
+	const int32 HaloWidth = Header.mHaloWidth;
+	const int32 WordsPerRow = Layout.mWordsPerRow;
+	const bool HasPreviousShard = ShardIndex > 0;
+	const bool HasNextShard = ShardIndex < Header.mNumShards - 1;
+
+	// Our strip, plus the rows we borrow from our neighbors on either side.
+	const int32 FirstOwnedRow = GetFirstRowOfShard(Height, Header.mNumShards, ShardIndex);
+	const int32 EndOwnedRow = GetFirstRowOfShard(Height, Header.mNumShards, ShardIndex + 1);
+	const int32 FirstLocalRow = HasPreviousShard ? FirstOwnedRow - HaloWidth : FirstOwnedRow;
+	const int32 EndLocalRow = HasNextShard ? EndOwnedRow + HaloWidth : EndOwnedRow;
+	const int32 NumLocalRows = EndLocalRow - FirstLocalRow;
+	const int32 NumOwnedRows = EndOwnedRow - FirstOwnedRow;
+	const int64 RowSize = WordsPerRow * sizeof(uint64);
+
+	TArray<uint64> Cells;
+	TArray<uint64> NextCells;
+	Cells.SetNumUninitialized(NumLocalRows * WordsPerRow);
+	NextCells.SetNumZeroed(NumLocalRows * WordsPerRow);
+
+	uint64* SharedGrid = Layout.GetGrid(RegionAddress);
+	FMemory::Memcpy(Cells.GetData(), SharedGrid + (int64)FirstLocalRow * WordsPerRow, NumLocalRows * RowSize);
+	State.mPublishedExchange.store(0, std::memory_order_release);
+
+	uint64* FirstOwnedRowData = Cells.GetData() + (int64)(FirstOwnedRow - FirstLocalRow) * WordsPerRow;
+	uint64* LastOwnedRowsData = Cells.GetData() + (int64)(EndOwnedRow - HaloWidth - FirstLocalRow) * WordsPerRow;
+
+	int64 Generation = 0;
+	for (int64 Exchange = 0; Generation < Header.mNumGenerations; ++Exchange)
+	{
+		// Our borrowed rows start out correct, so we only need to trade rows with our neighbors from the second round on.
+		if (Exchange > 0)
+		{
+			FMemory::Memcpy(Layout.GetPublishedRows(RegionAddress, ShardIndex, Exchange, false), FirstOwnedRowData, HaloWidth * RowSize);
+			FMemory::Memcpy(Layout.GetPublishedRows(RegionAddress, ShardIndex, Exchange, true), LastOwnedRowsData, HaloWidth * RowSize);
+			State.mPublishedExchange.store(Exchange, std::memory_order_release);
+
+			if (HasPreviousShard)
+			{
+				if (!WaitForExchange(Header, ShardIndex - 1, Exchange))
+				{
+					FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+					return 1;
+				}
+
+				FMemory::Memcpy(Cells.GetData(), Layout.GetPublishedRows(RegionAddress, ShardIndex - 1, Exchange, true), HaloWidth * RowSize);
+			}
+
+			if (HasNextShard)
+			{
+				if (!WaitForExchange(Header, ShardIndex + 1, Exchange))
+				{
+					FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+					return 1;
+				}
+
+				FMemory::Memcpy(Cells.GetData() + (int64)(EndOwnedRow - FirstLocalRow) * WordsPerRow, Layout.GetPublishedRows(RegionAddress, ShardIndex + 1, Exchange, false), HaloWidth * RowSize);
+			}
+		}
+
+		// Every generation, the borrowed rows next to a neighbor go stale one row further in, since their own neighbors weren't borrowed. Our own rows stay correct for HaloWidth generations.
+		const int64 NumSteps = FMath::Min<int64>(HaloWidth, Header.mNumGenerations - Generation);
+		for (int32 Step = 1; Step <= NumSteps; ++Step)
+		{
+			const int32 FirstCorrectRow = HasPreviousShard ? Step : 0;
+			const int32 EndCorrectRow = HasNextShard ? NumLocalRows - Step : NumLocalRows;
+			FDenseLifeGrid::SimulateRows(Cells.GetData(), NumLocalRows, Width, FirstCorrectRow, EndCorrectRow, Rule, NextCells.GetData());
+			Swap(Cells, NextCells);
+		}
+
+		// Swapping moved our rows, so find them again.
+		FirstOwnedRowData = Cells.GetData() + (int64)(FirstOwnedRow - FirstLocalRow) * WordsPerRow;
+		LastOwnedRowsData = Cells.GetData() + (int64)(EndOwnedRow - HaloWidth - FirstLocalRow) * WordsPerRow;
+
+		Generation += NumSteps;
+		State.mGeneration.store(Generation, std::memory_order_relaxed);
+		State.mPopulation.store(FDenseLifeGrid::CountPopulation(FirstOwnedRowData, NumOwnedRows, Width), std::memory_order_relaxed);
+	}
+
+	// Hand our strip back to the coordinator, once our neighbors are done reading their starting rows out of it.
+	if ((HasPreviousShard && !WaitForExchange(Header, ShardIndex - 1, 0)) || (HasNextShard && !WaitForExchange(Header, ShardIndex + 1, 0)))
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		return 1;
+	}
+
+	FMemory::Memcpy(SharedGrid + (int64)FirstOwnedRow * WordsPerRow, FirstOwnedRowData, NumOwnedRows * RowSize);
+	State.mPopulation.store(FDenseLifeGrid::CountPopulation(FirstOwnedRowData, NumOwnedRows, Width), std::memory_order_relaxed);
+	State.mIsDone.store(1, std::memory_order_release);
+
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+	return 0;
+}
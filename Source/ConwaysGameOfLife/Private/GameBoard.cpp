@@ -3,7 +3,20 @@
 
 #include "GameBoard.h"
 
-UGameBoard* UGameBoard::InitializeBoardWithDimension(int BoardDimension)
+#include "GameOfLifeStats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_CYCLE_STAT(TEXT("GameBoard SimulateNextGeneration"), STAT_GameBoardSimulateNextGeneration, STATGROUP_GameOfLife);
+DECLARE_QWORD_COUNTER_STAT(TEXT("Nodes Created"), STAT_GameBoardNodesCreated, STATGROUP_GameOfLife);
+DECLARE_QWORD_COUNTER_STAT(TEXT("Result Cache Hits"), STAT_GameBoardResultCacheHits, STATGROUP_GameOfLife);
+DECLARE_QWORD_COUNTER_STAT(TEXT("Result Cache Misses"), STAT_GameBoardResultCacheMisses, STATGROUP_GameOfLife);
+DECLARE_QWORD_COUNTER_STAT(TEXT("Base Case Invocations"), STAT_GameBoardBaseCaseInvocations, STATGROUP_GameOfLife);
+DECLARE_QWORD_COUNTER_STAT(TEXT("Parallel Tasks"), STAT_GameBoardParallelTasks, STATGROUP_GameOfLife);
+DECLARE_QWORD_ACCUMULATOR_STAT(TEXT("Max Recursion Depth"), STAT_GameBoardMaxRecursionDepth, STATGROUP_GameOfLife);
+DECLARE_QWORD_ACCUMULATOR_STAT(TEXT("Live Nodes"), STAT_GameBoardLiveNodes, STATGROUP_GameOfLife);
+DECLARE_QWORD_ACCUMULATOR_STAT(TEXT("Cached Results"), STAT_GameBoardCachedResults, STATGROUP_GameOfLife);
+
+UGameBoard* UGameBoard::InitializeBoardWithDimension(int BoardDimension, const FString& RuleString)
 {
 	UE_LOG(LogTemp, Error, TEXT("Currently lacking support for boards less than the max size!"));
 
@@ -15,22 +28,70 @@ UGameBoard* UGameBoard::InitializeBoardWithDimension(int BoardDimension)
 		return nullptr;
 	}
 
-	return InitializeBoardHelper(BoardDimension);
+	return InitializeBoardHelper(BoardDimension, RuleString);
+}
+
+UGameBoard* UGameBoard::InitializeMaxSizeBoard(const FString& RuleString)
+{
+	return InitializeBoardHelper(kMaxSizeBoard, RuleString);
 }
 
-UGameBoard* UGameBoard::InitializeMaxSizeBoard()
+UGameBoard* UGameBoard::InitializeFromCheckpoint(const FString& Filename, int64 Generation)
 {
-	return InitializeBoardHelper(kMaxSizeBoard);
+	TArray<FBoardCheckpointInfo> CheckpointInfos;
+	if (!FBoardCheckpointStream::ReadCheckpointInfos(Filename, CheckpointInfos))
+	{
+		return nullptr;
+	}
+
+	// A stream can hold the same generation more than once if the board was edited or seeked back to. The last one is what the board ended up as.
+	int32 CheckpointIndex = CheckpointInfos.Num() - 1;
+	while (CheckpointIndex >= 0 && Generation >= 0 && CheckpointInfos[CheckpointIndex].mGeneration != Generation)
+	{
+		--CheckpointIndex;
+	}
+
+	if (CheckpointIndex < 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has no checkpoint of generation %lld."), *Filename, Generation);
+		return nullptr;
+	}
+
+	FBoardCheckpoint Checkpoint;
+	if (!FBoardCheckpointStream::LoadCheckpoint(Filename, CheckpointIndex, Checkpoint))
+	{
+		return nullptr;
+	}
+
+	const uint8 Level = Checkpoint.mRootNode->mLevel;
+	UGameBoard* ResultPointer = InitializeBoardHelper((Level >= 64) ? kMaxSizeBoard : (uint64(1) << Level), Checkpoint.mRuleString);
+	if (ResultPointer != nullptr)
+	{
+		ResultPointer->mRootNode = Checkpoint.mRootNode;
+		ResultPointer->mGeneration = Checkpoint.mGeneration;
+		ResultPointer->OnBoardEdited();
+	}
+
+	return ResultPointer;
 }
 
-UGameBoard* UGameBoard::InitializeBoardHelper(uint64 BoardDimension)
+UGameBoard* UGameBoard::InitializeBoardHelper(uint64 BoardDimension, const FString& RuleString)
 {
+	const FLifeRule* Rule = FLifeRule::FindOrCreate(RuleString);
+	if (Rule == nullptr)
+	{
+		return nullptr;
+	}
+
 	if (UGameBoard* ResultPointer = NewObject<UGameBoard>())
 	{
 		ResultPointer->mBoardDimension = BoardDimension;
 		ResultPointer->mMaxLevelInTree = log2(BoardDimension);
 
 		ResultPointer->mRootNode = QuadTreeNode::CreateEmptyNode(ResultPointer->mMaxLevelInTree);
+		ResultPointer->mGeneration = 0;
+		ResultPointer->mRule = Rule;
+		ResultPointer->OnBoardEdited();
 
 		return ResultPointer;
 	}
@@ -40,10 +101,94 @@ UGameBoard* UGameBoard::InitializeBoardHelper(uint64 BoardDimension)
 
 void UGameBoard::SetCellToAlive(const FBoardCoordinate Coordinate)
 {
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call SetCellToAlive while the board is being simulated asynchronously."));
+		return;
+	}
+
 	mRootNode = mRootNode->SetCellToAlive(Coordinate.mX, Coordinate.mY);
+	OnBoardEdited();
+}
+
+void UGameBoard::SetCellsToAlive(const TArray<FBoardCoordinate>& Coordinates)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call SetCellsToAlive while the board is being simulated asynchronously."));
+		return;
+	}
+
+	// QuadTreeNode rewrites the coordinates as it sorts them into quadrants, so give it a copy.
+	TArray<FBoardCoordinate> LocalCoordinates = Coordinates;
+	mRootNode = QuadTreeNode::SetCellsToAlive(mRootNode, LocalCoordinates);
+	OnBoardEdited();
+}
+
+bool UGameBoard::Combine(const UGameBoard* Other, EBoardOperation Operation)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call Combine while the board is being simulated asynchronously."));
+		return false;
+	}
+
+	if (Other == nullptr || Other->mMaxLevelInTree != mMaxLevelInTree)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to combine boards that are not the same size."));
+		return false;
+	}
+
+	const TSharedPtr<const QuadTreeNode> CombinedRootNode = QuadTreeNode::Combine(mRootNode, Other->mRootNode, Operation);
+	if (CombinedRootNode == mRootNode)
+	{
+		return true;
+	}
+
+	mRootNode = CombinedRootNode;
+	OnBoardEdited();
+	return true;
+}
+
+bool UGameBoard::Transform(EBoardSymmetry Symmetry)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call Transform while the board is being simulated asynchronously."));
+		return false;
+	}
+
+	const TSharedPtr<const QuadTreeNode> TransformedRootNode = QuadTreeNode::Transform(mRootNode, Symmetry);
+	if (TransformedRootNode == mRootNode)
+	{
+		return true;
+	}
+
+	mRootNode = TransformedRootNode;
+	OnBoardEdited();
+	return true;
+}
+
+bool UGameBoard::Translate(int64 DeltaX, int64 DeltaY)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call Translate while the board is being simulated asynchronously."));
+		return false;
+	}
+
+	const TSharedPtr<const QuadTreeNode> TranslatedRootNode = QuadTreeNode::Translate(mRootNode, (uint64)DeltaX, (uint64)DeltaY);
+	if (TranslatedRootNode == mRootNode)
+	{
+		return true;
+	}
+
+	mRootNode = TranslatedRootNode;
+	OnBoardEdited();
+	return true;
 }
 
-ChildNode UGameBoard::GetOpposingVerticalQuadrant(ChildNode Child) const
+ChildNode UGameBoard::GetOpposingVerticalQuadrant(ChildNode Child)
 {
 	switch (Child)
 	{
@@ -61,7 +206,7 @@ ChildNode UGameBoard::GetOpposingVerticalQuadrant(ChildNode Child) const
 	}
 }
 
-ChildNode UGameBoard::GetOpposingHorizontalQuadrant(ChildNode Child) const
+ChildNode UGameBoard::GetOpposingHorizontalQuadrant(ChildNode Child)
 {
 	switch (Child)
 	{
@@ -79,7 +224,7 @@ ChildNode UGameBoard::GetOpposingHorizontalQuadrant(ChildNode Child) const
 	}	
 }
 
-ChildNode UGameBoard::GetOpposingDiagonalQuadrant(ChildNode Child) const
+ChildNode UGameBoard::GetOpposingDiagonalQuadrant(ChildNode Child)
 {
 	switch (Child)
 	{
@@ -97,47 +242,93 @@ ChildNode UGameBoard::GetOpposingDiagonalQuadrant(ChildNode Child) const
 	}
 }
 
-TSharedPtr<const QuadTreeNode> UGameBoard::ConstructBoardWithCenteredQuadrant(ChildNode QuadrantToCenter) const
+TSharedPtr<const QuadTreeNode> UGameBoard::ConstructBoardWithCenteredQuadrant(const TSharedPtr<const QuadTreeNode> RootNode, ChildNode QuadrantToCenter)
 {
-	TSharedPtr<const QuadTreeNode> MainQuadrant = mRootNode->GetChild(QuadrantToCenter);
-	TSharedPtr<const QuadTreeNode> OpposingHorizontal = mRootNode->GetChild(GetOpposingHorizontalQuadrant(QuadrantToCenter));
-	TSharedPtr<const QuadTreeNode> OpposingVertical = mRootNode->GetChild(GetOpposingVerticalQuadrant(QuadrantToCenter));
-	TSharedPtr<const QuadTreeNode> OpposingDiagonal = mRootNode->GetChild(GetOpposingDiagonalQuadrant(QuadrantToCenter));
+	const uint8 MaxLevelInTree = RootNode->mLevel;
 
-	TSharedPtr<const QuadTreeNode> EmptyTree = QuadTreeNode::CreateEmptyNode(mMaxLevelInTree - 2);
+	TSharedPtr<const QuadTreeNode> MainQuadrant = RootNode->GetChild(QuadrantToCenter);
+	TSharedPtr<const QuadTreeNode> OpposingHorizontal = RootNode->GetChild(GetOpposingHorizontalQuadrant(QuadrantToCenter));
+	TSharedPtr<const QuadTreeNode> OpposingVertical = RootNode->GetChild(GetOpposingVerticalQuadrant(QuadrantToCenter));
+	TSharedPtr<const QuadTreeNode> OpposingDiagonal = RootNode->GetChild(GetOpposingDiagonalQuadrant(QuadrantToCenter));
 	
-	const TSharedPtr<const QuadTreeNode> NewNorthwest = QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree - 1,
+	const TSharedPtr<const QuadTreeNode> NewNorthwest = QuadTreeNode::CreateNodeWithSubnodes(MaxLevelInTree - 1,
 		OpposingDiagonal->Southeast(),
 		OpposingVertical->Southwest(),
 		OpposingHorizontal->Northeast(),
 		MainQuadrant->Northwest());
 
-	const TSharedPtr<const QuadTreeNode> NewNortheast = QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree - 1,
+	const TSharedPtr<const QuadTreeNode> NewNortheast = QuadTreeNode::CreateNodeWithSubnodes(MaxLevelInTree - 1,
 		OpposingVertical->Southeast(),
 		OpposingDiagonal->Southwest(),
 		MainQuadrant->Northeast(),
 		OpposingHorizontal->Northwest());
 
-	const TSharedPtr<const QuadTreeNode> NewSouthwest = QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree - 1,
+	const TSharedPtr<const QuadTreeNode> NewSouthwest = QuadTreeNode::CreateNodeWithSubnodes(MaxLevelInTree - 1,
 		OpposingHorizontal->Southeast(),
 		MainQuadrant->Southwest(),
 		OpposingDiagonal->Northeast(),
 		OpposingVertical->Northwest());
 
-	const TSharedPtr<const QuadTreeNode> NewSoutheast = QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree - 1,
+	const TSharedPtr<const QuadTreeNode> NewSoutheast = QuadTreeNode::CreateNodeWithSubnodes(MaxLevelInTree - 1,
 		MainQuadrant->Southeast(),
 		OpposingHorizontal->Southwest(),
 		OpposingVertical->Northeast(),
 		OpposingDiagonal->Northwest());
 
-	return QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree, NewNorthwest, NewNortheast, NewSouthwest, NewSoutheast);
+	return QuadTreeNode::CreateNodeWithSubnodes(MaxLevelInTree, NewNorthwest, NewNortheast, NewSouthwest, NewSoutheast);
 }
 
 void UGameBoard::SimulateNextGeneration()
 {
-	TSharedPtr<const QuadTreeNode> NorthwestQuadrant, NortheastQuadrant, SouthwestQuadrant, SoutheastQuadrant;
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call SimulateNextGeneration while the board is being simulated asynchronously."));
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_GameBoardSimulateNextGeneration);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UGameBoard::SimulateNextGeneration);
+
+	// A board that has stopped changing doesn't need to be simulated. No work is done and no nodes are made, so the step stats are all zero,
+	// and the generation doesn't count towards the compaction interval, since there is nothing new to scatter the board's nodes.
+	if (mPeriodDetector.GetPeriodicity().mKind == EBoardPeriodicity::Static)
+	{
+		mLastStepStats = FGameBoardStepStats();
+		++mGeneration;
+		RecordGeneration();
+		return;
+	}
+
+	mRootNode = ComputeNextGenerationOfRoot(mRootNode, *mRule, &mLastStepStats);
+	++mGeneration;
+
+	mPeriodDetector.AddGeneration(mRootNode, mGeneration);
+	RecordGeneration();
+
+	if (mNodeCompactionInterval > 0 && ++mGenerationsSinceCompaction >= mNodeCompactionInterval)
+	{
+		CompactNodes();
+	}
+
+	INC_QWORD_STAT_BY(STAT_GameBoardNodesCreated, mLastStepStats.mSimulationStats.mNodesCreated);
+	INC_QWORD_STAT_BY(STAT_GameBoardResultCacheHits, mLastStepStats.mSimulationStats.mResultCacheHits);
+	INC_QWORD_STAT_BY(STAT_GameBoardResultCacheMisses, mLastStepStats.mSimulationStats.mResultCacheMisses);
+	INC_QWORD_STAT_BY(STAT_GameBoardBaseCaseInvocations, mLastStepStats.mSimulationStats.mBaseCaseInvocations);
+	INC_QWORD_STAT_BY(STAT_GameBoardParallelTasks, mLastStepStats.mSimulationStats.mParallelTasks);
+	SET_QWORD_STAT(STAT_GameBoardMaxRecursionDepth, mLastStepStats.mMaxRecursionDepth);
+	SET_QWORD_STAT(STAT_GameBoardLiveNodes, QuadTreeNode::GetLiveNodeCount());
+	SET_QWORD_STAT(STAT_GameBoardCachedResults, QuadTreeNode::GetCachedResultCount());
+}
+
+const FGameBoardStepStats& UGameBoard::GetLastStepStats() const
+{
+	return mLastStepStats;
+}
+
+TSharedPtr<const QuadTreeNode> UGameBoard::ComputeNextGenerationOfRoot(const TSharedPtr<const QuadTreeNode> RootNode, const FLifeRule& Rule, FGameBoardStepStats* StepStatsOut)
+{
+	const double StepStartTime = FPlatformTime::Seconds();
 
-	/*
 	/**
 	* Create four new trees. Each one will have one quadrant of our board in the center.
 	* In parallel, we go through and calculate the next generation on each of these new trees.
@@ -146,12 +337,422 @@ void UGameBoard::SimulateNextGeneration()
 	*/
 	TStaticArray<TSharedPtr<const QuadTreeNode>, 4> SolvedChildQuadrants;
 
+	const int32 ParallelDepth = QuadTreeNode::GetMaxParallelDepth();
+	const EParallelForFlags ParallelForFlags = (ParallelDepth > 0) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+
+	double QuadrantMilliseconds[ChildNode::kCount] = {};
+
+	// Only the work done for this board counts towards its step stats, even if other boards are simulating at the same time.
+	FQuadTreeSimulationStats QuadrantStats[ChildNode::kCount];
+
 	ParallelFor(ChildNode::kCount, [&](int32 QuadrantIndex)
 		{
-			SolvedChildQuadrants[QuadrantIndex] = ConstructBoardWithCenteredQuadrant((ChildNode) QuadrantIndex)->GetNextGeneration();
-		});
+			FQuadTreeSimulationStatsScope StatsScope((StepStatsOut != nullptr) ? &QuadrantStats[QuadrantIndex] : nullptr);
+			const double QuadrantStartTime = FPlatformTime::Seconds();
+			SolvedChildQuadrants[QuadrantIndex] = ConstructBoardWithCenteredQuadrant(RootNode, (ChildNode) QuadrantIndex)->GetNextGeneration(Rule, FMath::Max(ParallelDepth - 1, 0));
+			QuadrantMilliseconds[QuadrantIndex] = (FPlatformTime::Seconds() - QuadrantStartTime) * 1000.0;
+		}, ParallelForFlags);
+
+	const TSharedPtr<const QuadTreeNode> NewRootNode = QuadTreeNode::CreateNodeWithSubnodes(RootNode->mLevel, SolvedChildQuadrants[0], SolvedChildQuadrants[1], SolvedChildQuadrants[2], SolvedChildQuadrants[3]);
+
+	if (StepStatsOut != nullptr)
+	{
+		StepStatsOut->mSimulationStats = FQuadTreeSimulationStats();
+		for (const FQuadTreeSimulationStats& Stats : QuadrantStats)
+		{
+			StepStatsOut->mSimulationStats += Stats;
+		}
+
+		StepStatsOut->mSimulationStats.mParallelTasks += (ParallelDepth > 0) ? ChildNode::kCount : 0;
+		StepStatsOut->mMaxRecursionDepth = (StepStatsOut->mSimulationStats.mLowestLevelReached < RootNode->mLevel) ? RootNode->mLevel - StepStatsOut->mSimulationStats.mLowestLevelReached : 0;
+		StepStatsOut->mStepMilliseconds = (FPlatformTime::Seconds() - StepStartTime) * 1000.0;
+
+		for (int32 QuadrantIndex = 0; QuadrantIndex < ChildNode::kCount; ++QuadrantIndex)
+		{
+			StepStatsOut->mQuadrantMilliseconds[QuadrantIndex] = QuadrantMilliseconds[QuadrantIndex];
+		}
+	}
+
+	return NewRootNode;
+}
+
+void UGameBoard::SimulateToGeneration(int64 TargetGeneration)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call SimulateToGeneration while the board is being simulated asynchronously."));
+		return;
+	}
+
+	if (TargetGeneration < mGeneration)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to simulate to generation %lld, but the board is already at generation %lld."), TargetGeneration, mGeneration);
+		return;
+	}
+
+	// Step until we either get there or find out how the board repeats.
+	while (mGeneration < TargetGeneration && mPeriodDetector.GetPeriodicity().mKind == EBoardPeriodicity::Unknown)
+	{
+		SimulateNextGeneration();
+	}
+
+	if (mGeneration == TargetGeneration)
+	{
+		return;
+	}
+
+	// Every whole period leaves the board as it was, only moved by the displacement for spaceships, so we only have to simulate what's left over.
+	const FBoardPeriodicity& Periodicity = mPeriodDetector.GetPeriodicity();
+	const uint64 GenerationsLeft = TargetGeneration - mGeneration;
+	const uint64 NumPeriods = GenerationsLeft / Periodicity.mPeriod;
+
+	for (uint64 GenerationsLeftOver = GenerationsLeft % Periodicity.mPeriod; GenerationsLeftOver > 0; --GenerationsLeftOver)
+	{
+		SimulateNextGeneration();
+	}
+
+	if (Periodicity.mKind == EBoardPeriodicity::Spaceship)
+	{
+		mRootNode = QuadTreeNode::Translate(mRootNode, (uint64)Periodicity.mDisplacementX * NumPeriods, (uint64)Periodicity.mDisplacementY * NumPeriods);
+	}
+
+	mGeneration = TargetGeneration;
+	RecordGeneration();
+}
+
+bool UGameBoard::SeekToGeneration(int64 TargetGeneration)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call SeekToGeneration while the board is being simulated asynchronously."));
+		return false;
+	}
+
+	// Start from the closest generation we have on hand that isn't past the target, unless the board is already closer.
+	TSharedPtr<const QuadTreeNode> NearestRootNode;
+	int64 NearestGeneration = 0;
+	const bool FoundNearestGeneration = mHistory.FindNearestGeneration(TargetGeneration, NearestRootNode, NearestGeneration);
+
+	const bool IsCurrentGenerationCloser = mGeneration <= TargetGeneration && (!FoundNearestGeneration || NearestGeneration <= mGeneration);
+	if (!IsCurrentGenerationCloser)
+	{
+		if (!FoundNearestGeneration)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Attempting to seek to generation %lld, but the oldest generation we remember is %lld."), TargetGeneration, mHistory.GetOldestGeneration());
+			return false;
+		}
+
+		mRootNode = NearestRootNode;
+		mGeneration = NearestGeneration;
+		mPatternSearch.Reset();
+		ResetPeriodDetection();
+	}
+
+	SimulateToGeneration(TargetGeneration);
+	return true;
+}
+
+void UGameBoard::SetHistoryLimits(int32 RecentGenerations, int32 CheckpointsPerDoubling, int64 MemoryBudgetBytes)
+{
+	mHistory.SetLimits(RecentGenerations, CheckpointsPerDoubling, MemoryBudgetBytes);
+	mHistory.AddGeneration(mRootNode, mGeneration);
+}
+
+int64 UGameBoard::GetOldestSeekableGeneration() const
+{
+	const int64 OldestGeneration = mHistory.GetOldestGeneration();
+	return (OldestGeneration == INDEX_NONE) ? mGeneration : FMath::Min(OldestGeneration, mGeneration);
+}
+
+bool UGameBoard::StartCheckpointStream(const FString& Filename, int32 CheckpointEvery)
+{
+	mCheckpointStream = FBoardCheckpointStream::OpenForWriting(Filename);
+	if (!mCheckpointStream.IsValid())
+	{
+		return false;
+	}
+
+	if (!mCheckpointStream->WriteCheckpoint(mRootNode, mGeneration, GetRuleString()))
+	{
+		mCheckpointStream.Reset();
+		return false;
+	}
+
+	mCheckpointEvery = FMath::Max(CheckpointEvery, 1);
+	mLastCheckpointGeneration = mGeneration;
+	return true;
+}
+
+void UGameBoard::StopCheckpointStream()
+{
+	mCheckpointStream.Reset();
+}
+
+const FBoardCheckpointStream* UGameBoard::GetCheckpointStream() const
+{
+	return mCheckpointStream.Get();
+}
+
+bool UGameBoard::StartReplicationServer(int32 Port)
+{
+	mReplicationServer = FBoardReplicationServer::Listen(Port);
+	if (!mReplicationServer.IsValid())
+	{
+		return false;
+	}
 
-	mRootNode = QuadTreeNode::CreateNodeWithSubnodes(mMaxLevelInTree, SolvedChildQuadrants[0], SolvedChildQuadrants[1], SolvedChildQuadrants[2], SolvedChildQuadrants[3]);
+	mReplicationServer->SendGeneration(mRootNode, mGeneration, GetRuleString());
+	return true;
+}
+
+void UGameBoard::StopReplicationServer()
+{
+	mReplicationServer.Reset();
+}
+
+bool UGameBoard::StartReplicationClient(const FString& Address, int32 Port)
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to watch a replication server while the board is being simulated asynchronously."));
+		return false;
+	}
+
+	mReplicationClient = FBoardReplicationClient::Connect(Address, Port);
+	return mReplicationClient.IsValid();
+}
+
+void UGameBoard::StopReplicationClient()
+{
+	mReplicationClient.Reset();
+}
+
+bool UGameBoard::UpdateReplication()
+{
+	if (mReplicationServer.IsValid())
+	{
+		mReplicationServer->Update();
+	}
+
+	if (!mReplicationClient.IsValid())
+	{
+		return false;
+	}
+
+	const bool IsConnected = mReplicationClient->Update();
+	const TSharedPtr<const QuadTreeNode>& ReplicatedRootNode = mReplicationClient->GetRootNode();
+	const int64 ReplicatedGeneration = mReplicationClient->GetGeneration();
+
+	bool HasChanged = false;
+	if (ReplicatedRootNode.IsValid() && (ReplicatedRootNode != mRootNode || ReplicatedGeneration != mGeneration) && !IsSimulatingAsync())
+	{
+		const FLifeRule* Rule = FLifeRule::FindOrCreate(mReplicationClient->GetRuleString());
+		if (Rule != nullptr)
+		{
+			// The server's board may be a different size or follow a different rule than ours did, so take those from it too.
+			const uint8 Level = ReplicatedRootNode->mLevel;
+			const bool IsNextGeneration = (Level == mMaxLevelInTree && Rule == mRule && ReplicatedGeneration == mGeneration + 1);
+
+			mRootNode = ReplicatedRootNode;
+			mGeneration = ReplicatedGeneration;
+			mRule = Rule;
+			mMaxLevelInTree = Level;
+			mBoardDimension = (Level >= 64) ? kMaxSizeBoard : (uint64(1) << Level);
+
+			// Following the server one generation at a time looks to the rest of the board like simulating it. Anything else, like the server seeking or being edited, is an edit.
+			if (IsNextGeneration)
+			{
+				mPeriodDetector.AddGeneration(mRootNode, mGeneration);
+				RecordGeneration();
+			}
+			else
+			{
+				OnBoardEdited();
+			}
+
+			HasChanged = true;
+		}
+	}
+
+	if (!IsConnected)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Stopped watching the replication server. The board stays as it last was."));
+		mReplicationClient.Reset();
+	}
+
+	return HasChanged;
+}
+
+const FBoardReplicationServer* UGameBoard::GetReplicationServer() const
+{
+	return mReplicationServer.Get();
+}
+
+const FBoardReplicationClient* UGameBoard::GetReplicationClient() const
+{
+	return mReplicationClient.Get();
+}
+
+FBoardPeriodicity UGameBoard::GetPeriodicity() const
+{
+	return mPeriodDetector.GetPeriodicity();
+}
+
+void UGameBoard::SetMaxDetectablePeriod(int32 MaxPeriod)
+{
+	mPeriodDetector.SetMaxPeriod(MaxPeriod);
+	mPeriodDetector.AddGeneration(mRootNode, mGeneration);
+}
+
+void UGameBoard::ResetPeriodDetection()
+{
+	mPeriodDetector.Reset();
+	mPeriodDetector.AddGeneration(mRootNode, mGeneration);
+}
+
+void UGameBoard::OnBoardEdited()
+{
+	ResetPeriodDetection();
+
+	// Generations from here on no longer follow from the board, including the one we're on.
+	mHistory.DiscardGenerationsAfter(mGeneration - 1);
+	RecordGeneration(true);
+}
+
+FQuadTreeCompactionStats UGameBoard::CompactNodes()
+{
+	if (IsSimulatingAsync())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to compact the board's nodes while it is being simulated asynchronously."));
+		return FQuadTreeCompactionStats();
+	}
+
+	mGenerationsSinceCompaction = 0;
+
+	// The pattern search index holds on to the root, which would keep every node where it is. It's only a cache, so let it go.
+	mPatternSearch.Reset();
+
+	TArray<TSharedPtr<const QuadTreeNode>*> RootNodes;
+	RootNodes.Add(&mRootNode);
+	mHistory.GetRootNodeReferences(RootNodes);
+
+	const FQuadTreeCompactionStats Stats = QuadTreeNode::CompactNodes(RootNodes);
+
+	UE_LOG(LogTemp, Verbose, TEXT("Compacted %lld nodes into %.1f KB in %.3f ms, leaving %lld in place and releasing %.1f KB of emptied slabs."),
+		Stats.mNodesMoved, Stats.mArenaBytes / 1024.0, Stats.mSeconds * 1000.0, Stats.mNodesLeftInPlace, Stats.mSlabBytesReleased / 1024.0);
+	return Stats;
+}
+
+void UGameBoard::SetNodeCompactionInterval(int32 CompactEvery)
+{
+	mNodeCompactionInterval = FMath::Max(CompactEvery, 0);
+	mGenerationsSinceCompaction = 0;
+}
+
+void UGameBoard::RecordGeneration(const bool ForceCheckpoint)
+{
+	// The pattern search index holds on to the root it was built for, which would keep the old board's nodes alive. It's rebuilt the next time it's needed.
+	mPatternSearch.Reset();
+
+	mHistory.AddGeneration(mRootNode, mGeneration);
+
+	// Seeking back counts too, so going back and forth over the same generations doesn't write them again.
+	if (mCheckpointStream.IsValid() && (ForceCheckpoint || FMath::Abs(mGeneration - mLastCheckpointGeneration) >= mCheckpointEvery))
+	{
+		mCheckpointStream->WriteCheckpoint(mRootNode, mGeneration, GetRuleString());
+		mLastCheckpointGeneration = mGeneration;
+	}
+
+	if (mReplicationServer.IsValid())
+	{
+		mReplicationServer->SendGeneration(mRootNode, mGeneration, GetRuleString());
+	}
+}
+
+FString UGameBoard::GetRuleString() const
+{
+	return mRule->GetRuleString();
+}
+
+const FLifeRule& UGameBoard::GetRule() const
+{
+	return *mRule;
+}
+
+int64 UGameBoard::GetGeneration() const
+{
+	return mGeneration;
+}
+
+void UGameBoard::StartAsyncSimulation(float TargetGenerationsPerSecond, int32 MaxStepsPerFrame, int32 MaxPendingSnapshots)
+{
+	if (IsSimulatingAsync())
+	{
+		// The pending snapshot queue can't be resized while the background thread fills it, so a new size means starting over from where the simulation got to.
+		if (mAsyncSimulator->GetMaxPendingSnapshots() == FMath::Max(MaxPendingSnapshots, 1))
+		{
+			mAsyncSimulator->SetTargetGenerationsPerSecond(TargetGenerationsPerSecond);
+			mAsyncSimulator->SetMaxStepsPerFrame(MaxStepsPerFrame);
+			return;
+		}
+
+		StopAsyncSimulation();
+	}
+
+	FBoardSnapshot InitialSnapshot;
+	InitialSnapshot.mRootNode = mRootNode;
+	InitialSnapshot.mGeneration = mGeneration;
+
+	mAsyncSimulator = MakeUnique<FAsyncBoardSimulator>(InitialSnapshot, *mRule, TargetGenerationsPerSecond, MaxStepsPerFrame, MaxPendingSnapshots);
+}
+
+void UGameBoard::StopAsyncSimulation()
+{
+	if (!IsSimulatingAsync())
+	{
+		return;
+	}
+
+	// Wait for the background thread to finish, then keep whatever it managed to simulate.
+	mAsyncSimulator->StopAndWait();
+	ApplyLatestAsyncSnapshot();
+	mAsyncSimulator.Reset();
+}
+
+bool UGameBoard::ApplyLatestAsyncSnapshot()
+{
+	if (!IsSimulatingAsync())
+	{
+		return false;
+	}
+
+	FBoardSnapshot LatestSnapshot;
+	if (!mAsyncSimulator->ConsumeLatestSnapshot(LatestSnapshot))
+	{
+		return false;
+	}
+
+	mRootNode = LatestSnapshot.mRootNode;
+	mGeneration = LatestSnapshot.mGeneration;
+	mPeriodDetector.AddGeneration(mRootNode, mGeneration);
+	RecordGeneration();
+	return true;
+}
+
+bool UGameBoard::IsSimulatingAsync() const
+{
+	return mAsyncSimulator.IsValid();
+}
+
+void UGameBoard::BeginDestroy()
+{
+	// Make sure the background thread is not left running without a board.
+	mAsyncSimulator.Reset();
+	mCheckpointStream.Reset();
+	mReplicationServer.Reset();
+	mReplicationClient.Reset();
+
+	Super::BeginDestroy();
 }
 
 FString UGameBoard::GetBoardStringForBlockOfDimensionContainingCoordinate(uint64 DesiredDimension, const FBoardCoordinate Coordinate) const
@@ -189,6 +790,74 @@ TSharedPtr<const QuadTreeNode> UGameBoard::GetBlockOfDimensionContainingCoordina
 	return mRootNode->GetBlockOfDimensionContainingCoordinate(DesiredDimensionOfBlock, X, Y);
 }
 
+TSharedPtr<const QuadTreeNode> UGameBoard::GetRootNode() const
+{
+	return mRootNode;
+}
+
+bool UGameBoard::GetLiveBounds(FBoardRect& BoundsOut) const
+{
+	return mRootNode->GetLiveBounds(BoundsOut);
+}
+
+TSharedPtr<const QuadTreeNode> UGameBoard::ExtractRegion(const FBoardRect& Rect) const
+{
+	return QuadTreeNode::ExtractRegion(mRootNode, Rect);
+}
+
+TSharedPtr<const QuadTreeNode> UGameBoard::Diff(const UGameBoard* Other, FBoardRect& ChangedRectOut) const
+{
+	if (Other == nullptr || Other->mMaxLevelInTree != mMaxLevelInTree)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to diff boards that are not the same size."));
+		return nullptr;
+	}
+
+	// Every node knows the bounds of its own live cells, so finding the changed rectangle doesn't look through the differences again.
+	const TSharedPtr<const QuadTreeNode> Differences = QuadTreeNode::Combine(mRootNode, Other->mRootNode, EBoardOperation::SymmetricDifference);
+	if (!Differences->GetLiveBounds(ChangedRectOut))
+	{
+		return nullptr;
+	}
+
+	return QuadTreeNode::ExtractRegion(Differences, ChangedRectOut);
+}
+
+TSharedPtr<const QuadTreeNode> UGameBoard::GetRegionAtGeneration(const FBoardRect& Rect, int64 Generation) const
+{
+	// Start from the closest generation we have on hand that isn't past the target, unless the board is already closer.
+	TSharedPtr<const QuadTreeNode> StartRootNode = mRootNode;
+	int64 StartGeneration = mGeneration;
+
+	TSharedPtr<const QuadTreeNode> NearestRootNode;
+	int64 NearestGeneration = 0;
+	if (mHistory.FindNearestGeneration(Generation, NearestRootNode, NearestGeneration) && (StartGeneration > Generation || NearestGeneration > StartGeneration))
+	{
+		StartRootNode = NearestRootNode;
+		StartGeneration = NearestGeneration;
+	}
+
+	if (StartGeneration > Generation)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to look at generation %lld, but the oldest generation we remember is %lld."), Generation, mHistory.GetOldestGeneration());
+		return nullptr;
+	}
+
+	return QuadTreeNode::GetRegionAfterGenerations(StartRootNode, Rect, Generation - StartGeneration, *mRule);
+}
+
+void UGameBoard::FindPattern(const TArray<FBoardCoordinate>& Pattern, bool AllOrientations, int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const
+{
+	MatchesOut.Reset();
+
+	if (!mPatternSearch.IsValid() || mPatternSearch->GetRootNode() != mRootNode)
+	{
+		mPatternSearch = MakeUnique<FPatternSearch>(mRootNode);
+	}
+
+	mPatternSearch->FindPattern(Pattern, AllOrientations, BorderWidth, MatchesOut);
+}
+
 FString UGameBoard::GetBoardString() const
 {
 	return mRootNode->GetNodeString();
@@ -0,0 +1,185 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "LifeRule.h"
+
+#include "Misc/ScopeLock.h"
+
+const FLifeRule* FLifeRule::FindOrCreate(const FString& RuleString)
+{
+	uint16 BirthMask, SurvivalMask;
+	if (!ParseRuleString(RuleString, BirthMask, SurvivalMask))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not parse the rulestring '%s'. Expected something like B3/S23 or 23/3."), *RuleString);
+		return nullptr;
+	}
+
+	if (BirthMask & 0x1)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The rule '%s' brings cells with no live neighbors to life, so empty space would fill up every other generation. Rules with B0 are not supported."), *RuleString);
+		return nullptr;
+	}
+
+	// Every rule we've created so far, by their masks.
+	static FCriticalSection RulesLock;
+	static TMap<uint32, TUniquePtr<FLifeRule>> Rules;
+
+	FScopeLock Lock(&RulesLock);
+
+	TUniquePtr<FLifeRule>& Rule = Rules.FindOrAdd(((uint32)BirthMask << 16) | SurvivalMask);
+	if (!Rule.IsValid())
+	{
+		Rule = TUniquePtr<FLifeRule>(new FLifeRule(BirthMask, SurvivalMask));
+	}
+
+	return Rule.Get();
+}
+
+const FLifeRule& FLifeRule::GetConwaysLife()
+{
+	static const FLifeRule* ConwaysLife = FindOrCreate(TEXT("B3/S23"));
+	return *ConwaysLife;
+}
+
+const FString& FLifeRule::GetRuleString() const
+{
+	return mRuleString;
+}
+
+bool FLifeRule::GetIsAliveInNextGeneration(const bool IsAlive, const int32 NumLiveNeighbors) const
+{
+	const uint16 Mask = IsAlive ? mSurvivalMask : mBirthMask;
+	return (Mask >> NumLiveNeighbors) & 0x1;
+}
+
+uint16 FLifeRule::GetBirthMask() const
+{
+	return mBirthMask;
+}
+
+uint16 FLifeRule::GetSurvivalMask() const
+{
+	return mSurvivalMask;
+}
+
+FLifeRule::FLifeRule(const uint16 BirthMask, const uint16 SurvivalMask) :
+	mBirthMask(BirthMask),
+	mSurvivalMask(SurvivalMask)
+{
+	mRuleString = TEXT("B");
+	for (int32 NumLiveNeighbors = 0; NumLiveNeighbors <= 8; ++NumLiveNeighbors)
+	{
+		if ((mBirthMask >> NumLiveNeighbors) & 0x1)
+		{
+			mRuleString += FString::FromInt(NumLiveNeighbors);
+		}
+	}
+
+	mRuleString += TEXT("/S");
+	for (int32 NumLiveNeighbors = 0; NumLiveNeighbors <= 8; ++NumLiveNeighbors)
+	{
+		if ((mSurvivalMask >> NumLiveNeighbors) & 0x1)
+		{
+			mRuleString += FString::FromInt(NumLiveNeighbors);
+		}
+	}
+
+	// Each interior cell of a 4x4 block is in the center of a 3x3 neighborhood. Shifting the block by these amounts moves that cell to bit 5, with its neighborhood around it.
+	constexpr int32 InteriorCellShifts[4] = { 5, 4, 1, 0 };
+
+	// Masks off everything outside the neighborhood of bit 5, and bit 5 itself.
+	constexpr uint16 NeighborsMask = 0x757;
+
+	mResultTable.SetNumUninitialized(1 << 16);
+
+	for (int32 Block = 0; Block < (1 << 16); ++Block)
+	{
+		uint8 Result = 0;
+
+		for (const int32 Shift : InteriorCellShifts)
+		{
+			const uint16 Neighborhood = (uint16)(Block >> Shift);
+			const bool IsAlive = (Neighborhood >> 5) & 0x1;
+			const int32 NumLiveNeighbors = FMath::CountBits(Neighborhood & NeighborsMask);
+
+			Result = (Result << 1) | (GetIsAliveInNextGeneration(IsAlive, NumLiveNeighbors) ? 1 : 0);
+		}
+
+		mResultTable[Block] = Result;
+	}
+}
+
+bool FLifeRule::ParseRuleString(const FString& RuleString, uint16& BirthMaskOut, uint16& SurvivalMaskOut)
+{
+	const FString UpperRuleString = RuleString.TrimStartAndEnd().ToUpper();
+
+	// A rulestring has two sections, each optionally starting with B or S, holding the neighbor counts as digits.
+	uint16 SectionMasks[2] = { 0, 0 };
+	TCHAR SectionLetters[2] = { 0, 0 };
+	int32 Section = 0;
+
+	for (int32 Index = 0; Index < UpperRuleString.Len(); ++Index)
+	{
+		const TCHAR Character = UpperRuleString[Index];
+
+		if (Character == TEXT('/'))
+		{
+			++Section;
+		}
+		else if (Character == TEXT('B') || Character == TEXT('S'))
+		{
+			// Some rulestrings leave out the slash, as in "B3S23", so a letter after some digits starts the next section too.
+			if (SectionLetters[Section] != 0 || SectionMasks[Section] != 0)
+			{
+				++Section;
+			}
+
+			if (Section <= 1)
+			{
+				SectionLetters[Section] = Character;
+			}
+		}
+		else if (Character >= TEXT('0') && Character <= TEXT('8'))
+		{
+			SectionMasks[Section] |= 1 << (Character - TEXT('0'));
+		}
+		else
+		{
+			return false;
+		}
+
+		if (Section > 1)
+		{
+			return false;
+		}
+	}
+
+	if (Section != 1)
+	{
+		return false;
+	}
+
+	if (SectionLetters[0] == 0 && SectionLetters[1] == 0)
+	{
+		// Without letters, the survival counts come first.
+		SurvivalMaskOut = SectionMasks[0];
+		BirthMaskOut = SectionMasks[1];
+		return true;
+	}
+
+	if (SectionLetters[0] == TEXT('B') && SectionLetters[1] == TEXT('S'))
+	{
+		BirthMaskOut = SectionMasks[0];
+		SurvivalMaskOut = SectionMasks[1];
+		return true;
+	}
+
+	if (SectionLetters[0] == TEXT('S') && SectionLetters[1] == TEXT('B'))
+	{
+		SurvivalMaskOut = SectionMasks[0];
+		BirthMaskOut = SectionMasks[1];
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,292 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "PatternSearch.h"
+
+#include "Algo/Sort.h"
+#include "QuadTreeNode.h"
+
+namespace
+{
+	// The number of cells along each side of a block.
+	constexpr int32 kBlockDimension = 8;
+
+	// The number of orientations a pattern can have, counting mirror images.
+	constexpr int32 kNumOrientations = 8;
+
+	// The cells of Pattern in Orientation, moved so their bounding box starts at the origin. Puts the size of the bounding box in WidthOut and HeightOut.
+	TSet<FBoardCoordinate> GetOrientedCells(const TArray<FBoardCoordinate>& Pattern, const int32 Orientation, int32& WidthOut, int32& HeightOut)
+	{
+		uint64 MinX = UINT64_MAX, MinY = UINT64_MAX;
+		for (const FBoardCoordinate& Cell : Pattern)
+		{
+			MinX = FMath::Min(MinX, Cell.mX);
+			MinY = FMath::Min(MinY, Cell.mY);
+		}
+
+		// Mirror first, then turn counterclockwise a quarter at a time. Cells are relative to the pattern's bounding box, so they stay small and can be signed.
+		TArray<FIntPoint> OrientedCells;
+		FIntPoint Min(MAX_int32, MAX_int32);
+		for (const FBoardCoordinate& Cell : Pattern)
+		{
+			FIntPoint Point((int32)(Cell.mX - MinX), (int32)(Cell.mY - MinY));
+			if (Orientation >= 4)
+			{
+				Point.X = -Point.X;
+			}
+
+			for (int32 Turn = 0; Turn < Orientation % 4; ++Turn)
+			{
+				Point = FIntPoint(-Point.Y, Point.X);
+			}
+
+			OrientedCells.Add(Point);
+			Min = FIntPoint(FMath::Min(Min.X, Point.X), FMath::Min(Min.Y, Point.Y));
+		}
+
+		TSet<FBoardCoordinate> Result;
+		WidthOut = 0;
+		HeightOut = 0;
+		for (const FIntPoint& Point : OrientedCells)
+		{
+			FBoardCoordinate Cell;
+			Cell.SetXAndY(Point.X - Min.X, Point.Y - Min.Y);
+			Result.Add(Cell);
+
+			WidthOut = FMath::Max(WidthOut, (int32)Cell.mX + 1);
+			HeightOut = FMath::Max(HeightOut, (int32)Cell.mY + 1);
+		}
+
+		return Result;
+	}
+
+	// Returns whether two sets of cells are the same.
+	bool AreSameCells(const TSet<FBoardCoordinate>& A, const TSet<FBoardCoordinate>& B)
+	{
+		if (A.Num() != B.Num())
+		{
+			return false;
+		}
+
+		for (const FBoardCoordinate& Cell : A)
+		{
+			if (!B.Contains(Cell))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+FPatternSearch::FPatternSearch(const TSharedPtr<const QuadTreeNode>& RootNode) :
+	mRootNode(RootNode)
+{
+	if (mRootNode->mLevel < QuadTreeNode::kBlockLevel)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to search a board smaller than 8x8."));
+		return;
+	}
+
+	mBlockMask = (uint64(1) << (mRootNode->mLevel - QuadTreeNode::kBlockLevel)) - 1;
+	IndexNode(*mRootNode, 0, 0);
+}
+
+void FPatternSearch::IndexNode(const QuadTreeNode& Node, const uint64 BlockX, const uint64 BlockY)
+{
+	if (!Node.IsAlive())
+	{
+		return;
+	}
+
+	if (Node.mLevel == QuadTreeNode::kBlockLevel)
+	{
+		FBlockOccurrences* Occurrences = mOccurrences.Find(&Node);
+		if (Occurrences == nullptr)
+		{
+			Occurrences = &mOccurrences.Add(&Node);
+			Occurrences->mBitmap = Node.GetBlockBitmap();
+		}
+
+		FBoardCoordinate Position;
+		Position.SetXAndY(BlockX, BlockY);
+		mBlocks.Add(Position, Occurrences->mBitmap);
+		Occurrences->mPositions.Add(Position);
+		return;
+	}
+
+	const uint64 ChildBlocks = uint64(1) << (Node.mLevel - 1 - QuadTreeNode::kBlockLevel);
+	IndexNode(*Node.GetChild(ChildNode::Northwest), BlockX, BlockY + ChildBlocks);
+	IndexNode(*Node.GetChild(ChildNode::Northeast), BlockX + ChildBlocks, BlockY + ChildBlocks);
+	IndexNode(*Node.GetChild(ChildNode::Southwest), BlockX, BlockY);
+	IndexNode(*Node.GetChild(ChildNode::Southeast), BlockX + ChildBlocks, BlockY);
+}
+
+void FPatternSearch::FindPattern(const TArray<FBoardCoordinate>& Pattern, const bool AllOrientations, const int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const
+{
+	if (Pattern.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to search for an empty pattern."));
+		return;
+	}
+
+	const int32 FirstMatch = MatchesOut.Num();
+
+	// Symmetric patterns look the same in several orientations. Only search each distinct one once, so no match is reported twice.
+	TArray<TSet<FBoardCoordinate>> SearchedOrientations;
+	for (int32 Orientation = 0; Orientation < (AllOrientations ? kNumOrientations : 1); ++Orientation)
+	{
+		int32 Width = 0, Height = 0;
+		TSet<FBoardCoordinate> Cells = GetOrientedCells(Pattern, Orientation, Width, Height);
+
+		if (SearchedOrientations.ContainsByPredicate([&Cells](const TSet<FBoardCoordinate>& Other) { return AreSameCells(Cells, Other); }))
+		{
+			continue;
+		}
+
+		FindOrientedPattern(Cells, Width, Height, Orientation, FMath::Max(BorderWidth, 0), MatchesOut);
+		SearchedOrientations.Add(MoveTemp(Cells));
+	}
+
+	Algo::Sort(MakeArrayView(MatchesOut.GetData() + FirstMatch, MatchesOut.Num() - FirstMatch), [](const FPatternMatch& A, const FPatternMatch& B)
+		{
+			return (A.mPosition.mY != B.mPosition.mY) ? (A.mPosition.mY < B.mPosition.mY) : (A.mPosition.mX != B.mPosition.mX) ? (A.mPosition.mX < B.mPosition.mX) : (A.mOrientation < B.mOrientation);
+		});
+}
+
+void FPatternSearch::FindOrientedPattern(const TSet<FBoardCoordinate>& Cells, const int32 Width, const int32 Height, const int32 Orientation, const int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const
+{
+	// The region we check is the pattern's bounding box plus its border. Every cell in it has to match.
+	const int32 RegionWidth = Width + 2 * BorderWidth;
+	const int32 RegionHeight = Height + 2 * BorderWidth;
+
+	TArray<uint64> Masks;
+	TArray<uint64> Expected;
+
+	// Try every way the region can sit across the grid of blocks.
+	for (int32 OffsetY = 0; OffsetY < kBlockDimension; ++OffsetY)
+	{
+		for (int32 OffsetX = 0; OffsetX < kBlockDimension; ++OffsetX)
+		{
+			// Pack the region into the blocks it covers: which cells of each block we care about, and what they have to be.
+			const int32 NumBlocksX = (OffsetX + RegionWidth + kBlockDimension - 1) / kBlockDimension;
+			const int32 NumBlocksY = (OffsetY + RegionHeight + kBlockDimension - 1) / kBlockDimension;
+
+			Masks.Reset();
+			Masks.SetNumZeroed(NumBlocksX * NumBlocksY);
+			Expected.Reset();
+			Expected.SetNumZeroed(NumBlocksX * NumBlocksY);
+
+			for (int32 RegionY = 0; RegionY < RegionHeight; ++RegionY)
+			{
+				for (int32 RegionX = 0; RegionX < RegionWidth; ++RegionX)
+				{
+					const int32 X = OffsetX + RegionX;
+					const int32 Y = OffsetY + RegionY;
+					const int32 BlockIndex = (Y / kBlockDimension) * NumBlocksX + X / kBlockDimension;
+					const uint64 Bit = uint64(1) << ((Y % kBlockDimension) * kBlockDimension + X % kBlockDimension);
+
+					Masks[BlockIndex] |= Bit;
+
+					FBoardCoordinate Cell;
+					Cell.SetXAndY(RegionX - BorderWidth, RegionY - BorderWidth);
+					if (RegionX >= BorderWidth && RegionY >= BorderWidth && Cells.Contains(Cell))
+					{
+						Expected[BlockIndex] |= Bit;
+					}
+				}
+			}
+
+			// Find candidates with the block that narrows things down the most. It has to have live cells, since only live blocks are indexed.
+			int32 AnchorIndex = INDEX_NONE;
+			for (int32 BlockIndex = 0; BlockIndex < Masks.Num(); ++BlockIndex)
+			{
+				if (Expected[BlockIndex] != 0 && (AnchorIndex == INDEX_NONE || FMath::CountBits(Masks[BlockIndex]) > FMath::CountBits(Masks[AnchorIndex])))
+				{
+					AnchorIndex = BlockIndex;
+				}
+			}
+
+			const uint64 AnchorMask = Masks[AnchorIndex];
+			const uint64 AnchorExpected = Expected[AnchorIndex];
+			const uint64 AnchorBlockX = AnchorIndex % NumBlocksX;
+			const uint64 AnchorBlockY = AnchorIndex / NumBlocksX;
+
+			// Checks the rest of the region against the candidate whose anchor block is at Position, and adds it if it matches.
+			auto CheckCandidate = [&](const FBoardCoordinate& Position)
+			{
+				// Positions that run off the board, below 0 or past its far edge, are wrapped back onto it by GetBlockBitmap, so matches straddling the edge are found too.
+				const uint64 FirstBlockX = (Position.mX - AnchorBlockX) & mBlockMask;
+				const uint64 FirstBlockY = (Position.mY - AnchorBlockY) & mBlockMask;
+
+				for (int32 BlockIndex = 0; BlockIndex < Masks.Num(); ++BlockIndex)
+				{
+					if (BlockIndex != AnchorIndex && (GetBlockBitmap(FirstBlockX + BlockIndex % NumBlocksX, FirstBlockY + BlockIndex / NumBlocksX) & Masks[BlockIndex]) != Expected[BlockIndex])
+					{
+						return;
+					}
+				}
+
+				const uint64 CellMask = (mBlockMask << QuadTreeNode::kBlockLevel) | (kBlockDimension - 1);
+
+				FPatternMatch& Match = MatchesOut.AddDefaulted_GetRef();
+				Match.mPosition.SetXAndY((FirstBlockX * kBlockDimension + OffsetX + BorderWidth) & CellMask, (FirstBlockY * kBlockDimension + OffsetY + BorderWidth) & CellMask);
+				Match.mOrientation = Orientation;
+				Match.mWidth = Width;
+				Match.mHeight = Height;
+			};
+
+			if (AnchorMask == UINT64_MAX)
+			{
+				// The anchor block is wholly inside the region, so only one block can match it. Nodes are deduplicated, so building it gives us the very node the board uses, if the board has it.
+				const TSharedPtr<const QuadTreeNode> AnchorNode = QuadTreeNode::CreateBlockFromBitmap(AnchorExpected);
+				if (const FBlockOccurrences* Occurrences = mOccurrences.Find(AnchorNode.Get()))
+				{
+					for (const FBoardCoordinate& Position : Occurrences->mPositions)
+					{
+						CheckCandidate(Position);
+					}
+				}
+			}
+			else
+			{
+				// Otherwise compare the part of the anchor block we care about against each distinct block, and only look at the positions of those that match.
+				for (const TPair<const QuadTreeNode*, FBlockOccurrences>& Entry : mOccurrences)
+				{
+					if ((Entry.Value.mBitmap & AnchorMask) == AnchorExpected)
+					{
+						for (const FBoardCoordinate& Position : Entry.Value.mPositions)
+						{
+							CheckCandidate(Position);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+uint64 FPatternSearch::GetBlockBitmap(const uint64 BlockX, const uint64 BlockY) const
+{
+	FBoardCoordinate Position;
+	Position.SetXAndY(BlockX & mBlockMask, BlockY & mBlockMask);
+
+	const uint64* Bitmap = mBlocks.Find(Position);
+	return (Bitmap != nullptr) ? *Bitmap : 0;
+}
+
+const TSharedPtr<const QuadTreeNode>& FPatternSearch::GetRootNode() const
+{
+	return mRootNode;
+}
+
+int32 FPatternSearch::GetNumBlocks() const
+{
+	return mBlocks.Num();
+}
+
+int32 FPatternSearch::GetNumDistinctBlocks() const
+{
+	return mOccurrences.Num();
+}
@@ -0,0 +1,599 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "PersistentResultCache.h"
+
+#include "Async/MappedFileHandle.h"
+#include "BoardSerialization.h"
+#include "BoardUtilities.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "LifeRule.h"
+#include "Misc/Paths.h"
+#include "QuadTreeNode.h"
+
+namespace
+{
+	// Marks the start of a cache file.
+	constexpr uint64 kFileMagic = 0x4548434143464F47ull;
+
+	// Bumped whenever the layout of the file changes. Files from other versions are started over.
+	constexpr uint32 kFileVersion = 2;
+
+	// How many records build up before they're written out.
+	constexpr int32 kRecordsPerFlush = 1 << 16;
+
+	// The start of a cache file. It's as big as a record, so that records after it stay aligned.
+	struct FFileHeader
+	{
+		uint64 mMagic = kFileMagic;
+		uint32 mVersion = kFileVersion;
+
+		// The size of each record, in case it ever changes without the version being bumped.
+		uint32 mRecordSize = 0;
+
+		uint64 mReserved[4] = {};
+	};
+}
+
+TUniquePtr<FPersistentResultCache> FPersistentResultCache::Open(const FString& Filename, const int64 MaxFileBytes)
+{
+	static_assert(sizeof(FFileHeader) == sizeof(FRecord), "The header should be the size of a record, so records stay aligned.");
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	// Start a new file if there isn't one.
+	const int64 FileSize = PlatformFile.FileSize(*Filename);
+	if (FileSize < (int64)sizeof(FFileHeader) && !WriteFile(Filename, TArray<FRecord>()))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not create the result cache %s."), *Filename);
+		return nullptr;
+	}
+
+	// A run that stopped partway through writing a record leaves part of one at the end. Pad it out to a whole record, so the records after it stay aligned.
+	const int64 PartialRecordBytes = (FileSize > (int64)sizeof(FFileHeader)) ? (FileSize - sizeof(FFileHeader)) % sizeof(FRecord) : 0;
+	if (PartialRecordBytes > 0)
+	{
+		TArray<uint8> Padding;
+		Padding.SetNumZeroed(sizeof(FRecord) - PartialRecordBytes);
+
+		TUniquePtr<IFileHandle> File(PlatformFile.OpenWrite(*Filename, true));
+		if (!File.IsValid() || !File->Write(Padding.GetData(), Padding.Num()))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not repair the result cache %s."), *Filename);
+			return nullptr;
+		}
+	}
+
+	TUniquePtr<FPersistentResultCache> Cache(new FPersistentResultCache(Filename, MaxFileBytes));
+	if (!Cache->LoadIndex())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s isn't a result cache this version can read. Starting it over."), *Filename);
+
+		Cache->mMappedRegion.Reset();
+		Cache->mMappedFile.Reset();
+		if (!WriteFile(Filename, TArray<FRecord>()) || !Cache->LoadIndex())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not create the result cache %s."), *Filename);
+			return nullptr;
+		}
+	}
+
+	if (Cache->mMappedBytes >= MaxFileBytes && !Cache->Compact())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not compact the result cache %s."), *Filename);
+		return nullptr;
+	}
+
+	Cache->mOpenedBytes = Cache->mMappedBytes;
+
+	return Cache;
+}
+
+FPersistentResultCache::FPersistentResultCache(const FString& Filename, const int64 MaxFileBytes) :
+	mFilename(Filename),
+	mMaxFileBytes(MaxFileBytes)
+{
+}
+
+FPersistentResultCache::~FPersistentResultCache()
+{
+	Flush();
+}
+
+TSharedPtr<const QuadTreeNode> FPersistentResultCache::FindNextGeneration(const QuadTreeNode& Node, const FLifeRule& Rule)
+{
+	if (Node.mLevel < kMinLevel)
+	{
+		return nullptr;
+	}
+
+	FResultKey Key;
+	Key.mNodeHash = Node.GetHash();
+	Key.mLevel = Node.mLevel;
+	Key.mRuleKey = GetRuleKey(Rule);
+
+	TSharedPtr<const QuadTreeNode> NextGeneration;
+	bool WasUsedThisRun = false;
+	{
+		FReadScopeLock Lock(mLock);
+
+		// A different node can share the content hash, so make sure the second hash and population match as well.
+		const FResultEntry* Entry = mResults.Find(Key);
+		if (Entry == nullptr || Entry->mNodeCheckHash != Node.GetTranslationInvariantHash() || Entry->mNodePopulation != Node.GetPopulation())
+		{
+			return nullptr;
+		}
+
+		NextGeneration = BuildNode(Entry->mNextGenerationHash, Node.mLevel - 1);
+		WasUsedThisRun = (Entry->mLastUsedOffset >= mOpenedBytes);
+	}
+
+	if (!NextGeneration.IsValid())
+	{
+		return nullptr;
+	}
+
+	++mNumLoads;
+
+	// Note that the result was used, so compacting keeps it over results nobody has used in a while. Once per run is enough.
+	if (!WasUsedThisRun)
+	{
+		bool ShouldFlush = false;
+		{
+			FWriteScopeLock Lock(mLock);
+
+			FResultEntry* Entry = mResults.Find(Key);
+			if (!mIsFull && Entry != nullptr && Entry->mLastUsedOffset < mOpenedBytes)
+			{
+				FRecord Record;
+				Record.mType = ERecordType::Use;
+				Record.mLevel = Key.mLevel;
+				Record.mHash = Key.mNodeHash;
+				Record.mData[0] = Key.mRuleKey;
+
+				Entry->mLastUsedOffset = AppendRecord(Record, ShouldFlush);
+			}
+		}
+
+		if (ShouldFlush)
+		{
+			Flush();
+		}
+	}
+
+	return NextGeneration;
+}
+
+void FPersistentResultCache::AddNextGeneration(const QuadTreeNode& Node, const FLifeRule& Rule, const TSharedPtr<const QuadTreeNode>& NextGeneration)
+{
+	if (Node.mLevel < kMinLevel)
+	{
+		return;
+	}
+
+	FResultKey Key;
+	Key.mNodeHash = Node.GetHash();
+	Key.mLevel = Node.mLevel;
+	Key.mRuleKey = GetRuleKey(Rule);
+
+	bool ShouldFlush = false;
+	{
+		FWriteScopeLock Lock(mLock);
+
+		if (mIsFull || mResults.Contains(Key))
+		{
+			return;
+		}
+
+		// Write out the next generation's nodes before the result, so a file cut short never has a result without its nodes.
+		FRecord Record;
+		Record.mType = ERecordType::Result;
+		Record.mLevel = Key.mLevel;
+		Record.mHash = Key.mNodeHash;
+		Record.mData[0] = Key.mRuleKey;
+		Record.mData[1] = AppendNodeDefinitions(NextGeneration, ShouldFlush);
+		Record.mData[2] = Node.GetTranslationInvariantHash();
+		Record.mData[3] = Node.GetPopulation();
+
+		FResultEntry& Entry = mResults.Add(Key);
+		Entry.mNextGenerationHash = Record.mData[1];
+		Entry.mNodeCheckHash = Record.mData[2];
+		Entry.mNodePopulation = Record.mData[3];
+		Entry.mLastUsedOffset = AppendRecord(Record, ShouldFlush);
+
+		++mNumStores;
+	}
+
+	// Write the records out without holding the lock, so other threads can keep looking up and adding results in the meantime.
+	if (ShouldFlush)
+	{
+		Flush();
+	}
+}
+
+void FPersistentResultCache::Flush()
+{
+	FScopeLock FlushLock(&mFlushLock);
+
+	{
+		FWriteScopeLock Lock(mLock);
+		if (mPendingRecords.Num() == 0)
+		{
+			return;
+		}
+
+		// Lookups keep reading these records out of memory while we write them.
+		Swap(mFlushingRecords, mPendingRecords);
+	}
+
+	// Appending to the file doesn't touch the part that's mapped, so lookups can keep using it. Only we change mFlushingRecords, and nobody else writes to the file.
+	bool WasWritten = false;
+	{
+		TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*mFilename, true));
+		WasWritten = File.IsValid() && File->Write((const uint8*)mFlushingRecords.GetData(), (int64)mFlushingRecords.Num() * sizeof(FRecord));
+	}
+
+	// Map the file again to take in what we wrote.
+	FWriteScopeLock Lock(mLock);
+
+	const int64 OldMappedBytes = mMappedBytes;
+	if (!MapFile())
+	{
+		// Without the mapping, none of the offsets we know about lead anywhere.
+		UE_LOG(LogTemp, Warning, TEXT("Lost the mapping of the result cache %s. It won't be used for the rest of this run."), *mFilename);
+
+		mNodeOffsets.Reset();
+		mResults.Reset();
+		mFlushingRecords.Reset();
+		mPendingRecords.Reset();
+		mIsFull = true;
+		return;
+	}
+
+	if (!WasWritten)
+	{
+		// Keep reading the records that didn't make it out of mFlushingRecords for the rest of the run. Anything written partway is past the part of the file we look at,
+		// and since the file is full from here on nothing more is queued, so we never write after it.
+		UE_LOG(LogTemp, Warning, TEXT("Could not write to the result cache %s. No more results will be added to it this run."), *mFilename);
+
+		mMappedBytes = FMath::Min(mMappedBytes, OldMappedBytes);
+		mFlushingRecords.Append(mPendingRecords);
+		mPendingRecords.Reset();
+		mIsFull = true;
+		return;
+	}
+
+	mFlushingRecords.Reset();
+}
+
+FPersistentResultCacheStats FPersistentResultCache::GetStats() const
+{
+	FReadScopeLock Lock(mLock);
+
+	FPersistentResultCacheStats Result;
+	Result.mFileBytes = mMappedBytes + (int64)(mFlushingRecords.Num() + mPendingRecords.Num()) * sizeof(FRecord);
+	Result.mNumResults = mResults.Num();
+	Result.mNumNodes = mNodeOffsets.Num();
+	Result.mNumLoads = mNumLoads;
+	Result.mNumStores = mNumStores;
+	Result.mIsFull = mIsFull;
+	return Result;
+}
+
+bool FPersistentResultCache::LoadIndex()
+{
+	mNodeOffsets.Reset();
+	mResults.Reset();
+
+	if (!MapFile() || mMappedBytes < (int64)sizeof(FFileHeader))
+	{
+		return false;
+	}
+
+	const FFileHeader& Header = *(const FFileHeader*)mMappedRegion->GetMappedPtr();
+	if (Header.mMagic != kFileMagic || Header.mVersion != kFileVersion || Header.mRecordSize != sizeof(FRecord))
+	{
+		return false;
+	}
+
+	// Only note where everything is. Nodes aren't rebuilt until a result that needs them is looked up.
+	for (int64 Offset = sizeof(FFileHeader); Offset + (int64)sizeof(FRecord) <= mMappedBytes; Offset += sizeof(FRecord))
+	{
+		const FRecord& Record = GetRecord(Offset);
+
+		FResultKey Key;
+		Key.mNodeHash = Record.mHash;
+		Key.mLevel = Record.mLevel;
+		Key.mRuleKey = Record.mData[0];
+
+		switch (Record.mType)
+		{
+		case ERecordType::NodeDefinition:
+			mNodeOffsets.Add(Record.mHash, Offset);
+			break;
+		case ERecordType::Result:
+		{
+			FResultEntry& Entry = mResults.FindOrAdd(Key);
+			Entry.mNextGenerationHash = Record.mData[1];
+			Entry.mNodeCheckHash = Record.mData[2];
+			Entry.mNodePopulation = Record.mData[3];
+			Entry.mLastUsedOffset = Offset;
+			break;
+		}
+		case ERecordType::Use:
+			if (FResultEntry* Entry = mResults.Find(Key))
+			{
+				Entry->mLastUsedOffset = Offset;
+			}
+			break;
+		default:
+			// Padding left behind by a run that stopped partway through writing a record.
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool FPersistentResultCache::Compact()
+{
+	const int64 TargetBytes = mMaxFileBytes / 2;
+
+	TArray<TPair<FResultKey, FResultEntry>> Results;
+	for (const TPair<FResultKey, FResultEntry>& Result : mResults)
+	{
+		Results.Add(Result);
+	}
+
+	// Pick the results to keep, most recently used first, until they fill half of the limit. Results share most of their nodes, so each node only counts once.
+	Results.Sort([](const TPair<FResultKey, FResultEntry>& A, const TPair<FResultKey, FResultEntry>& B)
+		{
+			return A.Value.mLastUsedOffset > B.Value.mLastUsedOffset;
+		});
+
+	TSet<uint64> KeptNodes;
+	TArray<int32> KeptResultIndices;
+
+	for (int32 Index = 0; Index < Results.Num(); ++Index)
+	{
+		// Results whose nodes are missing can't be used anyway.
+		const TPair<FResultKey, FResultEntry>& Result = Results[Index];
+		if (!GatherNodeDefinitions(Result.Value.mNextGenerationHash, Result.Key.mLevel - 1, KeptNodes, nullptr))
+		{
+			continue;
+		}
+
+		const int64 KeptBytes = (int64)sizeof(FFileHeader) + (int64)(KeptNodes.Num() + KeptResultIndices.Num() + 1) * sizeof(FRecord);
+		if (KeptBytes > TargetBytes)
+		{
+			break;
+		}
+
+		KeptResultIndices.Add(Index);
+	}
+
+	// Write the kept results back oldest first, so they keep their order of use.
+	TArray<FRecord> Records;
+	TSet<uint64> WrittenNodes;
+
+	for (int32 KeptIndex = KeptResultIndices.Num() - 1; KeptIndex >= 0; --KeptIndex)
+	{
+		const TPair<FResultKey, FResultEntry>& Result = Results[KeptResultIndices[KeptIndex]];
+		GatherNodeDefinitions(Result.Value.mNextGenerationHash, Result.Key.mLevel - 1, WrittenNodes, &Records);
+
+		FRecord& Record = Records.AddDefaulted_GetRef();
+		Record.mType = ERecordType::Result;
+		Record.mLevel = Result.Key.mLevel;
+		Record.mHash = Result.Key.mNodeHash;
+		Record.mData[0] = Result.Key.mRuleKey;
+		Record.mData[1] = Result.Value.mNextGenerationHash;
+		Record.mData[2] = Result.Value.mNodeCheckHash;
+		Record.mData[3] = Result.Value.mNodePopulation;
+	}
+
+	// Some platforms won't replace a file that's mapped, so let go of it first.
+	const int64 OldBytes = mMappedBytes;
+	mMappedRegion.Reset();
+	mMappedFile.Reset();
+	mMappedBytes = 0;
+
+	const FString CompactedFilename = mFilename + TEXT(".compacting");
+
+	if (!WriteFile(CompactedFilename, Records) || !UBoardUtilities::ReplaceFile(mFilename, CompactedFilename) || !LoadIndex())
+	{
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Compacted the result cache %s from %.1f MB to %.1f MB, keeping %d of %d results."), *mFilename, OldBytes / (1024.0 * 1024.0), mMappedBytes / (1024.0 * 1024.0),
+		KeptResultIndices.Num(), Results.Num());
+
+	return true;
+}
+
+bool FPersistentResultCache::MapFile()
+{
+	mMappedRegion.Reset();
+	mMappedFile.Reset();
+	mMappedBytes = 0;
+
+	mMappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*mFilename));
+	if (!mMappedFile.IsValid())
+	{
+		return false;
+	}
+
+	mMappedRegion.Reset(mMappedFile->MapRegion(0, mMappedFile->GetFileSize()));
+	if (!mMappedRegion.IsValid())
+	{
+		mMappedFile.Reset();
+		return false;
+	}
+
+	mMappedBytes = mMappedRegion->GetMappedSize();
+	return true;
+}
+
+const FPersistentResultCache::FRecord& FPersistentResultCache::GetRecord(const int64 Offset) const
+{
+	if (Offset < mMappedBytes)
+	{
+		return *(const FRecord*)(mMappedRegion->GetMappedPtr() + Offset);
+	}
+
+	const int64 Index = (Offset - mMappedBytes) / sizeof(FRecord);
+	return (Index < mFlushingRecords.Num()) ? mFlushingRecords[Index] : mPendingRecords[Index - mFlushingRecords.Num()];
+}
+
+int64 FPersistentResultCache::AppendRecord(const FRecord& Record, bool& ShouldFlushOut)
+{
+	const int64 Offset = mMappedBytes + (int64)(mFlushingRecords.Num() + mPendingRecords.Num()) * sizeof(FRecord);
+	mPendingRecords.Add(Record);
+
+	if (!mIsFull && Offset + (int64)sizeof(FRecord) >= mMaxFileBytes)
+	{
+		UE_LOG(LogTemp, Display, TEXT("The result cache %s has reached its limit of %.1f MB. It will be compacted the next time it's opened."), *mFilename, mMaxFileBytes / (1024.0 * 1024.0));
+		mIsFull = true;
+	}
+
+	ShouldFlushOut |= (mPendingRecords.Num() >= kRecordsPerFlush);
+
+	return Offset;
+}
+
+uint64 FPersistentResultCache::AppendNodeDefinitions(const TSharedPtr<const QuadTreeNode>& Node, bool& ShouldFlushOut)
+{
+	uint64 Reference = 0;
+	FNodeDefinition::AppendDefinitions(Node,
+		[this](const QuadTreeNode& WrittenNode)
+		{
+			return mNodeOffsets.Contains(WrittenNode.GetHash()) ? EWrittenNodeState::Written : EWrittenNodeState::NotWritten;
+		},
+		[this, &ShouldFlushOut](const TSharedPtr<const QuadTreeNode>& NewNode, const FNodeDefinition& Definition)
+		{
+			FRecord Record;
+			Record.mType = ERecordType::NodeDefinition;
+			Record.mLevel = Definition.mLevel;
+			Record.mHash = Definition.mHash;
+			FMemory::Memcpy(Record.mData, Definition.mChildren, sizeof(Definition.mChildren));
+
+			mNodeOffsets.Add(Definition.mHash, AppendRecord(Record, ShouldFlushOut));
+		},
+		Reference);
+
+	return Reference;
+}
+
+TSharedPtr<const QuadTreeNode> FPersistentResultCache::BuildNode(const uint64 Reference, const uint8 Level)
+{
+	const bool IsBlock = (Level == QuadTreeNode::kBlockLevel);
+	if (TSharedPtr<const QuadTreeNode> BuiltNode = FindBuiltNode(Reference, IsBlock))
+	{
+		return BuiltNode;
+	}
+
+	if (IsBlock)
+	{
+		return AddBuiltNode(Reference, IsBlock, QuadTreeNode::CreateBlockFromBitmap(Reference));
+	}
+
+	const int64* Offset = mNodeOffsets.Find(Reference);
+	if (Offset == nullptr || GetRecord(*Offset).mLevel != Level)
+	{
+		return nullptr;
+	}
+
+	const FRecord& Record = GetRecord(*Offset);
+	FNodeDefinition Definition;
+	Definition.mHash = Reference;
+	Definition.mLevel = Level;
+	FMemory::Memcpy(Definition.mChildren, Record.mData, sizeof(Definition.mChildren));
+
+	// A damaged file builds no node at all, so it gives us a miss rather than a wrong result.
+	TSharedPtr<const QuadTreeNode> Node = Definition.Build([this](const uint64 ChildReference, const uint8 ChildLevel)
+		{
+			return BuildNode(ChildReference, ChildLevel);
+		});
+
+	return Node.IsValid() ? AddBuiltNode(Reference, IsBlock, Node) : nullptr;
+}
+
+TSharedPtr<const QuadTreeNode> FPersistentResultCache::FindBuiltNode(const uint64 Reference, const bool IsBlock)
+{
+	FScopeLock Lock(&mBuiltNodesLock);
+
+	const TWeakPtr<const QuadTreeNode>* BuiltNode = (IsBlock ? mBuiltBlocks : mBuiltNodes).Find(Reference);
+	return (BuiltNode != nullptr) ? BuiltNode->Pin() : nullptr;
+}
+
+TSharedPtr<const QuadTreeNode> FPersistentResultCache::AddBuiltNode(const uint64 Reference, const bool IsBlock, const TSharedPtr<const QuadTreeNode>& Node)
+{
+	FScopeLock Lock(&mBuiltNodesLock);
+
+	(IsBlock ? mBuiltBlocks : mBuiltNodes).Add(Reference, Node);
+
+	// Nodes that die leave their entries behind, so sweep those out whenever the maps have doubled in size since the last sweep.
+	if (mBuiltNodes.Num() + mBuiltBlocks.Num() > mBuiltNodesPurgeThreshold)
+	{
+		for (TMap<uint64, TWeakPtr<const QuadTreeNode>>* BuiltNodes : { &mBuiltNodes, &mBuiltBlocks })
+		{
+			for (auto Iter = BuiltNodes->CreateIterator(); Iter; ++Iter)
+			{
+				if (!Iter.Value().IsValid())
+				{
+					Iter.RemoveCurrent();
+				}
+			}
+		}
+
+		mBuiltNodesPurgeThreshold = FMath::Max((mBuiltNodes.Num() + mBuiltBlocks.Num()) * 2, 1024);
+	}
+
+	return Node;
+}
+
+bool FPersistentResultCache::GatherNodeDefinitions(const uint64 Hash, const uint8 Level, TSet<uint64>& GatheredHashes, TArray<FRecord>* RecordsOut) const
+{
+	if (Level <= QuadTreeNode::kBlockLevel || GatheredHashes.Contains(Hash))
+	{
+		return true;
+	}
+
+	const int64* Offset = mNodeOffsets.Find(Hash);
+	if (Offset == nullptr)
+	{
+		return false;
+	}
+
+	const FRecord& Record = GetRecord(*Offset);
+	for (const uint64 Child : Record.mData)
+	{
+		if (!GatherNodeDefinitions(Child, Level - 1, GatheredHashes, RecordsOut))
+		{
+			return false;
+		}
+	}
+
+	GatheredHashes.Add(Hash);
+	if (RecordsOut != nullptr)
+	{
+		RecordsOut->Add(Record);
+	}
+
+	return true;
+}
+
+bool FPersistentResultCache::WriteFile(const FString& Filename, const TArray<FRecord>& Records)
+{
+	FFileHeader Header;
+	Header.mRecordSize = sizeof(FRecord);
+
+	TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Filename));
+	return File.IsValid() && File->Write((const uint8*)&Header, sizeof(Header)) && File->Write((const uint8*)Records.GetData(), (int64)Records.Num() * sizeof(FRecord));
+}
+
+uint64 FPersistentResultCache::GetRuleKey(const FLifeRule& Rule)
+{
+	return ((uint64)Rule.GetBirthMask() << 16) | Rule.GetSurvivalMask();
+}
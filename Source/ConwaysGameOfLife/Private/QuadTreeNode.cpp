@@ -3,94 +3,1405 @@
 
 #include "QuadTreeNode.h"
 
+#include "Algo/Sort.h"
+#include "BoardUtilities.h"
+#include "GameOfLifeStats.h"
+#include "LifeRule.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
+#include "PersistentResultCache.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Templates/Function.h"
+
+DECLARE_CYCLE_STAT(TEXT("QuadTreeNode GetNextGeneration"), STAT_QuadTreeNodeGetNextGeneration, STATGROUP_GameOfLife);
+
+namespace
+{
+	// The node table and the result cache are each split into this many independently locked shards, so threads simulating different quadrants rarely wait on each other.
+	constexpr int32 kNumTableShards = 64;
+
+	// A node table shard has to hold at least this many entries before we bother sweeping out the ones whose nodes have died.
+	constexpr int32 kMinNodeTablePurgeThreshold = 1024;
+
+	// The highest level we keep a ready made empty node for. This is the level of a max size board.
+	constexpr uint8 kMaxEmptyNodeLevel = 64;
+
+	// Identifies a node by its contents. Children are deduplicated too, so comparing them by pointer is enough.
+	struct FNodeKey
+	{
+		// The level of the node.
+		uint8 mLevel = 0;
+
+		// The node's children, indexed by ChildNode.
+		const QuadTreeNode* mChildren[ChildNode::kCount] = {};
+
+		bool operator==(const FNodeKey& Other) const
+		{
+			return (mLevel == Other.mLevel) &&
+				(mChildren[ChildNode::Northwest] == Other.mChildren[ChildNode::Northwest]) &&
+				(mChildren[ChildNode::Northeast] == Other.mChildren[ChildNode::Northeast]) &&
+				(mChildren[ChildNode::Southwest] == Other.mChildren[ChildNode::Southwest]) &&
+				(mChildren[ChildNode::Southeast] == Other.mChildren[ChildNode::Southeast]);
+		}
+	};
+
+	// Hash function for an FNodeKey
+	uint32 GetTypeHash(const FNodeKey& Key)
+	{
+		uint32 Hash = Key.mLevel;
+		for (const QuadTreeNode* Child : Key.mChildren)
+		{
+			Hash = HashCombine(Hash, PointerHash(Child));
+		}
+		return Hash;
+	}
+
+	// One shard of the table we deduplicate nodes with. Entries are weak, so the table never keeps a node alive by itself.
+	struct FNodeTableShard
+	{
+		// Guards everything in this shard.
+		FCriticalSection mLock;
+
+		// Every node in this shard, by contents. Entries for nodes that have died linger until the next sweep.
+		TMap<FNodeKey, TWeakPtr<const QuadTreeNode>> mNodes;
+
+		// The number of entries at which we next sweep out dead entries.
+		int32 mPurgeThreshold = kMinNodeTablePurgeThreshold;
+	};
+
+	// Identifies a result in the result cache. The same node evolves differently under different rules, so results are kept per rule.
+	struct FResultKey
+	{
+		// The node that was advanced.
+		const QuadTreeNode* mNode = nullptr;
+
+		// The rule it was advanced under. Rules are never destroyed, so the pointer is enough to identify one.
+		const FLifeRule* mRule = nullptr;
+
+		bool operator==(const FResultKey& Other) const
+		{
+			return (mNode == Other.mNode) && (mRule == Other.mRule);
+		}
+	};
+
+	// Hash function for an FResultKey
+	uint32 GetTypeHash(const FResultKey& Key)
+	{
+		return HashCombine(PointerHash(Key.mNode), PointerHash(Key.mRule));
+	}
+
+	// A node's next generation, as computed by GetNextGeneration.
+	struct FCachedResult
+	{
+		// The node the result belongs to. Holding on to it keeps its address from being reused by some other node while we're cached.
+		TSharedPtr<const QuadTreeNode> mNode;
+
+		// The centered child of mNode, advanced one generation.
+		TSharedPtr<const QuadTreeNode> mNextGeneration;
+	};
+
+	// One shard of the result cache.
+	struct FResultCacheShard
+	{
+		// Guards everything in this shard.
+		FCriticalSection mLock;
+
+		// Cached results, by node and rule.
+		TMap<FResultKey, FCachedResult> mResults;
+	};
+
+	// Returns the shards of the node table. Built on first use, so that it's ready no matter which static initializer needs a node first.
+	FNodeTableShard* GetNodeTable()
+	{
+		static FNodeTableShard NodeTable[kNumTableShards];
+		return NodeTable;
+	}
+
+	// Returns the shards of the result cache.
+	FResultCacheShard* GetResultCache()
+	{
+		static FResultCacheShard ResultCache[kNumTableShards];
+		return ResultCache;
+	}
+
+	// Held for reading by everything that looks nodes up in the node table or the result cache, and for writing by CompactNodes, which moves nodes out from under both.
+	FRWLock& GetNodeStoreLock()
+	{
+		static FRWLock NodeStoreLock;
+		return NodeStoreLock;
+	}
+
+	// How many FNodeStoreScopes the calling thread is inside, including the one of the thread that handed it its work.
+	int32& GetNodeStoreScopeDepth()
+	{
+		thread_local int32 Depth = 0;
+		return Depth;
+	}
+
+	// Keeps CompactNodes from running while it's in scope. Only the outermost scope on a thread takes the lock, so nodes looked up while simulating don't pay for it again.
+	class FNodeStoreScope
+	{
+	public:
+		// Work handed to another thread by one that's already in scope is covered by that thread's lock, and must not wait on it: a waiting CompactNodes would block the work, while CompactNodes waits on the thread that handed it off.
+		explicit FNodeStoreScope(const bool IsHandedOff = false) :
+			mHasLock(!IsHandedOff && GetNodeStoreScopeDepth() == 0)
+		{
+			if (mHasLock)
+			{
+				GetNodeStoreLock().ReadLock();
+			}
+
+			++GetNodeStoreScopeDepth();
+		}
+
+		~FNodeStoreScope()
+		{
+			--GetNodeStoreScopeDepth();
+
+			if (mHasLock)
+			{
+				GetNodeStoreLock().ReadUnlock();
+			}
+		}
+
+		FNodeStoreScope(const FNodeStoreScope&) = delete;
+		FNodeStoreScope& operator=(const FNodeStoreScope&) = delete;
+
+	private:
+		// Whether this scope took the lock, and has to let go of it.
+		const bool mHasLock;
+	};
+
+	// CompactNodes lays nodes out in chunks of this many bytes, aligned to their size so a node can find its chunk from its own address.
+	constexpr SIZE_T kNodeArenaChunkBytes = 64 * 1024;
+
+	// The header at the start of every arena chunk. The nodes follow it, starting on a cache line.
+	struct FNodeArenaChunk
+	{
+		// The number of nodes in this chunk that haven't died yet. The chunk is freed along with the last of them.
+		std::atomic<int32> mNumLiveNodes{0};
+	};
+
+	// How far apart nodes are in arena chunks and node slabs.
+	constexpr SIZE_T kNodeSlotBytes = Align(sizeof(QuadTreeNode), alignof(QuadTreeNode));
+
+	// The reference controller every node's shared pointer allocates: a vtable pointer, the shared and weak reference counts, and the pointer to the node. Our deleter has no state of its own.
+	constexpr SIZE_T kNodeReferenceControllerBytes = sizeof(void*) * 2 + sizeof(int32) * 2;
+
+	// Where the first node in a chunk goes.
+	constexpr SIZE_T kNodeArenaFirstSlotOffset = Align(sizeof(FNodeArenaChunk), PLATFORM_CACHE_LINE_SIZE);
+
+	// Returns the chunk Node was laid out in.
+	FNodeArenaChunk* GetNodeArenaChunk(const QuadTreeNode* Node)
+	{
+		return reinterpret_cast<FNodeArenaChunk*>(UPTRINT(Node) & ~UPTRINT(kNodeArenaChunkBytes - 1));
+	}
+
+	// Destroys a node that CompactNodes laid out in an arena chunk, freeing the chunk once nothing else in it is left.
+	struct FNodeArenaDeleter
+	{
+		void operator()(const QuadTreeNode* Node) const
+		{
+			FNodeArenaChunk* Chunk = GetNodeArenaChunk(Node);
+			Node->~QuadTreeNode();
+
+			if (Chunk->mNumLiveNodes.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				Chunk->~FNodeArenaChunk();
+				FMemory::Free(Chunk);
+			}
+		}
+	};
+
+	// CreateNodeWithSubnodes carves nodes out of slabs of this many bytes, aligned to their size so a slot can find its slab from its own address. The slots of nodes that die are reused for new ones,
+	// and slabs whose slots have all found their way back to the shared pool are freed by ReleaseEmptyNodeSlabs.
+	constexpr SIZE_T kNodeSlabBytes = 64 * 1024;
+
+	// The number of node slots in one slab.
+	constexpr int32 kNumSlotsPerNodeSlab = kNodeSlabBytes / kNodeSlotBytes;
+
+	// How many free slots move between a thread's cache and the shared pool at a time.
+	constexpr int32 kNodeSlotBatchSize = 256;
+
+	// The slot of a node that has died, linked into a free list through the memory the node used to take up.
+	struct FFreeNodeSlot
+	{
+		// The next free slot in the list.
+		FFreeNodeSlot* mNext = nullptr;
+	};
+
+	// A list of free slots, moved between a thread's cache and the shared pool as a whole.
+	struct FNodeSlotBatch
+	{
+		// The first slot in the list.
+		FFreeNodeSlot* mFirstSlot = nullptr;
+
+		// The number of slots in the list.
+		int32 mNumSlots = 0;
+	};
+
+	// The free slots no thread has claimed. Threads only come here once per batch, so its lock is rarely contended.
+	struct FNodeSlotPool
+	{
+		// Guards mBatches.
+		FCriticalSection mLock;
+
+		// Every batch of free slots handed back by a thread.
+		TArray<FNodeSlotBatch> mBatches;
+	};
+
+	// Returns the shared pool of free slots. It is never destroyed, since nodes held by other statics can die after it would have been.
+	FNodeSlotPool& GetNodeSlotPool()
+	{
+		static FNodeSlotPool* Pool = new FNodeSlotPool();
+		return *Pool;
+	}
+
+	// The free slots one thread allocates nodes from and frees them to. Only the owning thread touches it, so neither needs a lock until the cache runs dry or fills up.
+	struct FNodeSlotCache
+	{
+		// The free slots, most recently freed first.
+		FFreeNodeSlot* mFreeSlots = nullptr;
+
+		// The number of slots in mFreeSlots.
+		int32 mNumFreeSlots = 0;
+
+		// Whether the thread is exiting and has handed its slots back. From then on slots go straight back to the pool.
+		bool mIsReleased = false;
+	};
+
+	// Moves the first NumSlots slots of Cache into the shared pool as one batch.
+	void ReturnNodeSlots(FNodeSlotCache& Cache, const int32 NumSlots)
+	{
+		if (NumSlots <= 0)
+		{
+			return;
+		}
+
+		FNodeSlotBatch Batch;
+		Batch.mFirstSlot = Cache.mFreeSlots;
+		Batch.mNumSlots = NumSlots;
+
+		FFreeNodeSlot* LastSlot = Cache.mFreeSlots;
+		for (int32 SlotIndex = 1; SlotIndex < NumSlots; ++SlotIndex)
+		{
+			LastSlot = LastSlot->mNext;
+		}
+
+		Cache.mFreeSlots = LastSlot->mNext;
+		Cache.mNumFreeSlots -= NumSlots;
+		LastSlot->mNext = nullptr;
+
+		FNodeSlotPool& Pool = GetNodeSlotPool();
+		FScopeLock Lock(&Pool.mLock);
+		Pool.mBatches.Add(Batch);
+	}
+
+	// Hands a thread's free slots back to the pool as the thread exits, so they aren't lost along with it.
+	struct FNodeSlotCacheReleaser
+	{
+		// The cache to release.
+		FNodeSlotCache& mCache;
+
+		~FNodeSlotCacheReleaser()
+		{
+			ReturnNodeSlots(mCache, mCache.mNumFreeSlots);
+			mCache.mIsReleased = true;
+		}
+	};
+
+	// Returns the calling thread's slot cache.
+	FNodeSlotCache& GetNodeSlotCache()
+	{
+		// The cache itself is trivially destructible, so nodes that die while the thread's other thread locals are being destroyed can still use it.
+		thread_local FNodeSlotCache Cache;
+		thread_local FNodeSlotCacheReleaser Releaser{ Cache };
+		return Cache;
+	}
+
+	// Fills an empty cache with a batch from the pool, or with the slots of a new slab if the pool is empty too.
+	void RefillNodeSlotCache(FNodeSlotCache& Cache)
+	{
+		{
+			FNodeSlotPool& Pool = GetNodeSlotPool();
+			FScopeLock Lock(&Pool.mLock);
+			if (Pool.mBatches.Num() > 0)
+			{
+				const FNodeSlotBatch Batch = Pool.mBatches.Pop(false);
+				Cache.mFreeSlots = Batch.mFirstSlot;
+				Cache.mNumFreeSlots = Batch.mNumSlots;
+				return;
+			}
+		}
+
+		// Link the new slots up back to front, so nodes allocated one after another sit next to each other.
+		uint8* Slab = (uint8*)FMemory::Malloc(kNodeSlabBytes, kNodeSlabBytes);
+		for (SIZE_T SlotOffset = (kNumSlotsPerNodeSlab - 1) * kNodeSlotBytes; ; SlotOffset -= kNodeSlotBytes)
+		{
+			Cache.mFreeSlots = new (Slab + SlotOffset) FFreeNodeSlot{ Cache.mFreeSlots };
+			++Cache.mNumFreeSlots;
+
+			if (SlotOffset == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	// Returns uninitialized memory for one node from the calling thread's cache.
+	void* AllocateNodeSlot()
+	{
+		FNodeSlotCache& Cache = GetNodeSlotCache();
+		if (Cache.mFreeSlots == nullptr)
+		{
+			RefillNodeSlotCache(Cache);
+		}
+
+		FFreeNodeSlot* Slot = Cache.mFreeSlots;
+		Cache.mFreeSlots = Slot->mNext;
+		--Cache.mNumFreeSlots;
+
+		if (Cache.mIsReleased)
+		{
+			ReturnNodeSlots(Cache, Cache.mNumFreeSlots);
+		}
+
+		return Slot;
+	}
+
+	// Puts the slot of a node that has died in the calling thread's cache, handing a batch back to the pool once the cache holds two batches' worth.
+	void FreeNodeSlot(void* Memory)
+	{
+		FNodeSlotCache& Cache = GetNodeSlotCache();
+		Cache.mFreeSlots = new (Memory) FFreeNodeSlot{ Cache.mFreeSlots };
+		++Cache.mNumFreeSlots;
+
+		if (Cache.mIsReleased)
+		{
+			ReturnNodeSlots(Cache, Cache.mNumFreeSlots);
+		}
+		else if (Cache.mNumFreeSlots >= 2 * kNodeSlotBatchSize)
+		{
+			ReturnNodeSlots(Cache, kNodeSlotBatchSize);
+		}
+	}
+
+	// Frees every slab whose slots are all sitting in the shared pool, and returns how many bytes that gave back. Slots in threads' own caches are out of sight, so their slabs are kept.
+	// Every pooled slot is walked with the pool locked, so this is meant to follow something that frees a lot of nodes at once, like CompactNodes, rather than to run all the time.
+	int64 ReleaseEmptyNodeSlabs()
+	{
+		auto GetSlab = [](const FFreeNodeSlot* Slot)
+		{
+			return reinterpret_cast<uint8*>(UPTRINT(Slot) & ~UPTRINT(kNodeSlabBytes - 1));
+		};
+
+		FNodeSlotPool& Pool = GetNodeSlotPool();
+		FScopeLock Lock(&Pool.mLock);
+
+		TMap<uint8*, int32> NumFreeSlotsBySlab;
+		for (const FNodeSlotBatch& Batch : Pool.mBatches)
+		{
+			for (const FFreeNodeSlot* Slot = Batch.mFirstSlot; Slot != nullptr; Slot = Slot->mNext)
+			{
+				++NumFreeSlotsBySlab.FindOrAdd(GetSlab(Slot));
+			}
+		}
+
+		TSet<uint8*> EmptySlabs;
+		for (const TPair<uint8*, int32>& Slab : NumFreeSlotsBySlab)
+		{
+			if (Slab.Value == kNumSlotsPerNodeSlab)
+			{
+				EmptySlabs.Add(Slab.Key);
+			}
+		}
+
+		if (EmptySlabs.Num() == 0)
+		{
+			return 0;
+		}
+
+		// Batch the slots that are staying back up, leaving out those of the slabs we're about to free.
+		TArray<FNodeSlotBatch> RemainingBatches;
+		FNodeSlotBatch RemainingBatch;
+		for (const FNodeSlotBatch& Batch : Pool.mBatches)
+		{
+			FFreeNodeSlot* NextSlot = nullptr;
+			for (FFreeNodeSlot* Slot = Batch.mFirstSlot; Slot != nullptr; Slot = NextSlot)
+			{
+				NextSlot = Slot->mNext;
+				if (EmptySlabs.Contains(GetSlab(Slot)))
+				{
+					continue;
+				}
+
+				Slot->mNext = RemainingBatch.mFirstSlot;
+				RemainingBatch.mFirstSlot = Slot;
+				if (++RemainingBatch.mNumSlots == kNodeSlotBatchSize)
+				{
+					RemainingBatches.Add(RemainingBatch);
+					RemainingBatch = FNodeSlotBatch();
+				}
+			}
+		}
+
+		if (RemainingBatch.mNumSlots > 0)
+		{
+			RemainingBatches.Add(RemainingBatch);
+		}
+
+		Pool.mBatches = MoveTemp(RemainingBatches);
+
+		for (uint8* Slab : EmptySlabs)
+		{
+			FMemory::Free(Slab);
+		}
+
+		return (int64)EmptySlabs.Num() * kNodeSlabBytes;
+	}
+
+	// Destroys a node allocated by AllocateNodeSlot and frees its slot.
+	struct FNodeSlotDeleter
+	{
+		void operator()(const QuadTreeNode* Node) const
+		{
+			Node->~QuadTreeNode();
+			FreeNodeSlot(const_cast<QuadTreeNode*>(Node));
+		}
+	};
+
+	// Simulation counters for one thread. Only the owning thread writes to them, which spares the hot path any atomic read-modify-writes, but any thread can read them.
+	struct FThreadSimulationCounters
+	{
+		std::atomic<uint64> mNodesCreated{0};
+		std::atomic<uint64> mResultCacheHits{0};
+		std::atomic<uint64> mResultCacheMisses{0};
+		std::atomic<uint64> mPersistentCacheHits{0};
+		std::atomic<uint64> mBaseCaseInvocations{0};
+		std::atomic<uint64> mParallelTasks{0};
+		std::atomic<uint8> mLowestLevelReached{UINT8_MAX};
+	};
+
+	// Every thread's simulation counters. Counters are never freed, so the work of threads that have exited still counts towards the totals.
+	struct FSimulationCounterRegistry
+	{
+		// Guards mThreadCounters.
+		FCriticalSection mLock;
+
+		// One set of counters for each thread that has done any simulation work.
+		TArray<TUniquePtr<FThreadSimulationCounters>> mThreadCounters;
+	};
+
+	// Returns the registry of every thread's counters.
+	FSimulationCounterRegistry& GetSimulationCounterRegistry()
+	{
+		static FSimulationCounterRegistry Registry;
+		return Registry;
+	}
+
+	// Returns the calling thread's counters, registering them the first time the thread asks.
+	FThreadSimulationCounters& GetThreadSimulationCounters()
+	{
+		thread_local FThreadSimulationCounters* ThreadCounters = nullptr;
+
+		if (ThreadCounters == nullptr)
+		{
+			FSimulationCounterRegistry& Registry = GetSimulationCounterRegistry();
+			FScopeLock Lock(&Registry.mLock);
+			ThreadCounters = Registry.mThreadCounters.Add_GetRef(MakeUnique<FThreadSimulationCounters>()).Get();
+		}
+
+		return *ThreadCounters;
+	}
+
+	// Returns the stats the calling thread's work is being gathered into by an FQuadTreeSimulationStatsScope, or nullptr if none are.
+	FQuadTreeSimulationStats*& GetScopedSimulationStats()
+	{
+		thread_local FQuadTreeSimulationStats* ScopedStats = nullptr;
+		return ScopedStats;
+	}
+
+	// The bases for the translation hash, one for each axis. Any odd constants work, as long as they stay the same.
+	constexpr uint64 kTranslationHashBaseX = 0x9E3779B97F4A7C15ull;
+	constexpr uint64 kTranslationHashBaseY = 0xC2B2AE3D27D4EB4Full;
+
+	// Mixes Value into Hash. Used to build node hashes out of child hashes.
+	uint64 CombineNodeHash(uint64 Hash, const uint64 Value)
+	{
+		// The finalizer from SplitMix64.
+		Hash += Value + 0x9E3779B97F4A7C15ull;
+		Hash = (Hash ^ (Hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+		Hash = (Hash ^ (Hash >> 27)) * 0x94D049BB133111EBull;
+		return Hash ^ (Hash >> 31);
+	}
+
+	// Returns Base raised to Exponent, modulo 2^64.
+	uint64 PowerModulo64(uint64 Base, uint64 Exponent)
+	{
+		uint64 Result = 1;
+		while (Exponent > 0)
+		{
+			if (Exponent & 0x1)
+			{
+				Result *= Base;
+			}
+
+			Base *= Base;
+			Exponent >>= 1;
+		}
+
+		return Result;
+	}
+
+	// Returns the number that Value multiplies with to give 1, modulo 2^64. Value must be odd.
+	uint64 InverseModulo64(const uint64 Value)
+	{
+		// Newton's method doubles the number of correct low bits with every iteration, and Value is already correct to three bits.
+		uint64 Result = Value;
+		for (int32 Iteration = 0; Iteration < 5; ++Iteration)
+		{
+			Result *= 2 - Value * Result;
+		}
+
+		return Result;
+	}
+
+	// Returns the translation hash bases raised to the child offset of a node at Level, i.e. 2^(Level - 1).
+	void GetTranslationHashChildMultipliers(const uint8 Level, uint64& MultiplierXOut, uint64& MultiplierYOut)
+	{
+		// There are only 64 levels, so work every multiplier out once.
+		static const TArray<uint64> MultipliersX = []()
+		{
+			TArray<uint64> Result;
+			for (uint64 Multiplier = kTranslationHashBaseX, Shift = 0; Shift < 64; Multiplier *= Multiplier, ++Shift)
+			{
+				Result.Add(Multiplier);
+			}
+			return Result;
+		}();
+
+		static const TArray<uint64> MultipliersY = []()
+		{
+			TArray<uint64> Result;
+			for (uint64 Multiplier = kTranslationHashBaseY, Shift = 0; Shift < 64; Multiplier *= Multiplier, ++Shift)
+			{
+				Result.Add(Multiplier);
+			}
+			return Result;
+		}();
+
+		MultiplierXOut = MultipliersX[Level - 1];
+		MultiplierYOut = MultipliersY[Level - 1];
+	}
+
+	// Returns the cells of two 8x8 blocks, as returned by QuadTreeNode::GetBlockBitmap, combined by Operation.
+	uint64 CombineBlockBitmaps(const uint64 A, const uint64 B, const EBoardOperation Operation)
+	{
+		switch (Operation)
+		{
+		case EBoardOperation::Union:
+			return A | B;
+		case EBoardOperation::Intersection:
+			return A & B;
+		case EBoardOperation::Difference:
+			return A & ~B;
+		case EBoardOperation::SymmetricDifference:
+			return A ^ B;
+		default:
+			UE_LOG(LogTemp, Warning, TEXT("Attempted to combine blocks with some unknown EBoardOperation. Did we forget to add a case?"));
+			return A;
+		}
+	}
+
+	// Moves the cell at X, Y of a Dimension by Dimension square to where Symmetry takes it: mirrored east to west first if Symmetry mirrors, then turned counterclockwise a quarter turn at a time.
+	void TransformLocalCell(const EBoardSymmetry Symmetry, const int32 Dimension, int32& X, int32& Y)
+	{
+		if ((uint8)Symmetry >= (uint8)EBoardSymmetry::Mirror)
+		{
+			X = Dimension - 1 - X;
+		}
+
+		for (int32 Turn = 0; Turn < (uint8)Symmetry % 4; ++Turn)
+		{
+			const int32 OldX = X;
+			X = Dimension - 1 - Y;
+			Y = OldX;
+		}
+	}
+
+	// Returns the cells of an 8x8 block, as returned by QuadTreeNode::GetBlockBitmap, turned and mirrored by Symmetry.
+	uint64 TransformBlockBitmap(const uint64 Bitmap, const EBoardSymmetry Symmetry)
+	{
+		uint64 Result = 0;
+		for (uint64 Remaining = Bitmap; Remaining != 0; Remaining &= Remaining - 1)
+		{
+			const int32 Bit = (int32)FMath::CountTrailingZeros64(Remaining);
+			int32 X = Bit % 8;
+			int32 Y = Bit / 8;
+			TransformLocalCell(Symmetry, 8, X, Y);
+			Result |= uint64(1) << (Y * 8 + X);
+		}
+
+		return Result;
+	}
+
+	// Adds Amount to one of the calling thread's counters, and to the matching counter of the stats being gathered on this thread, if there are any.
+	void IncrementCounter(std::atomic<uint64>& Counter, uint64 FQuadTreeSimulationStats::* ScopedCounter, const uint64 Amount = 1)
+	{
+		Counter.store(Counter.load(std::memory_order_relaxed) + Amount, std::memory_order_relaxed);
+
+		if (FQuadTreeSimulationStats* ScopedStats = GetScopedSimulationStats())
+		{
+			ScopedStats->*ScopedCounter += Amount;
+		}
+	}
+
+	// Returns the 2x2 node whose cells are the low four bits of Cells, northwest first. There are only sixteen, so there's no need to look them up in the node table every time.
+	const TSharedPtr<const QuadTreeNode>& GetTwoByTwoNode(const uint8 Cells)
+	{
+		static const TArray<TSharedPtr<const QuadTreeNode>> TwoByTwoNodes = []()
+		{
+			TArray<TSharedPtr<const QuadTreeNode>> Result;
+			for (uint8 NodeCells = 0; NodeCells < 16; ++NodeCells)
+			{
+				Result.Add(QuadTreeNode::CreateNodeWithSubnodes(1, QuadTreeNode::CreateLeaf(NodeCells & 0x8), QuadTreeNode::CreateLeaf(NodeCells & 0x4), QuadTreeNode::CreateLeaf(NodeCells & 0x2), QuadTreeNode::CreateLeaf(NodeCells & 0x1)));
+			}
+			return Result;
+		}();
+
+		return TwoByTwoNodes[Cells & 0xf];
+	}
+}
+
+FQuadTreeSimulationStats FQuadTreeSimulationStats::operator-(const FQuadTreeSimulationStats& Earlier) const
+{
+	FQuadTreeSimulationStats Result = *this;
+	Result.mNodesCreated -= Earlier.mNodesCreated;
+	Result.mResultCacheHits -= Earlier.mResultCacheHits;
+	Result.mResultCacheMisses -= Earlier.mResultCacheMisses;
+	Result.mPersistentCacheHits -= Earlier.mPersistentCacheHits;
+	Result.mBaseCaseInvocations -= Earlier.mBaseCaseInvocations;
+	Result.mParallelTasks -= Earlier.mParallelTasks;
+	return Result;
+}
+
+FQuadTreeSimulationStats& FQuadTreeSimulationStats::operator+=(const FQuadTreeSimulationStats& Other)
+{
+	mNodesCreated += Other.mNodesCreated;
+	mResultCacheHits += Other.mResultCacheHits;
+	mResultCacheMisses += Other.mResultCacheMisses;
+	mPersistentCacheHits += Other.mPersistentCacheHits;
+	mBaseCaseInvocations += Other.mBaseCaseInvocations;
+	mParallelTasks += Other.mParallelTasks;
+	mLowestLevelReached = FMath::Min(mLowestLevelReached, Other.mLowestLevelReached);
+	return *this;
+}
+
+FQuadTreeSimulationStatsScope::FQuadTreeSimulationStatsScope(FQuadTreeSimulationStats* StatsOut)
+	: mPreviousStats(GetScopedSimulationStats())
+{
+	GetScopedSimulationStats() = StatsOut;
+}
+
+FQuadTreeSimulationStatsScope::~FQuadTreeSimulationStatsScope()
+{
+	GetScopedSimulationStats() = mPreviousStats;
+}
+
+FQuadTreeSimulationStats* FQuadTreeSimulationStatsScope::GetCurrentStats()
+{
+	return GetScopedSimulationStats();
+}
+
+// By default, every level of the recursion is split across threads.
+int32 QuadTreeNode::sMaxParallelDepth = MAX_int32;
+
+// By default, cache about a million results.
+std::atomic<int64> QuadTreeNode::sMaxCachedResults(1 << 20);
+
+// There's no persistent result cache until one is asked for.
+TUniquePtr<FPersistentResultCache> QuadTreeNode::sPersistentResultCache;
+
+// Node counts. These are constant initialized, so they are ready before our canonical leaves below are created.
+std::atomic<int64> QuadTreeNode::sLiveNodeCount(0);
+std::atomic<int64> QuadTreeNode::sPeakLiveNodeCount(0);
+
 // Initialization for our canonical leaf nodes. Having canonical versions of these will cut down on memory requirements.
 TSharedPtr<const QuadTreeNode> QuadTreeNode::sCanonicalLiveCell = MakeShareable<QuadTreeNode>(new QuadTreeNode(true));
 TSharedPtr<const QuadTreeNode> QuadTreeNode::sCanonicalDeadCell = MakeShareable<QuadTreeNode>(new QuadTreeNode(false));
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateLeaf(bool IsAlive)
+TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateLeaf(bool IsAlive)
+{
+	// Return our canonical leaves instead of creating new ones.
+	if (IsAlive)
+	{
+		return sCanonicalLiveCell;
+	}
+
+	return sCanonicalDeadCell;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateBlockFromBitmap(const uint64 Bitmap)
+{
+	if (Bitmap == 0)
+	{
+		return CreateEmptyNode(kBlockLevel);
+	}
+
+	// Returns the 2x2 node whose southwest cell is at X and Y.
+	auto GetTwoByTwoNodeAt = [Bitmap](const int32 X, const int32 Y)
+	{
+		const uint64 SouthRow = Bitmap >> (Y * 8 + X);
+		const uint64 NorthRow = Bitmap >> ((Y + 1) * 8 + X);
+		return GetTwoByTwoNode((uint8)(((NorthRow & 0x1) << 3) | (((NorthRow >> 1) & 0x1) << 2) | ((SouthRow & 0x1) << 1) | ((SouthRow >> 1) & 0x1)));
+	};
+
+	// Returns the 4x4 node whose southwest cell is at X and Y.
+	auto GetFourByFourNode = [&GetTwoByTwoNodeAt](const int32 X, const int32 Y)
+	{
+		return CreateNodeWithSubnodes(2, GetTwoByTwoNodeAt(X, Y + 2), GetTwoByTwoNodeAt(X + 2, Y + 2), GetTwoByTwoNodeAt(X, Y), GetTwoByTwoNodeAt(X + 2, Y));
+	};
+
+	return CreateNodeWithSubnodes(kBlockLevel, GetFourByFourNode(0, 4), GetFourByFourNode(4, 4), GetFourByFourNode(0, 0), GetFourByFourNode(4, 0));
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateNodeWithSubnodes(const uint8 Level, const TSharedPtr<const QuadTreeNode> Northwest, const TSharedPtr<const QuadTreeNode> Northeast, const TSharedPtr<const QuadTreeNode> Southwest, const TSharedPtr<const QuadTreeNode> Southeast)
+{
+#if !UE_BUILD_SHIPPING
+	if (!Northwest.IsValid() || !Northeast.IsValid() || !Southwest.IsValid() || !Southeast.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to create a node with some non-valid subnode."));
+		return nullptr;
+	}
+
+	if (Northwest->mLevel != Level - 1 || Northeast->mLevel != Level - 1 || Southwest->mLevel != Level - 1 || Southeast->mLevel != Level - 1)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to create a node with subnodes that are not at the correct level."));
+		return nullptr;
+	}
+
+	if (Level == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("We're trying to construct a node with subnodes at level 0, this is not supported."));
+		return nullptr;
+	}
+#endif
+
+	FNodeKey Key;
+	Key.mLevel = Level;
+	Key.mChildren[ChildNode::Northwest] = Northwest.Get();
+	Key.mChildren[ChildNode::Northeast] = Northeast.Get();
+	Key.mChildren[ChildNode::Southwest] = Southwest.Get();
+	Key.mChildren[ChildNode::Southeast] = Southeast.Get();
+
+	FNodeStoreScope NodeStoreScope;
+	FNodeTableShard& Shard = GetNodeTable()[GetTypeHash(Key) % kNumTableShards];
+	FScopeLock Lock(&Shard.mLock);
+
+	// If this node already exists, hand back the existing one instead of making a copy.
+	TWeakPtr<const QuadTreeNode>& ExistingNode = Shard.mNodes.FindOrAdd(Key);
+	if (TSharedPtr<const QuadTreeNode> PinnedNode = ExistingNode.Pin())
+	{
+		return PinnedNode;
+	}
+
+	// Nodes come out of the calling thread's own slot cache, so threads building nodes at once don't queue up on the heap.
+	TSharedPtr<const QuadTreeNode> NewNode = MakeShareable<const QuadTreeNode>(new (AllocateNodeSlot()) QuadTreeNode(Level, Northwest, Northeast, Southwest, Southeast), FNodeSlotDeleter());
+	ExistingNode = NewNode;
+
+	// Nodes that die leave their entries behind, so sweep those out whenever the shard has doubled in size since the last sweep.
+	if (Shard.mNodes.Num() > Shard.mPurgeThreshold)
+	{
+		for (auto Iter = Shard.mNodes.CreateIterator(); Iter; ++Iter)
+		{
+			if (!Iter.Value().IsValid())
+			{
+				Iter.RemoveCurrent();
+			}
+		}
+
+		Shard.mPurgeThreshold = FMath::Max(Shard.mNodes.Num() * 2, kMinNodeTablePurgeThreshold);
+	}
+
+	return NewNode;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateEmptyNode(const uint8 NumLevels)
+{
+	// Empty nodes are needed constantly while simulating, so keep one of every level around.
+	static const TArray<TSharedPtr<const QuadTreeNode>> EmptyNodes = []()
+	{
+		TArray<TSharedPtr<const QuadTreeNode>> Result;
+		Result.Add(CreateLeaf(false));
+
+		for (uint8 Level = 1; Level <= kMaxEmptyNodeLevel; ++Level)
+		{
+			Result.Add(CreateNodeWithSubnodes(Level, Result.Last(), Result.Last(), Result.Last(), Result.Last()));
+		}
+
+		return Result;
+	}();
+
+	if (NumLevels < EmptyNodes.Num())
+	{
+		return EmptyNodes[NumLevels];
+	}
+
+	TSharedPtr<const QuadTreeNode> EmptyChild = CreateEmptyNode(NumLevels - 1);
+
+	return CreateNodeWithSubnodes(NumLevels, EmptyChild, EmptyChild, EmptyChild, EmptyChild);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::SetCellsToAlive(const TSharedPtr<const QuadTreeNode> Node, TArrayView<FBoardCoordinate> LocalCoordinates)
 {
-	// Return our canonical leaves instead of creating new ones.
-	if (IsAlive)
+	if (LocalCoordinates.Num() == 0)
 	{
-		return sCanonicalLiveCell;
+		return Node;
+	}
+	else if (Node->IsLeaf())
+	{
+		return CreateLeaf(true);
 	}
 
-	return sCanonicalDeadCell;
+	const uint64 ChildNodeDimension = uint64(1) << (Node->mLevel - 1);
+
+	// Moves every coordinate matching Predicate to the front of Coordinates, and returns how many there were.
+	auto PartitionCoordinates = [](TArrayView<FBoardCoordinate> Coordinates, TFunctionRef<bool(const FBoardCoordinate&)> Predicate)
+	{
+		int32 NumMatching = 0;
+		for (int32 Index = 0; Index < Coordinates.Num(); ++Index)
+		{
+			if (Predicate(Coordinates[Index]))
+			{
+				Swap(Coordinates[Index], Coordinates[NumMatching]);
+				++NumMatching;
+			}
+		}
+		return NumMatching;
+	};
+
+	// Split our coordinates into southern and northern halves, then split each half into western and eastern quadrants.
+	const int32 NumSouthern = PartitionCoordinates(LocalCoordinates, [ChildNodeDimension](const FBoardCoordinate& Coordinate) { return Coordinate.mY < ChildNodeDimension; });
+	TArrayView<FBoardCoordinate> SouthernCoordinates = LocalCoordinates.Slice(0, NumSouthern);
+	TArrayView<FBoardCoordinate> NorthernCoordinates = LocalCoordinates.Slice(NumSouthern, LocalCoordinates.Num() - NumSouthern);
+
+	auto IsWestern = [ChildNodeDimension](const FBoardCoordinate& Coordinate) { return Coordinate.mX < ChildNodeDimension; };
+	const int32 NumSouthwestern = PartitionCoordinates(SouthernCoordinates, IsWestern);
+	const int32 NumNorthwestern = PartitionCoordinates(NorthernCoordinates, IsWestern);
+
+	// Make every coordinate local to the child that contains it.
+	for (FBoardCoordinate& Coordinate : LocalCoordinates)
+	{
+		Coordinate.SetXAndY(Coordinate.mX % ChildNodeDimension, Coordinate.mY % ChildNodeDimension);
+	}
+
+	return CreateNodeWithSubnodes(Node->mLevel,
+		SetCellsToAlive(Node->Northwest(), NorthernCoordinates.Slice(0, NumNorthwestern)),
+		SetCellsToAlive(Node->Northeast(), NorthernCoordinates.Slice(NumNorthwestern, NorthernCoordinates.Num() - NumNorthwestern)),
+		SetCellsToAlive(Node->Southwest(), SouthernCoordinates.Slice(0, NumSouthwestern)),
+		SetCellsToAlive(Node->Southeast(), SouthernCoordinates.Slice(NumSouthwestern, SouthernCoordinates.Num() - NumSouthwestern)));
 }
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateNodeWithSubnodes(const uint8 Level, const TSharedPtr<const QuadTreeNode> Northwest, const TSharedPtr<const QuadTreeNode> Northeast, const TSharedPtr<const QuadTreeNode> Southwest, const TSharedPtr<const QuadTreeNode> Southeast)
+void QuadTreeNode::SetMaxSimulationThreads(const int32 NumThreads)
 {
-#if !UE_BUILD_SHIPPING
-	if (!Northwest.IsValid() || !Northeast.IsValid() || !Southwest.IsValid() || !Southeast.IsValid())
+	if (NumThreads <= 0)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Attempting to create a node with some non-valid subnode."));
-		return nullptr;
+		sMaxParallelDepth = MAX_int32;
+		return;
 	}
 
-	if (Northwest->mLevel != Level - 1 || Northeast->mLevel != Level - 1 || Southwest->mLevel != Level - 1 || Southeast->mLevel != Level - 1)
+	// Every parallel level of the recursion splits into four tasks, so split just enough levels to give every thread some work.
+	sMaxParallelDepth = 0;
+	for (int64 NumTasks = 1; NumTasks < NumThreads; NumTasks *= ChildNode::kCount)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Attempting to create a node with subnodes that are not at the correct level."));
-		return nullptr;
+		++sMaxParallelDepth;
 	}
+}
 
-	if (Level == 0)
+int32 QuadTreeNode::GetMaxParallelDepth()
+{
+	return sMaxParallelDepth;
+}
+
+int64 QuadTreeNode::GetLiveNodeCount()
+{
+	return sLiveNodeCount;
+}
+
+int64 QuadTreeNode::GetPeakLiveNodeCount()
+{
+	return sPeakLiveNodeCount;
+}
+
+void QuadTreeNode::ResetPeakLiveNodeCount()
+{
+	sPeakLiveNodeCount = sLiveNodeCount.load();
+}
+
+SIZE_T QuadTreeNode::GetBytesPerNode()
+{
+	return kNodeSlotBytes + kNodeReferenceControllerBytes;
+}
+
+void* QuadTreeNode::AllocateNodeMemory()
+{
+	return AllocateNodeSlot();
+}
+
+void QuadTreeNode::FreeNodeMemory(void* Memory)
+{
+	FreeNodeSlot(Memory);
+}
+
+void QuadTreeNode::TrackNodeCreated()
+{
+	const int64 NewLiveNodeCount = ++sLiveNodeCount;
+
+	int64 PeakLiveNodeCount = sPeakLiveNodeCount;
+	while (NewLiveNodeCount > PeakLiveNodeCount && !sPeakLiveNodeCount.compare_exchange_weak(PeakLiveNodeCount, NewLiveNodeCount))
 	{
-		UE_LOG(LogTemp, Warning, TEXT("We're trying to construct a node with subnodes at level 0, this is not supported."));
-		return nullptr;
 	}
-#endif
 
-	return MakeShareable<QuadTreeNode>(new QuadTreeNode(Level, Northwest, Northeast, Southwest, Southeast));
+	IncrementCounter(GetThreadSimulationCounters().mNodesCreated, &FQuadTreeSimulationStats::mNodesCreated);
 }
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::CreateEmptyNode(const uint8 NumLevels)
+FQuadTreeSimulationStats QuadTreeNode::GetSimulationStats()
 {
-	if (NumLevels == 0)
+	FQuadTreeSimulationStats Result;
+
+	FSimulationCounterRegistry& Registry = GetSimulationCounterRegistry();
+	FScopeLock Lock(&Registry.mLock);
+
+	for (const TUniquePtr<FThreadSimulationCounters>& ThreadCounters : Registry.mThreadCounters)
 	{
-		return CreateLeaf(false);
+		Result.mNodesCreated += ThreadCounters->mNodesCreated.load(std::memory_order_relaxed);
+		Result.mResultCacheHits += ThreadCounters->mResultCacheHits.load(std::memory_order_relaxed);
+		Result.mResultCacheMisses += ThreadCounters->mResultCacheMisses.load(std::memory_order_relaxed);
+		Result.mPersistentCacheHits += ThreadCounters->mPersistentCacheHits.load(std::memory_order_relaxed);
+		Result.mBaseCaseInvocations += ThreadCounters->mBaseCaseInvocations.load(std::memory_order_relaxed);
+		Result.mParallelTasks += ThreadCounters->mParallelTasks.load(std::memory_order_relaxed);
+		Result.mLowestLevelReached = FMath::Min(Result.mLowestLevelReached, ThreadCounters->mLowestLevelReached.load(std::memory_order_relaxed));
 	}
 
-	TSharedPtr<const QuadTreeNode> EmptyChild = CreateEmptyNode(NumLevels - 1);
+	return Result;
+}
 
-	return CreateNodeWithSubnodes(NumLevels, EmptyChild, EmptyChild, EmptyChild, EmptyChild);
+void QuadTreeNode::ResetLowestLevelReached()
+{
+	FSimulationCounterRegistry& Registry = GetSimulationCounterRegistry();
+	FScopeLock Lock(&Registry.mLock);
+
+	for (const TUniquePtr<FThreadSimulationCounters>& ThreadCounters : Registry.mThreadCounters)
+	{
+		ThreadCounters->mLowestLevelReached.store(UINT8_MAX, std::memory_order_relaxed);
+	}
+}
+
+int64 QuadTreeNode::GetCachedResultCount()
+{
+	int64 Result = 0;
+
+	FResultCacheShard* ResultCache = GetResultCache();
+	for (int32 ShardIndex = 0; ShardIndex < kNumTableShards; ++ShardIndex)
+	{
+		FScopeLock Lock(&ResultCache[ShardIndex].mLock);
+		Result += ResultCache[ShardIndex].mResults.Num();
+	}
+
+	return Result;
+}
+
+void QuadTreeNode::SetMaxCachedResults(const int64 MaxCachedResults)
+{
+	sMaxCachedResults = FMath::Max<int64>(MaxCachedResults, kNumTableShards);
+}
+
+void QuadTreeNode::ClearResultCache()
+{
+	FNodeStoreScope NodeStoreScope;
+	FResultCacheShard* ResultCache = GetResultCache();
+	for (int32 ShardIndex = 0; ShardIndex < kNumTableShards; ++ShardIndex)
+	{
+		// Releasing the nodes can take a while, so do it after letting go of the lock.
+		TMap<FResultKey, FCachedResult> EvictedResults;
+		{
+			FScopeLock Lock(&ResultCache[ShardIndex].mLock);
+			EvictedResults = MoveTemp(ResultCache[ShardIndex].mResults);
+		}
+	}
 }
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::GetNextGenerationCellFromNeighborhood(uint16 NeighborhoodBitset)
+bool QuadTreeNode::SetPersistentResultCache(const FString& Filename, const int64 MaxFileBytes)
 {
-	if (NeighborhoodBitset == 0)
+	// Close the old file first, so that reopening the same file sees everything written to it.
+	sPersistentResultCache.Reset();
+
+	if (Filename.IsEmpty())
 	{
-		return CreateLeaf(false);
+		return true;
 	}
 
-	const bool IsCurrentCellAlive = (NeighborhoodBitset >> 5) & 0x1;
+	sPersistentResultCache = FPersistentResultCache::Open(Filename, MaxFileBytes);
+	return sPersistentResultCache.IsValid();
+}
+
+FPersistentResultCache* QuadTreeNode::GetPersistentResultCache()
+{
+	return sPersistentResultCache.Get();
+}
+
+FQuadTreeCompactionStats QuadTreeNode::CompactNodes(TArrayView<TSharedPtr<const QuadTreeNode>* const> RootNodes)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::CompactNodes);
+
+	const double StartTime = FPlatformTime::Seconds();
+	FQuadTreeCompactionStats Stats;
+
+	// Wait for every other board to finish what it's doing with nodes, and keep them from starting anything new until we're done. Until then nobody else can look up, cache or take a new reference to a node we might move.
+	FRWScopeLock NodeStoreLock(GetNodeStoreLock(), SLT_Write);
+
+	// What we know about one node below the roots.
+	struct FCompactionEntry
+	{
+		// One of the shared pointers to the node, to read its reference count from.
+		const TSharedPtr<const QuadTreeNode>* mReference = nullptr;
+
+		// The number of references to the node we can update: from roots, from the result cache, and from parents that are moving too.
+		int32 mKnownReferences = 0;
 
-	// Mask off bits outside the neighborhood, and the cell itself.
-	const uint16 Bitmask = 0x757;
-	NeighborhoodBitset &= Bitmask;
+		// Whether the node is being moved, and where to.
+		bool mIsMoving = false;
+		void* mNewAddress = nullptr;
 
-	// Count the number of 1s in the neighborhood bitset. These represent our live neighbors.
-	uint8 NeighborCount = 0;
+		// The moved copy, once it's built.
+		TSharedPtr<const QuadTreeNode> mNewNode;
+	};
 
-	while (NeighborhoodBitset > 0)
+	TMap<const QuadTreeNode*, FCompactionEntry> Entries;
+	TArray<const QuadTreeNode*> Nodes;
+
+	// The nodes the result cache holds are built out of the same nodes as the boards, so they're walked and moved too, after the roots. Otherwise the cache would keep most of every board where it is.
+	// We hold the node store lock, so the cache won't change under us until we swap it over at the end.
+	FResultCacheShard* ResultCache = GetResultCache();
+	TArray<const TSharedPtr<const QuadTreeNode>*> CachedNodes;
+	for (int32 ShardIndex = 0; ShardIndex < kNumTableShards; ++ShardIndex)
 	{
-		++NeighborCount;
-		NeighborhoodBitset &= (NeighborhoodBitset - 1);
+		FScopeLock Lock(&ResultCache[ShardIndex].mLock);
+		for (const TPair<FResultKey, FCachedResult>& Result : ResultCache[ShardIndex].mResults)
+		{
+			CachedNodes.Add(&Result.Value.mNextGeneration);
+			CachedNodes.Add(&Result.Value.mNode);
+		}
 	}
 
-	// Apply our Game of Life rules.
-	if (NeighborCount == 3 || (IsCurrentCellAlive && NeighborCount == 2))
+	// Find every node below the roots and the cache. Leaves and empty nodes are shared by everything and kept alive by their own caches, so they stay where they are.
+	Entries.Reserve(GetLiveNodeCount());
+	Nodes.Reserve(GetLiveNodeCount());
+
+	TArray<const TSharedPtr<const QuadTreeNode>*> NodesToVisit;
+	for (int32 CachedNodeIndex = CachedNodes.Num() - 1; CachedNodeIndex >= 0; --CachedNodeIndex)
 	{
-		return CreateLeaf(true);
+		NodesToVisit.Add(CachedNodes[CachedNodeIndex]);
+	}
+
+	for (int32 RootIndex = RootNodes.Num() - 1; RootIndex >= 0; --RootIndex)
+	{
+		if (RootNodes[RootIndex]->IsValid())
+		{
+			NodesToVisit.Add(RootNodes[RootIndex]);
+		}
+	}
+
+	while (NodesToVisit.Num() > 0)
+	{
+		const TSharedPtr<const QuadTreeNode>* Reference = NodesToVisit.Pop(false);
+		const QuadTreeNode* Node = Reference->Get();
+
+		if (Node->mLevel == 0 || !Node->IsAlive() || Entries.Contains(Node))
+		{
+			continue;
+		}
+
+		Entries.Add(Node).mReference = Reference;
+		Nodes.Add(Node);
+
+		for (const TSharedPtr<const QuadTreeNode>& Child : Node->mChildren)
+		{
+			NodesToVisit.Add(&Child);
+		}
+	}
+
+	// Count the references we can update. Parents only count once we know they're moving, below.
+	for (TSharedPtr<const QuadTreeNode>* RootNode : RootNodes)
+	{
+		if (FCompactionEntry* Entry = Entries.Find(RootNode->Get()))
+		{
+			++Entry->mKnownReferences;
+		}
+	}
+
+	for (const TSharedPtr<const QuadTreeNode>* CachedNode : CachedNodes)
+	{
+		if (FCompactionEntry* Entry = Entries.Find(CachedNode->Get()))
+		{
+			++Entry->mKnownReferences;
+		}
+	}
+
+	// Going from the top down, a node can move if we can account for every reference to it. Whatever holds on to a node that can't move also holds on to its children, so they can't either.
+	Algo::Sort(Nodes, [](const QuadTreeNode* A, const QuadTreeNode* B) { return A->mLevel > B->mLevel; });
+
+	for (const QuadTreeNode* Node : Nodes)
+	{
+		FCompactionEntry& Entry = Entries.FindChecked(Node);
+		Entry.mIsMoving = (Entry.mReference->GetSharedReferenceCount() == Entry.mKnownReferences);
+
+		if (!Entry.mIsMoving)
+		{
+			++Stats.mNodesLeftInPlace;
+			continue;
+		}
+
+		++Stats.mNodesMoved;
+		for (const TSharedPtr<const QuadTreeNode>& Child : Node->mChildren)
+		{
+			if (FCompactionEntry* ChildEntry = Entries.Find(Child.Get()))
+			{
+				++ChildEntry->mKnownReferences;
+			}
+		}
+	}
+
+	if (Stats.mNodesMoved == 0)
+	{
+		Stats.mSeconds = FPlatformTime::Seconds() - StartTime;
+		return Stats;
+	}
+
+	// Lay the moving nodes out depth first from each root and then from the cache, giving each node's children consecutive slots before going down into any of them.
+	uint8* Chunk = nullptr;
+	SIZE_T ChunkOffset = kNodeArenaChunkBytes;
+
+	auto AllocateSlot = [&]()
+	{
+		if (ChunkOffset + kNodeSlotBytes > kNodeArenaChunkBytes)
+		{
+			Chunk = (uint8*)FMemory::Malloc(kNodeArenaChunkBytes, kNodeArenaChunkBytes);
+			new (Chunk) FNodeArenaChunk();
+			ChunkOffset = kNodeArenaFirstSlotOffset;
+			Stats.mArenaBytes += kNodeArenaChunkBytes;
+		}
+
+		void* Slot = Chunk + ChunkOffset;
+		ChunkOffset += kNodeSlotBytes;
+		return Slot;
+	};
+
+	TArray<const TSharedPtr<const QuadTreeNode>*> LayoutRoots(RootNodes.GetData(), RootNodes.Num());
+	LayoutRoots.Append(CachedNodes);
+
+	TArray<const QuadTreeNode*> NodesToLayOut;
+	for (const TSharedPtr<const QuadTreeNode>* RootNode : LayoutRoots)
+	{
+		FCompactionEntry* RootEntry = Entries.Find(RootNode->Get());
+		if (RootEntry == nullptr || !RootEntry->mIsMoving || RootEntry->mNewAddress != nullptr)
+		{
+			continue;
+		}
+
+		RootEntry->mNewAddress = AllocateSlot();
+		NodesToLayOut.Add(RootNode->Get());
+
+		while (NodesToLayOut.Num() > 0)
+		{
+			const QuadTreeNode* Node = NodesToLayOut.Pop(false);
+
+			const QuadTreeNode* ChildrenLaidOut[ChildNode::kCount] = {};
+			for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+			{
+				FCompactionEntry* ChildEntry = Entries.Find(Node->mChildren[ChildIndex].Get());
+				if (ChildEntry != nullptr && ChildEntry->mIsMoving && ChildEntry->mNewAddress == nullptr)
+				{
+					ChildEntry->mNewAddress = AllocateSlot();
+					ChildrenLaidOut[ChildIndex] = Node->mChildren[ChildIndex].Get();
+				}
+			}
+
+			// Pushed in reverse, so the northwest child is the next one laid out below.
+			for (int32 ChildIndex = ChildNode::kCount - 1; ChildIndex >= 0; --ChildIndex)
+			{
+				if (ChildrenLaidOut[ChildIndex] != nullptr)
+				{
+					NodesToLayOut.Add(ChildrenLaidOut[ChildIndex]);
+				}
+			}
+		}
+	}
+
+	// Build the copies from the bottom up, so every node's moved children exist before it does, and point the node table at them.
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; --NodeIndex)
+	{
+		const QuadTreeNode* Node = Nodes[NodeIndex];
+		FCompactionEntry& Entry = Entries.FindChecked(Node);
+		if (!Entry.mIsMoving)
+		{
+			continue;
+		}
+
+		TSharedPtr<const QuadTreeNode> Children[ChildNode::kCount];
+		for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+		{
+			const FCompactionEntry* ChildEntry = Entries.Find(Node->mChildren[ChildIndex].Get());
+			Children[ChildIndex] = (ChildEntry != nullptr && ChildEntry->mIsMoving) ? ChildEntry->mNewNode : Node->mChildren[ChildIndex];
+		}
+
+		const QuadTreeNode* NewNode = new (Entry.mNewAddress) QuadTreeNode(Node->mLevel, Children[ChildNode::Northwest], Children[ChildNode::Northeast], Children[ChildNode::Southwest], Children[ChildNode::Southeast]);
+		GetNodeArenaChunk(NewNode)->mNumLiveNodes.fetch_add(1, std::memory_order_relaxed);
+		Entry.mNewNode = MakeShareable(NewNode, FNodeArenaDeleter());
+
+		FNodeKey Key;
+		Key.mLevel = Node->mLevel;
+		for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+		{
+			Key.mChildren[ChildIndex] = Children[ChildIndex].Get();
+		}
+
+		FNodeTableShard& Shard = GetNodeTable()[GetTypeHash(Key) % kNumTableShards];
+		FScopeLock Lock(&Shard.mLock);
+		Shard.mNodes.FindOrAdd(Key) = Entry.mNewNode;
+	}
+
+	// Swap every reference we counted over to the copies. The originals die as the last of them goes, and their table entries are swept out later like any other dead node's.
+	for (TSharedPtr<const QuadTreeNode>* RootNode : RootNodes)
+	{
+		const FCompactionEntry* Entry = Entries.Find(RootNode->Get());
+		if (Entry != nullptr && Entry->mIsMoving)
+		{
+			*RootNode = Entry->mNewNode;
+		}
+	}
+
+	// Results are keyed by node address, so moved ones may belong in another shard now.
+	auto GetMovedNode = [&Entries](const TSharedPtr<const QuadTreeNode>& Node)
+	{
+		const FCompactionEntry* Entry = Entries.Find(Node.Get());
+		return (Entry != nullptr && Entry->mIsMoving) ? Entry->mNewNode : Node;
+	};
+
+	TArray<TPair<FResultKey, FCachedResult>> MovedResults;
+	for (int32 ShardIndex = 0; ShardIndex < kNumTableShards; ++ShardIndex)
+	{
+		FScopeLock Lock(&ResultCache[ShardIndex].mLock);
+		for (auto Iter = ResultCache[ShardIndex].mResults.CreateIterator(); Iter; ++Iter)
+		{
+			Iter.Value().mNextGeneration = GetMovedNode(Iter.Value().mNextGeneration);
+
+			const TSharedPtr<const QuadTreeNode> MovedNode = GetMovedNode(Iter.Value().mNode);
+			if (MovedNode != Iter.Value().mNode)
+			{
+				FResultKey MovedKey = Iter.Key();
+				MovedKey.mNode = MovedNode.Get();
+				Iter.Value().mNode = MovedNode;
+				MovedResults.Emplace(MovedKey, MoveTemp(Iter.Value()));
+				Iter.RemoveCurrent();
+			}
+		}
+	}
+
+	for (TPair<FResultKey, FCachedResult>& MovedResult : MovedResults)
+	{
+		FResultCacheShard& Shard = ResultCache[GetTypeHash(MovedResult.Key) % kNumTableShards];
+		FScopeLock Lock(&Shard.mLock);
+		Shard.mResults.Add(MovedResult.Key, MoveTemp(MovedResult.Value));
+	}
+
+	MovedResults.Empty();
+	Entries.Empty();
+
+	// The originals that died gave their slots back, which may have emptied whole slabs. Our own cache doesn't count, so hand it over first.
+	FNodeSlotCache& SlotCache = GetNodeSlotCache();
+	ReturnNodeSlots(SlotCache, SlotCache.mNumFreeSlots);
+	Stats.mSlabBytesReleased = ReleaseEmptyNodeSlabs();
+
+	Stats.mSeconds = FPlatformTime::Seconds() - StartTime;
+	return Stats;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetCachedNextGeneration(const TSharedPtr<const QuadTreeNode>& Node, const FLifeRule& Rule, const int32 ParallelDepth)
+{
+	FNodeStoreScope NodeStoreScope;
+
+	// Empty nodes and 4x4 blocks are quicker to simulate than to look up.
+	if (!Node->IsAlive() || Node->GetNodeDimension() == 4)
+	{
+		return Node->ComputeNextGeneration(Rule, ParallelDepth);
+	}
+
+	FResultKey Key;
+	Key.mNode = Node.Get();
+	Key.mRule = &Rule;
+
+	FThreadSimulationCounters& Counters = GetThreadSimulationCounters();
+	FResultCacheShard& Shard = GetResultCache()[GetTypeHash(Key) % kNumTableShards];
+
+	{
+		FScopeLock Lock(&Shard.mLock);
+		if (const FCachedResult* CachedResult = Shard.mResults.Find(Key))
+		{
+			IncrementCounter(Counters.mResultCacheHits, &FQuadTreeSimulationStats::mResultCacheHits);
+			return CachedResult->mNextGeneration;
+		}
+	}
+
+	IncrementCounter(Counters.mResultCacheMisses, &FQuadTreeSimulationStats::mResultCacheMisses);
+
+	// Before doing the work, see if an earlier run already did it.
+	FPersistentResultCache* PersistentResultCache = sPersistentResultCache.Get();
+	TSharedPtr<const QuadTreeNode> NextGeneration = (PersistentResultCache != nullptr) ? PersistentResultCache->FindNextGeneration(*Node, Rule) : nullptr;
+
+	if (NextGeneration.IsValid())
+	{
+		IncrementCounter(Counters.mPersistentCacheHits, &FQuadTreeSimulationStats::mPersistentCacheHits);
+	}
+	else
+	{
+		NextGeneration = Node->ComputeNextGeneration(Rule, ParallelDepth);
+
+		if (PersistentResultCache != nullptr)
+		{
+			PersistentResultCache->AddNextGeneration(*Node, Rule, NextGeneration);
+		}
+	}
+
+	// Once a shard is full we start it over. Releasing the nodes it held can take a while, so do it after letting go of the lock.
+	TMap<FResultKey, FCachedResult> EvictedResults;
+	{
+		FScopeLock Lock(&Shard.mLock);
+		if (Shard.mResults.Num() >= sMaxCachedResults / kNumTableShards)
+		{
+			EvictedResults = MoveTemp(Shard.mResults);
+		}
+
+		FCachedResult& NewResult = Shard.mResults.Add(Key);
+		NewResult.mNode = Node;
+		NewResult.mNextGeneration = NextGeneration;
 	}
 
-	return CreateLeaf(false);
+	return NextGeneration;
 }
 
 QuadTreeNode::QuadTreeNode(const bool IsAlive) :
 	mLevel(0),
-	mIsAlive(IsAlive)
+	mIsAlive(IsAlive),
+	mPopulation(IsAlive ? 1 : 0),
+	mHash(IsAlive ? 0x2545F4914F6CDD1Dull : 0x8BB84B93962EACC9ull),
+	mTranslationHash(IsAlive ? 1 : 0),
+	mLiveMinX(0),
+	mLiveMinY(0),
+	mLiveMaxX(0),
+	mLiveMaxY(0)
 {
-
+	TrackNodeCreated();
 }
 
 QuadTreeNode::QuadTreeNode(const uint8 Level, const TSharedPtr<const QuadTreeNode> Northwest, const TSharedPtr<const QuadTreeNode> Northeast, const TSharedPtr<const QuadTreeNode> Southwest, const TSharedPtr<const QuadTreeNode> Southeast) :
@@ -103,6 +1414,59 @@ QuadTreeNode::QuadTreeNode(const uint8 Level, const TSharedPtr<const QuadTreeNod
 
 	// This node is alive if at least one cell inside it is alive.
 	mIsAlive = (Northwest->IsAlive() || Northeast->IsAlive() || Southwest->IsAlive() || Southeast->IsAlive());
+
+	// Sum up the population of our children. Nodes near the top of a max size board can hold more than UINT64_MAX cells, so saturate instead of overflowing.
+	mPopulation = 0;
+	for (const TSharedPtr<const QuadTreeNode>& Child : mChildren)
+	{
+		const uint64 ChildPopulation = Child->GetPopulation();
+		mPopulation = (mPopulation > UINT64_MAX - ChildPopulation) ? UINT64_MAX : mPopulation + ChildPopulation;
+	}
+
+	mHash = CombineNodeHash(Level, Northwest->mHash);
+	mHash = CombineNodeHash(mHash, Northeast->mHash);
+	mHash = CombineNodeHash(mHash, Southwest->mHash);
+	mHash = CombineNodeHash(mHash, Southeast->mHash);
+
+	// Move each child's translation hash to where that child sits in this node.
+	uint64 MultiplierX, MultiplierY;
+	GetTranslationHashChildMultipliers(Level, MultiplierX, MultiplierY);
+
+	mTranslationHash = Southwest->mTranslationHash +
+		Southeast->mTranslationHash * MultiplierX +
+		Northwest->mTranslationHash * MultiplierY +
+		Northeast->mTranslationHash * MultiplierX * MultiplierY;
+
+	// Grow our live bounds to contain the live bounds of each child.
+	mLiveMinX = UINT64_MAX;
+	mLiveMinY = UINT64_MAX;
+	mLiveMaxX = 0;
+	mLiveMaxY = 0;
+
+	const uint64 ChildNodeDimension = uint64(1) << (Level - 1);
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		const TSharedPtr<const QuadTreeNode>& Child = mChildren[ChildIndex];
+		if (!Child->IsAlive())
+		{
+			continue;
+		}
+
+		const uint64 OffsetX = (ChildIndex == ChildNode::Northeast || ChildIndex == ChildNode::Southeast) ? ChildNodeDimension : 0;
+		const uint64 OffsetY = (ChildIndex == ChildNode::Northwest || ChildIndex == ChildNode::Northeast) ? ChildNodeDimension : 0;
+
+		mLiveMinX = FMath::Min(mLiveMinX, Child->mLiveMinX + OffsetX);
+		mLiveMinY = FMath::Min(mLiveMinY, Child->mLiveMinY + OffsetY);
+		mLiveMaxX = FMath::Max(mLiveMaxX, Child->mLiveMaxX + OffsetX);
+		mLiveMaxY = FMath::Max(mLiveMaxY, Child->mLiveMaxY + OffsetY);
+	}
+
+	TrackNodeCreated();
+}
+
+QuadTreeNode::~QuadTreeNode()
+{
+	--sLiveNodeCount;
 }
 
 bool QuadTreeNode::operator==(const QuadTreeNode& Other) const
@@ -231,7 +1595,37 @@ TSharedPtr<const QuadTreeNode> QuadTreeNode::GetChild(ChildNode Node) const
 	return mChildren[Node];
 }
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::Run4x4Simulation() const
+uint64 QuadTreeNode::GetBlockBitmap() const
+{
+#if !UE_BUILD_SHIPPING
+	if (mLevel != kBlockLevel)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to call GetBlockBitmap on a node that isn't 8x8."));
+		return 0;
+	}
+#endif
+
+	if (!IsAlive())
+	{
+		return 0;
+	}
+
+	uint64 Bitmap = 0;
+	for (int32 Y = 0; Y < 8; ++Y)
+	{
+		for (int32 X = 0; X < 8; ++X)
+		{
+			if (GetIsCellAlive(X, Y))
+			{
+				Bitmap |= uint64(1) << (Y * 8 + X);
+			}
+		}
+	}
+
+	return Bitmap;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::Run4x4Simulation(const FLifeRule& Rule) const
 {
 #if !UE_BUILD_SHIPPING
 	if (GetNodeDimension() != 4)
@@ -254,12 +1648,34 @@ TSharedPtr<const QuadTreeNode> QuadTreeNode::Run4x4Simulation() const
 		}
 	}
 
-	// Using some known Game Of Life bitset tricks, we can quickly calculate the next generation of the interior 2x2 node.
-	return CreateNodeWithSubnodes(mLevel - 1, GetNextGenerationCellFromNeighborhood(Bitset >> 5), GetNextGenerationCellFromNeighborhood(Bitset >> 4), GetNextGenerationCellFromNeighborhood(Bitset >> 1), GetNextGenerationCellFromNeighborhood(Bitset));
+	// The rule has already worked out how every 4x4 block evolves, so all that's left is to look ours up. It hands back the 2x2 result in the same order GetTwoByTwoNode takes.
+	return GetTwoByTwoNode(Rule.Run4x4Block(Bitset));
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetNextGeneration(const FLifeRule& Rule, const int32 ParallelDepth) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_QuadTreeNodeGetNextGeneration);
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::GetNextGeneration);
+
+	return ComputeNextGeneration(Rule, ParallelDepth);
 }
 
-TSharedPtr<const QuadTreeNode> QuadTreeNode::GetNextGeneration() const
+TSharedPtr<const QuadTreeNode> QuadTreeNode::ComputeNextGeneration(const FLifeRule& Rule, const int32 ParallelDepth) const
 {
+	FNodeStoreScope NodeStoreScope;
+
+	FThreadSimulationCounters& Counters = GetThreadSimulationCounters();
+	if (mLevel < Counters.mLowestLevelReached.load(std::memory_order_relaxed))
+	{
+		Counters.mLowestLevelReached.store(mLevel, std::memory_order_relaxed);
+	}
+
+	FQuadTreeSimulationStats* const ScopedStats = FQuadTreeSimulationStatsScope::GetCurrentStats();
+	if (ScopedStats != nullptr && mLevel < ScopedStats->mLowestLevelReached)
+	{
+		ScopedStats->mLowestLevelReached = mLevel;
+	}
+
 	if (!IsAlive())
 	{
 		// If there are no live cells in this node, we can just return an empty tree.
@@ -268,7 +1684,8 @@ TSharedPtr<const QuadTreeNode> QuadTreeNode::GetNextGeneration() const
 	else if (GetNodeDimension() == 4)
 	{
 		// Once we've reached a 4x4 block, go to our specialized simulation.
-		return Run4x4Simulation();
+		IncrementCounter(Counters.mBaseCaseInvocations, &FQuadTreeSimulationStats::mBaseCaseInvocations);
+		return Run4x4Simulation(Rule);
 	}
 
 	/*
@@ -295,26 +1712,51 @@ TSharedPtr<const QuadTreeNode> QuadTreeNode::GetNextGeneration() const
 	// Construct our four nodes that will give us each of our four quadrants for the intended centered result node and simulate their next generation in parallel. 
 	TSharedPtr<const QuadTreeNode> NewNorthwest, NewNortheast, NewSouthwest, NewSoutheast;
 
+	// Once we've used up our parallel depth, keep the rest of the recursion on this thread.
+	const int32 ChildParallelDepth = FMath::Max(ParallelDepth - 1, 0);
+	const EParallelForFlags ParallelForFlags = (ParallelDepth > 0) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+
+	if (ParallelDepth > 0)
+	{
+		IncrementCounter(Counters.mParallelTasks, &FQuadTreeSimulationStats::mParallelTasks, ChildNode::kCount);
+	}
+
+	// Each quadrant gathers its work separately, since it may run on another thread, and it's added to ours once they've all finished.
+	FQuadTreeSimulationStats QuadrantStats[ChildNode::kCount];
+
 	ParallelFor(ChildNode::kCount, [&](int32 QuadrantIndex)
 		{
+			FQuadTreeSimulationStatsScope StatsScope((ScopedStats != nullptr) ? &QuadrantStats[QuadrantIndex] : nullptr);
+
+			// Wherever the quadrant runs, it's covered by our hold on the node store.
+			FNodeStoreScope QuadrantNodeStoreScope(true);
+
 			switch (QuadrantIndex) 
 			{
 			case ChildNode::Northwest:
-				NewNorthwest = CreateNodeWithSubnodes(mLevel - 1, CenterNorthwest, CenterNorth, CenterWest, TrueCenter)->GetNextGeneration();
+				NewNorthwest = GetCachedNextGeneration(CreateNodeWithSubnodes(mLevel - 1, CenterNorthwest, CenterNorth, CenterWest, TrueCenter), Rule, ChildParallelDepth);
 				break;
 			case ChildNode::Northeast:
-				NewNortheast = CreateNodeWithSubnodes(mLevel - 1, CenterNorth, CenterNortheast, TrueCenter, CenterEast)->GetNextGeneration();
+				NewNortheast = GetCachedNextGeneration(CreateNodeWithSubnodes(mLevel - 1, CenterNorth, CenterNortheast, TrueCenter, CenterEast), Rule, ChildParallelDepth);
 				break;
 			case ChildNode::Southwest:
-				NewSouthwest = CreateNodeWithSubnodes(mLevel - 1, CenterWest, TrueCenter, CenterSouthwest, CenterSouth)->GetNextGeneration();
+				NewSouthwest = GetCachedNextGeneration(CreateNodeWithSubnodes(mLevel - 1, CenterWest, TrueCenter, CenterSouthwest, CenterSouth), Rule, ChildParallelDepth);
 				break;
 			case ChildNode::Southeast:
-				NewSoutheast = CreateNodeWithSubnodes(mLevel - 1, TrueCenter, CenterEast, CenterSouth, CenterSoutheast)->GetNextGeneration();
+				NewSoutheast = GetCachedNextGeneration(CreateNodeWithSubnodes(mLevel - 1, TrueCenter, CenterEast, CenterSouth, CenterSoutheast), Rule, ChildParallelDepth);
 				break;
 			default:
 				UE_LOG(LogTemp, Warning, TEXT("Reached some unknown case during ParallelFor in GetNextGeneration."))
 			}
-		});
+		}, ParallelForFlags);
+
+	if (ScopedStats != nullptr)
+	{
+		for (const FQuadTreeSimulationStats& Stats : QuadrantStats)
+		{
+			*ScopedStats += Stats;
+		}
+	}
 
 	// Recombine to get our centered result node.
 	return CreateNodeWithSubnodes(mLevel - 1, NewNorthwest, NewNortheast, NewSouthwest, NewSoutheast);
@@ -393,6 +1835,384 @@ bool QuadTreeNode::IsAlive() const
 	return mIsAlive;
 }
 
+uint64 QuadTreeNode::GetPopulation() const
+{
+	return mPopulation;
+}
+
+uint64 QuadTreeNode::GetHash() const
+{
+	return mHash;
+}
+
+uint64 QuadTreeNode::GetTranslationInvariantHash() const
+{
+	if (!IsAlive())
+	{
+		return 0;
+	}
+
+	// Moving the live cells so their bounds start at (0, 0) takes away any dependence on where they were.
+	return mTranslationHash *
+		PowerModulo64(InverseModulo64(kTranslationHashBaseX), mLiveMinX) *
+		PowerModulo64(InverseModulo64(kTranslationHashBaseY), mLiveMinY);
+}
+
+bool QuadTreeNode::GetLiveBounds(FBoardRect& BoundsOut) const
+{
+	if (!IsAlive())
+	{
+		return false;
+	}
+
+	BoundsOut.mMinX = mLiveMinX;
+	BoundsOut.mMinY = mLiveMinY;
+	BoundsOut.mMaxX = mLiveMaxX;
+	BoundsOut.mMaxY = mLiveMaxY;
+	return true;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::CropToRect(const TSharedPtr<const QuadTreeNode> Node, const FBoardRect& Rect)
+{
+	if (!Node->IsAlive())
+	{
+		return Node;
+	}
+
+	// Nodes that are entirely in or entirely out don't need to be looked into.
+	if (Rect.mMinX <= Node->mLiveMinX && Rect.mMinY <= Node->mLiveMinY && Rect.mMaxX >= Node->mLiveMaxX && Rect.mMaxY >= Node->mLiveMaxY)
+	{
+		return Node;
+	}
+
+	if (Rect.mMinX > Node->mLiveMaxX || Rect.mMinY > Node->mLiveMaxY || Rect.mMaxX < Node->mLiveMinX || Rect.mMaxY < Node->mLiveMinY)
+	{
+		return CreateEmptyNode(Node->mLevel);
+	}
+
+	// Some of our live cells are inside Rect and some aren't, so we can't be a leaf. Crop each child to the part of Rect that overlaps it.
+	const uint64 ChildNodeDimension = uint64(1) << (Node->mLevel - 1);
+	TSharedPtr<const QuadTreeNode> CroppedChildren[ChildNode::kCount];
+
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		const uint64 OffsetX = (ChildIndex == ChildNode::Northeast || ChildIndex == ChildNode::Southeast) ? ChildNodeDimension : 0;
+		const uint64 OffsetY = (ChildIndex == ChildNode::Northwest || ChildIndex == ChildNode::Northeast) ? ChildNodeDimension : 0;
+
+		if (Rect.mMaxX < OffsetX || Rect.mMaxY < OffsetY || Rect.mMinX > OffsetX + (ChildNodeDimension - 1) || Rect.mMinY > OffsetY + (ChildNodeDimension - 1))
+		{
+			CroppedChildren[ChildIndex] = CreateEmptyNode(Node->mLevel - 1);
+			continue;
+		}
+
+		FBoardRect ChildRect;
+		ChildRect.mMinX = (Rect.mMinX > OffsetX) ? Rect.mMinX - OffsetX : 0;
+		ChildRect.mMinY = (Rect.mMinY > OffsetY) ? Rect.mMinY - OffsetY : 0;
+		ChildRect.mMaxX = FMath::Min(Rect.mMaxX - OffsetX, ChildNodeDimension - 1);
+		ChildRect.mMaxY = FMath::Min(Rect.mMaxY - OffsetY, ChildNodeDimension - 1);
+
+		CroppedChildren[ChildIndex] = CropToRect(Node->mChildren[ChildIndex], ChildRect);
+	}
+
+	return CreateNodeWithSubnodes(Node->mLevel, CroppedChildren[ChildNode::Northwest], CroppedChildren[ChildNode::Northeast], CroppedChildren[ChildNode::Southwest], CroppedChildren[ChildNode::Southeast]);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::ExtractRegion(const TSharedPtr<const QuadTreeNode> Node, const FBoardRect& Rect)
+{
+	if (Rect.mMinX > Rect.mMaxX || Rect.mMinY > Rect.mMaxY)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to extract an empty region."));
+		return nullptr;
+	}
+
+	// Find the smallest level that fits Rect. A width of 0 means Rect spans all 2^64 columns.
+	const uint64 Width = Rect.GetWidth();
+	const uint64 Height = Rect.GetHeight();
+	const uint8 Level = (Width == 0 || Height == 0) ? 64 : (uint8)FMath::Max<uint64>(FMath::CeilLogTwo64(FMath::Max(Width, Height)), kBlockLevel);
+
+	// The region lies within the 2x2 block of aligned nodes at Level whose southwest node contains Rect's southwest corner.
+	const uint64 IndexX = (Level >= 64) ? 0 : (Rect.mMinX >> Level);
+	const uint64 IndexY = (Level >= 64) ? 0 : (Rect.mMinY >> Level);
+
+	const TSharedPtr<const QuadTreeNode> Block[ChildNode::kCount] =
+	{
+		GetAlignedNode(Node, Level, IndexX, IndexY + 1),
+		GetAlignedNode(Node, Level, IndexX + 1, IndexY + 1),
+		GetAlignedNode(Node, Level, IndexX, IndexY),
+		GetAlignedNode(Node, Level, IndexX + 1, IndexY),
+	};
+
+	TMap<FWindowKey, TSharedPtr<const QuadTreeNode>> Windows;
+	const TSharedPtr<const QuadTreeNode> Window = GetWindow(Block, Rect.mMinX - (IndexX << (Level % 64)), Rect.mMinY - (IndexY << (Level % 64)), Windows);
+
+	// The window runs past Rect to the north and east unless Rect is square and a power of two wide, so clear whatever it picked up there.
+	FBoardRect LocalRect;
+	LocalRect.mMaxX = Width - 1;
+	LocalRect.mMaxY = Height - 1;
+
+	return CropToRect(Window, LocalRect);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetAlignedNode(const TSharedPtr<const QuadTreeNode>& Node, const uint8 Level, const uint64 IndexX, const uint64 IndexY)
+{
+	// Nodes bigger than Node are Node padded out with dead cells to the north and east.
+	if (Level >= Node->mLevel)
+	{
+		if (IndexX != 0 || IndexY != 0)
+		{
+			return CreateEmptyNode(Level);
+		}
+
+		TSharedPtr<const QuadTreeNode> PaddedNode = Node;
+		while (PaddedNode->mLevel < Level)
+		{
+			const TSharedPtr<const QuadTreeNode> EmptyNode = CreateEmptyNode(PaddedNode->mLevel);
+			PaddedNode = CreateNodeWithSubnodes(PaddedNode->mLevel + 1, EmptyNode, EmptyNode, PaddedNode, EmptyNode);
+		}
+
+		return PaddedNode;
+	}
+
+	// Anything past Node's edges is dead.
+	const uint8 Depth = Node->mLevel - Level;
+	if (Depth < 64 && ((IndexX >> Depth) != 0 || (IndexY >> Depth) != 0))
+	{
+		return CreateEmptyNode(Level);
+	}
+
+	// Each bit of the index, from the top, picks the child to go down into.
+	TSharedPtr<const QuadTreeNode> AlignedNode = Node;
+	for (int32 Bit = Depth - 1; Bit >= 0; --Bit)
+	{
+		if (!AlignedNode->IsAlive())
+		{
+			return CreateEmptyNode(Level);
+		}
+
+		const bool IsEast = (IndexX >> Bit) & 0x1;
+		const bool IsNorth = (IndexY >> Bit) & 0x1;
+		AlignedNode = AlignedNode->mChildren[IsNorth ? (IsEast ? ChildNode::Northeast : ChildNode::Northwest) : (IsEast ? ChildNode::Southeast : ChildNode::Southwest)];
+	}
+
+	return AlignedNode;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetWindow(const TSharedPtr<const QuadTreeNode> (&Block)[ChildNode::kCount], const uint64 OffsetX, const uint64 OffsetY, TMap<FWindowKey, TSharedPtr<const QuadTreeNode>>& Windows)
+{
+	// A window that lines up with the block is its southwest node, shared as it is.
+	if (OffsetX == 0 && OffsetY == 0)
+	{
+		return Block[ChildNode::Southwest];
+	}
+
+	const uint8 Level = Block[ChildNode::Southwest]->mLevel;
+	if (!Block[ChildNode::Northwest]->IsAlive() && !Block[ChildNode::Northeast]->IsAlive() && !Block[ChildNode::Southwest]->IsAlive() && !Block[ChildNode::Southeast]->IsAlive())
+	{
+		return CreateEmptyNode(Level);
+	}
+
+	FWindowKey Key;
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		Key.mNodes[ChildIndex] = Block[ChildIndex].Get();
+	}
+	Key.mOffsetX = OffsetX;
+	Key.mOffsetY = OffsetY;
+
+	if (const TSharedPtr<const QuadTreeNode>* FoundWindow = Windows.Find(Key))
+	{
+		return *FoundWindow;
+	}
+
+	// Lay the block's children out in a 4x4 grid, rows from south to north.
+	TSharedPtr<const QuadTreeNode> Grid[4][4];
+	for (int32 Row = 0; Row < 2; ++Row)
+	{
+		for (int32 Column = 0; Column < 2; ++Column)
+		{
+			const QuadTreeNode& BlockNode = *Block[(Row == 1) ? (Column == 1 ? ChildNode::Northeast : ChildNode::Northwest) : (Column == 1 ? ChildNode::Southeast : ChildNode::Southwest)];
+			Grid[Row * 2][Column * 2] = BlockNode.mChildren[ChildNode::Southwest];
+			Grid[Row * 2][Column * 2 + 1] = BlockNode.mChildren[ChildNode::Southeast];
+			Grid[Row * 2 + 1][Column * 2] = BlockNode.mChildren[ChildNode::Northwest];
+			Grid[Row * 2 + 1][Column * 2 + 1] = BlockNode.mChildren[ChildNode::Northeast];
+		}
+	}
+
+	// Each quadrant of the window is a window onto the 2x2 block of grid cells its southwest corner falls in.
+	const uint64 ChildNodeDimension = uint64(1) << (Level - 1);
+	const int32 FirstColumn = (int32)(OffsetX / ChildNodeDimension);
+	const int32 FirstRow = (int32)(OffsetY / ChildNodeDimension);
+
+	auto GetQuadrant = [&](const int32 Column, const int32 Row)
+	{
+		const TSharedPtr<const QuadTreeNode> ChildBlock[ChildNode::kCount] = { Grid[Row + 1][Column], Grid[Row + 1][Column + 1], Grid[Row][Column], Grid[Row][Column + 1] };
+		return GetWindow(ChildBlock, OffsetX % ChildNodeDimension, OffsetY % ChildNodeDimension, Windows);
+	};
+
+	const TSharedPtr<const QuadTreeNode> Window = CreateNodeWithSubnodes(Level, GetQuadrant(FirstColumn, FirstRow + 1), GetQuadrant(FirstColumn + 1, FirstRow + 1), GetQuadrant(FirstColumn, FirstRow), GetQuadrant(FirstColumn + 1, FirstRow));
+	Windows.Add(Key, Window);
+
+	return Window;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetFutureCenter(const TSharedPtr<const QuadTreeNode> Node, const uint64 NumGenerations, const FLifeRule& Rule)
+{
+	if (Node->mLevel < 2 || Node->mLevel > 63 || NumGenerations > (uint64(1) << (Node->mLevel - 2)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to look %llu generations ahead with a node at level %d, which can't see that far."), NumGenerations, Node->mLevel);
+		return nullptr;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::GetFutureCenter);
+
+	TMap<FFutureKey, FFutureResult> Futures;
+	return ComputeFutureCenter(Node, NumGenerations, Rule, Futures);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::ComputeFutureCenter(const TSharedPtr<const QuadTreeNode>& Node, const uint64 NumGenerations, const FLifeRule& Rule, TMap<FFutureKey, FFutureResult>& Futures)
+{
+	const uint8 Level = Node->mLevel;
+
+	if (!Node->IsAlive())
+	{
+		return CreateEmptyNode(Level - 1);
+	}
+	else if (NumGenerations == 0)
+	{
+		return Node->ConstructCenteredChild();
+	}
+	else if (NumGenerations == 1)
+	{
+		// Single steps are what SimulateNextGeneration computes too, so share its results.
+		return GetCachedNextGeneration(Node, Rule, 0);
+	}
+
+	FFutureKey Key;
+	Key.mNode = Node.Get();
+	Key.mNumGenerations = NumGenerations;
+
+	if (const FFutureResult* FoundFuture = Futures.Find(Key))
+	{
+		return FoundFuture->mFutureCenter;
+	}
+
+	/*
+	 * This works like ComputeNextGeneration, in two stages instead of one. Each stage can go up to an eighth of our dimension ahead.
+	 * First, the 9 overlapping nodes at (Level-1) that tile us are each advanced by the first stage, giving 9 nodes at (Level-2) around our center.
+	 * Those are recombined into four nodes at (Level-1), each with one quadrant of our center in its own center, and advanced by the second stage.
+	 */
+	const uint64 MaxStageGenerations = uint64(1) << (Level - 3);
+	const uint64 FirstStageGenerations = (NumGenerations > MaxStageGenerations) ? NumGenerations - MaxStageGenerations : 0;
+	const uint64 SecondStageGenerations = NumGenerations - FirstStageGenerations;
+
+	const TSharedPtr<const QuadTreeNode>& NW = Node->mChildren[ChildNode::Northwest];
+	const TSharedPtr<const QuadTreeNode>& NE = Node->mChildren[ChildNode::Northeast];
+	const TSharedPtr<const QuadTreeNode>& SW = Node->mChildren[ChildNode::Southwest];
+	const TSharedPtr<const QuadTreeNode>& SE = Node->mChildren[ChildNode::Southeast];
+
+	auto Advance = [&](const TSharedPtr<const QuadTreeNode>& Subnode, const uint64 Generations)
+	{
+		return ComputeFutureCenter(Subnode, Generations, Rule, Futures);
+	};
+
+	const TSharedPtr<const QuadTreeNode> North = CreateNodeWithSubnodes(Level - 1, NW->Northeast(), NE->Northwest(), NW->Southeast(), NE->Southwest());
+	const TSharedPtr<const QuadTreeNode> West = CreateNodeWithSubnodes(Level - 1, NW->Southwest(), NW->Southeast(), SW->Northwest(), SW->Northeast());
+	const TSharedPtr<const QuadTreeNode> Center = CreateNodeWithSubnodes(Level - 1, NW->Southeast(), NE->Southwest(), SW->Northeast(), SE->Northwest());
+	const TSharedPtr<const QuadTreeNode> East = CreateNodeWithSubnodes(Level - 1, NE->Southwest(), NE->Southeast(), SE->Northwest(), SE->Northeast());
+	const TSharedPtr<const QuadTreeNode> South = CreateNodeWithSubnodes(Level - 1, SW->Northeast(), SE->Northwest(), SW->Southeast(), SE->Southwest());
+
+	const TSharedPtr<const QuadTreeNode> CenterNorthwest = Advance(NW, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterNorth = Advance(North, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterNortheast = Advance(NE, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterWest = Advance(West, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> TrueCenter = Advance(Center, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterEast = Advance(East, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterSouthwest = Advance(SW, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterSouth = Advance(South, FirstStageGenerations);
+	const TSharedPtr<const QuadTreeNode> CenterSoutheast = Advance(SE, FirstStageGenerations);
+
+	const TSharedPtr<const QuadTreeNode> FutureCenter = CreateNodeWithSubnodes(Level - 1,
+		Advance(CreateNodeWithSubnodes(Level - 1, CenterNorthwest, CenterNorth, CenterWest, TrueCenter), SecondStageGenerations),
+		Advance(CreateNodeWithSubnodes(Level - 1, CenterNorth, CenterNortheast, TrueCenter, CenterEast), SecondStageGenerations),
+		Advance(CreateNodeWithSubnodes(Level - 1, CenterWest, TrueCenter, CenterSouthwest, CenterSouth), SecondStageGenerations),
+		Advance(CreateNodeWithSubnodes(Level - 1, TrueCenter, CenterEast, CenterSouth, CenterSoutheast), SecondStageGenerations));
+
+	FFutureResult& NewFuture = Futures.Add(Key);
+	NewFuture.mNode = Node;
+	NewFuture.mFutureCenter = FutureCenter;
+
+	return FutureCenter;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::GetRegionAfterGenerations(const TSharedPtr<const QuadTreeNode> RootNode, const FBoardRect& Rect, const uint64 NumGenerations, const FLifeRule& Rule)
+{
+	if (Rect.mMinX > Rect.mMaxX || Rect.mMinY > Rect.mMaxY)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to look ahead at an empty region."));
+		return nullptr;
+	}
+
+	// The light cone is a node whose center holds Rect and reaches at least NumGenerations past it on every side. A width of 0 means Rect spans all 2^64 columns.
+	const uint64 Width = Rect.GetWidth();
+	const uint64 Height = Rect.GetHeight();
+	const uint64 RectLevel = (Width == 0 || Height == 0) ? 64 : FMath::CeilLogTwo64(FMath::Max(Width, Height));
+	const uint64 LookaheadLevel = (NumGenerations > (uint64(1) << 62)) ? 64 : FMath::CeilLogTwo64(FMath::Max<uint64>(NumGenerations, 1));
+	const uint64 ConeLevel = FMath::Max3<uint64>(RectLevel + 1, LookaheadLevel + 2, kBlockLevel);
+
+	if (ConeLevel > 63)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to look %llu generations ahead at a %llux%llu region, which is too far to simulate."), NumGenerations, Width, Height);
+		return nullptr;
+	}
+
+	const uint8 Level = (uint8)ConeLevel;
+	const uint8 BoardLevel = RootNode->mLevel;
+	const uint64 BoardMask = (BoardLevel >= 64) ? UINT64_MAX : (uint64(1) << BoardLevel) - 1;
+	const uint64 ConeMinX = (Rect.mMinX - (uint64(1) << (Level - 2))) & BoardMask;
+	const uint64 ConeMinY = (Rect.mMinY - (uint64(1) << (Level - 2))) & BoardMask;
+
+	TMap<FWindowKey, TSharedPtr<const QuadTreeNode>> Windows;
+	TSharedPtr<const QuadTreeNode> Cone;
+
+	if (Level <= BoardLevel)
+	{
+		// The cone lies within the 2x2 block of aligned nodes at Level whose southwest node contains its southwest corner, wrapping around the board's edges.
+		const uint64 IndexMask = BoardMask >> Level;
+		const uint64 IndexX = ConeMinX >> Level;
+		const uint64 IndexY = ConeMinY >> Level;
+
+		const TSharedPtr<const QuadTreeNode> Block[ChildNode::kCount] =
+		{
+			GetAlignedNode(RootNode, Level, IndexX, (IndexY + 1) & IndexMask),
+			GetAlignedNode(RootNode, Level, (IndexX + 1) & IndexMask, (IndexY + 1) & IndexMask),
+			GetAlignedNode(RootNode, Level, IndexX, IndexY),
+			GetAlignedNode(RootNode, Level, (IndexX + 1) & IndexMask, IndexY),
+		};
+
+		Cone = GetWindow(Block, ConeMinX - (IndexX << Level), ConeMinY - (IndexY << Level), Windows);
+	}
+	else
+	{
+		// The cone is bigger than the board, which repeats itself across it. Lay copies of the board, shifted to start where the cone does, side by side until they cover it.
+		const TSharedPtr<const QuadTreeNode> Block[ChildNode::kCount] = { RootNode, RootNode, RootNode, RootNode };
+		Cone = GetWindow(Block, ConeMinX, ConeMinY, Windows);
+
+		while (Cone->mLevel < Level)
+		{
+			Cone = CreateNodeWithSubnodes(Cone->mLevel + 1, Cone, Cone, Cone, Cone);
+		}
+	}
+
+	// The future center starts at Rect's southwest corner, and runs past Rect to the north and east unless Rect fills it.
+	const TSharedPtr<const QuadTreeNode> FutureCenter = GetFutureCenter(Cone, NumGenerations, Rule);
+
+	FBoardRect LocalRect;
+	LocalRect.mMaxX = Width - 1;
+	LocalRect.mMaxY = Height - 1;
+
+	return ExtractRegion(FutureCenter, LocalRect);
+}
+
 TSharedPtr<const QuadTreeNode> QuadTreeNode::GetBlockOfDimensionContainingCoordinate(const uint64 DesiredDimension, const uint64 X, const uint64 Y) const
 {
 	if (GetNodeDimension() == DesiredDimension)
@@ -466,4 +2286,125 @@ TSharedPtr<const QuadTreeNode> QuadTreeNode::ConstructCenteredGrandchild() const
 	SoutheastSubnode = Southeast()->Northwest()->Northwest();
 
 	return CreateNodeWithSubnodes(mLevel - 2, NorthwestSubnode, NortheastSubnode, SouthwestSubnode, SoutheastSubnode);
-}
\ No newline at end of file
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::Combine(const TSharedPtr<const QuadTreeNode> A, const TSharedPtr<const QuadTreeNode> B, const EBoardOperation Operation)
+{
+	if (!A.IsValid() || !B.IsValid() || A->mLevel != B->mLevel)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Attempting to combine nodes that are not the same size."));
+		return nullptr;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::Combine);
+
+	TMap<FCombinationKey, TSharedPtr<const QuadTreeNode>> Combinations;
+	return ComputeCombination(A, B, Operation, Combinations);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::ComputeCombination(const TSharedPtr<const QuadTreeNode>& A, const TSharedPtr<const QuadTreeNode>& B, const EBoardOperation Operation, TMap<FCombinationKey, TSharedPtr<const QuadTreeNode>>& Combinations)
+{
+	// Nodes are deduplicated, so the same node on both sides, or an empty node on either, settles the result without looking inside. This also covers every pair of leaves.
+	if (A == B)
+	{
+		return (Operation == EBoardOperation::Union || Operation == EBoardOperation::Intersection) ? A : CreateEmptyNode(A->mLevel);
+	}
+	else if (!A->IsAlive())
+	{
+		return (Operation == EBoardOperation::Union || Operation == EBoardOperation::SymmetricDifference) ? B : A;
+	}
+	else if (!B->IsAlive())
+	{
+		return (Operation == EBoardOperation::Intersection) ? B : A;
+	}
+	else if (A->mLevel == kBlockLevel)
+	{
+		// Small enough to combine every cell at once.
+		return CreateBlockFromBitmap(CombineBlockBitmaps(A->GetBlockBitmap(), B->GetBlockBitmap(), Operation));
+	}
+
+	FCombinationKey Key;
+	Key.mOperation = Operation;
+	Key.mA = A.Get();
+	Key.mB = B.Get();
+
+	if (const TSharedPtr<const QuadTreeNode>* FoundCombination = Combinations.Find(Key))
+	{
+		return *FoundCombination;
+	}
+
+	TSharedPtr<const QuadTreeNode> Children[ChildNode::kCount];
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		Children[ChildIndex] = ComputeCombination(A->mChildren[ChildIndex], B->mChildren[ChildIndex], Operation, Combinations);
+	}
+
+	// If nothing changed on one side, this hands back that side's node, so unchanged parts of a tree are shared with the result.
+	TSharedPtr<const QuadTreeNode> Result = CreateNodeWithSubnodes(A->mLevel, Children[ChildNode::Northwest], Children[ChildNode::Northeast], Children[ChildNode::Southwest], Children[ChildNode::Southeast]);
+	Combinations.Add(Key, Result);
+	return Result;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::Transform(const TSharedPtr<const QuadTreeNode> Node, const EBoardSymmetry Symmetry)
+{
+	if (Symmetry == EBoardSymmetry::Identity)
+	{
+		return Node;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::Transform);
+
+	TMap<const QuadTreeNode*, TSharedPtr<const QuadTreeNode>> Transformed;
+	return ComputeTransform(Node, Symmetry, Transformed);
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::ComputeTransform(const TSharedPtr<const QuadTreeNode>& Node, const EBoardSymmetry Symmetry, TMap<const QuadTreeNode*, TSharedPtr<const QuadTreeNode>>& Transformed)
+{
+	if (!Node->IsAlive() || Node->IsLeaf())
+	{
+		return Node;
+	}
+
+	// Boards repeat the same 8x8 blocks over and over, so blocks are remembered too.
+	if (const TSharedPtr<const QuadTreeNode>* FoundTransformed = Transformed.Find(Node.Get()))
+	{
+		return *FoundTransformed;
+	}
+
+	if (Node->mLevel == kBlockLevel)
+	{
+		// Small enough to move every cell at once.
+		TSharedPtr<const QuadTreeNode> Result = CreateBlockFromBitmap(TransformBlockBitmap(Node->GetBlockBitmap(), Symmetry));
+		Transformed.Add(Node.Get(), Result);
+		return Result;
+	}
+
+	// Each child moves to the quadrant its corner of a 2x2 square goes to, and is transformed the same way within it.
+	TSharedPtr<const QuadTreeNode> Children[ChildNode::kCount];
+	for (int32 ChildIndex = 0; ChildIndex < ChildNode::kCount; ++ChildIndex)
+	{
+		int32 Column = (ChildIndex == ChildNode::Northeast || ChildIndex == ChildNode::Southeast) ? 1 : 0;
+		int32 Row = (ChildIndex == ChildNode::Northwest || ChildIndex == ChildNode::Northeast) ? 1 : 0;
+		TransformLocalCell(Symmetry, 2, Column, Row);
+
+		const int32 TransformedIndex = (Row == 1) ? (Column == 1 ? ChildNode::Northeast : ChildNode::Northwest) : (Column == 1 ? ChildNode::Southeast : ChildNode::Southwest);
+		Children[TransformedIndex] = ComputeTransform(Node->mChildren[ChildIndex], Symmetry, Transformed);
+	}
+
+	TSharedPtr<const QuadTreeNode> Result = CreateNodeWithSubnodes(Node->mLevel, Children[ChildNode::Northwest], Children[ChildNode::Northeast], Children[ChildNode::Southwest], Children[ChildNode::Southeast]);
+	Transformed.Add(Node.Get(), Result);
+	return Result;
+}
+
+TSharedPtr<const QuadTreeNode> QuadTreeNode::Translate(const TSharedPtr<const QuadTreeNode> Node, const uint64 DeltaX, const uint64 DeltaY)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(QuadTreeNode::Translate);
+
+	// Node repeats itself past its edges, so the moved node is the window onto a 2x2 block of copies of it that starts DeltaX, DeltaY cells before its southwest corner.
+	// Unsigned arithmetic wraps around for us.
+	const uint64 Mask = (Node->mLevel >= 64) ? UINT64_MAX : (uint64(1) << Node->mLevel) - 1;
+	const TSharedPtr<const QuadTreeNode> Block[ChildNode::kCount] = { Node, Node, Node, Node };
+
+	TMap<FWindowKey, TSharedPtr<const QuadTreeNode>> Windows;
+	return GetWindow(Block, (0 - DeltaX) & Mask, (0 - DeltaY) & Mask, Windows);
+}
@@ -0,0 +1,153 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#include "SoupSearch.h"
+
+#include "Async/ParallelFor.h"
+#include "BoardUtilities.h"
+#include "HAL/PlatformMisc.h"
+#include "LifeRule.h"
+#include "Math/RandomStream.h"
+
+#include <atomic>
+
+namespace
+{
+	// Returns whether any live cell in RootNode is on its outermost rows or columns, where the next generation could grow past it.
+	bool IsTouchingEdge(const QuadTreeNode& RootNode)
+	{
+		FBoardRect LiveBounds;
+		if (!RootNode.GetLiveBounds(LiveBounds))
+		{
+			return false;
+		}
+
+		const uint64 LastCell = RootNode.GetNodeDimension() - 1;
+		return LiveBounds.mMinX == 0 || LiveBounds.mMinY == 0 || LiveBounds.mMaxX == LastCell || LiveBounds.mMaxY == LastCell;
+	}
+}
+
+double FSoupSearchResults::GetSoupsPerSecond() const
+{
+	return (mSeconds > 0.0) ? mSoups.Num() / mSeconds : 0.0;
+}
+
+bool FSoupSearch::Run(const FSoupSearchSettings& Settings, FSoupSearchResults& ResultsOut)
+{
+	const FLifeRule* Rule = FLifeRule::FindOrCreate(Settings.mRuleString);
+	if (Rule == nullptr)
+	{
+		return false;
+	}
+
+	// The soup has to fit on its board, and the board has to leave room to grow one level while simulating.
+	if (Settings.mSoupDimension <= 0 || Settings.mBoardLevel > 63 || (uint64(1) << Settings.mBoardLevel) < (uint64)Settings.mSoupDimension * 2)
+	{
+		UE_LOG(LogTemp, Error, TEXT("A soup with dimension %d doesn't fit on a board of level %d."), Settings.mSoupDimension, Settings.mBoardLevel);
+		return false;
+	}
+
+	ResultsOut = FSoupSearchResults();
+	ResultsOut.mSoups.SetNum(FMath::Max(Settings.mNumSoups, 0));
+
+	const FQuadTreeSimulationStats StatsBeforeSearch = QuadTreeNode::GetSimulationStats();
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Each worker takes the next soup nobody has started on until they've all been run. Soups are small, so each one stays on its worker's thread.
+	const int32 NumWorkers = (Settings.mNumThreads > 0) ? Settings.mNumThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	std::atomic<int32> NextSoupIndex = 0;
+
+	ParallelFor(NumWorkers, [&](int32 WorkerIndex)
+		{
+			for (int32 SoupIndex = NextSoupIndex++; SoupIndex < ResultsOut.mSoups.Num(); SoupIndex = NextSoupIndex++)
+			{
+				ResultsOut.mSoups[SoupIndex] = RunSoup(Settings, *Rule, SoupIndex);
+			}
+		}, (NumWorkers > 1) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+
+	ResultsOut.mSeconds = FPlatformTime::Seconds() - StartTime;
+	ResultsOut.mSimulationStats = QuadTreeNode::GetSimulationStats() - StatsBeforeSearch;
+
+	for (const FSoupResult& Soup : ResultsOut.mSoups)
+	{
+		++ResultsOut.mNumSoupsByPeriodicity[(int32)Soup.mPeriodicity.mKind];
+
+		if (Soup.mPeriodicity.mKind == EBoardPeriodicity::Oscillator || Soup.mPeriodicity.mKind == EBoardPeriodicity::Spaceship)
+		{
+			++ResultsOut.mNumSoupsByPeriod.FindOrAdd(Soup.mPeriodicity.mPeriod);
+		}
+
+		if (Soup.mReachedEdge)
+		{
+			++ResultsOut.mNumSoupsReachedEdge;
+		}
+	}
+
+	return true;
+}
+
+TSharedPtr<const QuadTreeNode> FSoupSearch::CreateSoup(const FSoupSearchSettings& Settings, const int32 SoupIndex)
+{
+	// Mix the index into the seed so neighboring soups don't start from neighboring random streams.
+	FRandomStream RandomStream((int32)((uint32)Settings.mSeed ^ ((uint32)SoupIndex * 0x9E3779B9u)));
+
+	const uint64 BoardDimension = uint64(1) << Settings.mBoardLevel;
+	const uint64 SoupOffset = (BoardDimension - Settings.mSoupDimension) / 2;
+
+	TArray<FBoardCoordinate> LiveCells;
+	for (int32 Y = 0; Y < Settings.mSoupDimension; ++Y)
+	{
+		for (int32 X = 0; X < Settings.mSoupDimension; ++X)
+		{
+			if (RandomStream.FRand() < Settings.mDensity)
+			{
+				FBoardCoordinate& LiveCell = LiveCells.AddDefaulted_GetRef();
+				LiveCell.SetXAndY(SoupOffset + X, SoupOffset + Y);
+			}
+		}
+	}
+
+	return QuadTreeNode::SetCellsToAlive(QuadTreeNode::CreateEmptyNode(Settings.mBoardLevel), LiveCells);
+}
+
+FSoupResult FSoupSearch::RunSoup(const FSoupSearchSettings& Settings, const FLifeRule& Rule, const int32 SoupIndex)
+{
+	TSharedPtr<const QuadTreeNode> RootNode = CreateSoup(Settings, SoupIndex);
+
+	FSoupResult Result;
+	Result.mSoupIndex = SoupIndex;
+	Result.mInitialPopulation = RootNode->GetPopulation();
+
+	FBoardPeriodDetector PeriodDetector(Settings.mMaxPeriod);
+	PeriodDetector.AddGeneration(RootNode, 0);
+
+	int64 Generation = 0;
+	while (Generation < Settings.mMaxGenerations && PeriodDetector.GetPeriodicity().mKind == EBoardPeriodicity::Unknown)
+	{
+		RootNode = SimulateBoundedGeneration(RootNode, Rule);
+		Result.mReachedEdge |= IsTouchingEdge(*RootNode);
+		++Generation;
+		PeriodDetector.AddGeneration(RootNode, Generation);
+	}
+
+	Result.mFinalPopulation = RootNode->GetPopulation();
+	Result.mGenerations = Generation;
+	Result.mPeriodicity = PeriodDetector.GetPeriodicity();
+
+	return Result;
+}
+
+TSharedPtr<const QuadTreeNode> FSoupSearch::SimulateBoundedGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const FLifeRule& Rule)
+{
+	// Surround the board with dead cells, so the centered result GetNextGeneration gives us is the whole board a generation later.
+	const uint8 Level = RootNode->mLevel;
+	const TSharedPtr<const QuadTreeNode> Empty = QuadTreeNode::CreateEmptyNode(Level - 1);
+
+	const TSharedPtr<const QuadTreeNode> BorderedRoot = QuadTreeNode::CreateNodeWithSubnodes(Level + 1,
+		QuadTreeNode::CreateNodeWithSubnodes(Level, Empty, Empty, Empty, RootNode->Northwest()),
+		QuadTreeNode::CreateNodeWithSubnodes(Level, Empty, Empty, RootNode->Northeast(), Empty),
+		QuadTreeNode::CreateNodeWithSubnodes(Level, Empty, RootNode->Southwest(), Empty, Empty),
+		QuadTreeNode::CreateNodeWithSubnodes(Level, RootNode->Southeast(), Empty, Empty, Empty));
+
+	return BorderedRoot->GetNextGeneration(Rule, 0);
+}
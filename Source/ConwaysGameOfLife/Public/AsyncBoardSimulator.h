@@ -0,0 +1,92 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/CircularQueue.h"
+#include "HAL/Runnable.h"
+#include "QuadTreeNode.h"
+
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+
+/**
+ * An immutable view of a board at one generation.
+ * Nodes are const and shared, so snapshots can be handed between threads freely.
+ */
+struct FBoardSnapshot
+{
+	// Root node of the quadtree representing the board at mGeneration.
+	TSharedPtr<const QuadTreeNode> mRootNode;
+
+	// The generation this snapshot represents.
+	int64 mGeneration = 0;
+};
+
+/**
+ * Simulates a board on a background thread, publishing a snapshot after every generation.
+ * Snapshots are handed to the game thread through a bounded single-producer single-consumer queue, so consuming them never takes a lock.
+ */
+class CONWAYSGAMEOFLIFE_API FAsyncBoardSimulator : public FRunnable
+{
+public:
+	// Starts simulating from InitialSnapshot under Rule right away. A TargetGenerationsPerSecond of 0 runs as fast as possible, and a MaxStepsPerFrame of 0 lets the simulation run arbitrarily far ahead of the consumer.
+	FAsyncBoardSimulator(const FBoardSnapshot& InitialSnapshot, const FLifeRule& Rule, float TargetGenerationsPerSecond, int32 MaxStepsPerFrame, int32 MaxPendingSnapshots);
+
+	// Stops the background thread if it is still running.
+	virtual ~FAsyncBoardSimulator();
+
+	// Hands back the newest pending snapshot and discards any older ones. Returns false if nothing new has been published. Must only be called from one thread.
+	bool ConsumeLatestSnapshot(FBoardSnapshot& SnapshotOut);
+
+	// Changes how many generations per second the background thread aims for. 0 runs as fast as possible.
+	void SetTargetGenerationsPerSecond(float TargetGenerationsPerSecond);
+
+	// Changes how many generations the background thread may simulate between two calls to ConsumeLatestSnapshot. 0 removes the limit.
+	void SetMaxStepsPerFrame(int32 MaxStepsPerFrame);
+
+	// Returns how many snapshots may wait to be consumed before the background thread pauses. The queue is sized when the simulator starts, so this can't be changed afterwards.
+	int32 GetMaxPendingSnapshots() const;
+
+	// Asks the background thread to stop and blocks until it has. Snapshots it already published can still be consumed afterwards.
+	void StopAndWait();
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+private:
+	// Snapshots published by the background thread that the consumer has not picked up yet.
+	TCircularQueue<FBoardSnapshot> mPendingSnapshots;
+
+	// The last snapshot the background thread produced. Only touched by the background thread.
+	FBoardSnapshot mCurrentSnapshot;
+
+	// The rule the board follows.
+	const FLifeRule& mRule;
+
+	// The generations per second we are aiming for, or 0 to run flat out.
+	std::atomic<float> mTargetGenerationsPerSecond;
+
+	// How many generations we may simulate between consumer frames, or 0 for no limit.
+	std::atomic<int32> mMaxStepsPerFrame;
+
+	// The most snapshots we let pile up before waiting for the consumer.
+	const uint32 mMaxPendingSnapshots;
+
+	// How many generations we have simulated since the consumer last picked up a snapshot.
+	std::atomic<int32> mStepsSinceLastConsume;
+
+	// Set when the background thread should exit.
+	std::atomic<bool> mStopRequested;
+
+	// Wakes the background thread up when it is waiting on the consumer, the pacing timer, or a stop request.
+	FEvent* mWakeEvent;
+
+	// The background thread running the simulation.
+	FRunnableThread* mThread;
+};
@@ -0,0 +1,124 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IFileHandle;
+class QuadTreeNode;
+
+/**
+ * A board read back out of a checkpoint stream.
+ */
+struct FBoardCheckpoint
+{
+	// The root node of the board.
+	TSharedPtr<const QuadTreeNode> mRootNode;
+
+	// The generation the board was at.
+	int64 mGeneration = 0;
+
+	// The rule the board followed, in "B3/S23" form.
+	FString mRuleString;
+};
+
+/**
+ * What one checkpoint in a stream holds, without rebuilding its board.
+ */
+struct FBoardCheckpointInfo
+{
+	// The generation the board was at.
+	int64 mGeneration = 0;
+
+	// The rule the board followed, in "B3/S23" form.
+	FString mRuleString;
+
+	// The level of the board's root node.
+	uint8 mRootLevel = 0;
+
+	// The number of node definitions this checkpoint added to the stream. Every other node of its board was written by an earlier checkpoint.
+	int32 mNumNewNodes = 0;
+
+	// The size of this checkpoint in the file, in bytes.
+	int64 mNumBytes = 0;
+};
+
+/**
+ * What a checkpoint stream has written since it was opened.
+ */
+struct FBoardCheckpointStreamStats
+{
+	// The number of checkpoints written.
+	int64 mNumCheckpoints = 0;
+
+	// The number of node definitions they added.
+	int64 mNumNodes = 0;
+
+	// The number of bytes they added to the file.
+	int64 mNumBytes = 0;
+
+	// The wall clock time spent writing them, in seconds.
+	double mSeconds = 0.0;
+};
+
+/**
+ * An append-only file of board checkpoints, where each checkpoint only adds the nodes that no earlier checkpoint in the file has, followed by a reference to its root.
+ * Consecutive generations share almost all of their nodes, so writing a checkpoint costs about as much as the board changed since the last one, however big the board is.
+ * Nodes are identified by their content hash, so a stream can be continued by a later run. Nodes down to level 4 have definitions; 8x8 blocks are stored inline as 64 bit bitmaps.
+ * Since a node that shares a hash with one already in the stream would be taken for it, writers check the children of every node they skip against the children that were written,
+ * and readers check that every definition of a hash has the same children. Either way a collision fails the checkpoint rather than giving back the wrong board.
+ * Reading a checkpoint back means reading the stream up to it, so long streams should now and then be compacted into a single full checkpoint with Compact.
+ * A run that stopped partway through writing a checkpoint leaves part of one at the end, which readers ignore and writers cut off.
+ */
+class CONWAYSGAMEOFLIFE_API FBoardCheckpointStream
+{
+public:
+	// Opens the stream at Filename to add checkpoints to, starting it if there's no such file. Checkpoints already in the file are indexed, so new ones only add nodes it doesn't have yet.
+	// Returns nullptr if the file can't be written, or isn't a checkpoint stream.
+	static TUniquePtr<FBoardCheckpointStream> OpenForWriting(const FString& Filename);
+
+	~FBoardCheckpointStream();
+
+	// Appends a checkpoint of the board rooted at RootNode, at Generation and following RuleString. Returns false if it couldn't be written, after which the stream takes no more checkpoints.
+	bool WriteCheckpoint(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation, const FString& RuleString);
+
+	// Returns what this stream has written since it was opened.
+	const FBoardCheckpointStreamStats& GetStats() const;
+
+	// Returns the path of the file this stream writes to.
+	const FString& GetFilename() const;
+
+	// Fills InfosOut with every whole checkpoint in the stream at Filename, oldest first. Returns false if the file can't be read, or isn't a checkpoint stream.
+	static bool ReadCheckpointInfos(const FString& Filename, TArray<FBoardCheckpointInfo>& InfosOut);
+
+	// Rebuilds the board of the checkpoint at CheckpointIndex in the stream at Filename, or of the last one if CheckpointIndex is INDEX_NONE.
+	// Returns false if there's no such checkpoint, or the stream is missing or has damaged some of its nodes.
+	static bool LoadCheckpoint(const FString& Filename, const int32 CheckpointIndex, FBoardCheckpoint& CheckpointOut);
+
+	// Folds the stream at Filename up to the checkpoint at CheckpointIndex, or the last one if CheckpointIndex is INDEX_NONE, into a new stream at OutputFilename holding just that checkpoint,
+	// with only the nodes its board uses. OutputFilename may be Filename itself. Returns false if the checkpoint couldn't be loaded or the new stream couldn't be written.
+	static bool Compact(const FString& Filename, const int32 CheckpointIndex, const FString& OutputFilename, FBoardCheckpointInfo& InfoOut);
+
+private:
+	FBoardCheckpointStream(const FString& Filename);
+
+	// Adds definitions for Node and every node below it that the stream doesn't have yet to NodeDefinitionsOut, children first, and puts the reference to Node its parent's definition should hold in ReferenceOut.
+	// Returns false if a node shares its hash with a different node the stream already has, so the board can't be written.
+	bool AppendNodeDefinitions(const TSharedPtr<const QuadTreeNode>& Node, TArray<uint8>& NodeDefinitionsOut, int32& NumNodesOut, uint64& ReferenceOut);
+
+	// The path of the stream.
+	FString mFilename;
+
+	// The open file, which every checkpoint is appended to.
+	TUniquePtr<IFileHandle> mFile;
+
+	// The hashes of every node with a definition in the stream, whether this run or an earlier one wrote it, each with a check word made from the children it was written with.
+	TMap<uint64, uint64> mWrittenNodes;
+
+	// What this stream has written since it was opened.
+	FBoardCheckpointStreamStats mStats;
+
+	// Set once a checkpoint couldn't be written. The file may end partway through it, so nothing more can be appended.
+	bool mHasFailed = false;
+};
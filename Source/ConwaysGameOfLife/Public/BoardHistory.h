@@ -0,0 +1,114 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+/**
+ * Remembers past boards so that we can go back to them without simulating from the start.
+ * Nodes are immutable and shared between generations, so keeping an old root only costs the nodes that have changed since.
+ * The most recent generations are all kept, in a ring buffer. Older generations are kept as checkpoints that get sparser the further back they are,
+ * about CheckpointsPerDoubling of them for every doubling of their age, so any generation can be reached by simulating forward from a nearby checkpoint.
+ */
+class CONWAYSGAMEOFLIFE_API FBoardHistory
+{
+public:
+	// Creates a history that keeps every one of the last RecentGenerations generations, and stays within MemoryBudgetBytes. A RecentGenerations of 0 turns the history off, and a MemoryBudgetBytes of 0 or less removes the limit.
+	explicit FBoardHistory(const int32 RecentGenerations = 256, const int32 CheckpointsPerDoubling = 8, const int64 MemoryBudgetBytes = 256 * 1024 * 1024);
+
+	// Records the board at Generation. Generations no newer than the newest one we have are already covered, and are ignored.
+	void AddGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation);
+
+	// Finds the newest generation we have that is no newer than Generation. Returns false if every generation we have is newer.
+	bool FindNearestGeneration(const int64 Generation, TSharedPtr<const QuadTreeNode>& RootNodeOut, int64& GenerationOut) const;
+
+	// Forgets every generation newer than Generation. Should be called when the board is edited, since those generations no longer follow from it.
+	void DiscardGenerationsAfter(const int64 Generation);
+
+	// Forgets everything we've recorded.
+	void Reset();
+
+	// Changes how much we keep, forgetting everything we've recorded.
+	void SetLimits(const int32 RecentGenerations, const int32 CheckpointsPerDoubling, const int64 MemoryBudgetBytes);
+
+	// Returns the oldest generation we have, or INDEX_NONE if we have none.
+	int64 GetOldestGeneration() const;
+
+	// Returns the newest generation we have, or INDEX_NONE if we have none.
+	int64 GetNewestGeneration() const;
+
+	// Returns the number of generations we're holding on to.
+	int32 GetNumGenerations() const;
+
+	// Returns roughly how much memory the nodes kept alive only by the history take up, in bytes.
+	int64 GetEstimatedMemoryBytes() const;
+
+	// Adds the root of every generation we're holding on to to RootNodesOut, so QuadTreeNode::CompactNodes can swap them for moved copies along with the board's own root.
+	void GetRootNodeReferences(TArray<TSharedPtr<const QuadTreeNode>*>& RootNodesOut);
+
+private:
+	// One generation we're holding on to.
+	struct FHistoryEntry
+	{
+		// The root of the board at mGeneration.
+		TSharedPtr<const QuadTreeNode> mRootNode;
+
+		// The generation this entry was recorded at.
+		int64 mGeneration = 0;
+
+		// The number of nodes in this board that aren't in the next newer entry, i.e. roughly what forgetting this entry would free. 0 for the newest entry.
+		int64 mNodesNotInNewerEntry = 0;
+	};
+
+	// Checkpoints older than everything in mRecentEntries, oldest first.
+	TArray<FHistoryEntry> mCheckpoints;
+
+	// The most recent generations, used as a ring buffer. Sized to hold mMaxRecentEntries once anything is recorded.
+	TArray<FHistoryEntry> mRecentEntries;
+
+	// The index in mRecentEntries of the oldest recent entry.
+	int32 mOldestRecentIndex;
+
+	// The number of entries in use in mRecentEntries.
+	int32 mNumRecentEntries;
+
+	// The number of recent generations we keep every one of.
+	int32 mMaxRecentEntries;
+
+	// About how many checkpoints we keep for every doubling in age.
+	int32 mCheckpointsPerDoubling;
+
+	// How much memory the history may take up, in bytes. 0 or less means there is no limit.
+	int64 mMemoryBudgetBytes;
+
+	// The sum of mNodesNotInNewerEntry over every entry.
+	int64 mTotalNodesNotInNewerEntries;
+
+	// Returns the recent entry at Index, counting from the oldest.
+	FHistoryEntry& GetRecentEntry(const int32 Index);
+	const FHistoryEntry& GetRecentEntry(const int32 Index) const;
+
+	// Returns the newest entry. There must be at least one entry.
+	FHistoryEntry& GetNewestEntry();
+	const FHistoryEntry& GetNewestEntry() const;
+
+	// Returns the entry just newer than the checkpoint at CheckpointIndex, or nullptr if there isn't one.
+	const FHistoryEntry* GetEntryNewerThanCheckpoint(const int32 CheckpointIndex) const;
+
+	// Forgets checkpoints that are closer to their neighbors than their age calls for.
+	void ThinCheckpoints();
+
+	// Forgets the oldest entries until we're within our memory budget, always keeping the newest entry.
+	void EnforceMemoryBudget();
+
+	// Removes the oldest entry, wherever it is.
+	void RemoveOldestEntry();
+
+	// Sets how many nodes Entry holds on to that Newer doesn't, keeping mTotalNodesNotInNewerEntries up to date.
+	void UpdateNodesNotInNewerEntry(FHistoryEntry& Entry, const FHistoryEntry* Newer);
+
+	// Returns the number of distinct nodes in Node that aren't at the same place in Other and aren't in Visited yet, adding them to Visited. Shared and empty nodes cost nothing.
+	static int64 CountNodesNotIn(const QuadTreeNode& Node, const QuadTreeNode* Other, TSet<const QuadTreeNode*>& Visited);
+};
@@ -0,0 +1,174 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "QuadTreeNode.h"
+#include "BoardLODVisualizer.generated.h"
+
+class UGameBoard;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/**
+ * Identifies one node of the board by its level and the unsigned coordinate of its southwest corner.
+ */
+struct FVisibleNodeKey
+{
+	// The level of the node in the tree.
+	uint8 mLevel = 0;
+
+	// The X component of the node's southwest corner on the board.
+	uint64 mX = 0;
+
+	// The Y component of the node's southwest corner on the board.
+	uint64 mY = 0;
+
+	bool operator==(const FVisibleNodeKey& Other) const
+	{
+		return (mLevel == Other.mLevel) && (mX == Other.mX) && (mY == Other.mY);
+	}
+};
+
+// Hash function for an FVisibleNodeKey
+FORCEINLINE uint32 GetTypeHash(const FVisibleNodeKey& Key)
+{
+	return HashCombine(GetTypeHash(Key.mLevel), HashCombine(GetTypeHash(Key.mX), GetTypeHash(Key.mY)));
+}
+
+/**
+ * An Actor that visualizes an entire GameBoard at multiple resolutions.
+ * Nodes that are far from the camera are drawn as a single quad shaded by their population density, and only nodes close to the camera are expanded down to individual cells.
+ * The number of quads drawn depends on how much of the view the board covers, not on how much of the board is in view, so zooming out costs the same as zooming in.
+ */
+UCLASS(Blueprintable, meta=(BlueprintSpawnableComponent))
+class CONWAYSGAMEOFLIFE_API ABoardLODVisualizer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	ABoardLODVisualizer();
+
+	// The component holding one instance for every visible node. Custom data float 0 holds the population density of the node, from 0 to 1.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (DisplayName = "Quad Instances"))
+	UInstancedStaticMeshComponent* mQuadInstances;
+
+	// The mesh used to draw one node. Should be a 1x1 unit quad centered on its origin.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, meta = (DisplayName = "Quad Mesh"))
+	UStaticMesh* mQuadMesh;
+
+	// The size of one cell in world units.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (DisplayName = "Cell Size"))
+	float mCellSize;
+
+	// Nodes whose size divided by their distance from the camera is below this value are drawn as a single quad instead of being expanded.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (DisplayName = "Max Angular Size Per Quad"))
+	float mMaxAngularSizePerQuad;
+
+	// Nodes further than this from the camera are not drawn at all.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (DisplayName = "Max View Distance"))
+	float mMaxViewDistance;
+
+	// The camera has to move at least this far before we recompute which nodes are visible, unless the board itself has changed.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (DisplayName = "Camera Move Threshold"))
+	float mCameraMoveThreshold;
+
+	// Update the visible nodes to the current state of the provided game board, as seen from CameraLocation.
+	UFUNCTION(BlueprintCallable)
+	void UpdateRepresentation(const UGameBoard* GameBoard, FVector CameraLocation);
+
+	// Returns the number of nodes currently being drawn.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	int32 GetVisibleNodeCount() const;
+
+protected:
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+private:
+	// How a node of the cut is handled from where the camera is.
+	enum class ENodeLOD : uint8
+	{
+		// Empty, or too far away to draw.
+		Hidden,
+
+		// Drawn as a single quad.
+		Drawn,
+
+		// Too big on screen to draw as one quad, so its children are in the cut instead.
+		Split
+	};
+
+	// One node of the cut through the tree we draw: every node from the root down to the ones that are drawn or hidden as a whole.
+	struct FCutNode
+	{
+		// The node at this position when we last looked at it. Weak, so that it doesn't keep the board's nodes from being compacted.
+		TWeakPtr<const QuadTreeNode> mNode;
+
+		// Whether the node is split, with its children in the cut below it.
+		bool mIsSplit = false;
+	};
+
+	// A node that is currently being drawn, along with the instance drawing it.
+	struct FVisibleNode
+	{
+		// The population density that the instance is currently shaded with.
+		float mDensity = 0.0f;
+
+		// The index of the instance in mQuadInstances.
+		int32 mInstanceIndex = INDEX_NONE;
+	};
+
+	// Every node of the cut, kept from one update to the next so that it only has to be refined and coarsened where the camera or the board changed.
+	TMap<FVisibleNodeKey, FCutNode> mCutNodes;
+
+	// Every node currently being drawn.
+	TMap<FVisibleNodeKey, FVisibleNode> mVisibleNodes;
+
+	// Instances that are hidden and can be reused for newly visible nodes.
+	TArray<int32> mFreeInstances;
+
+	// The root node the cut was last brought up to date with. Weak, so that it doesn't keep the board's nodes from being compacted.
+	TWeakPtr<const QuadTreeNode> mLastRootNode;
+
+	// The level of that root. A board of another size starts the cut over.
+	uint8 mLastRootLevel;
+
+	// The camera location (in actor space) every node of the cut was last checked against.
+	FVector mLastCameraLocation;
+
+	// Returns how the node identified by Key should be handled from the camera location.
+	ENodeLOD GetNodeLOD(const FVisibleNodeKey& Key, const QuadTreeNode& Node, const FVector& LocalCameraLocation) const;
+
+	// Brings the cut at Key, which now holds Node, up to date with the camera location: splitting it, drawing it, or hiding it, and coarsening away whatever was below it if it's no longer split.
+	// With OnlyIfChanged, parts of the cut still holding the same node as last time are left as they are, since nothing about them has changed unless the camera has moved.
+	void UpdateCutNode(const FVisibleNodeKey& Key, const TSharedPtr<const QuadTreeNode>& Node, const FVector& LocalCameraLocation, const bool OnlyIfChanged);
+
+	// Refines and coarsens the cut for a camera that has moved: every split node that looks small enough now is merged back into one, and every node at the bottom of the cut is split further, drawn or hidden anew.
+	void UpdateCutForCamera(const TSharedPtr<const QuadTreeNode>& RootNode, const FVector& LocalCameraLocation);
+
+	// Removes everything below Key from the cut, hiding whatever of it was drawn.
+	void RemoveCutChildren(const FVisibleNodeKey& Key);
+
+	// Draws the node identified by Key with the given density, reusing its instance if it's already drawn.
+	void DrawNode(const FVisibleNodeKey& Key, const float Density);
+
+	// Stops drawing the node identified by Key, if it's drawn.
+	void HideNode(const FVisibleNodeKey& Key);
+
+	// Returns the keys of the children of the node identified by Key, indexed by ChildNode.
+	static void GetChildKeys(const FVisibleNodeKey& Key, FVisibleNodeKey (&ChildKeysOut)[ChildNode::kCount]);
+
+	// Returns the node of the tree below RootNode identified by Key.
+	static TSharedPtr<const QuadTreeNode> FindNode(const TSharedPtr<const QuadTreeNode>& RootNode, const FVisibleNodeKey& Key);
+
+	// Returns the actor space transform of the quad that draws the node identified by Key.
+	FTransform GetNodeTransform(const FVisibleNodeKey& Key) const;
+
+	// Returns a free instance, adding a new one if we have none to reuse.
+	int32 AcquireInstance();
+
+	// Hides an instance and puts it up for reuse.
+	void ReleaseInstance(int32 InstanceIndex);
+};
@@ -0,0 +1,122 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+#include "BoardPeriodDetector.generated.h"
+
+// What we know about how a board behaves over time.
+UENUM(BlueprintType)
+enum class EBoardPeriodicity : uint8
+{
+	// The board hasn't repeated itself yet, as far as we've seen.
+	Unknown,
+
+	// The board no longer changes.
+	Static,
+
+	// The board repeats itself in place every mPeriod generations.
+	Oscillator,
+
+	// The board repeats itself every mPeriod generations, moved over by a fixed displacement.
+	Spaceship
+};
+
+/**
+ * Describes how a board repeats itself, once it does.
+ */
+USTRUCT(BlueprintType)
+struct FBoardPeriodicity
+{
+	GENERATED_BODY()
+
+public:
+	// Whether the board has been seen to repeat itself, and how.
+	UPROPERTY(BlueprintReadOnly, meta = (DisplayName = "Kind"))
+	EBoardPeriodicity mKind = EBoardPeriodicity::Unknown;
+
+	// The number of generations between repeats. 1 for static boards.
+	UPROPERTY(BlueprintReadOnly, meta = (DisplayName = "Period"))
+	int64 mPeriod = 0;
+
+	// How far the board moves along X every period. Always 0 unless the board is a spaceship.
+	UPROPERTY(BlueprintReadOnly, meta = (DisplayName = "Displacement X"))
+	int64 mDisplacementX = 0;
+
+	// How far the board moves along Y every period. Always 0 unless the board is a spaceship.
+	UPROPERTY(BlueprintReadOnly, meta = (DisplayName = "Displacement Y"))
+	int64 mDisplacementY = 0;
+
+	// The generation at which we saw the board repeat. Every generation from here on follows the cycle.
+	UPROPERTY(BlueprintReadOnly, meta = (DisplayName = "Detected At Generation"))
+	int64 mDetectedAtGeneration = 0;
+};
+
+/**
+ * Watches a board from generation to generation and notices when it starts repeating itself, either in place or translated.
+ * Boards are looked up by the hashes their root nodes carry, so recording a generation costs the same no matter how large the board is.
+ * A hash match is only a candidate: since nodes are deduplicated, it's confirmed by comparing root nodes, after translating the old one for spaceships, before we declare a period.
+ * Each recorded generation keeps its root node alive. Generations share most of their nodes, so this usually costs little, but a board that never settles down holds on to up to MaxPeriod distinct generations.
+ * Generations don't have to be recorded one after another; if some are skipped, the period we find may be a multiple of the true one, which is still a period.
+ */
+class CONWAYSGAMEOFLIFE_API FBoardPeriodDetector
+{
+public:
+	// Creates a detector that can recognize periods up to MaxPeriod generations. A MaxPeriod of 0 turns detection off.
+	explicit FBoardPeriodDetector(const int32 MaxPeriod = 1024);
+
+	// Records the board at Generation. Returns whether or not we know the board's periodicity now.
+	bool AddGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation);
+
+	// Returns what we've found out about the board so far.
+	const FBoardPeriodicity& GetPeriodicity() const;
+
+	// Forgets everything we've recorded. Should be called whenever the board is edited.
+	void Reset();
+
+	// Changes the longest period we can recognize, forgetting everything we've recorded.
+	void SetMaxPeriod(const int32 MaxPeriod);
+
+	// Returns the longest period we can recognize.
+	int32 GetMaxPeriod() const;
+
+private:
+	// What we remember about one recorded generation.
+	struct FHistoryEntry
+	{
+		// The board's root node, kept so a hash match can be confirmed node for node.
+		TSharedPtr<const QuadTreeNode> mRootNode;
+
+		// The hash of the board's live cells, without their position.
+		uint64 mTranslationInvariantHash = 0;
+
+		// The number of live cells.
+		uint64 mPopulation = 0;
+
+		// The smallest rectangle containing every live cell. Left at zero for empty boards.
+		uint64 mLiveMinX = 0;
+		uint64 mLiveMinY = 0;
+		uint64 mLiveWidth = 0;
+		uint64 mLiveHeight = 0;
+
+		// The generation this entry was recorded at.
+		int64 mGeneration = 0;
+	};
+
+	// The most recent generations we've recorded, used as a ring buffer.
+	TArray<FHistoryEntry> mHistory;
+
+	// The slot in mHistory the next generation is recorded into.
+	int32 mNextHistoryIndex;
+
+	// The longest period we can recognize. This is also the size of mHistory once it fills up.
+	int32 mMaxPeriod;
+
+	// The indices in mHistory of every entry with each translation invariant hash. Distinct boards can share a hash, so there may be several.
+	TMultiMap<uint64, int32> mHistoryIndicesByHash;
+
+	// What we've found out so far.
+	FBoardPeriodicity mPeriodicity;
+};
@@ -0,0 +1,175 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSocket;
+class QuadTreeNode;
+
+/**
+ * What a replication server has sent, or a replication client has received, since it started.
+ */
+struct FBoardReplicationStats
+{
+	// The number of generations sent or received. A server counts each generation once per client it went to.
+	int64 mNumGenerations = 0;
+
+	// The number of node definitions they carried.
+	int64 mNumNodes = 0;
+
+	// The number of bytes sent or received.
+	int64 mNumBytes = 0;
+
+	// The number of generations a server didn't send to a client because the client hadn't caught up with the ones before. The client gets the next one instead, with everything it missed.
+	int64 mNumSkippedGenerations = 0;
+};
+
+/**
+ * Serves a board to spectator clients over TCP, sending each client only the nodes it doesn't have yet.
+ * Each generation a client gets the definitions of the nodes new to it, children first, in chunks of at most 16384, followed by a message with the id of the new root.
+ * Ids are content hashes, so a node that another part of the board already uses, or that is still around from an earlier generation, is never sent twice.
+ * Nodes down to 16x16 are sent as their level and four child ids; 8x8 blocks are packed into 64 bit tiles in place of an id.
+ * Consecutive generations share almost all of their nodes, so the bandwidth follows how much of the board changed rather than how many cells are alive.
+ * The server remembers which node it sent under each id, and sends a node again whenever it isn't the one the client has under its id, such as a different node that shares the hash.
+ * The client then replaces the node it had under that id, which leaves alone any node it built out of the old one, since those hold on to their own children.
+ * Clients keep every node they've been sent, so once a client holds several times as many nodes as the board it's watching, both sides forget them and the whole board is sent again.
+ * Sockets are non-blocking. A client that falls behind has generations skipped rather than queued up, and catches up with whatever the board looks like when it's ready again.
+ */
+class CONWAYSGAMEOFLIFE_API FBoardReplicationServer
+{
+public:
+	// Starts listening for clients on Port, on every interface. A Port of 0 picks any free port, which GetPort returns. Returns nullptr if the port can't be listened on.
+	static TUniquePtr<FBoardReplicationServer> Listen(const int32 Port);
+
+	~FBoardReplicationServer();
+
+	// Sends the board rooted at RootNode, at Generation and following RuleString, to every client, and accepts any clients waiting to connect.
+	void SendGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const int64 Generation, const FString& RuleString);
+
+	// Accepts any clients waiting to connect, sends them the last generation sent, and keeps sending whatever the clients couldn't take yet. Call this regularly while the board isn't changing.
+	void Update();
+
+	// Returns the port the server is listening on.
+	int32 GetPort() const;
+
+	// Returns the number of clients connected.
+	int32 GetNumClients() const;
+
+	// Returns what the server has sent since it started.
+	const FBoardReplicationStats& GetStats() const;
+
+private:
+	// One spectator, along with what it has been sent.
+	struct FClientConnection
+	{
+		// The connection to the client.
+		FSocket* mSocket = nullptr;
+
+		// The node last sent to the client under each id since it last forgot them all. A node the server has let go of since is sent again if it's built again.
+		TMap<uint64, TWeakPtr<const QuadTreeNode>> mKnownNodes;
+
+		// The number of nodes in the last whole board the client was sent. Once mKnownNodes grows to several times this, the client forgets them and is sent the whole board again.
+		int32 mNumNodesInLastWholeBoard = 0;
+
+		// Bytes that are waiting to go out to the client, starting at mNumPendingBytesSent.
+		TArray<uint8> mPendingBytes;
+
+		// How many of mPendingBytes have been sent.
+		int32 mNumPendingBytesSent = 0;
+
+		// Whether the client had the latest generation skipped, and should get it as soon as it catches up.
+		bool mIsBehind = false;
+	};
+
+	explicit FBoardReplicationServer(FSocket* ListenSocket);
+
+	// Accepts every client waiting to connect, sending each the last generation sent if there was one.
+	void AcceptClients();
+
+	// Queues up the generation rooted at mLastRootNode for Client, unless Client is still busy with earlier ones.
+	void QueueGeneration(FClientConnection& Client);
+
+	// Sends as much of Client's pending bytes as its connection takes right now. Returns false if the connection was lost.
+	bool FlushPendingBytes(FClientConnection& Client);
+
+	// Closes Client's connection.
+	void CloseClient(FClientConnection& Client);
+
+	// The socket clients connect to.
+	FSocket* mListenSocket = nullptr;
+
+	// The port mListenSocket is bound to.
+	int32 mPort = 0;
+
+	// Every connected client.
+	TArray<FClientConnection> mClients;
+
+	// The last generation sent, which new clients are sent as soon as they connect.
+	TSharedPtr<const QuadTreeNode> mLastRootNode;
+	int64 mLastGeneration = 0;
+	FString mLastRuleString;
+
+	// What the server has sent since it started.
+	FBoardReplicationStats mStats;
+};
+
+/**
+ * Watches a board served by an FBoardReplicationServer, rebuilding each generation it's sent out of the nodes it already has and the ones that came with the generation.
+ */
+class CONWAYSGAMEOFLIFE_API FBoardReplicationClient
+{
+public:
+	// Connects to the server on Port at Address, an IPv4 address such as 127.0.0.1. Returns nullptr if the server can't be reached.
+	static TUniquePtr<FBoardReplicationClient> Connect(const FString& Address, const int32 Port);
+
+	~FBoardReplicationClient();
+
+	// Reads whatever the server has sent, rebuilding every generation that has come in whole. Returns false once the connection has been lost, or the server sent something we can't read.
+	bool Update();
+
+	// Returns the root of the latest generation received, or nullptr if none has been yet.
+	const TSharedPtr<const QuadTreeNode>& GetRootNode() const;
+
+	// Returns the latest generation received.
+	int64 GetGeneration() const;
+
+	// Returns the rule the board follows, in "B3/S23" form.
+	const FString& GetRuleString() const;
+
+	// Returns the number of nodes the client holds on to for generations to come.
+	int32 GetNumKnownNodes() const;
+
+	// Returns what the client has received since it connected.
+	const FBoardReplicationStats& GetStats() const;
+
+private:
+	explicit FBoardReplicationClient(FSocket* Socket);
+
+	// Reads every whole message at the front of mReceivedBytes and removes it. Returns false if a message can't be read.
+	bool ReadMessages();
+
+	// The connection to the server.
+	FSocket* mSocket = nullptr;
+
+	// Bytes received that don't make up a whole message yet.
+	TArray<uint8> mReceivedBytes;
+
+	// Whether the server has said which version of the protocol it speaks yet.
+	bool mHasReadHello = false;
+
+	// Set once the connection is lost or the server sent something we can't read.
+	bool mHasFailed = false;
+
+	// The latest node the server has sent us under each id since it last told us to forget them.
+	TMap<uint64, TSharedPtr<const QuadTreeNode>> mKnownNodes;
+
+	// The latest generation received.
+	TSharedPtr<const QuadTreeNode> mRootNode;
+	int64 mGeneration = 0;
+	FString mRuleString;
+
+	// What the client has received since it connected.
+	FBoardReplicationStats mStats;
+};
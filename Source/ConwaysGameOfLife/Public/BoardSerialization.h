@@ -0,0 +1,73 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+
+/**
+ * What something writing node definitions already has of a node, as its FNodeDefinition::AppendDefinitions lookup reports it.
+ */
+enum class EWrittenNodeState : uint8
+{
+	// The node hasn't been written, so its definition is appended.
+	NotWritten,
+
+	// The node has been written, along with everything below it, so it's skipped.
+	Written,
+
+	// A different node that shares the node's hash has been written, so the node can't be.
+	Conflicting,
+};
+
+/**
+ * The definition of one node as checkpoint streams, board replication and the persistent result cache write it: its hash, its level and a reference to each child.
+ * Nodes down to 16x16 have definitions of their own, written before any definition that refers to them, and are referred to by hash. 8x8 blocks are packed inline as 64 bit bitmaps.
+ */
+struct CONWAYSGAMEOFLIFE_API FNodeDefinition
+{
+	// The hash of the node.
+	uint64 mHash = 0;
+
+	// Each child by ChildNode, as a hash if it has a definition of its own and as a bitmap if it's an 8x8 block.
+	uint64 mChildren[ChildNode::kCount] = {};
+
+	// The level of the node.
+	uint8 mLevel = 0;
+
+	uint8 mPadding[7] = {};
+
+	// Returns the reference a parent's definition holds to Node: its hash if it has a definition of its own and its bitmap if it's an 8x8 block.
+	static uint64 GetReference(const QuadTreeNode& Node);
+
+	// Returns the definition of Node, which must be 16x16 or bigger.
+	static FNodeDefinition Make(const QuadTreeNode& Node);
+
+	// Hands AppendDefinition the definitions of Node and every node below it that FindWrittenNode reports as not written yet, children first, and puts the reference Node's parent should hold in ReferenceOut.
+	// FindWrittenNode is only asked about nodes that have definitions, and whatever it reports as written is skipped along with everything below it.
+	// Returns false as soon as FindWrittenNode reports a conflict, after which some definitions may already have been handed out.
+	static bool AppendDefinitions(const TSharedPtr<const QuadTreeNode>& Node, TFunctionRef<EWrittenNodeState(const QuadTreeNode&)> FindWrittenNode,
+		TFunctionRef<void(const TSharedPtr<const QuadTreeNode>&, const FNodeDefinition&)> AppendDefinition, uint64& ReferenceOut);
+
+	// Builds the node this defines out of the children FindChild returns for each child's reference and level.
+	// Returns nullptr if the definition is damaged, a child is missing, or the node built doesn't have the hash it was defined with.
+	TSharedPtr<const QuadTreeNode> Build(TFunctionRef<TSharedPtr<const QuadTreeNode>(uint64, uint8)> FindChild) const;
+};
+
+/**
+ * A rulestring stored in a fixed size field of a file or message.
+ */
+struct CONWAYSGAMEOFLIFE_API FStoredRuleString
+{
+	// The longest rulestring that fits, including its terminator. "B012345678/S012345678" is the longest a rule can have.
+	static constexpr int32 kMaxLength = 32;
+
+	ANSICHAR mChars[kMaxLength] = {};
+
+	// Stores RuleString. Returns false, and stores nothing, if it's too long to fit.
+	bool Set(const FString& RuleString);
+
+	// Returns the rulestring stored. One read from a damaged file or message is cut off where the field ends.
+	FString Get() const;
+};
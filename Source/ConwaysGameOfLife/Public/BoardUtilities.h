@@ -51,6 +51,95 @@ FORCEINLINE uint32 GetTypeHash(const FBoardCoordinate& BoardCoordinate)
 	return HashCombine(GetTypeHash(BoardCoordinate.mX), GetTypeHash(BoardCoordinate.mY));
 }
 
+/**
+ * A rectangle of cells on the Game Of Life board, in the same unsigned coordinates as FBoardCoordinate. Both corners are included in the rectangle.
+ */
+USTRUCT(BlueprintType)
+struct FBoardRect
+{
+	GENERATED_BODY()
+
+public:
+	// The X value of the rectangle's western edge.
+	uint64 mMinX = 0;
+
+	// The Y value of the rectangle's southern edge.
+	uint64 mMinY = 0;
+
+	// The X value of the rectangle's eastern edge.
+	uint64 mMaxX = 0;
+
+	// The Y value of the rectangle's northern edge.
+	uint64 mMaxY = 0;
+
+	// Returns the number of columns in the rectangle. Wraps to 0 for a rectangle spanning the entire max size board.
+	uint64 GetWidth() const
+	{
+		return mMaxX - mMinX + 1;
+	}
+
+	// Returns the number of rows in the rectangle. Wraps to 0 for a rectangle spanning the entire max size board.
+	uint64 GetHeight() const
+	{
+		return mMaxY - mMinY + 1;
+	}
+
+	bool operator==(const FBoardRect& Other) const
+	{
+		return (mMinX == Other.mMinX) && (mMinY == Other.mMinY) && (mMaxX == Other.mMaxX) && (mMaxY == Other.mMaxY);
+	}
+};
+
+/**
+ * A way of combining the live cells of two boards, cell by cell.
+ */
+UENUM(BlueprintType)
+enum class EBoardOperation : uint8
+{
+	// Cells alive on either board.
+	Union,
+
+	// Cells alive on both boards.
+	Intersection,
+
+	// Cells alive on the first board but not on the second.
+	Difference,
+
+	// Cells alive on exactly one of the boards.
+	SymmetricDifference
+};
+
+/**
+ * One of the eight ways of turning and mirroring a square onto itself. They're numbered the way FPatternMatch::mOrientation is: the mirrored ones mirror east to west first, then turn.
+ */
+UENUM(BlueprintType)
+enum class EBoardSymmetry : uint8
+{
+	// Leaves every cell where it is.
+	Identity,
+
+	// Turns the cells a quarter turn counterclockwise.
+	Rotate90,
+
+	// Turns the cells half a turn.
+	Rotate180,
+
+	// Turns the cells three quarters of a turn counterclockwise.
+	Rotate270,
+
+	// Mirrors the cells east to west.
+	Mirror,
+
+	// Mirrors the cells east to west, then turns them a quarter turn counterclockwise, which mirrors them across the diagonal from northwest to southeast.
+	MirrorRotate90,
+
+	// Mirrors the cells east to west, then turns them half a turn, which mirrors them north to south.
+	MirrorRotate180,
+
+	// Mirrors the cells east to west, then turns them three quarters of a turn counterclockwise, which mirrors them across the diagonal from southwest to northeast.
+	MirrorRotate270
+};
+
 /**
  * Various helper functions for Game of Life.
  */
@@ -63,6 +152,18 @@ public:
 	// Parses a string of coordinates separated by newlines into an array of FBoardCoordinates.
 	UFUNCTION(BlueprintCallable, BlueprintPure)
 	static void ParseStringIntoCoordinates(FString SourceString, TArray<FBoardCoordinate>& ResultsOut);
+
+	// Parses a pattern in run length encoded (RLE) format into an array of FBoardCoordinates. The top left of the pattern is placed at the signed coordinate (0, 0).
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	static void ParseRLEIntoCoordinates(FString SourceString, TArray<FBoardCoordinate>& ResultsOut);
+
+	// Loads a pattern file into an array of FBoardCoordinates. Files ending in .rle are read as RLE, anything else as a list of coordinates. Returns false if the file could not be read.
+	UFUNCTION(BlueprintCallable)
+	static bool LoadPatternFile(FString FilePath, TArray<FBoardCoordinate>& ResultsOut);
+
+	// Moves the file at SourceFilename over the one at TargetFilename in a single step, so there's always a whole file at TargetFilename, even if we stop partway through. Returns false if the file could not be moved.
+	UFUNCTION(BlueprintCallable)
+	static bool ReplaceFile(FString TargetFilename, FString SourceFilename);
 	
 	// Converts a string to an int64.
 	UFUNCTION(BlueprintCallable, BlueprintPure)
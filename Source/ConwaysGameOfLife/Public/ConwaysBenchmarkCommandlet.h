@@ -0,0 +1,27 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs a fixed corpus of patterns through UGameBoard, writes the results as JSON and CSV, and optionally compares them against a stored baseline.
+ * Returns a non-zero exit code when any metric is worse than the baseline by more than the tolerance, so it can gate changes to the engine.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysBenchmark [-output=<results.json>] [-baseline=<baseline.json>] [-tolerance=0.1] [-cases=name,name] [-threads=N] -nullrhi
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysBenchmarkCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
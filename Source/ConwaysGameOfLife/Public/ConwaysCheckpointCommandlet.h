@@ -0,0 +1,26 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysCheckpointCommandlet.generated.h"
+
+/**
+ * Lists the checkpoints in a checkpoint stream, or compacts the stream up to one of them into a single full checkpoint.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysCheckpoint -stream=<file> [-compact] [-checkpoint=N] [-output=<file>] -nullrhi
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysCheckpointCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysCheckpointCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
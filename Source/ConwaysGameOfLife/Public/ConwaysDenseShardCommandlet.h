@@ -0,0 +1,26 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysDenseShardCommandlet.generated.h"
+
+/**
+ * Simulates one strip of a sharded dense simulation. Started by FDenseShardSimulation for each shard; not meant to be run by hand.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysDenseShard -region=<name> -shard=N -rule=B3/S23 -nullrhi
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysDenseShardCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysDenseShardCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
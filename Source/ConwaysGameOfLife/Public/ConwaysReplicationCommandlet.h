@@ -0,0 +1,28 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysReplicationCommandlet.generated.h"
+
+/**
+ * Serves a simulation to spectators over the network, watches one, or both at once over loopback to check that every generation arrives intact and to measure how many bytes each one takes.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysReplication -pattern=<file> [-generations=N] [-rule=B3/S23] [-reportevery=N] -nullrhi
+ *        UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysReplication -serve -pattern=<file> [-port=N] [-clients=N] [-gps=N] [-generations=N] [-rule=B3/S23] -nullrhi
+ *        UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysReplication -connect=<address> [-port=N] -nullrhi
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysReplicationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysReplicationCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,27 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysSimulationCommandlet.generated.h"
+
+/**
+ * Runs a simulation without any rendering or game framework, for batch jobs and for reproducing performance issues outside of the editor.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysSimulation -pattern=<file> [-generations=N] [-rule=B3/S23] [-engine=quadtree|dense|sharded] [-threads=N] [-reportevery=N] -nullrhi
+ * The dense engines also take [-margin=N] or [-width=N] [-height=N] to size the grid, and the sharded engine takes [-shards=N] [-halo=N].
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysSimulationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysSimulationCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,27 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ConwaysSoupSearchCommandlet.generated.h"
+
+/**
+ * Runs a batch of random soups until they settle down and reports what they settled into, along with how many soups per second we got through.
+ * Every soup's result is written as CSV.
+ *
+ * Usage: UnrealEditor-Cmd ConwaysGameOfLife.uproject -run=ConwaysSoupSearch [-soups=N] [-seed=N] [-rule=B3/S23] [-soupsize=16] [-density=0.5] [-boardlevel=10] [-maxgenerations=N] [-maxperiod=N] [-threads=N] [-output=<soups.csv>] -nullrhi
+ */
+UCLASS()
+class CONWAYSGAMEOFLIFE_API UConwaysSoupSearchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UConwaysSoupSearchCommandlet();
+
+	//~ Begin UCommandlet Interface
+	virtual int32 Main(const FString& Params) override;
+	//~ End UCommandlet Interface
+};
@@ -0,0 +1,68 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FLifeRule;
+
+/**
+ * A bounded board stored densely, one bit per cell, for patterns that fill most of their area and would get little out of the quadtree's deduplication.
+ * Cells outside of the grid are always dead.
+ * Rows are stored one after another, each as a run of 64 bit words with the cell at X in bit X % 64 of word X / 64. Bits past the width are always 0.
+ */
+class CONWAYSGAMEOFLIFE_API FDenseLifeGrid
+{
+public:
+	// Creates a grid of Width x Height dead cells.
+	FDenseLifeGrid(const int32 Width, const int32 Height);
+
+	// Returns the number of cells in each row.
+	int32 GetWidth() const;
+
+	// Returns the number of rows.
+	int32 GetHeight() const;
+
+	// Returns the number of words each row is stored in.
+	int32 GetWordsPerRow() const;
+
+	// Sets the cell at X and Y to alive. Cells outside of the grid are ignored.
+	void SetCellToAlive(const int32 X, const int32 Y);
+
+	// Returns whether or not the cell at X and Y is alive. Cells outside of the grid are always dead.
+	bool GetIsCellAlive(const int32 X, const int32 Y) const;
+
+	// Advances the whole grid by one generation under Rule, splitting the rows across threads.
+	void SimulateNextGeneration(const FLifeRule& Rule);
+
+	// Returns the number of live cells.
+	uint64 GetPopulation() const;
+
+	// Returns the words the row at Y is stored in.
+	uint64* GetRow(const int32 Y);
+	const uint64* GetRow(const int32 Y) const;
+
+	// Computes the next generation of rows [FirstRow, EndRow) out of NumRows rows stored like a grid's, writing them to the same rows of RowsOut.
+	// Rows before the first and after the last are treated as dead, so any block of rows can be simulated on its own as long as the caller knows which of its rows are still correct.
+	static void SimulateRows(const uint64* Rows, const int32 NumRows, const int32 Width, const int32 FirstRow, const int32 EndRow, const FLifeRule& Rule, uint64* RowsOut);
+
+	// Returns the number of live cells in NumRows rows of Width cells.
+	static uint64 CountPopulation(const uint64* Rows, const int32 NumRows, const int32 Width);
+
+	// Returns the number of words a row of Width cells is stored in.
+	static int32 GetWordsPerRow(const int32 Width);
+
+private:
+	// The number of cells in each row.
+	int32 mWidth;
+
+	// The number of rows.
+	int32 mHeight;
+
+	// The current generation.
+	TArray<uint64> mCells;
+
+	// Where the next generation is built before being swapped in, kept around so we don't reallocate every generation.
+	TArray<uint64> mNextCells;
+};
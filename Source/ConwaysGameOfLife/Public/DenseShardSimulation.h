@@ -0,0 +1,61 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FDenseLifeGrid;
+class FLifeRule;
+
+/**
+ * Describes how to split a dense simulation across worker processes.
+ */
+struct FDenseShardSettings
+{
+	// The rule to simulate.
+	FString mRuleString = TEXT("B3/S23");
+
+	// The number of worker processes. The grid is split into this many horizontal strips, one per worker.
+	int32 mNumShards = 4;
+
+	// The number of rows each worker borrows from its neighbors. Workers only have to synchronize once every mHaloWidth generations, at the cost of simulating that many extra rows.
+	int32 mHaloWidth = 1;
+
+	// The number of generations to simulate.
+	int64 mNumGenerations = 100;
+};
+
+/**
+ * What a sharded simulation did.
+ */
+struct FDenseShardStats
+{
+	// The wall clock time from starting the workers to getting the grid back, in seconds.
+	double mSeconds = 0.0;
+
+	// The number of live cells at the end, summed over every shard.
+	uint64 mPopulation = 0;
+
+	// The number of times the workers exchanged halos.
+	int64 mNumExchanges = 0;
+};
+
+/**
+ * Simulates a FDenseLifeGrid that is too big for one process's threads, by splitting it into horizontal strips that each run in their own worker process.
+ * The coordinator puts the grid in a named shared memory region and launches one ConwaysDenseShard commandlet per strip.
+ * Every mHaloWidth generations each worker publishes the mHaloWidth rows along its edges and copies in its neighbors', then runs that many generations on its own,
+ * letting the borrowed rows go stale one row per generation. Once every generation has been simulated, workers write their strips back and the coordinator adds up their populations.
+ */
+class CONWAYSGAMEOFLIFE_API FDenseShardSimulation
+{
+public:
+	// Simulates Grid for Settings.mNumGenerations generations across Settings.mNumShards worker processes, leaving the result in Grid. Returns false if the simulation couldn't be run, leaving Grid alone.
+	static bool Run(FDenseLifeGrid& Grid, const FDenseShardSettings& Settings, FDenseShardStats& StatsOut);
+
+	// Runs the strip at ShardIndex of the simulation in the shared memory region named RegionName. This is what each worker process does. Returns the worker's exit code.
+	static int32 RunWorker(const FString& RegionName, const int32 ShardIndex, const FLifeRule& Rule);
+
+	// The most worker processes one simulation can use.
+	static constexpr int32 kMaxShards = 256;
+};
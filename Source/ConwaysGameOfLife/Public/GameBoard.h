@@ -7,9 +7,34 @@
 #include "UObject/NoExportTypes.h"
 #include "QuadTreeNode.h"
 #include "BoardUtilities.h"
+#include "AsyncBoardSimulator.h"
+#include "BoardPeriodDetector.h"
+#include "BoardHistory.h"
+#include "BoardCheckpointStream.h"
+#include "BoardReplication.h"
+#include "PatternSearch.h"
+#include "LifeRule.h"
 
 #include "GameBoard.generated.h"
 
+/**
+ * What it took to simulate one generation of a board.
+ */
+struct FGameBoardStepStats
+{
+	// The work done by the quadtree during the step.
+	FQuadTreeSimulationStats mSimulationStats;
+
+	// How many levels below the root the recursion went.
+	uint8 mMaxRecursionDepth = 0;
+
+	// The wall clock time the whole step took, in milliseconds.
+	double mStepMilliseconds = 0.0;
+
+	// The time spent simulating each top level quadrant, in milliseconds, indexed by ChildNode. Quadrants run in parallel, so these can add up to more than mStepMilliseconds.
+	double mQuadrantMilliseconds[ChildNode::kCount] = {};
+};
+
 /**
  * A square board used to simulate the Game of Life.
  */
@@ -19,23 +44,46 @@ class CONWAYSGAMEOFLIFE_API UGameBoard : public UObject
 	GENERATED_BODY()
 
 public:
-	// Returns a UGameBoard with size BoardDimensionxBoardDimension.
+	// Returns a UGameBoard with size BoardDimensionxBoardDimension that follows RuleString, e.g. "B3/S23" for Conway's Life or "B36/S23" for HighLife. Returns nullptr if RuleString is not a rule we can simulate.
 	UFUNCTION(BlueprintCallable)
-	static UGameBoard* InitializeBoardWithDimension(int BoardDimension);
+	static UGameBoard* InitializeBoardWithDimension(int BoardDimension, const FString& RuleString = TEXT("B3/S23"));
 
-	// Returns a UGameBoard with size kMaxSizeBoardxkMaxSizeBoard.
+	// Returns a UGameBoard with size kMaxSizeBoardxkMaxSizeBoard that follows RuleString. Returns nullptr if RuleString is not a rule we can simulate.
 	UFUNCTION(BlueprintCallable)
-	static UGameBoard* InitializeMaxSizeBoard();
+	static UGameBoard* InitializeMaxSizeBoard(const FString& RuleString = TEXT("B3/S23"));
+
+	// Returns a UGameBoard restored from the last checkpoint at Generation in the checkpoint stream at Filename, or from the last checkpoint in it if Generation is -1. Returns nullptr if there's no such checkpoint, or it can't be read.
+	UFUNCTION(BlueprintCallable)
+	static UGameBoard* InitializeFromCheckpoint(const FString& Filename, int64 Generation = -1);
 
 private:
 	// Helper used to construct an empty board with size BoardDimension.
-	static UGameBoard* InitializeBoardHelper(uint64 BoardDimension);
+	static UGameBoard* InitializeBoardHelper(uint64 BoardDimension, const FString& RuleString);
 
 public:
 	// Sets the cell at FBoardCoordinate to alive. Should only be run before we've started simulating.
 	UFUNCTION(BlueprintCallable)
 	void SetCellToAlive(const FBoardCoordinate Coordinate);
 
+	// Sets every cell in Coordinates to alive at once. Should only be run before we've started simulating.
+	UFUNCTION(BlueprintCallable)
+	void SetCellsToAlive(const TArray<FBoardCoordinate>& Coordinates);
+
+	// Combines the live cells of Other into this board by Operation, cell by cell, e.g. to overlay a pattern. Other must be the same size as this board. Only the nodes where the boards differ are visited,
+	// so the cost follows how different the boards are rather than how big they are. Returns false, leaving the board alone, if the boards can't be combined.
+	UFUNCTION(BlueprintCallable)
+	bool Combine(const UGameBoard* Other, EBoardOperation Operation);
+
+	// Turns and mirrors the whole board by Symmetry about its center, e.g. to try a pattern in every orientation. Each distinct node is only transformed once, so the cost follows the number of distinct nodes
+	// rather than the population. Returns false, leaving the board alone, while it's being simulated asynchronously.
+	UFUNCTION(BlueprintCallable)
+	bool Transform(EBoardSymmetry Symmetry);
+
+	// Moves every live cell DeltaX cells east and DeltaY cells north, wrapping around the edges of the board. The board is rebuilt out of shifted copies of its nodes rather than cell by cell.
+	// Returns false, leaving the board alone, while it's being simulated asynchronously.
+	UFUNCTION(BlueprintCallable)
+	bool Translate(int64 DeltaX, int64 DeltaY);
+
 	// Returns a string representing the state of the entire board.
 	UFUNCTION(BlueprintCallable)
 	FString GetBoardString() const;
@@ -44,6 +92,115 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void SimulateNextGeneration();
 
+	// Advances the board to TargetGeneration. Once the board is known to repeat itself, this takes less than one period of steps, however far away TargetGeneration is.
+	UFUNCTION(BlueprintCallable)
+	void SimulateToGeneration(int64 TargetGeneration);
+
+	// Returns whether the board has been seen to settle into a still life, an oscillator or a spaceship.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	FBoardPeriodicity GetPeriodicity() const;
+
+	// Sets the longest period we watch for. Longer periods take more memory to recognize. 0 turns detection off.
+	UFUNCTION(BlueprintCallable)
+	void SetMaxDetectablePeriod(int32 MaxPeriod);
+
+	// Moves the board to TargetGeneration, going back to the nearest generation we remember and simulating forward from there if needed. Returns false if TargetGeneration is older than anything we remember.
+	UFUNCTION(BlueprintCallable)
+	bool SeekToGeneration(int64 TargetGeneration);
+
+	// Sets how much history we keep for SeekToGeneration: every one of the last RecentGenerations generations, about CheckpointsPerDoubling older ones for every doubling in age, and no more than MemoryBudgetBytes of nodes. A RecentGenerations of 0 turns the history off. Forgets the history kept so far.
+	UFUNCTION(BlueprintCallable)
+	void SetHistoryLimits(int32 RecentGenerations, int32 CheckpointsPerDoubling, int64 MemoryBudgetBytes);
+
+	// Returns the oldest generation SeekToGeneration can go back to.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	int64 GetOldestSeekableGeneration() const;
+
+	// Starts appending a checkpoint of the board to the checkpoint stream at Filename every CheckpointEvery generations, and whenever it's edited, beginning with the board as it is now.
+	// Each checkpoint only writes the nodes the stream doesn't have yet. Continues the stream if the file already holds one. Returns false, leaving no stream running, if the stream can't be opened or the first checkpoint can't be written.
+	UFUNCTION(BlueprintCallable)
+	bool StartCheckpointStream(const FString& Filename, int32 CheckpointEvery = 1);
+
+	// Stops writing checkpoints, closing the stream.
+	UFUNCTION(BlueprintCallable)
+	void StopCheckpointStream();
+
+	// Returns the checkpoint stream being written, or nullptr if there isn't one.
+	const FBoardCheckpointStream* GetCheckpointStream() const;
+
+	// Starts serving the board to spectators on Port, a Port of 0 picking any free one, sending them the board as it is now and every generation after it. Each generation only sends a spectator the nodes it doesn't have yet.
+	// Returns false if the port can't be listened on.
+	UFUNCTION(BlueprintCallable)
+	bool StartReplicationServer(int32 Port);
+
+	// Stops serving the board, disconnecting every spectator.
+	UFUNCTION(BlueprintCallable)
+	void StopReplicationServer();
+
+	// Makes the board a spectator of the board served on Port at Address, an IPv4 address. From then on UpdateReplication replaces the board with each generation the server sends. Returns false if the server can't be reached.
+	UFUNCTION(BlueprintCallable)
+	bool StartReplicationClient(const FString& Address, int32 Port);
+
+	// Stops watching the server, leaving the board as it last was.
+	UFUNCTION(BlueprintCallable)
+	void StopReplicationClient();
+
+	// Keeps replication going while the board is served or watched: lets the server take in new spectators and catch slow ones up, and applies the latest generation a spectator has received.
+	// Call it every frame while replicating. Returns whether the board changed.
+	UFUNCTION(BlueprintCallable)
+	bool UpdateReplication();
+
+	// Returns the server the board is served from, or nullptr if it isn't.
+	const FBoardReplicationServer* GetReplicationServer() const;
+
+	// Returns the server connection the board is watched through, or nullptr if it isn't.
+	const FBoardReplicationClient* GetReplicationClient() const;
+
+	// Moves the nodes of the board and of its history next to each other in memory, in the order the simulation walks them. Nodes created generation after generation end up scattered across the heap,
+	// so a board that has run for a while misses the CPU caches on almost every step down the tree. Nodes that anything else still holds on to stay where they are. Does nothing while simulating asynchronously.
+	FQuadTreeCompactionStats CompactNodes();
+
+	// Compacts the board's nodes every CompactEvery generations as it's simulated. 0 turns it off, which is the default.
+	UFUNCTION(BlueprintCallable)
+	void SetNodeCompactionInterval(int32 CompactEvery);
+
+	// Returns the rule this board follows, in "B3/S23" form.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	FString GetRuleString() const;
+
+	// Returns the rule this board follows.
+	const FLifeRule& GetRule() const;
+
+	// Returns the number of generations this board has been simulated for.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	int64 GetGeneration() const;
+
+	// Starts simulating this board on a background thread. A TargetGenerationsPerSecond of 0 runs as fast as possible, and a MaxStepsPerFrame of 0 lets the simulation run arbitrarily far ahead of the game thread.
+	// If the board is already simulating, the new settings are applied to it. Changing MaxPendingSnapshots restarts the background thread from the latest generation it simulated.
+	UFUNCTION(BlueprintCallable)
+	void StartAsyncSimulation(float TargetGenerationsPerSecond, int32 MaxStepsPerFrame, int32 MaxPendingSnapshots);
+
+	// Stops the background simulation, keeping the latest generation it produced.
+	UFUNCTION(BlueprintCallable)
+	void StopAsyncSimulation();
+
+	// Moves the board to the latest generation produced by the background simulation. Should be called once per frame while simulating asynchronously. Returns whether or not the board changed.
+	UFUNCTION(BlueprintCallable)
+	bool ApplyLatestAsyncSnapshot();
+
+	// Returns whether or not this board is currently being simulated on a background thread.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool IsSimulatingAsync() const;
+
+	// Returns what it took to simulate the most recent generation with SimulateNextGeneration. All zero if the board had stopped changing and wasn't simulated.
+	const FGameBoardStepStats& GetLastStepStats() const;
+
+	// Returns the root of a board with the provided root advanced by one generation. Only reads immutable nodes, so this is safe to call from any thread.
+	// If StepStatsOut is provided, it is filled in with what the step took.
+	static TSharedPtr<const QuadTreeNode> ComputeNextGenerationOfRoot(const TSharedPtr<const QuadTreeNode> RootNode, const FLifeRule& Rule, FGameBoardStepStats* StepStatsOut = nullptr);
+
+	virtual void BeginDestroy() override;
+
 	// Returns a string representing a portion of the board indicated by DesiredDimension and Coordinate. For Debug purposes.
 	FString GetBoardStringForBlockOfDimensionContainingCoordinate(uint64 DesiredDimension, const FBoardCoordinate Coordinate) const;
 
@@ -51,6 +208,32 @@ public:
 	void GetLocalLiveCellCoordinatesFromFoundBlock(uint64 DesiredDimensionOfBlock, const FBoardCoordinate CoordinateToFind, TArray<FBoardCoordinate>& ResultsOut) const;
 
 	TSharedPtr<const QuadTreeNode> GetBlockOfDimensionContainingCoordinate(uint64 DesiredDimensionOfBlock, uint64 X, uint64 Y) const;
+
+	// Returns the root node of the quadtree representing the current board.
+	TSharedPtr<const QuadTreeNode> GetRootNode() const;
+
+	// Puts the smallest rectangle containing every live cell on the board in BoundsOut. Returns false, leaving BoundsOut alone, if the board is empty.
+	// Every node keeps the bounds of its own live cells, so this doesn't have to look through the board.
+	UFUNCTION(BlueprintCallable)
+	bool GetLiveBounds(FBoardRect& BoundsOut) const;
+
+	// Returns a tree holding only the cells of the board inside Rect, moved so that Rect's southwest corner is at the origin. Shares nodes with the board wherever Rect lines up with them.
+	// Returns nullptr if Rect is empty.
+	TSharedPtr<const QuadTreeNode> ExtractRegion(const FBoardRect& Rect) const;
+
+	// Returns the cells that differ between this board and Other, cropped to the smallest rectangle holding all of them and moved so that its southwest corner is at the origin, and puts that rectangle in ChangedRectOut.
+	// Like Combine, this only visits the nodes where the boards differ. Returns nullptr, leaving ChangedRectOut alone, if the boards are the same or can't be compared.
+	TSharedPtr<const QuadTreeNode> Diff(const UGameBoard* Other, FBoardRect& ChangedRectOut) const;
+
+	// Returns a tree holding only the cells inside Rect at Generation, moved so that Rect's southwest corner is at the origin, without simulating the rest of the board or changing it.
+	// Only Rect grown by one cell per generation on every side is simulated, starting from the closest generation on hand that isn't past Generation, and far jumps are taken in large strides.
+	// Returns nullptr if Rect is empty, Generation is older than any we remember, or the jump is too far to simulate.
+	TSharedPtr<const QuadTreeNode> GetRegionAtGeneration(const FBoardRect& Rect, int64 Generation) const;
+
+	// Fills MatchesOut with every place Pattern occurs on the board. Only the shape of Pattern matters, not where its cells are. If AllOrientations is set, rotated and mirrored copies are looked for too,
+	// and a BorderWidth above 0 only accepts matches with that many dead cells all around them. The board is indexed the first time it's searched after it changes, so searching it for several patterns only indexes it once.
+	UFUNCTION(BlueprintCallable)
+	void FindPattern(const TArray<FBoardCoordinate>& Pattern, bool AllOrientations, int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const;
 	
 private:
 	// The dimensions of the board on one side. Must be a power of two. Boards are always square.
@@ -62,16 +245,67 @@ private:
 	// Root node of the quadtree representing our current board.
 	TSharedPtr<const QuadTreeNode> mRootNode;
 
+	// The number of generations this board has been simulated for.
+	int64 mGeneration;
+
+	// The rule this board follows.
+	const FLifeRule* mRule;
+
+	// What it took to simulate the most recent generation with SimulateNextGeneration.
+	FGameBoardStepStats mLastStepStats;
+
+	// Watches for the board repeating itself.
+	FBoardPeriodDetector mPeriodDetector;
+
+	// Forgets what we know about the board's periodicity and starts watching again from the current generation.
+	void ResetPeriodDetection();
+
+	// Past generations we can go back to. Holding on to their roots keeps their nodes alive.
+	FBoardHistory mHistory;
+
+	// Updates the period detector and the history after the board was changed by something other than simulating it.
+	void OnBoardEdited();
+
+	// Adds the current generation to the history, and to the checkpoint stream if one is due or ForceCheckpoint is set.
+	void RecordGeneration(const bool ForceCheckpoint = false);
+
+	// Where the board is checkpointed to, while it is.
+	TUniquePtr<FBoardCheckpointStream> mCheckpointStream;
+
+	// How many generations apart checkpoints are written.
+	int64 mCheckpointEvery = 1;
+
+	// The generation of the last checkpoint written.
+	int64 mLastCheckpointGeneration = 0;
+
+	// Serves the board to spectators, while it is.
+	TUniquePtr<FBoardReplicationServer> mReplicationServer;
+
+	// Watches another board, while this one is a spectator.
+	TUniquePtr<FBoardReplicationClient> mReplicationClient;
+
+	// How many generations apart the board's nodes are compacted. 0 if they aren't.
+	int32 mNodeCompactionInterval = 0;
+
+	// The number of generations simulated since the board's nodes were last compacted.
+	int32 mGenerationsSinceCompaction = 0;
+
+	// Runs the simulation on a background thread while it is active.
+	TUniquePtr<FAsyncBoardSimulator> mAsyncSimulator;
+
+	// The index FindPattern last searched, kept until the board changes.
+	mutable TUniquePtr<FPatternSearch> mPatternSearch;
+
 	// Given a quadrant, returns the quadrant that is above or below it.
-	ChildNode GetOpposingVerticalQuadrant(ChildNode Child) const;
+	static ChildNode GetOpposingVerticalQuadrant(ChildNode Child);
 	
 	// Given a quadrant, returns the quadrant that is to the left or right of it.
-	ChildNode GetOpposingHorizontalQuadrant(ChildNode Child) const;
+	static ChildNode GetOpposingHorizontalQuadrant(ChildNode Child);
 
 	// Given a quadrant, returns the quadrant that is diagonal, from it.
-	ChildNode GetOpposingDiagonalQuadrant(ChildNode Child) const;
+	static ChildNode GetOpposingDiagonalQuadrant(ChildNode Child);
 
-	// Constructs a new board with the provided quadrant in the center. Will have dimension (mBoardDimension / 2).
-	TSharedPtr<const QuadTreeNode> ConstructBoardWithCenteredQuadrant(ChildNode QuadrantToCenter) const;
+	// Constructs a new board with the provided quadrant of RootNode in the center. Has the same dimension as RootNode, and wraps around its edges.
+	static TSharedPtr<const QuadTreeNode> ConstructBoardWithCenteredQuadrant(const TSharedPtr<const QuadTreeNode> RootNode, ChildNode QuadrantToCenter);
 };
 
@@ -0,0 +1,10 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// Groups every stat the simulation reports. View it in game with "stat GameOfLife".
+DECLARE_STATS_GROUP(TEXT("Game Of Life"), STATGROUP_GameOfLife, STATCAT_Advanced);
@@ -0,0 +1,60 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * An outer-totalistic rule for a Life-like cellular automaton, such as Conway's Life (B3/S23), HighLife (B36/S23), Day & Night (B3678/S34678) or Seeds (B2/S).
+ * Every rule precomputes how each possible 4x4 block evolves, so simulating with one never branches on the rule itself.
+ * Rules are shared: asking for the same rule twice returns the same FLifeRule, and rules are never destroyed. That lets us tell rules apart by pointer.
+ */
+class CONWAYSGAMEOFLIFE_API FLifeRule
+{
+public:
+	// Returns the rule described by RuleString, creating it the first time it's asked for. Accepts "B3/S23" style rulestrings, and the older "23/3" style with the survival counts first.
+	// Returns nullptr and logs an error if RuleString can't be parsed, or describes a rule we can't simulate.
+	static const FLifeRule* FindOrCreate(const FString& RuleString);
+
+	// Returns Conway's Life, B3/S23.
+	static const FLifeRule& GetConwaysLife();
+
+	// Returns this rule as a rulestring in "B3/S23" form.
+	const FString& GetRuleString() const;
+
+	// Returns whether or not a cell is alive in the next generation, given whether it is alive now and how many of its eight neighbors are.
+	bool GetIsAliveInNextGeneration(const bool IsAlive, const int32 NumLiveNeighbors) const;
+
+	// Returns a mask with bit N set if a dead cell with N live neighbors comes alive.
+	uint16 GetBirthMask() const;
+
+	// Returns a mask with bit N set if a live cell with N live neighbors stays alive.
+	uint16 GetSurvivalMask() const;
+
+	// Given a 4x4 block of cells, returns its interior 2x2 block advanced one generation.
+	// Both are bitsets with rows from north to south and cells from west to east within a row, the first cell in the highest bit.
+	FORCEINLINE uint8 Run4x4Block(const uint16 Block) const
+	{
+		return mResultTable[Block];
+	}
+
+private:
+	// Creates a rule from masks of neighbor counts and precomputes its result table.
+	FLifeRule(const uint16 BirthMask, const uint16 SurvivalMask);
+
+	// Reads the neighbor counts out of a rulestring. Returns false if RuleString isn't a rulestring.
+	static bool ParseRuleString(const FString& RuleString, uint16& BirthMaskOut, uint16& SurvivalMaskOut);
+
+	// Bit N is set if a dead cell with N live neighbors comes alive.
+	const uint16 mBirthMask;
+
+	// Bit N is set if a live cell with N live neighbors stays alive.
+	const uint16 mSurvivalMask;
+
+	// This rule in "B3/S23" form.
+	FString mRuleString;
+
+	// The result of Run4x4Block for every possible 4x4 block.
+	TArray<uint8> mResultTable;
+};
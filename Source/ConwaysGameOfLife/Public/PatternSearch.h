@@ -0,0 +1,93 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BoardUtilities.h"
+#include "PatternSearch.generated.h"
+
+class QuadTreeNode;
+
+/**
+ * One place a pattern was found on a board.
+ */
+USTRUCT(BlueprintType)
+struct FPatternMatch
+{
+	GENERATED_BODY()
+
+public:
+	// The southwest corner of the pattern's bounding box where it was found.
+	FBoardCoordinate mPosition;
+
+	// Which way round the pattern was found. 0 is the pattern as given, 1 to 3 turn it 90, 180 and 270 degrees counterclockwise, and 4 to 7 do the same after mirroring it east to west.
+	int32 mOrientation = 0;
+
+	// The width of the pattern's bounding box in this orientation.
+	int32 mWidth = 0;
+
+	// The height of the pattern's bounding box in this orientation.
+	int32 mHeight = 0;
+};
+
+/**
+ * Finds every place a small pattern occurs on a board.
+ * Opening a search indexes every live 8x8 block of the board twice over: by position, and by node, listing every position each distinct block occurs at.
+ * Nodes are deduplicated, so blocks are compared by pointer and a debris field with many copies of the same block only has to be looked at once per distinct block.
+ * A pattern matches where the cells inside its bounding box, and optionally a border of dead cells around it, are exactly the pattern's. Cells further out don't matter.
+ * Boards wrap around at their edges, so a match can straddle the edge, and its position is where its southwest corner ends up after wrapping.
+ * For each orientation and each of the 64 ways the pattern can sit across the 8x8 grid, one block of the pattern is used to find candidates and the rest are checked against those candidates.
+ * Blocks the pattern covers completely are looked up by node identity. Blocks it only partly covers are compared bitwise against every distinct block on the board.
+ */
+class CONWAYSGAMEOFLIFE_API FPatternSearch
+{
+public:
+	// Indexes the board rooted at RootNode. The search holds on to the board, so it stays valid however the board it came from changes.
+	explicit FPatternSearch(const TSharedPtr<const QuadTreeNode>& RootNode);
+
+	// Adds every place Pattern occurs to MatchesOut, sorted from south to north and west to east. Only the shape of Pattern matters, not where its cells are.
+	// If AllOrientations is set, rotated and mirrored copies of Pattern are looked for as well. A BorderWidth above 0 only accepts matches with that many dead cells all around them.
+	void FindPattern(const TArray<FBoardCoordinate>& Pattern, const bool AllOrientations, const int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const;
+
+	// Returns the root of the board this search indexed.
+	const TSharedPtr<const QuadTreeNode>& GetRootNode() const;
+
+	// Returns the number of live 8x8 blocks on the board.
+	int32 GetNumBlocks() const;
+
+	// Returns the number of distinct live 8x8 blocks on the board.
+	int32 GetNumDistinctBlocks() const;
+
+private:
+	// Every position one distinct block occurs at.
+	struct FBlockOccurrences
+	{
+		// The block's cells, as returned by QuadTreeNode::GetBlockBitmap.
+		uint64 mBitmap = 0;
+
+		// The positions the block occurs at, in units of blocks.
+		TArray<FBoardCoordinate> mPositions;
+	};
+
+	// Adds every live block of Node to the index. BlockX and BlockY are where Node's southwest corner is, in units of blocks.
+	void IndexNode(const QuadTreeNode& Node, const uint64 BlockX, const uint64 BlockY);
+
+	// Adds every place the pattern made of Cells, normalized so its bounding box starts at the origin and Width by Height big, occurs to MatchesOut.
+	void FindOrientedPattern(const TSet<FBoardCoordinate>& Cells, const int32 Width, const int32 Height, const int32 Orientation, const int32 BorderWidth, TArray<FPatternMatch>& MatchesOut) const;
+
+	// Returns the cells of the block at BlockX and BlockY, in units of blocks. Positions off the board wrap around to the other side, and positions without a live block are dead.
+	uint64 GetBlockBitmap(const uint64 BlockX, const uint64 BlockY) const;
+
+	// The board we indexed. Keeping it alive keeps the node pointers below valid.
+	TSharedPtr<const QuadTreeNode> mRootNode;
+
+	// The number of blocks along each side of the board, less one. Block positions are wrapped onto the board with it.
+	uint64 mBlockMask = 0;
+
+	// The cells of every live block, by position in units of blocks.
+	TMap<FBoardCoordinate, uint64> mBlocks;
+
+	// Every distinct live block, with every position it occurs at.
+	TMap<const QuadTreeNode*, FBlockOccurrences> mOccurrences;
+};
@@ -0,0 +1,232 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeRWLock.h"
+
+#include <atomic>
+
+class FLifeRule;
+class IMappedFileHandle;
+class IMappedFileRegion;
+class QuadTreeNode;
+
+/**
+ * How much a persistent result cache holds, and how much use it has been.
+ */
+struct FPersistentResultCacheStats
+{
+	// The size of the cache file, including anything not yet written out, in bytes.
+	int64 mFileBytes = 0;
+
+	// The number of results the file holds.
+	int64 mNumResults = 0;
+
+	// The number of node definitions the file holds.
+	int64 mNumNodes = 0;
+
+	// The number of results read back out of the file since it was opened.
+	uint64 mNumLoads = 0;
+
+	// The number of results added to the file since it was opened.
+	uint64 mNumStores = 0;
+
+	// Whether or not the file has reached its size limit and stopped taking new results.
+	bool mIsFull = false;
+};
+
+/**
+ * A result cache that outlives the process, so runs simulating patterns that earlier runs already simulated don't start from a cold cache.
+ * Results are keyed by the content hash of the node they belong to and by the rule, so they stay valid across runs even though node addresses don't.
+ * Each result also holds the node's translation invariant hash and population, which are checked on lookup, so a collision of the content hash alone gives a miss rather than someone else's result.
+ * The file is append-only: a header followed by fixed size records, each either a node definition, a result, or a note that a result was used.
+ * Node definitions go down to level 4, below which 8x8 blocks are stored inline as 64 bit bitmaps. Only results for nodes of kMinLevel and up are stored,
+ * since smaller ones are quicker to recompute than to load.
+ * Opening the file only builds an index of where each record is. The file is memory mapped, and a result's nodes are only rebuilt the first time it's looked up.
+ * Once the file grows past its size limit no more results are added, and the next time it's opened it's compacted down to half the limit, keeping the most recently used results.
+ */
+class CONWAYSGAMEOFLIFE_API FPersistentResultCache
+{
+public:
+	// Opens the cache file at Filename, creating it if needed, and compacting it if it's grown past MaxFileBytes. Returns nullptr if the file can't be used.
+	static TUniquePtr<FPersistentResultCache> Open(const FString& Filename, const int64 MaxFileBytes);
+
+	// Writes out anything not yet in the file.
+	~FPersistentResultCache();
+
+	// Returns Node's next generation under Rule if the file has it, rebuilding its nodes out of the file. Returns nullptr otherwise.
+	TSharedPtr<const QuadTreeNode> FindNextGeneration(const QuadTreeNode& Node, const FLifeRule& Rule);
+
+	// Adds NextGeneration to the file as Node's next generation under Rule, along with the definitions of any of its nodes the file doesn't have yet.
+	void AddNextGeneration(const QuadTreeNode& Node, const FLifeRule& Rule, const TSharedPtr<const QuadTreeNode>& NextGeneration);
+
+	// Writes out everything added so far.
+	void Flush();
+
+	// Returns how much the file holds.
+	FPersistentResultCacheStats GetStats() const;
+
+	// The lowest level of node whose results are stored.
+	static constexpr uint8 kMinLevel = 6;
+
+private:
+	// One record of the file. Every record has the same size, so the file can be read back without any framing.
+	struct FRecord
+	{
+		// What kind of record this is, an ERecordType.
+		uint8 mType = 0;
+
+		// The level of the node this record is about.
+		uint8 mLevel = 0;
+
+		uint8 mPadding[6] = {};
+
+		// The hash of the node this record is about.
+		uint64 mHash = 0;
+
+		// For node definitions, each child by ChildNode, as a hash if it has a definition of its own and as a bitmap if it's an 8x8 block.
+		// For results and uses, the rule in mData[0]. For results, the hash of the next generation in mData[1], and the node's translation invariant hash and population in mData[2] and mData[3].
+		uint64 mData[4] = {};
+	};
+
+	// The kinds of records in the file.
+	enum ERecordType : uint8
+	{
+		NodeDefinition = 1,
+		Result = 2,
+		Use = 3,
+	};
+
+	// Identifies a result in the file.
+	struct FResultKey
+	{
+		// The hash of the node that was advanced.
+		uint64 mNodeHash = 0;
+
+		// The level of the node that was advanced.
+		uint8 mLevel = 0;
+
+		// The rule it was advanced under, as returned by GetRuleKey.
+		uint64 mRuleKey = 0;
+
+		bool operator==(const FResultKey& Other) const
+		{
+			return (mNodeHash == Other.mNodeHash) && (mLevel == Other.mLevel) && (mRuleKey == Other.mRuleKey);
+		}
+
+		friend uint32 GetTypeHash(const FResultKey& Key)
+		{
+			return HashCombine(::GetTypeHash(Key.mNodeHash), HashCombine(::GetTypeHash(Key.mLevel), ::GetTypeHash(Key.mRuleKey)));
+		}
+	};
+
+	// Where to find a result.
+	struct FResultEntry
+	{
+		// The hash of the next generation.
+		uint64 mNextGenerationHash = 0;
+
+		// The translation invariant hash and population of the node that was advanced, checked on lookup to tell it apart from other nodes with the same content hash.
+		uint64 mNodeCheckHash = 0;
+		uint64 mNodePopulation = 0;
+
+		// The offset of the last record that added or used this result. Later records were written more recently.
+		int64 mLastUsedOffset = 0;
+	};
+
+	FPersistentResultCache(const FString& Filename, const int64 MaxFileBytes);
+
+	// Maps the file and indexes every record in it. Returns false if it isn't a cache file, or was written by an incompatible version.
+	bool LoadIndex();
+
+	// Rewrites the file with only the most recently used results, until it's about half of mMaxFileBytes. Returns false if the file couldn't be rewritten.
+	bool Compact();
+
+	// Maps the whole file as it is on disk, replacing any earlier mapping.
+	bool MapFile();
+
+	// Returns the record at Offset, from the mapping, mFlushingRecords or mPendingRecords.
+	const FRecord& GetRecord(const int64 Offset) const;
+
+	// Queues Record to be written, and returns its offset. Sets ShouldFlushOut if enough records have built up that they should be written out once mLock is released. mLock must be held for writing.
+	int64 AppendRecord(const FRecord& Record, bool& ShouldFlushOut);
+
+	// Queues definitions for Node and every node below it that the file doesn't have yet. Returns the reference to Node a parent's definition should hold.
+	uint64 AppendNodeDefinitions(const TSharedPtr<const QuadTreeNode>& Node, bool& ShouldFlushOut);
+
+	// Rebuilds the node at Level referred to by Reference, reusing any nodes that were rebuilt before and are still alive. Returns nullptr if the file is missing or has damaged some of its definitions. mLock must be held.
+	TSharedPtr<const QuadTreeNode> BuildNode(const uint64 Reference, const uint8 Level);
+
+	// Returns the node that was rebuilt for Reference earlier, if it's still alive, out of the map for 8x8 blocks if IsBlock is true and for nodes with definitions otherwise.
+	TSharedPtr<const QuadTreeNode> FindBuiltNode(const uint64 Reference, const bool IsBlock);
+
+	// Remembers that Node was rebuilt for Reference, and returns it.
+	TSharedPtr<const QuadTreeNode> AddBuiltNode(const uint64 Reference, const bool IsBlock, const TSharedPtr<const QuadTreeNode>& Node);
+
+	// Adds the hashes of the node at Level with Hash and every node below it with a definition to GatheredHashes, and the definitions of those that weren't already there to RecordsOut, children first.
+	// Returns false if the file is missing some of the definitions.
+	bool GatherNodeDefinitions(const uint64 Hash, const uint8 Level, TSet<uint64>& GatheredHashes, TArray<FRecord>* RecordsOut) const;
+
+	// Replaces the file at Filename with a new cache file holding Records.
+	static bool WriteFile(const FString& Filename, const TArray<FRecord>& Records);
+
+	// Returns a key identifying Rule that stays the same across runs.
+	static uint64 GetRuleKey(const FLifeRule& Rule);
+
+	// The path of the cache file.
+	FString mFilename;
+
+	// Past this size the file stops taking new results.
+	int64 mMaxFileBytes;
+
+	// Guards everything below. Lookups only read, so they can run side by side.
+	mutable FRWLock mLock;
+
+	// The open mapping of the file, if it's long enough to hold any records.
+	TUniquePtr<IMappedFileHandle> mMappedFile;
+	TUniquePtr<IMappedFileRegion> mMappedRegion;
+
+	// The number of bytes of the file that are mapped. Records from here on are in mPendingRecords.
+	int64 mMappedBytes = 0;
+
+	// The size of the file when it was opened. Records before this were written by earlier runs.
+	int64 mOpenedBytes = 0;
+
+	// Records being written out by Flush. They come right after the mapped part of the file, and are read from here until the file is mapped again.
+	TArray<FRecord> mFlushingRecords;
+
+	// Records that haven't been written out yet. They come after mFlushingRecords.
+	TArray<FRecord> mPendingRecords;
+
+	// Held by Flush, so only one thread writes to the file at a time and mFlushingRecords is only changed by it. Taken before mLock.
+	FCriticalSection mFlushLock;
+
+	// The offset of every node definition, by the node's hash.
+	TMap<uint64, int64> mNodeOffsets;
+
+	// Every result in the file.
+	TMap<FResultKey, FResultEntry> mResults;
+
+	// Guards mBuiltNodes and mBuiltBlocks, which lookups change even though they only read the file.
+	FCriticalSection mBuiltNodesLock;
+
+	// The nodes rebuilt out of the file, by hash, for as long as something else keeps them alive. Consecutive generations share most of their nodes, so this saves rebuilding them for every result.
+	TMap<uint64, TWeakPtr<const QuadTreeNode>> mBuiltNodes;
+
+	// The same for 8x8 blocks, by bitmap.
+	TMap<uint64, TWeakPtr<const QuadTreeNode>> mBuiltBlocks;
+
+	// The number of entries in mBuiltNodes and mBuiltBlocks at which we next sweep out the ones whose nodes have died.
+	int32 mBuiltNodesPurgeThreshold = 1024;
+
+	// Set once the file passes mMaxFileBytes, or couldn't be written.
+	bool mIsFull = false;
+
+	// The number of results read back out of the file since it was opened.
+	std::atomic<uint64> mNumLoads = 0;
+
+	// The number of results added since the file was opened.
+	std::atomic<uint64> mNumStores = 0;
+};
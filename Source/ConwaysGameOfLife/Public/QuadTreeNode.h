@@ -5,6 +5,15 @@
 
 #include "CoreMinimal.h"
 
+#include <atomic>
+
+struct FBoardCoordinate;
+struct FBoardRect;
+class FLifeRule;
+class FPersistentResultCache;
+enum class EBoardOperation : uint8;
+enum class EBoardSymmetry : uint8;
+
 // The different quadrants/children that are present in one QuadTreeNode.
 enum ChildNode : int8
 {
@@ -16,9 +25,87 @@ enum ChildNode : int8
 	kCount = 4
 };
 
+/**
+ * Counters describing how much work the simulation has done.
+ * QuadTreeNode::GetSimulationStats adds every counter up from program start across all boards, while an FQuadTreeSimulationStatsScope gathers only the work done inside it.
+ */
+struct FQuadTreeSimulationStats
+{
+	// The number of nodes that were allocated.
+	uint64 mNodesCreated = 0;
+
+	// The number of times GetNextGeneration found a node's result in the result cache.
+	uint64 mResultCacheHits = 0;
+
+	// The number of times GetNextGeneration had to compute and cache a node's result.
+	uint64 mResultCacheMisses = 0;
+
+	// The number of result cache misses whose result was read out of the persistent result cache instead of being computed.
+	uint64 mPersistentCacheHits = 0;
+
+	// The number of 4x4 blocks that were simulated cell by cell.
+	uint64 mBaseCaseInvocations = 0;
+
+	// The number of quadrants that were handed to ParallelFor to be simulated on another thread.
+	uint64 mParallelTasks = 0;
+
+	// The lowest level GetNextGeneration recursed down to since the last call to QuadTreeNode::ResetLowestLevelReached, or while these stats were being gathered by an FQuadTreeSimulationStatsScope. UINT8_MAX if it hasn't run since.
+	uint8 mLowestLevelReached = UINT8_MAX;
+
+	// Returns the work done between Earlier and these stats. mLowestLevelReached is kept as is.
+	FQuadTreeSimulationStats operator-(const FQuadTreeSimulationStats& Earlier) const;
+
+	// Adds the work in Other to these stats, keeping the lower of the two lowest levels reached.
+	FQuadTreeSimulationStats& operator+=(const FQuadTreeSimulationStats& Other);
+};
+
+/**
+ * Gathers the simulation work done on the calling thread while it's in scope into a set of stats, including the quadrants GetNextGeneration hands to other threads.
+ * Unlike the difference of two QuadTreeNode::GetSimulationStats calls, the work of other boards simulating at the same time doesn't show up in them.
+ */
+class CONWAYSGAMEOFLIFE_API FQuadTreeSimulationStatsScope
+{
+public:
+	// Starts adding this thread's work to StatsOut. Passing nullptr stops any gathering on this thread until the scope ends.
+	explicit FQuadTreeSimulationStatsScope(FQuadTreeSimulationStats* StatsOut);
+	~FQuadTreeSimulationStatsScope();
+
+	FQuadTreeSimulationStatsScope(const FQuadTreeSimulationStatsScope&) = delete;
+	FQuadTreeSimulationStatsScope& operator=(const FQuadTreeSimulationStatsScope&) = delete;
+
+	// Returns the stats the calling thread's work is being added to, or nullptr if none are being gathered.
+	static FQuadTreeSimulationStats* GetCurrentStats();
+
+private:
+	// The stats that were being gathered on this thread before this scope started, put back when it ends.
+	FQuadTreeSimulationStats* mPreviousStats;
+};
+
+/**
+ * What one call to QuadTreeNode::CompactNodes did.
+ */
+struct FQuadTreeCompactionStats
+{
+	// The number of nodes that were moved.
+	int64 mNodesMoved = 0;
+
+	// The number of live nodes below the roots that were left where they were, because something else still holds on to them or to a node above them.
+	int64 mNodesLeftInPlace = 0;
+
+	// The number of bytes of arena the moved nodes were laid out in.
+	int64 mArenaBytes = 0;
+
+	// The number of bytes of node slabs given back to the heap, because every node allocated from them had died.
+	int64 mSlabBytesReleased = 0;
+
+	// The wall clock time the compaction took, in seconds.
+	double mSeconds = 0.0;
+};
+
 /**
  * A class representing one node of a QuadTree that contains data for the Game of Life board.
  * Utilizes unsigned int coordinates to support the max size of the board.
+ * Nodes are deduplicated as they are created, so two nodes with the same contents are always the same object and can be compared by pointer.
  */
 class CONWAYSGAMEOFLIFE_API QuadTreeNode
 {
@@ -32,6 +119,91 @@ public:
 	// Create a leaf. 
 	static TSharedPtr<const QuadTreeNode> CreateLeaf(bool IsAlive);
 
+	// Creates the 8x8 node whose cells are in Bitmap, as returned by GetBlockBitmap.
+	static TSharedPtr<const QuadTreeNode> CreateBlockFromBitmap(const uint64 Bitmap);
+
+	// Returns a node that is the same as Node, but with every cell in LocalCoordinates set to alive. Much faster than setting cells one at a time for large patterns.
+	// LocalCoordinates are relative to Node, and are reordered and rewritten in place.
+	static TSharedPtr<const QuadTreeNode> SetCellsToAlive(const TSharedPtr<const QuadTreeNode> Node, TArrayView<FBoardCoordinate> LocalCoordinates);
+
+	// Returns a node that is the same as Node, but with every cell outside Rect cleared. Rect is local to Node. Children whose live cells all lie inside Rect are reused as they are,
+	// so only the nodes along Rect's edges are rebuilt.
+	static TSharedPtr<const QuadTreeNode> CropToRect(const TSharedPtr<const QuadTreeNode> Node, const FBoardRect& Rect);
+
+	// Returns a node holding only the cells of Node inside Rect, moved so that Rect's southwest corner is at the origin. Rect is local to Node, and anything past Node's edges is dead.
+	// The result is the smallest node that fits Rect, and at least 8x8. Wherever Rect lines up with Node's children they are reused as they are. Returns nullptr if Rect is empty.
+	static TSharedPtr<const QuadTreeNode> ExtractRegion(const TSharedPtr<const QuadTreeNode> Node, const FBoardRect& Rect);
+
+	// Returns a node representing how the centered half of Node would look NumGenerations later under Rule. NumGenerations can be at most a quarter of Node's dimension, since nothing further out can reach the center sooner.
+	// Big jumps are split into halves the way hashlife does, and repeated pieces are only simulated once, so a jump costs about as much as the pattern's activity over its largest power of two, not over every generation.
+	static TSharedPtr<const QuadTreeNode> GetFutureCenter(const TSharedPtr<const QuadTreeNode> Node, const uint64 NumGenerations, const FLifeRule& Rule);
+
+	// Returns the cells inside Rect, NumGenerations after the board rooted at RootNode, moved so that Rect's southwest corner is at the origin. The board wraps around at its edges, as it does when it's simulated.
+	// Only Rect's backward light cone, Rect grown by NumGenerations cells on every side, is simulated, however big the board is. Returns nullptr if Rect is empty, or too big to simulate that far.
+	static TSharedPtr<const QuadTreeNode> GetRegionAfterGenerations(const TSharedPtr<const QuadTreeNode> RootNode, const FBoardRect& Rect, const uint64 NumGenerations, const FLifeRule& Rule);
+
+	// Returns a node whose cells are those of A and B combined by Operation. A and B must be the same size. Children that are the same node, or empty, are settled without looking inside them,
+	// and pairs of children that come up more than once are only combined once, so the cost follows the number of nodes where A and B differ rather than their area. Returns nullptr if A and B are different sizes.
+	static TSharedPtr<const QuadTreeNode> Combine(const TSharedPtr<const QuadTreeNode> A, const TSharedPtr<const QuadTreeNode> B, const EBoardOperation Operation);
+
+	// Returns Node turned and mirrored by Symmetry within its own square. Each child is moved to the quadrant Symmetry takes it to and transformed in turn, and nodes that come up more than once
+	// are only transformed once, so the cost follows the number of distinct nodes rather than the population.
+	static TSharedPtr<const QuadTreeNode> Transform(const TSharedPtr<const QuadTreeNode> Node, const EBoardSymmetry Symmetry);
+
+	// Returns Node with every cell moved DeltaX cells east and DeltaY cells north, wrapping around Node's edges. The result is pieced together out of windows onto Node's children rather than cell by cell,
+	// so the cost follows the number of distinct nodes rather than the population, and moving by a multiple of a child's size just swaps the children around.
+	static TSharedPtr<const QuadTreeNode> Translate(const TSharedPtr<const QuadTreeNode> Node, const uint64 DeltaX, const uint64 DeltaY);
+
+	// Limits how many threads GetNextGeneration fans out to. NumThreads <= 0 removes the limit, and 1 runs everything on the calling thread.
+	static void SetMaxSimulationThreads(const int32 NumThreads);
+
+	// Returns how many levels of the tree GetNextGeneration should split across threads before continuing on one thread.
+	static int32 GetMaxParallelDepth();
+
+	// Returns the number of nodes that currently exist.
+	static int64 GetLiveNodeCount();
+
+	// Returns the largest number of nodes that have existed at the same time.
+	static int64 GetPeakLiveNodeCount();
+
+	// Resets the peak node count to the number of nodes that currently exist.
+	static void ResetPeakLiveNodeCount();
+
+	// Returns the memory each node takes: its own slot, plus the reference controller its shared pointer allocates next to it.
+	static SIZE_T GetBytesPerNode();
+
+	// Allocates and frees memory for one node the way CreateNodeWithSubnodes does, out of the calling thread's cache of slots. Only meant for measuring the allocator on its own.
+	static void* AllocateNodeMemory();
+	static void FreeNodeMemory(void* Memory);
+
+	// Returns the work the simulation has done so far, summed across every thread.
+	static FQuadTreeSimulationStats GetSimulationStats();
+
+	// Starts tracking the lowest level reached by GetNextGeneration over again.
+	static void ResetLowestLevelReached();
+
+	// Returns the number of results currently held by the result cache.
+	static int64 GetCachedResultCount();
+
+	// Limits how many results the result cache holds before it starts over. Cached results keep their nodes alive, so this also bounds memory.
+	static void SetMaxCachedResults(const int64 MaxCachedResults);
+
+	// Throws away every cached result, releasing the nodes they kept alive.
+	static void ClearResultCache();
+
+	// Backs the result cache with the file at Filename, so results computed by earlier runs are reused and results computed by this run are kept for later ones.
+	// The file stops growing past MaxFileBytes. Pass an empty Filename to close the file. Returns false if the file couldn't be opened. Must not be called while simulating.
+	static bool SetPersistentResultCache(const FString& Filename, const int64 MaxFileBytes = 256 * 1024 * 1024);
+
+	// Returns the file backing the result cache, or nullptr if there isn't one.
+	static FPersistentResultCache* GetPersistentResultCache();
+
+	// Moves every node below RootNodes into freshly allocated, contiguous memory, laid out depth first with the top levels first and each node's children side by side, and points each root at its new copy.
+	// Nodes allocated as a board evolves end up scattered all over the heap, so walking the tree misses the CPU caches on almost every step; after compacting, parents and children mostly share cache lines and pages.
+	// The nodes the result cache holds are moved too, after those of the roots. A node is only moved if every reference to it is one we can update: a root, the result cache, or a parent that is moving too. Anything else holding on to a node keeps it, and everything below it, where it is,
+	// so nodes stay deduplicated. Waits for other threads to finish whatever they're doing with nodes and holds off new work until it's done, so other boards can keep simulating around it; it must not be called while simulating on the calling thread.
+	static FQuadTreeCompactionStats CompactNodes(TArrayView<TSharedPtr<const QuadTreeNode>* const> RootNodes);
+
 private:
 	// The canonical live cell. We have only one of these in order to cut down on memory requirements.
 	static TSharedPtr<const QuadTreeNode> sCanonicalLiveCell;
@@ -39,8 +211,110 @@ private:
 	// The canonical dead cell. We have only one of these in order to cut down on memory requirements.
 	static TSharedPtr<const QuadTreeNode> sCanonicalDeadCell;
 
-	// Given a bitset representing a neighborhood (block of nine cells), return a leaf representing the center cell in the next generation.
-	static TSharedPtr<const QuadTreeNode> GetNextGenerationCellFromNeighborhood(uint16 NeighborhoodBitset);
+	// How many levels of the tree GetNextGeneration splits across threads.
+	static int32 sMaxParallelDepth;
+
+	// The number of nodes that currently exist.
+	static std::atomic<int64> sLiveNodeCount;
+
+	// The largest number of nodes that have existed at the same time.
+	static std::atomic<int64> sPeakLiveNodeCount;
+
+	// Records that a node was created, for our node counts.
+	static void TrackNodeCreated();
+
+	// The largest number of results the result cache holds before it starts over.
+	static std::atomic<int64> sMaxCachedResults;
+
+	// The file backing the result cache, if any.
+	static TUniquePtr<FPersistentResultCache> sPersistentResultCache;
+
+	// Returns Node's next generation under Rule from the result cache, computing and caching it first if needed.
+	static TSharedPtr<const QuadTreeNode> GetCachedNextGeneration(const TSharedPtr<const QuadTreeNode>& Node, const FLifeRule& Rule, const int32 ParallelDepth);
+
+	// Identifies a window onto a 2x2 block of nodes while extracting a region.
+	struct FWindowKey
+	{
+		// The block, indexed by ChildNode.
+		const QuadTreeNode* mNodes[ChildNode::kCount] = {};
+
+		// How far the window's southwest corner is from the block's.
+		uint64 mOffsetX = 0;
+		uint64 mOffsetY = 0;
+
+		bool operator==(const FWindowKey& Other) const
+		{
+			return (FMemory::Memcmp(mNodes, Other.mNodes, sizeof(mNodes)) == 0) && (mOffsetX == Other.mOffsetX) && (mOffsetY == Other.mOffsetY);
+		}
+
+		friend uint32 GetTypeHash(const FWindowKey& Key)
+		{
+			uint32 Hash = HashCombine(::GetTypeHash(Key.mOffsetX), ::GetTypeHash(Key.mOffsetY));
+			for (const QuadTreeNode* Node : Key.mNodes)
+			{
+				Hash = HashCombine(Hash, PointerHash(Node));
+			}
+			return Hash;
+		}
+	};
+
+	// Returns the node at Level in column IndexX and row IndexY of the nodes at Level that make up Node, counting from the southwest. Anything past Node's edges is dead.
+	static TSharedPtr<const QuadTreeNode> GetAlignedNode(const TSharedPtr<const QuadTreeNode>& Node, const uint8 Level, const uint64 IndexX, const uint64 IndexY);
+
+	// Returns the node the size of each node of Block, a 2x2 block indexed by ChildNode, whose southwest corner is OffsetX, OffsetY cells from Block's. Offsets must be smaller than that size.
+	// Windows built earlier in the same extraction are found in Windows instead of being built again.
+	static TSharedPtr<const QuadTreeNode> GetWindow(const TSharedPtr<const QuadTreeNode> (&Block)[ChildNode::kCount], const uint64 OffsetX, const uint64 OffsetY, TMap<FWindowKey, TSharedPtr<const QuadTreeNode>>& Windows);
+
+	// Identifies a node advanced some number of generations while looking into the future.
+	struct FFutureKey
+	{
+		const QuadTreeNode* mNode = nullptr;
+		uint64 mNumGenerations = 0;
+
+		bool operator==(const FFutureKey& Other) const
+		{
+			return (mNode == Other.mNode) && (mNumGenerations == Other.mNumGenerations);
+		}
+
+		friend uint32 GetTypeHash(const FFutureKey& Key)
+		{
+			return HashCombine(PointerHash(Key.mNode), ::GetTypeHash(Key.mNumGenerations));
+		}
+	};
+
+	// The future of a node. Holds on to the node too, since it was often only built for the lookahead and its address could otherwise be reused by another node.
+	struct FFutureResult
+	{
+		TSharedPtr<const QuadTreeNode> mNode;
+		TSharedPtr<const QuadTreeNode> mFutureCenter;
+	};
+
+	// Does the work for GetFutureCenter. Futures computed earlier in the same lookahead are found in Futures instead of being computed again.
+	static TSharedPtr<const QuadTreeNode> ComputeFutureCenter(const TSharedPtr<const QuadTreeNode>& Node, const uint64 NumGenerations, const FLifeRule& Rule, TMap<FFutureKey, FFutureResult>& Futures);
+
+	// Identifies a pair of nodes combined while combining two trees.
+	struct FCombinationKey
+	{
+		EBoardOperation mOperation{};
+		const QuadTreeNode* mA = nullptr;
+		const QuadTreeNode* mB = nullptr;
+
+		bool operator==(const FCombinationKey& Other) const
+		{
+			return (mOperation == Other.mOperation) && (mA == Other.mA) && (mB == Other.mB);
+		}
+
+		friend uint32 GetTypeHash(const FCombinationKey& Key)
+		{
+			return HashCombine(::GetTypeHash((uint8)Key.mOperation), HashCombine(PointerHash(Key.mA), PointerHash(Key.mB)));
+		}
+	};
+
+	// Does the work for Combine. Pairs combined earlier in the same call are found in Combinations instead of being combined again. Both nodes of every pair are held by the trees being combined, so their addresses stay theirs.
+	static TSharedPtr<const QuadTreeNode> ComputeCombination(const TSharedPtr<const QuadTreeNode>& A, const TSharedPtr<const QuadTreeNode>& B, const EBoardOperation Operation, TMap<FCombinationKey, TSharedPtr<const QuadTreeNode>>& Combinations);
+
+	// Does the work for Transform. Nodes transformed earlier in the same call are found in Transformed instead of being transformed again. Every node is held by the tree being transformed, so its address stays its own.
+	static TSharedPtr<const QuadTreeNode> ComputeTransform(const TSharedPtr<const QuadTreeNode>& Node, const EBoardSymmetry Symmetry, TMap<const QuadTreeNode*, TSharedPtr<const QuadTreeNode>>& Transformed);
 
 public:
 	// The level of this node in the tree.
@@ -52,6 +326,8 @@ public:
 	// Basic constructor for a node. Returns a node at Level with the four provided nodes as children.
 	QuadTreeNode(const uint8 Level, const TSharedPtr<const QuadTreeNode> Northwest, const TSharedPtr<const QuadTreeNode> Northeast, const TSharedPtr<const QuadTreeNode> Southwest, const TSharedPtr<const QuadTreeNode> Southeast);
 
+	~QuadTreeNode();
+
 	// Basic == operator.
 	bool operator==(const QuadTreeNode& Other) const;
 
@@ -64,8 +340,15 @@ public:
 	// Returns the child node corresponding to Node.
 	TSharedPtr<const QuadTreeNode> GetChild(ChildNode Node) const;
 
-	// Returns a node representing how a centered GetNodeDimension()xGetNodeDimension() portion of this node would look if advanced one generation.
-	TSharedPtr<const QuadTreeNode> GetNextGeneration() const;
+	// Returns the cells of this node, which must be 8x8, with the cell at X and Y in bit Y * 8 + X. Small enough blocks are cheaper to store this way than as nodes.
+	uint64 GetBlockBitmap() const;
+
+	// The level of the nodes GetBlockBitmap and CreateBlockFromBitmap work with.
+	static constexpr uint8 kBlockLevel = 3;
+
+	// Returns a node representing how a centered GetNodeDimension()xGetNodeDimension() portion of this node would look if advanced one generation under Rule.
+	// The top ParallelDepth levels of the recursion are split across threads.
+	TSharedPtr<const QuadTreeNode> GetNextGeneration(const FLifeRule& Rule, const int32 ParallelDepth = GetMaxParallelDepth()) const;
 
 	// Constructs a node at mLevel - 1 using the cells at the center of this node.
 	TSharedPtr<const QuadTreeNode> ConstructCenteredChild() const;
@@ -94,6 +377,18 @@ public:
 	// Returns whether or not this node is alive, i.e. whether or not it contains any live cells.
 	bool IsAlive() const;
 
+	// Returns the number of live cells in this node. Saturates at UINT64_MAX for very large, very full nodes.
+	uint64 GetPopulation() const;
+
+	// Returns a hash of this node's contents. Nodes with the same cells always have the same hash, in every run.
+	uint64 GetHash() const;
+
+	// Returns a hash of this node's live cells that doesn't depend on where they are, so a pattern and a translated copy of it hash the same.
+	uint64 GetTranslationInvariantHash() const;
+
+	// Puts the smallest rectangle containing every live cell in BoundsOut, in coordinates local to this node. Returns false, leaving BoundsOut alone, if there are no live cells.
+	bool GetLiveBounds(FBoardRect& BoundsOut) const;
+
 	// Returns the node with size DesiredDimensionxDesiredDimension that contains the cell with coordinates (X, Y).
 	TSharedPtr<const QuadTreeNode> GetBlockOfDimensionContainingCoordinate(const uint64 DesiredDimension, const uint64 X, const uint64 Y) const;
 
@@ -104,11 +399,29 @@ private:
 	// Indicates whether or not this node contains any live cells.
 	bool mIsAlive;
 
+	// The number of live cells contained in this node.
+	uint64 mPopulation;
+
+	// A hash of this node's contents, built from our children's hashes.
+	uint64 mHash;
+
+	// The sum of A^x * B^y over every live cell (x, y) in this node, for two fixed odd constants A and B. Moving every cell by (dx, dy) multiplies it by A^dx * B^dy.
+	uint64 mTranslationHash;
+
+	// The smallest rectangle containing every live cell, local to this node. Only meaningful while mIsAlive is true.
+	uint64 mLiveMinX;
+	uint64 mLiveMinY;
+	uint64 mLiveMaxX;
+	uint64 mLiveMaxY;
+
 	// Returns the child node that X and Y are contained in. Puts the relative coordinates for X and Y within that child in the out params.
 	ChildNode GetChildAndLocalCoordinates(const uint64 X, const uint64 Y, uint64& LocalXOut, uint64& LocalYOut) const;
 
-	// Returns a node representing the centered 2x2 interior square of cells if they were advanced one generation.
-	TSharedPtr<const QuadTreeNode> Run4x4Simulation() const;
+	// Returns a node representing the centered 2x2 interior square of cells if they were advanced one generation under Rule.
+	TSharedPtr<const QuadTreeNode> Run4x4Simulation(const FLifeRule& Rule) const;
+
+	// Does the work for GetNextGeneration, without the profiling scopes that would be too costly at every level of the recursion.
+	TSharedPtr<const QuadTreeNode> ComputeNextGeneration(const FLifeRule& Rule, const int32 ParallelDepth) const;
 
 	// Constructs a node at level mLevel - 2 that is centered horizontally between the two provided quadrants.
 	TSharedPtr<const QuadTreeNode> ConstructHorizontalCenteredGrandchild(TSharedPtr<const QuadTreeNode> WestChildNode, TSharedPtr<const QuadTreeNode> EastChildNode) const;
@@ -0,0 +1,116 @@
+// Conway's Game Of Life in Unreal
+// Ilana Franklin, 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "QuadTreeNode.h"
+#include "BoardPeriodDetector.h"
+
+class FLifeRule;
+
+/**
+ * Describes a batch of random soups to run.
+ */
+struct FSoupSearchSettings
+{
+	// The rule every soup follows.
+	FString mRuleString = TEXT("B3/S23");
+
+	// Soups are generated from this seed and their index, so the same settings always produce the same soups.
+	int32 mSeed = 0;
+
+	// The number of soups to run.
+	int32 mNumSoups = 1000;
+
+	// Each soup starts out as a random square of cells with this dimension.
+	int32 mSoupDimension = 16;
+
+	// The chance of each cell in a soup starting out alive.
+	float mDensity = 0.5f;
+
+	// Each soup runs on a board with dimension 2^mBoardLevel, centered on it. Cells that leave the board are dropped, so escaping spaceships don't keep a soup from settling.
+	// Soups that reach the edge are flagged, since anything that would have grown past it is lost too.
+	uint8 mBoardLevel = 10;
+
+	// Soups that haven't settled after this many generations are given up on.
+	int64 mMaxGenerations = 20000;
+
+	// The longest period a soup can settle into and still be recognized.
+	int32 mMaxPeriod = 64;
+
+	// The number of threads to spread the soups across. 0 or less uses every core.
+	int32 mNumThreads = 0;
+};
+
+/**
+ * What happened to one soup.
+ */
+struct FSoupResult
+{
+	// The index of the soup within its batch.
+	int32 mSoupIndex = 0;
+
+	// The number of live cells the soup started out with.
+	uint64 mInitialPopulation = 0;
+
+	// The number of live cells the soup ended up with.
+	uint64 mFinalPopulation = 0;
+
+	// The number of generations the soup was run for.
+	int64 mGenerations = 0;
+
+	// How the soup settled down. Unknown if it didn't within mMaxGenerations.
+	FBoardPeriodicity mPeriodicity;
+
+	// Whether any live cell ever reached the edge of the soup's board. Cells beyond the edge are dropped, so such a soup may have been cut short of how it would have evolved on an unbounded board, and its periodicity is only what's left of it.
+	bool mReachedEdge = false;
+};
+
+/**
+ * What happened to a whole batch of soups.
+ */
+struct FSoupSearchResults
+{
+	// Every soup's result, in soup index order.
+	TArray<FSoupResult> mSoups;
+
+	// The number of soups that settled into each kind of periodicity, indexed by EBoardPeriodicity.
+	int32 mNumSoupsByPeriodicity[4] = {};
+
+	// The number of soups that settled into an oscillator or spaceship with each period.
+	TMap<int64, int32> mNumSoupsByPeriod;
+
+	// The number of soups that reached the edge of their board.
+	int32 mNumSoupsReachedEdge = 0;
+
+	// The wall clock time the batch took, in seconds.
+	double mSeconds = 0.0;
+
+	// The work the quadtree did for the whole batch.
+	FQuadTreeSimulationStats mSimulationStats;
+
+	// Returns the number of soups run per second.
+	double GetSoupsPerSecond() const;
+};
+
+/**
+ * Runs batches of small random soups until they settle down, like a census of what a rule tends to leave behind.
+ * Soups run concurrently, one per thread, and share the same deduplicated nodes and cached results, so debris that keeps coming up is only ever simulated once.
+ * Each soup lives on its own small board instead of a max size UGameBoard, which keeps the per-soup cost down to the cells it actually has.
+ */
+class CONWAYSGAMEOFLIFE_API FSoupSearch
+{
+public:
+	// Runs every soup described by Settings and puts what happened in ResultsOut. Returns false if the settings can't be run.
+	static bool Run(const FSoupSearchSettings& Settings, FSoupSearchResults& ResultsOut);
+
+	// Returns the starting board of the soup at SoupIndex, at level Settings.mBoardLevel.
+	static TSharedPtr<const QuadTreeNode> CreateSoup(const FSoupSearchSettings& Settings, const int32 SoupIndex);
+
+	// Runs the soup at SoupIndex until it settles down or runs out of generations.
+	static FSoupResult RunSoup(const FSoupSearchSettings& Settings, const FLifeRule& Rule, const int32 SoupIndex);
+
+	// Returns RootNode advanced one generation, treating every cell outside of it as dead. The result is at the same level as RootNode.
+	static TSharedPtr<const QuadTreeNode> SimulateBoundedGeneration(const TSharedPtr<const QuadTreeNode>& RootNode, const FLifeRule& Rule);
+};